@@ -1,12 +1,20 @@
+#include <algorithm>
 #include <boost/program_options.hpp>
 #include <fstream>
 #include <iostream>
+#include <mutex>
+#include <memory>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include <spdlog/spdlog.h>
 
+#include "logging.hpp"
 #include "messages.hpp"
 #include "multicast.hpp"
+#include "shmlog.hpp"
+#include "stats.hpp"
 
 
 /**
@@ -33,9 +41,68 @@ std::vector<std::string> parse_hostfile(const std::string& hostfile) {
   return hosts;
 }
 
+/**
+ * Print every delivered message, flushing stdout once per batch.
+ */
+class StdoutSink : public multicast::DeliverySink {
+ public:
+  explicit StdoutSink(uint32_t process_id) : process_id_{process_id} {}
+
+  void deliver(multicast::Delivery* deliveries, std::size_t count) override {
+    for (std::size_t i = 0; i < count; i++) {
+      const multicast::Delivery& m = deliveries[i];
+      std::cout << process_id_ << ": Processed message " << m.msg_id
+                << " with from sender " << m.sender << " with seq ("
+                << m.final_seq << ", " << m.final_seq_proposer << ")\n";
+    }
+    std::cout.flush();
+  }
+
+ private:
+  uint32_t process_id_;
+};
+
+/**
+ * Hand every batch to two sinks in turn. Neither may move from the
+ * deliveries.
+ */
+class TeeSink : public multicast::DeliverySink {
+ public:
+  TeeSink(multicast::DeliverySink& first, multicast::DeliverySink& second)
+      : first_{first}, second_{second} {}
+
+  void deliver(multicast::Delivery* deliveries, std::size_t count) override {
+    first_.deliver(deliveries, count);
+    second_.deliver(deliveries, count);
+  }
+
+ private:
+  multicast::DeliverySink& first_;
+  multicast::DeliverySink& second_;
+};
+
+/**
+ * Drain ring into sink forever, in batches of whatever has queued up.
+ */
+void print_deliveries(multicast::RingSink& ring,
+                      multicast::DeliverySink& sink) {
+  constexpr std::size_t kMaxBatch{256};
+  std::vector<multicast::Delivery> batch(kMaxBatch);
+  while (true) {
+    std::size_t count{};
+    while (count < kMaxBatch && ring.try_pop(batch[count])) {
+      count++;
+    }
+    if (count) {
+      sink.deliver(batch.data(), count);
+    } else {
+      std::this_thread::sleep_for(std::chrono::milliseconds{1});
+    }
+  }
+}
+
 int main(int argc, char** argv) {
   using namespace boost::program_options;
-  spdlog::set_level(spdlog::level::debug);
 
   bool is_help{};
   options_description description{"multicast "};
@@ -46,7 +113,83 @@ int main(int argc, char** argv) {
       "hostfile,z", value<std::string>(),
       "hostfile is the path to a file that contains the list of hostnames")(
       "count,c", value<int>()->default_value(0),
-      "number of message to multicast");
+      "number of message to multicast")(
+      "payload-size,s", value<std::size_t>()->default_value(0),
+      "bytes of payload to attach to each message")(
+      "fragment-size", value<std::size_t>()->default_value(0),
+      "largest datagram a message goes out in, larger ones are split into "
+      "fragments, e.g. 1472 for a 1500 byte MTU; 0 never splits")(
+      "refresh,r", value<int>()->default_value(0),
+      "interval in ms at which host names are re-resolved, 0 to disable")(
+      "batch,b", value<std::size_t>()->default_value(0),
+      "largest frame in bytes to coalesce messages into, 0 to disable")(
+      "batch-delay", value<int>()->default_value(200),
+      "microseconds a partially filled frame may wait before being sent")(
+      "mmsg", bool_switch(),
+      "use recvmmsg/sendmmsg to move datagrams in batches (Linux only)")(
+      "threads,t", value<std::size_t>()->default_value(0),
+      "worker threads to run the multicaster on, 0 runs it on main")(
+      "cpus", value<std::vector<int>>()->multitoken(),
+      "cpus to pin worker threads to, round robin")(
+      "wait,w", value<std::string>()->default_value("block"),
+      "how idle threads wait: block, spin or busy-poll")(
+      "spin-us", value<int>()->default_value(50),
+      "microseconds the spin strategy polls before blocking")(
+      "busy-poll-us", value<int>()->default_value(50),
+      "SO_BUSY_POLL budget in microseconds for the busy-poll strategy")(
+      "window", value<std::size_t>()->default_value(0),
+      "most own messages in flight before sending waits, 0 for no limit")(
+      "ordering,o", value<std::string>()->default_value("isis"),
+      "how the total order is agreed: isis or sequencer")(
+      "sequencer", value<uint32_t>()->default_value(0),
+      "process id of the sequencer, by line in the hostfile")(
+      "order", value<std::string>()->default_value("total"),
+      "order the sent messages are delivered in: total, causal or fifo")(
+      "mcast-group", value<std::string>(),
+      "IPv4 multicast group to send Data and Seq to once, e.g. 239.255.0.1")(
+      "mcast-port", value<uint16_t>()->default_value(0),
+      "port of the multicast group, distinct from --port")(
+      "mcast-interface", value<std::string>(),
+      "address of the interface to use the group on, e.g. 127.0.0.1")(
+      "mcast-ttl", value<int>()->default_value(1),
+      "routers the group's datagrams may cross")(
+      "mcast-no-loop", bool_switch(),
+      "do not loop the group's datagrams back to this host")(
+      "ring", value<std::size_t>()->default_value(0),
+      "print deliveries from a separate thread fed through a ring of this "
+      "many entries, 0 prints on the delivering thread")(
+      "shm", value<std::string>(),
+      "also append deliveries to a shared memory log at this path, e.g. "
+      "/dev/shm/isis_multicast")(
+      "shm-size", value<std::size_t>()->default_value(64 << 20),
+      "bytes of deliveries the shared memory log holds")(
+      "stats", value<std::string>(),
+      "dump counters and latency histograms as JSON to this file, or to "
+      "every client of a Unix domain socket given as unix:PATH")(
+      "stats-interval", value<int>()->default_value(1000),
+      "milliseconds between rewrites of the --stats file")(
+      "trace", value<std::string>(),
+      "record every message sent, received and delivered to this binary "
+      "trace file, see isis_multicastTraceMerge")(
+      "journal", value<std::string>(),
+      "journal the protocol state to this file and pick up from it when "
+      "restarted on it")(
+      "journal-size", value<std::size_t>()->default_value(64 << 20),
+      "bytes of records the journal holds")(
+      "journal-sync", value<int>()->default_value(1),
+      "milliseconds between syncs of the journal to disk, 0 leaves it to "
+      "the kernel")(
+      "catchup-history", value<std::size_t>()->default_value(0),
+      "bytes of recently delivered messages kept for peers catching up")(
+      "catch-up-from", value<uint32_t>(),
+      "fetch the messages delivered by this process id that were missed, "
+      "before delivering live ones")(
+      "log-level", value<std::string>()->default_value("info"),
+      "trace, debug, info, warn, error, critical or off; levels below the "
+      "one built with are compiled out")(
+      "log-queue", value<std::size_t>()->default_value(8192),
+      "log messages queued for the logging thread before the oldest are "
+      "dropped");
 
   command_line_parser parser{argc, argv};
   parser.options(description);
@@ -60,6 +203,13 @@ int main(int argc, char** argv) {
     spdlog::error("{}", e.what());
     return -1;
   }
+  const auto& log_level = vm["log-level"].as<std::string>();
+  auto level = spdlog::level::from_str(log_level);
+  if (level == spdlog::level::off && log_level != "off") {
+    spdlog::error("Unknown log level {}", log_level);
+    return -1;
+  }
+  multicast::init_async_logging(vm["log-queue"].as<std::size_t>(), level);
   spdlog::info("Parsed commandline vars");
 
   if (is_help) {
@@ -78,6 +228,76 @@ int main(int argc, char** argv) {
   const auto port = vm["port"].as<uint16_t>();
   const auto& hostfile = vm["hostfile"].as<std::string>();
   const auto count = vm["count"].as<int>();
+  const auto payload_size = vm["payload-size"].as<std::size_t>();
+  multicast::Config config{};
+  config.peer_refresh_interval =
+      std::chrono::milliseconds{vm["refresh"].as<int>()};
+  config.batch_max_bytes = vm["batch"].as<std::size_t>();
+  config.batch_delay = std::chrono::microseconds{vm["batch-delay"].as<int>()};
+  config.use_mmsg = vm["mmsg"].as<bool>();
+  config.max_payload_size = std::max(config.max_payload_size, payload_size);
+  config.fragment_size = vm["fragment-size"].as<std::size_t>();
+  const auto threads = vm["threads"].as<std::size_t>();
+  config.threads = std::max<std::size_t>(1, threads);
+  if (!vm["cpus"].empty()) {
+    config.cpu_affinity = vm["cpus"].as<std::vector<int>>();
+  }
+  const auto& wait = vm["wait"].as<std::string>();
+  if (wait == "block") {
+    config.wait_strategy = multicast::WaitStrategy::kBlock;
+  } else if (wait == "spin") {
+    config.wait_strategy = multicast::WaitStrategy::kSpinThenBlock;
+  } else if (wait == "busy-poll") {
+    config.wait_strategy = multicast::WaitStrategy::kBusyPoll;
+  } else {
+    spdlog::error("Unknown wait strategy {}", wait);
+    return -1;
+  }
+  config.spin_duration = std::chrono::microseconds{vm["spin-us"].as<int>()};
+  config.busy_poll = std::chrono::microseconds{vm["busy-poll-us"].as<int>()};
+  config.max_in_flight = vm["window"].as<std::size_t>();
+  const auto& ordering = vm["ordering"].as<std::string>();
+  if (ordering == "isis") {
+    config.ordering = multicast::Ordering::kIsis;
+  } else if (ordering == "sequencer") {
+    config.ordering = multicast::Ordering::kSequencer;
+  } else {
+    spdlog::error("Unknown ordering {}", ordering);
+    return -1;
+  }
+  config.sequencer = vm["sequencer"].as<uint32_t>();
+  const auto& order_name = vm["order"].as<std::string>();
+  multicast::DeliveryOrder order{};
+  if (order_name == "total") {
+    order = multicast::DeliveryOrder::kTotal;
+  } else if (order_name == "causal") {
+    order = multicast::DeliveryOrder::kCausal;
+  } else if (order_name == "fifo") {
+    order = multicast::DeliveryOrder::kFifo;
+  } else {
+    spdlog::error("Unknown order {}", order_name);
+    return -1;
+  }
+  if (!vm["mcast-group"].empty()) {
+    config.multicast_group = vm["mcast-group"].as<std::string>();
+  }
+  config.multicast_port = vm["mcast-port"].as<uint16_t>();
+  if (!vm["mcast-interface"].empty()) {
+    config.multicast_interface = vm["mcast-interface"].as<std::string>();
+  }
+  config.multicast_ttl = vm["mcast-ttl"].as<int>();
+  config.multicast_loopback = !vm["mcast-no-loop"].as<bool>();
+  if (!vm["trace"].empty()) {
+    config.trace_path = vm["trace"].as<std::string>();
+  }
+  if (!vm["journal"].empty()) {
+    config.journal_path = vm["journal"].as<std::string>();
+  }
+  config.journal_capacity = vm["journal-size"].as<std::size_t>();
+  config.journal_sync_interval =
+      std::chrono::milliseconds{vm["journal-sync"].as<int>()};
+  config.catchup_history = vm["catchup-history"].as<std::size_t>();
+  const auto ring_size = vm["ring"].as<std::size_t>();
 
   std::vector<std::string> hosts{};
   try {
@@ -97,18 +317,64 @@ int main(int argc, char** argv) {
   }
   spdlog::info("Process id: {}", process_id);
 
+  // Outlive the multicaster and the printing thread
+  StdoutSink stdout_sink{process_id};
+  std::unique_ptr<multicast::ShmLogSink> shm_log{};
+  std::unique_ptr<TeeSink> tee{};
+  std::unique_ptr<multicast::RingSink> ring{};
   try {
+    multicast::DeliverySink* printer{&stdout_sink};
+    if (!vm["shm"].empty()) {
+      shm_log.reset(new multicast::ShmLogSink{
+          vm["shm"].as<std::string>(), vm["shm-size"].as<std::size_t>()});
+      tee.reset(new TeeSink{*shm_log, stdout_sink});
+      printer = tee.get();
+    }
     spdlog::info("Creating multicaster");
-    multicast::Multicaster multicaster{hosts, port, process_id};
+    multicast::Multicaster multicaster{hosts, port, process_id, config};
+    std::unique_ptr<multicast::StatsReporter> stats{};
+    if (!vm["stats"].empty()) {
+      stats.reset(new multicast::StatsReporter{
+          [&multicaster]() { return multicaster.stats(); },
+          vm["stats"].as<std::string>(),
+          std::chrono::milliseconds{vm["stats-interval"].as<int>()}});
+    }
+    if (ring_size) {
+      ring.reset(new multicast::RingSink{ring_size});
+      multicaster.set_sink(ring.get());
+      std::thread{print_deliveries, std::ref(*ring), std::ref(*printer)}
+          .detach();
+    } else {
+      multicaster.set_sink(printer);
+    }
     spdlog::info("Starting main event loop");
+    std::vector<char> payload(payload_size, 'x');
+    // Send as much as the window allows, then pick up again once it opens.
+    // Sends do not wait for the event loop, anything the socket cannot take
+    // right away is queued until it runs
+    std::mutex pump_mutex{};
     int i{};
-    while (true) {
-      multicaster.poll();
-      if (i < count) {
-        multicaster.multicast(i);
+    auto pump = [&]() {
+      std::lock_guard<std::mutex> lock{pump_mutex};
+      while (i < count && multicaster.try_multicast(payload.data(),
+                                                    payload.size(), i, order)) {
         i++;
       }
+    };
+    multicaster.on_window_open(pump);
+    if (!vm["catch-up-from"].empty()) {
+      multicaster.catch_up(vm["catch-up-from"].as<uint32_t>());
+    }
+    if (threads) {
+      multicaster.start();
+    }
+    pump();
+    if (threads) {
+      while (true) {
+        std::this_thread::sleep_for(std::chrono::seconds{1});
+      }
     }
+    multicaster.run();
   } catch (std::exception& e) {
     spdlog::error("{}", e.what());
   }
@@ -0,0 +1,140 @@
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <vector>
+
+#include "delivery.hpp"
+#include "messages.hpp"
+
+/************************************************
+ *  Encode Benchmarks
+ ***********************************************/
+static void BM_DataEncode(benchmark::State& state) {
+  messages::DataMessage msg{1, 2, 3};
+  char buf[messages::codec::WireLayout<messages::DataMessage>::kSize];
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(msg.encode(buf, sizeof(buf)));
+    benchmark::ClobberMemory();
+    msg.msg_id++;
+  }
+}
+BENCHMARK(BM_DataEncode);
+
+static void BM_DataSerialize(benchmark::State& state) {
+  messages::DataMessage msg{1, 2, 3};
+  std::vector<uint32_t> buf{};
+  for (auto _ : state) {
+    buf.clear();
+    msg.serialize(buf);
+    benchmark::DoNotOptimize(buf.data());
+    msg.msg_id++;
+  }
+}
+BENCHMARK(BM_DataSerialize);
+
+static void BM_AckEncode(benchmark::State& state) {
+  messages::AckMessage msg{1, 2, 3, 4};
+  char buf[messages::codec::WireLayout<messages::AckMessage>::kSize];
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(msg.encode(buf, sizeof(buf)));
+    benchmark::ClobberMemory();
+    msg.proposed_seq++;
+  }
+}
+BENCHMARK(BM_AckEncode);
+
+static void BM_SeqEncode(benchmark::State& state) {
+  messages::SeqMessage msg{1, 2, 3, 4};
+  char buf[messages::codec::WireLayout<messages::SeqMessage>::kSize];
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(msg.encode(buf, sizeof(buf)));
+    benchmark::ClobberMemory();
+    msg.final_seq++;
+  }
+}
+BENCHMARK(BM_SeqEncode);
+
+// Argument is the number of vector clock entries
+static void BM_CausalEncode(benchmark::State& state) {
+  std::vector<uint32_t> clock(state.range(0), htonl(7));
+  messages::StreamMessage msg{
+      1, 2, 3, static_cast<uint32_t>(multicast::DeliveryOrder::kCausal), 4};
+  msg.clock_size = static_cast<uint32_t>(clock.size());
+  msg.clock = reinterpret_cast<const char*>(clock.data());
+  std::vector<char> buf(
+      messages::codec::WireLayout<messages::StreamMessage>::kSize +
+      clock.size() * sizeof(uint32_t));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(msg.encode(buf.data(), buf.size()));
+    benchmark::ClobberMemory();
+    msg.stream_seq++;
+  }
+}
+BENCHMARK(BM_CausalEncode)->Arg(4)->Arg(16)->Arg(64);
+
+/************************************************
+ *  Decode Benchmarks
+ ***********************************************/
+static void BM_DataDecode(benchmark::State& state) {
+  char buf[messages::codec::WireLayout<messages::DataMessage>::kSize];
+  std::size_t len{messages::DataMessage{1, 2, 3}.encode(buf, sizeof(buf))};
+  for (auto _ : state) {
+    messages::DataMessage msg{buf, len};
+    benchmark::DoNotOptimize(msg);
+  }
+}
+BENCHMARK(BM_DataDecode);
+
+static void BM_DataDeserialize(benchmark::State& state) {
+  std::vector<uint32_t> buf{};
+  messages::DataMessage{1, 2, 3}.serialize(buf);
+  for (auto _ : state) {
+    messages::DataMessage msg{buf};
+    benchmark::DoNotOptimize(msg);
+  }
+}
+BENCHMARK(BM_DataDeserialize);
+
+static void BM_AckDecode(benchmark::State& state) {
+  char buf[messages::codec::WireLayout<messages::AckMessage>::kSize];
+  std::size_t len{messages::AckMessage{1, 2, 3, 4}.encode(buf, sizeof(buf))};
+  for (auto _ : state) {
+    messages::AckMessage msg{buf, len};
+    benchmark::DoNotOptimize(msg);
+  }
+}
+BENCHMARK(BM_AckDecode);
+
+static void BM_SeqDecode(benchmark::State& state) {
+  char buf[messages::codec::WireLayout<messages::SeqMessage>::kSize];
+  std::size_t len{messages::SeqMessage{1, 2, 3, 4}.encode(buf, sizeof(buf))};
+  for (auto _ : state) {
+    messages::SeqMessage msg{buf, len};
+    benchmark::DoNotOptimize(msg);
+  }
+}
+BENCHMARK(BM_SeqDecode);
+
+/************************************************
+ *  Frame Benchmarks
+ ***********************************************/
+// Argument is the number of Acks per frame
+static void BM_FrameBuildAndRead(benchmark::State& state) {
+  messages::FrameBuilder builder{65507};
+  char ack[messages::codec::WireLayout<messages::AckMessage>::kSize];
+  std::size_t ack_len{
+      messages::AckMessage{1, 2, 3, 4}.encode(ack, sizeof(ack))};
+  for (auto _ : state) {
+    builder.clear();
+    for (int64_t i = 0; i < state.range(0); i++) {
+      builder.append(ack, ack_len);
+    }
+    messages::FrameReader reader{builder.data(), builder.size()};
+    const char* record{};
+    std::size_t len{};
+    while (reader.next(record, len)) {
+      benchmark::DoNotOptimize(record);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_FrameBuildAndRead)->Arg(1)->Arg(16)->Arg(128);
@@ -0,0 +1,272 @@
+#include <benchmark/benchmark.h>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <vector>
+#include <boost/asio.hpp>
+
+#include "loopback.hpp"
+#include "messages.hpp"
+#include "multicast.hpp"
+
+namespace {
+/**
+ * Transport the benchmark feeds by hand. Datagrams a Multicaster sends to
+ * itself are looped back by loop_back(), everything else is dropped after
+ * noting the proposals in its Acks.
+ */
+class InjectTransport : public multicast::Transport {
+ public:
+  InjectTransport(boost::asio::io_context& io_context, uint32_t process_id)
+      : process_id_{process_id}, work_{io_context.get_executor()} {}
+
+  std::size_t receive_paths() const override { return 1; }
+
+  void start(const std::vector<multicast::Strand>&,
+             ReceiveHandler handler) override {
+    handler_ = std::move(handler);
+  }
+
+  void send(const multicast::Segments& message,
+            std::size_t destination) override {
+    const char* header = static_cast<const char*>(message[0].data());
+    if (destination != process_id_) {
+      if (messages::codec::peek_type(header, message[0].size()) == 2) {
+        proposals.push_back(
+            messages::AckMessage{header, message[0].size()}.proposed_seq);
+      }
+      return;
+    }
+    looped_.emplace_back(multicast::segments_size(message));
+    std::memcpy(looped_.back().data(), header, message[0].size());
+    if (message[1].size()) {
+      std::memcpy(looped_.back().data() + message[0].size(),
+                  message[1].data(), message[1].size());
+    }
+  }
+
+  void close() override { work_.reset(); }
+
+  /**
+   * Hand the Multicaster a datagram, as if received.
+   */
+  template <typename M>
+  void inject(const M& msg) {
+    char buf[messages::codec::WireLayout<M>::kSize];
+    std::size_t len{msg.encode(buf, sizeof(buf))};
+    handler_(multicast::BufferRef{}, buf, len);
+  }
+
+  /**
+   * Receive what the Multicaster sent itself, until it sends nothing more.
+   */
+  void loop_back() {
+    while (!looped_.empty()) {
+      std::vector<std::vector<char>> datagrams{};
+      datagrams.swap(looped_);
+      for (auto& datagram : datagrams) {
+        handler_(multicast::BufferRef{}, datagram.data(), datagram.size());
+      }
+    }
+  }
+
+  // Proposed sequence numbers of the Acks sent to others, oldest first
+  std::deque<uint32_t> proposals{};
+
+ private:
+  uint32_t process_id_;
+  boost::asio::executor_work_guard<boost::asio::io_context::executor_type>
+      work_;
+  ReceiveHandler handler_{};
+  std::vector<std::vector<char>> looped_{};
+};
+
+/**
+ * Process 0 of a group of group_size over an InjectTransport.
+ */
+struct Injected {
+  explicit Injected(std::size_t group_size)
+      : multicaster{group_size, 0,
+                    [this](boost::asio::io_context& io_context) {
+                      transport = new InjectTransport{io_context, 0};
+                      return std::unique_ptr<multicast::Transport>{
+                          transport};
+                    },
+                    config()} {}
+
+  static multicast::Config config() {
+    multicast::Config config{};
+    // Nothing is lost, and timers would need the io_context polled
+    config.retransmit = false;
+    return config;
+  }
+
+  InjectTransport* transport{};
+  multicast::Multicaster multicaster;
+};
+
+/**
+ * A group of Multicasters on one LoopbackNetwork, polled round robin.
+ */
+struct LoopbackNodes {
+  LoopbackNodes(std::size_t size, const multicast::Config& config)
+      : network{size} {
+    for (uint32_t i = 0; i < size; i++) {
+      nodes.emplace_back(new multicast::Multicaster{
+          size, i, network.transport(i), config});
+    }
+  }
+
+  /**
+   * Poll until every node has delivered expected messages. Returns false if
+   * that takes over ten seconds.
+   */
+  bool poll_until_delivered(std::size_t expected) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{10};
+    while (std::chrono::steady_clock::now() < deadline) {
+      bool done{true};
+      for (auto& node : nodes) {
+        node->poll();
+        done = done && node->delivered() >= expected;
+      }
+      if (done) return true;
+    }
+    return false;
+  }
+
+  multicast::LoopbackNetwork network;
+  std::vector<std::unique_ptr<multicast::Multicaster>> nodes{};
+};
+}  // namespace
+
+/************************************************
+ *  Receive Path Benchmarks
+ ***********************************************/
+// Argument is the backlog of messages from process 1 waiting for their Seq.
+// Every iteration receives one more Data, acking it, and the Seq of the
+// oldest, delivering it.
+static void BM_HandleDataAndSeq(benchmark::State& state) {
+  Injected injected{2};
+  InjectTransport& transport = *injected.transport;
+  uint32_t next{};
+  for (; next < state.range(0); next++) {
+    transport.inject(messages::DataMessage{1, next, 0});
+  }
+  uint32_t oldest{};
+  auto step = [&]() {
+    transport.inject(messages::DataMessage{1, next++, 0});
+    transport.inject(
+        messages::SeqMessage{1, oldest++, transport.proposals.front(), 0});
+    transport.proposals.pop_front();
+  };
+  // The first message past a power of two backlog grows the pending index,
+  // which is not what is timed
+  step();
+  for (auto _ : state) {
+    step();
+  }
+  if (injected.multicaster.delivered() !=
+      static_cast<std::size_t>(state.iterations()) + 1) {
+    state.SkipWithError("Messages were not delivered");
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_HandleDataAndSeq)->RangeMultiplier(8)->Range(8, 32768);
+
+// Argument is the backlog of own messages waiting for the acks of the other
+// two processes. Every iteration multicasts one more and collects the acks
+// of the oldest, which sends its Seq and delivers it, and the confirmations
+// that the others have it.
+static void BM_HandleAcks(benchmark::State& state) {
+  Injected injected{3};
+  InjectTransport& transport = *injected.transport;
+  multicast::Multicaster& multicaster = injected.multicaster;
+  uint32_t next{};
+  for (; next < state.range(0); next++) {
+    multicaster.multicast(next);
+    transport.loop_back();
+  }
+  uint32_t oldest{};
+  auto step = [&]() {
+    multicaster.multicast(next++);
+    transport.loop_back();
+    for (uint32_t peer = 1; peer < 3; peer++) {
+      transport.inject(messages::AckMessage{0, oldest, 1, peer});
+    }
+    transport.loop_back();
+    for (uint32_t peer = 1; peer < 3; peer++) {
+      transport.inject(messages::SeqAckMessage{0, oldest, peer});
+    }
+    oldest++;
+  };
+  // The first message past a power of two backlog grows the pending and ack
+  // indexes, which is not what is timed
+  step();
+  for (auto _ : state) {
+    step();
+  }
+  std::size_t iterations{static_cast<std::size_t>(state.iterations())};
+  if (multicaster.delivered() != iterations + 1 ||
+      multicaster.in_flight() != static_cast<std::size_t>(state.range(0))) {
+    state.SkipWithError("Messages were not delivered");
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_HandleAcks)->RangeMultiplier(8)->Range(8, 32768);
+
+/************************************************
+ *  End To End Benchmarks
+ ***********************************************/
+// Arguments are the group size, the frame size (0 for no batching) and the
+// ordering. Every node multicasts a burst of 32 messages of 64 bytes, and the
+// iteration ends once every node has delivered all of them.
+static void BM_LoopbackThroughput(benchmark::State& state) {
+  constexpr uint32_t kBurst{32};
+  std::size_t size{static_cast<std::size_t>(state.range(0))};
+  multicast::Config config{};
+  config.batch_max_bytes = static_cast<std::size_t>(state.range(1));
+  config.ordering = static_cast<multicast::Ordering>(state.range(2));
+  LoopbackNodes group{size, config};
+  char payload[64]{};
+  std::size_t expected{};
+  for (auto _ : state) {
+    for (uint32_t i = 0; i < kBurst; i++) {
+      for (auto& node : group.nodes) {
+        node->multicast(payload, sizeof(payload), i);
+      }
+    }
+    expected += kBurst * size;
+    if (!group.poll_until_delivered(expected)) {
+      state.SkipWithError("Messages were not delivered");
+      break;
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * kBurst * size);
+  state.SetBytesProcessed(state.iterations() * kBurst * size *
+                          sizeof(payload));
+}
+BENCHMARK(BM_LoopbackThroughput)
+    ->ArgNames({"nodes", "batch", "ordering"})
+    ->ArgsProduct({{2, 3, 5},
+                   {0, 1400},
+                   {static_cast<int64_t>(multicast::Ordering::kIsis),
+                    static_cast<int64_t>(multicast::Ordering::kSequencer)}})
+    ->UseRealTime();
+
+// Argument is the group size. Every iteration is one message from node 0
+// until every node has delivered it, so the time per iteration is the
+// ordering latency.
+static void BM_LoopbackLatency(benchmark::State& state) {
+  std::size_t size{static_cast<std::size_t>(state.range(0))};
+  LoopbackNodes group{size, multicast::Config{}};
+  std::size_t expected{};
+  for (auto _ : state) {
+    group.nodes[0]->multicast(static_cast<uint32_t>(expected));
+    if (!group.poll_until_delivered(++expected)) {
+      state.SkipWithError("Message was not delivered");
+      break;
+    }
+  }
+}
+BENCHMARK(BM_LoopbackLatency)->DenseRange(2, 5)->UseRealTime();
@@ -0,0 +1,72 @@
+#include <benchmark/benchmark.h>
+#include <cstddef>
+#include <cstdint>
+
+#include "messages.hpp"
+#include "pending.hpp"
+
+namespace {
+/**
+ * A store holding backlog proposed but unsequenced messages from sender 1,
+ * with msg_ids and proposals counting up from zero. Sized for one more, so
+ * that the benchmarks do not time the index growing.
+ */
+struct Backlog {
+  explicit Backlog(uint32_t backlog) : store{pool, std::size_t{backlog} + 1} {
+    for (; next < backlog; next++) {
+      propose(next);
+    }
+  }
+
+  void propose(uint32_t msg_id) {
+    messages::DataMessage* msg =
+        store.insert(messages::DataMessage{1, msg_id, 0});
+    store.reorder(msg, msg_id + 1, 0, false);
+  }
+
+  multicast::MessagePool pool{};
+  multicast::PendingStore store{pool};
+  uint32_t next{};
+};
+}  // namespace
+
+/************************************************
+ *  Pending Store Benchmarks
+ ***********************************************/
+// Argument is the backlog of proposed messages waiting for their Seq. Every
+// iteration proposes one more and sequences and delivers the oldest, as a
+// receiver does in steady state.
+static void BM_PendingProposeAndDeliver(benchmark::State& state) {
+  Backlog backlog{static_cast<uint32_t>(state.range(0))};
+  uint32_t oldest{};
+  for (auto _ : state) {
+    backlog.propose(backlog.next++);
+    messages::DataMessage* msg = backlog.store.find(1, oldest);
+    backlog.store.reorder(msg, oldest + 1, 0, true);
+    benchmark::DoNotOptimize(backlog.store.deliverable_head());
+    backlog.store.pop_head();
+    oldest++;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_PendingProposeAndDeliver)->RangeMultiplier(8)->Range(8, 32768);
+
+// As above, but every Seq raises the final sequence past the whole backlog,
+// the worst case for the heap, and delivery waits until the backlog drains.
+static void BM_PendingReorderPastBacklog(benchmark::State& state) {
+  uint32_t size{static_cast<uint32_t>(state.range(0))};
+  for (auto _ : state) {
+    state.PauseTiming();
+    Backlog backlog{size};
+    state.ResumeTiming();
+    for (uint32_t msg_id = 0; msg_id < size; msg_id++) {
+      messages::DataMessage* msg = backlog.store.find(1, msg_id);
+      backlog.store.reorder(msg, size + msg_id + 1, 1, true);
+    }
+    while (backlog.store.deliverable_head()) {
+      backlog.store.pop_head();
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * size);
+}
+BENCHMARK(BM_PendingReorderPastBacklog)->RangeMultiplier(8)->Range(8, 32768);
@@ -0,0 +1,31 @@
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <unistd.h>
+
+#include "trace.hpp"
+
+/************************************************
+ *  Trace Benchmarks
+ ***********************************************/
+// Runs with as many threads as the hosts' workers record from at once
+static void BM_TraceRecord(benchmark::State& state) {
+  static multicast::Tracer* tracer{};
+  std::string path{"/tmp/isis_multicast_bench_trace_" +
+                   std::to_string(getpid())};
+  if (state.thread_index() == 0) {
+    tracer = new multicast::Tracer{path, 0, 3, 1 << 16};
+  }
+  uint32_t msg_id{};
+  for (auto _ : state) {
+    tracer->record(multicast::trace::Kind::kReceived, 2, 0, msg_id++, 7, 1);
+  }
+  state.SetItemsProcessed(state.iterations());
+  if (state.thread_index() == 0) {
+    state.counters["dropped"] = static_cast<double>(tracer->dropped());
+    delete tracer;
+    std::remove(path.c_str());
+  }
+}
+BENCHMARK(BM_TraceRecord)->Threads(1)->Threads(4);
@@ -0,0 +1,107 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "buffer.hpp"
+
+namespace multicast {
+
+// Largest group whose acks fit the per message bitmaps of an AckState.
+constexpr std::size_t kMaxGroupSize{64};
+
+/**
+ * Acks gathered so far for one of this process's own messages. final_seq and
+ * final_seq_proposer hold the largest (seq, proposer) pair proposed.
+ *
+ * A message is collecting acks until every peer has proposed, then sequenced
+ * until every peer has confirmed its SeqMessage. A StreamMessage is never
+ * ordered by the group, it starts out sequenced and a peer confirms it on
+ * receipt. The remaining fields drive retransmission of whichever message
+ * the peers are still missing.
+ */
+struct AckState {
+  uint32_t msg_id{};
+  uint32_t acks_received{};
+  uint32_t final_seq{};
+  uint32_t final_seq_proposer{};
+  bool in_use{};
+  // Bit p is set once process p has acked
+  uint64_t acked{};
+  // Seq sent, bit p of confirmed is set once process p has confirmed it
+  bool sequenced{};
+  uint64_t confirmed{};
+  uint32_t confirmations{};
+  // A StreamMessage rather than a DataMessage
+  bool stream{};
+  // When the message was multicast and when its Seq went out or, with the
+  // sequencer, came back, for the latency stats
+  std::chrono::steady_clock::time_point multicast_at{};
+  std::chrono::steady_clock::time_point sequenced_at{};
+  // Retransmissions in the current phase and when the phase began
+  uint32_t retransmits{};
+  std::chrono::steady_clock::time_point sent_at{};
+  // Tick of the retransmit timer that is still current
+  uint64_t deadline{};
+  // The encoded message, kept until all acks or confirmations are in
+  BufferRef message{};
+  std::size_t message_size{};
+};
+
+/**
+ * Ack collection for the messages this process originated.
+ *
+ * Own msg_ids only ever grow, so states live in a ring indexed by the low
+ * bits of the msg_id and lookups never hash or allocate. The ring doubles
+ * whenever a new message would land on a slot that is still collecting.
+ */
+class AckCollector {
+ public:
+  explicit AckCollector(std::size_t capacity_hint = 1024);
+
+  /**
+   * Start collecting acks for msg_id. Returns false if it is already being
+   * collected.
+   */
+  bool track(uint32_t msg_id);
+
+  /**
+   * Fold a proposal into the state of msg_id. Returns nullptr if msg_id is
+   * not being collected, for instance because all its acks are already in,
+   * or if proposer has acked it before.
+   */
+  AckState* add(uint32_t msg_id, uint32_t proposed_seq, uint32_t proposer);
+
+  /**
+   * Record that acker has the SeqMessage of msg_id. Returns nullptr if
+   * msg_id is not sequenced or acker has confirmed it before.
+   */
+  AckState* confirm(uint32_t msg_id, uint32_t acker);
+
+  /**
+   * The state of msg_id, nullptr if it is not being collected.
+   */
+  AckState* find(uint32_t msg_id);
+
+  /**
+   * Stop collecting acks for msg_id.
+   */
+  void erase(uint32_t msg_id);
+
+  std::size_t size() const { return size_; }
+  std::size_t capacity() const { return slots_.size(); }
+
+ private:
+  AckState& slot(uint32_t msg_id) { return slots_[msg_id & mask_]; }
+
+  /**
+   * Double the ring until every live state has a slot of its own.
+   */
+  void grow();
+
+  std::vector<AckState> slots_;
+  std::size_t mask_;
+  std::size_t size_{};
+};
+}  // namespace multicast
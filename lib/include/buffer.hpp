@@ -0,0 +1,139 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <boost/asio/buffer.hpp>
+
+namespace multicast {
+
+/**
+ * A message as a header plus an optional payload, sent without joining
+ * the two.
+ */
+using Segments = std::array<boost::asio::const_buffer, 2>;
+
+inline std::size_t segments_size(const Segments& segments) {
+  return segments[0].size() + segments[1].size();
+}
+
+class BufferPool;
+
+/**
+ * Fixed size block of memory handed out by a BufferPool.
+ */
+class Buffer {
+ public:
+  char* data() { return data_.get(); }
+  const char* data() const { return data_.get(); }
+  std::size_t capacity() const { return capacity_; }
+
+ private:
+  friend class BufferPool;
+  friend class BufferRef;
+
+  Buffer(BufferPool* pool, std::size_t capacity)
+      : pool_{pool}, capacity_{capacity}, data_{new char[capacity]} {}
+
+  BufferPool* pool_;
+  std::size_t capacity_;
+  std::unique_ptr<char[]> data_;
+  std::atomic<std::size_t> refs_{};
+  Buffer* next_{};
+};
+
+/**
+ * Reference counted handle to a pooled Buffer. The buffer returns to its
+ * pool when the last reference is dropped, which may happen on any thread.
+ * A single BufferRef must not be used from two threads at once.
+ */
+class BufferRef {
+ public:
+  BufferRef() = default;
+  explicit BufferRef(Buffer* buffer) : buffer_{buffer} { retain(); }
+  BufferRef(const BufferRef& other) : buffer_{other.buffer_} { retain(); }
+  BufferRef(BufferRef&& other) noexcept : buffer_{other.buffer_} {
+    other.buffer_ = nullptr;
+  }
+  BufferRef& operator=(BufferRef other) noexcept {
+    std::swap(buffer_, other.buffer_);
+    return *this;
+  }
+  ~BufferRef() { reset(); }
+
+  void reset();
+
+  Buffer* get() const { return buffer_; }
+  Buffer* operator->() const { return buffer_; }
+  explicit operator bool() const { return buffer_ != nullptr; }
+
+  /**
+   * Number of references to the buffer, including this one.
+   */
+  std::size_t use_count() const {
+    return buffer_ ? buffer_->refs_.load(std::memory_order_acquire) : 0;
+  }
+
+ private:
+  void retain() {
+    if (buffer_) buffer_->refs_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  Buffer* buffer_{};
+};
+
+/**
+ * Free list of equally sized buffers. Buffers are allocated on demand and only
+ * freed with the pool, which must outlive every BufferRef it has issued.
+ * Buffers may be released from any thread; the free list is guarded by a
+ * mutex that is uncontended unless they are.
+ */
+class BufferPool {
+ public:
+  struct Stats {
+    std::size_t capacity;    // buffers allocated
+    std::size_t in_use;      // buffers currently referenced
+    std::size_t high_water;  // largest in_use seen
+  };
+
+  explicit BufferPool(std::size_t buffer_size, std::size_t initial = 0);
+  ~BufferPool() = default;
+
+  BufferPool(const BufferPool&) = delete;
+  BufferPool& operator=(const BufferPool&) = delete;
+
+  BufferRef acquire();
+
+  std::size_t buffer_size() const { return buffer_size_; }
+  Stats stats() const {
+    std::lock_guard<std::mutex> lock{mutex_};
+    return Stats{buffers_.size(), in_use_, high_water_};
+  }
+
+ private:
+  friend class BufferRef;
+
+  void release(Buffer* buffer);
+  void grow();
+
+  std::size_t buffer_size_;
+  mutable std::mutex mutex_{};
+  std::vector<std::unique_ptr<Buffer>> buffers_{};
+  Buffer* free_{};
+  std::size_t in_use_{};
+  std::size_t high_water_{};
+};
+
+/**
+ * A payload that lives inside a pooled buffer, the datagram it was received
+ * in or a copy packed with others. Holding the Payload keeps the buffer
+ * alive.
+ */
+struct Payload {
+  BufferRef buffer{};
+  const char* data{};
+  std::size_t size{};
+};
+}  // namespace multicast
@@ -0,0 +1,124 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+#include "buffer.hpp"
+#include "delivery.hpp"
+#include "messages.hpp"
+
+namespace multicast {
+
+/**
+ * Delivers StreamMessages in FIFO or causal order.
+ *
+ * Every sender's StreamMessages form one stream, delivered in stream_seq
+ * order whatever their DeliveryOrder. A kFifo message is deliverable as soon
+ * as it is next in its stream. A kCausal message additionally waits until
+ * this host has delivered as many messages from every other process as its
+ * vector clock says its sender had. A message that is not deliverable yet is
+ * held back, with the buffer its clock and payload live in, until the ones
+ * it depends on have been delivered. Messages arriving in order are
+ * delivered without being held or allocating. Not thread safe.
+ */
+class CausalOrder {
+ public:
+  explicit CausalOrder(std::size_t hosts);
+
+  /**
+   * Accept M, whose sender must be below hosts. deliver(M, buffer) is called
+   * for M and every held message that became deliverable with it, in
+   * delivery order, with delivered() already counting the message. Returns
+   * false if M was delivered or is held already.
+   */
+  template <typename Deliver>
+  bool receive(const messages::StreamMessage& M, BufferRef buffer,
+               Deliver&& deliver);
+
+  /**
+   * Would M be delivered right away rather than held back.
+   */
+  bool deliverable(const messages::StreamMessage& M) const {
+    return M.stream_seq == delivered_[M.sender] + 1 && ready(M);
+  }
+
+  /**
+   * Number of StreamMessages from sender delivered so far.
+   */
+  uint32_t delivered(uint32_t sender) const { return delivered_[sender]; }
+
+  /**
+   * Carry on from delivered messages of sender's stream, after a restart.
+   * Nothing of sender may be held.
+   */
+  void restore(uint32_t sender, uint32_t delivered) {
+    delivered_[sender] = delivered;
+  }
+
+  /**
+   * Start sender's stream over, dropping whatever of it is held back, for a
+   * sender that restarted without its state.
+   */
+  void reset(uint32_t sender);
+
+  /**
+   * Number of messages held back.
+   */
+  std::size_t held() const { return held_count_; }
+
+ private:
+  struct Held {
+    messages::StreamMessage msg;
+    BufferRef buffer;
+  };
+
+  /**
+   * Is M next in its stream with everything it depends on delivered.
+   */
+  bool ready(const messages::StreamMessage& M) const;
+
+  std::vector<uint32_t> delivered_;
+  // Held back messages per sender by stream_seq
+  std::vector<std::map<uint32_t, Held>> held_;
+  std::size_t held_count_{};
+};
+
+template <typename Deliver>
+bool CausalOrder::receive(const messages::StreamMessage& M, BufferRef buffer,
+                          Deliver&& deliver) {
+  uint32_t offset{M.stream_seq - (delivered_[M.sender] + 1)};
+  if (offset >= 0x80000000u) {
+    // Behind the stream
+    return false;
+  }
+  if (offset || !ready(M)) {
+    if (!held_[M.sender].emplace(M.stream_seq, Held{M, std::move(buffer)})
+             .second) {
+      return false;
+    }
+    held_count_++;
+    return true;
+  }
+  delivered_[M.sender]++;
+  deliver(M, std::move(buffer));
+
+  // Each delivery may release the head of any stream, keep sweeping until a
+  // sweep delivers nothing
+  bool progress{held_count_ > 0};
+  while (progress) {
+    progress = false;
+    for (std::size_t sender = 0; sender < held_.size(); sender++) {
+      auto next = held_[sender].find(delivered_[sender] + 1);
+      if (next == held_[sender].end() || !ready(next->second.msg)) continue;
+      Held held{std::move(next->second)};
+      held_[sender].erase(next);
+      held_count_--;
+      delivered_[sender]++;
+      deliver(held.msg, std::move(held.buffer));
+      progress = true;
+    }
+  }
+  return true;
+}
+}  // namespace multicast
@@ -0,0 +1,75 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <arpa/inet.h>
+
+namespace messages {
+namespace codec {
+
+/**
+ * Fixed wire layout of a message: the listed uint32_t members, in order, in
+ * network byte order with no padding. Encoding writes straight into a caller
+ * provided buffer and decoding reads straight out of one, both check the
+ * buffer size before touching it.
+ */
+template <typename Message, uint32_t Message::*... Fields>
+struct Layout {
+  static constexpr std::size_t kFields{sizeof...(Fields)};
+  static constexpr std::size_t kSize{kFields * sizeof(uint32_t)};
+
+  /**
+   * Write msg into buf. Returns the number of bytes written, throws
+   * std::runtime_error if buf is shorter than kSize.
+   */
+  static std::size_t encode(const Message& msg, void* buf, std::size_t len) {
+    if (len < kSize) {
+      throw std::runtime_error("Attempted to serialize into short buf");
+    }
+    uint32_t words[kFields]{htonl(msg.*Fields)...};
+    std::memcpy(buf, words, kSize);
+    return kSize;
+  }
+
+  /**
+   * Read the fields of msg from buf. Throws std::runtime_error if buf is
+   * shorter than kSize, trailing bytes are ignored.
+   */
+  static void decode(Message& msg, const void* buf, std::size_t len) {
+    if (len < kSize) {
+      throw std::runtime_error("Attempted to deserialize from short buf");
+    }
+    uint32_t words[kFields];
+    std::memcpy(words, buf, kSize);
+    std::size_t i{};
+    using expand = int[];
+    (void)expand{0, (msg.*Fields = ntohl(words[i++]), 0)...};
+  }
+};
+
+template <typename Message, uint32_t Message::*... Fields>
+constexpr std::size_t Layout<Message, Fields...>::kFields;
+template <typename Message, uint32_t Message::*... Fields>
+constexpr std::size_t Layout<Message, Fields...>::kSize;
+
+/**
+ * Wire layout of each message type, specialised next to the message.
+ */
+template <typename Message>
+struct WireLayout;
+
+/**
+ * Type of the message at the start of buf. Throws std::runtime_error if buf
+ * is too short to hold one.
+ */
+inline uint32_t peek_type(const void* buf, std::size_t len) {
+  if (len < sizeof(uint32_t)) {
+    throw std::runtime_error("Message shorter than its type");
+  }
+  uint32_t type{};
+  std::memcpy(&type, buf, sizeof(type));
+  return ntohl(type);
+}
+}  // namespace codec
+}  // namespace messages
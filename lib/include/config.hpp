@@ -0,0 +1,152 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "ordering.hpp"
+
+namespace multicast {
+
+/**
+ * How a thread driving the Multicaster waits for work.
+ */
+enum class WaitStrategy {
+  // Sleep in the reactor until something is ready. Idles at no CPU cost.
+  kBlock,
+  // Poll for Config::spin_duration after the last piece of work, backing off
+  // between polls, then block. The spin adapts to how soon work shows up.
+  kSpinThenBlock,
+  // Never sleep. The sockets busy poll the device queue (SO_BUSY_POLL) so a
+  // datagram is picked up as soon as it arrives. Burns a core per thread.
+  kBusyPoll,
+};
+
+/**
+ * Tunables for a Multicaster. By default every message goes out unbatched
+ * in its own datagram to each host in turn, lost ones are retransmitted,
+ * duplicates are dropped and latency is timed. Everything else is opt-in.
+ */
+struct Config {
+  // How often peer host names are re-resolved, zero disables refreshing.
+  std::chrono::milliseconds peer_refresh_interval{0};
+  // Largest frame the coalescer will build per destination, zero sends every
+  // message in its own datagram. Capped at fragment_size when that is set.
+  std::size_t batch_max_bytes{0};
+  // How long a partially filled frame may wait before it is flushed.
+  std::chrono::microseconds batch_delay{200};
+  // Drain the socket with recvmmsg and fan out with sendmmsg (Linux only).
+  bool use_mmsg{false};
+  // Number of datagrams read per recvmmsg call.
+  std::size_t mmsg_batch{32};
+  // Largest payload multicast() accepts.
+  std::size_t max_payload_size{8192};
+  // Largest datagram an own message goes out in, e.g. 1472 for a path MTU
+  // of 1500. A message larger than this, header included, is split into
+  // fragments that are reassembled before it is ordered, so a payload is no
+  // longer bound by the datagram size and IP never fragments. Zero sends
+  // every message whole.
+  std::size_t fragment_size{0};
+  // Messages of each sender reassembled at once, each in a buffer of
+  // max_payload_size. A fragment of one more takes the place of the one
+  // that has gone longest without a fragment, which is retransmitted.
+  std::size_t reassembly_slots{4};
+  // Own messages that may be in flight, multicast but not yet sequenced or,
+  // for FIFO and causal messages, not yet received by every host, before
+  // try_multicast() refuses more. Zero leaves the window unbounded. It bounds what a sender keeps, not what the
+  // receivers hold: a message leaves the window once sequenced or received,
+  // and may still wait at a host behind one whose Seq or causal predecessor
+  // was lost, along with everything sent after it.
+  std::size_t max_in_flight{0};
+  // Threads start() runs the io_context on. With more than one the receive
+  // path is split into that many shards sharing the port (Linux only).
+  std::size_t threads{1};
+  // CPUs to pin the threads to, round robin. Empty leaves them unpinned.
+  std::vector<int> cpu_affinity{};
+  // How run() and the worker threads wait for work.
+  WaitStrategy wait_strategy{WaitStrategy::kBlock};
+  // Initial time kSpinThenBlock keeps polling after the last piece of work.
+  std::chrono::microseconds spin_duration{50};
+  // SO_BUSY_POLL budget for kBusyPoll. Raising it above the
+  // net.core.busy_read sysctl needs CAP_NET_ADMIN.
+  std::chrono::microseconds busy_poll{50};
+  // Resend a DataMessage to the peers that have not acked it and a
+  // SeqMessage to the peers that have not confirmed it, so a lost datagram
+  // does not stall its message forever.
+  bool retransmit{true};
+  // Granularity of the retransmit timers.
+  std::chrono::microseconds retransmit_tick{1000};
+  // Retransmit timeout for a peer whose round trip time is not known yet.
+  std::chrono::microseconds initial_rto{100000};
+  // Bounds of the adaptive per peer timeout. Repeated retransmissions of a
+  // message back off exponentially up to max_rto.
+  std::chrono::microseconds min_rto{2000};
+  std::chrono::microseconds max_rto{1000000};
+  // Message ids per sender tracked for duplicates beyond the lowest one not
+  // seen yet. A DataMessage further ahead is dropped unacked and only gets
+  // through once retransmitted.
+  std::size_t duplicate_window{65536};
+  // How the group agrees on the order of messages. Every host must use the
+  // same ordering.
+  Ordering ordering{Ordering::kIsis};
+  // Process id of the sequencer for Ordering::kSequencer.
+  uint32_t sequencer{0};
+  // IPv4 multicast group, e.g. 239.255.0.1, that messages for every host
+  // are sent to once instead of to each host in turn. Acks, SeqAcks and
+  // retransmissions stay unicast. Every host joins the group, so all of them
+  // must use the same group and port. Empty disables the group.
+  std::string multicast_group{};
+  // Port of the group, distinct from the port of the Multicaster.
+  uint16_t multicast_port{0};
+  // Address of the local interface the group is joined and sent on, e.g.
+  // 127.0.0.1 to keep it on one box. Empty leaves it to the routing table.
+  std::string multicast_interface{};
+  // Routers the group's datagrams may cross.
+  int multicast_ttl{1};
+  // Let the kernel hand the group's datagrams back to the sending host.
+  // Without it a process sends its own copy to itself by unicast, and other
+  // processes on the same host do not hear the group at all.
+  bool multicast_loopback{true};
+  // Time the phases of every message for the latency histograms of
+  // Multicaster::stats(), at the cost of a few clock reads per message.
+  bool latency_stats{true};
+  // File to record a trace::Event into for every message sent, received
+  // and delivered, for offline analysis. Empty disables tracing.
+  std::string trace_path{};
+  // Events each thread may record ahead of the file before they are dropped.
+  std::size_t trace_ring_size{16384};
+  // Memory mapped file to journal the protocol state into, so that a
+  // process restarting on it carries on where it left off. Empty disables
+  // the journal.
+  std::string journal_path{};
+  // Size of the journal's ring, rounded up to a power of two. A quarter of
+  // it holds the messages waiting here and own ones not yet confirmed,
+  // besides a duplicate_window per host. Messages beyond that are refused:
+  // own ones by multicast() and try_multicast(), received ones are dropped
+  // unanswered until deliveries make room and they are resent.
+  std::size_t journal_capacity{64 << 20};
+  // Records written between checkpoints, which bound the replay on restart.
+  std::size_t journal_checkpoint_records{65536};
+  // How often the journal is synced to disk, in one go for everything
+  // written since. Zero leaves it to the kernel, which survives a crash of
+  // the process but not of the host.
+  std::chrono::milliseconds journal_sync_interval{1};
+  // Payload bytes of the kTotal messages delivered most recently kept to
+  // answer peers catching up, see Multicaster::catch_up(). Zero keeps none
+  // and spares every delivery a copy, peers asking are turned away. A
+  // message of max_payload_size must fit a batch datagram whole, so a
+  // history needs max_payload_size below about 64 KiB.
+  std::size_t catchup_history{0};
+  // Largest batch of messages sent to a peer catching up, a datagram each.
+  // Raised to fit a message of max_payload_size.
+  std::size_t catchup_batch_bytes{60000};
+  // Batches sent back to back per request before waiting to be asked for
+  // more. They should fit the receive buffer of the socket at the other end,
+  // anything dropped is asked for again after catchup_timeout.
+  std::size_t catchup_window{4};
+  // How long a host catching up waits for the next batch before asking
+  // again from where it got to.
+  std::chrono::milliseconds catchup_timeout{100};
+};
+}  // namespace multicast
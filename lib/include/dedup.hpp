@@ -0,0 +1,61 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace multicast {
+
+/**
+ * The msg_ids seen from one sender, whose ids count up from zero.
+ *
+ * Every id below base() has been seen. For the size() ids from base() on
+ * a ring of bits records which have, and base() moves up as the ids at the
+ * bottom of the window fill in. Checking and recording an id is constant
+ * time and never allocates. An id past the top of the window cannot be
+ * recorded, so it is reported as ahead and left for the sender to retransmit
+ * once the window has moved on. Comparisons are relative to base(), so ids
+ * may wrap around.
+ */
+class DuplicateWindow {
+ public:
+  enum class Result {
+    kNew,        // first time id was seen, now recorded
+    kDuplicate,  // id had been seen before
+    kAhead,      // id is too far ahead of base() to be recorded
+  };
+
+  /**
+   * size is rounded up to a power of two of at least 64. Ids below base
+   * count as seen.
+   */
+  explicit DuplicateWindow(std::size_t size = 4096, uint32_t base = 0);
+
+  /**
+   * Record id as seen.
+   */
+  Result insert(uint32_t id);
+
+  /**
+   * What insert(id) would report, without recording id.
+   */
+  Result check(uint32_t id) const;
+
+  /**
+   * Has id been seen. Ids ahead of the window have not.
+   */
+  bool seen(uint32_t id) const;
+
+  uint32_t base() const { return base_; }
+  std::size_t size() const { return size_; }
+
+ private:
+  bool test(uint32_t id) const {
+    return (bits_[(id & mask_) >> 6] >> (id & 63)) & 1;
+  }
+
+  std::vector<uint64_t> bits_;
+  std::size_t size_;
+  std::size_t mask_;
+  uint32_t base_;
+};
+}  // namespace multicast
@@ -0,0 +1,89 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "buffer.hpp"
+#include "ring.hpp"
+
+namespace multicast {
+
+/**
+ * The order a message is delivered in, chosen per message by its sender.
+ */
+enum class DeliveryOrder : uint32_t {
+  // The same order at every host, agreed by the group's Ordering.
+  kTotal = 0,
+  // After every message its sender had delivered when sending it, and after
+  // the sender's earlier messages.
+  kCausal = 1,
+  // After the sender's earlier messages, with no agreement at all.
+  kFifo = 2,
+};
+
+/**
+ * A message handed to the application. Holding the delivery keeps its payload
+ * alive. For kCausal and kFifo deliveries final_seq is the position of the
+ * message among the FIFO and causal messages of its sender, counting from
+ * one, and final_seq_proposer is the sender.
+ */
+struct Delivery {
+  uint32_t sender{};
+  uint32_t msg_id{};
+  uint32_t data{};
+  uint32_t final_seq{};
+  uint32_t final_seq_proposer{};
+  Payload payload{};
+  DeliveryOrder order{DeliveryOrder::kTotal};
+};
+
+/**
+ * Receives delivered messages from a Multicaster.
+ */
+class DeliverySink {
+ public:
+  virtual ~DeliverySink() = default;
+
+  /**
+   * Called with every message that became deliverable at once, in delivery
+   * order. Batches follow each other in order too. Runs on the thread
+   * delivering, so it should not block; the deliveries may be moved from.
+   */
+  virtual void deliver(Delivery* deliveries, std::size_t count) = 0;
+};
+
+/**
+ * Hands deliveries to one application thread through an SpscRing.
+ *
+ * deliver() never blocks nor drops: when the ring is full deliveries queue
+ * up behind it in an unbounded SpscQueue, which the consumer drains in order
+ * once it has emptied the ring. Neither side takes a lock, only the overflow
+ * allocates, a ring's worth at a time, and it holds as much as the consumer
+ * falls behind by.
+ */
+class RingSink : public DeliverySink {
+ public:
+  explicit RingSink(std::size_t capacity);
+
+  void deliver(Delivery* deliveries, std::size_t count) override;
+
+  /**
+   * Consumer only. Take the next delivery, returns false if there is none.
+   */
+  bool try_pop(Delivery& delivery);
+
+  /**
+   * Number of deliveries that did not fit in the ring.
+   */
+  std::size_t overflowed() const { return overflowed_.load(); }
+
+ private:
+  SpscRing<Delivery> ring_;
+  // Everything in overflow_ is newer than everything in ring_, so the
+  // producer only pushes to ring_ while the consumer has drained all it
+  // pushed to overflow_.
+  SpscQueue<Delivery> overflow_;
+  std::atomic<std::size_t> overflowed_{};
+  std::atomic<std::size_t> drained_{};
+};
+}  // namespace multicast
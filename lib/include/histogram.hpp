@@ -0,0 +1,80 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace multicast {
+
+/**
+ * Counts of a LatencyHistogram at one point in time.
+ */
+struct HistogramSnapshot {
+  uint64_t count{};
+  uint64_t sum{};  // nanoseconds
+  uint64_t min{};
+  uint64_t max{};
+  // Indexed like LatencyHistogram's buckets, empty if count is zero
+  std::vector<uint64_t> counts{};
+
+  double mean() const { return count ? static_cast<double>(sum) / count : 0; }
+
+  /**
+   * Smallest recorded value, to the histogram's precision, that at least
+   * fraction q of the values do not exceed. 0 if nothing was recorded.
+   */
+  uint64_t percentile(double q) const;
+};
+
+/**
+ * Latencies in nanoseconds, in log-linear buckets as HdrHistogram keeps them.
+ *
+ * Values below 2^kSubBucketBits have a bucket each. Every power of two above
+ * that is split into 2^(kSubBucketBits - 1) equal buckets, so a value is
+ * known to within 1/64 of itself. Values from 2^kMaxBits ns, about 18
+ * minutes, land in the top bucket.
+ *
+ * record() is wait-free and may be called from any thread; a snapshot taken
+ * meanwhile may miss values recorded concurrently but never tears one.
+ */
+class LatencyHistogram {
+ public:
+  static constexpr unsigned kSubBucketBits{7};
+  static constexpr unsigned kMaxBits{40};
+  static constexpr std::size_t kBuckets{
+      (std::size_t{1} << kSubBucketBits) +
+      (kMaxBits - kSubBucketBits) * (std::size_t{1} << (kSubBucketBits - 1))};
+
+  LatencyHistogram() = default;
+  LatencyHistogram(const LatencyHistogram&) = delete;
+  LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+  void record(uint64_t ns);
+
+  void record(std::chrono::steady_clock::duration elapsed) {
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed);
+    record(ns.count() > 0 ? static_cast<uint64_t>(ns.count()) : 0);
+  }
+
+  HistogramSnapshot snapshot() const;
+
+  /**
+   * Bucket holding ns.
+   */
+  static std::size_t bucket(uint64_t ns);
+
+  /**
+   * Largest value that lands in bucket index.
+   */
+  static uint64_t highest(std::size_t index);
+
+ private:
+  std::array<std::atomic<uint64_t>, kBuckets> counts_{};
+  std::atomic<uint64_t> count_{};
+  std::atomic<uint64_t> sum_{};
+  std::atomic<uint64_t> min_{UINT64_MAX};
+  std::atomic<uint64_t> max_{};
+};
+}  // namespace multicast
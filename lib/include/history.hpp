@@ -0,0 +1,87 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+#include "messages.hpp"
+
+namespace multicast {
+
+/**
+ * The kTotal messages delivered most recently, with copies of their
+ * payloads, kept to answer hosts catching up.
+ *
+ * Payloads are copied back to back into a ring of capacity bytes, never
+ * wrapping, and the oldest messages make room for new ones. The messages
+ * are indexed in delivery order, which is the total order, so the ones
+ * after a given (final_seq, final_seq_proposer) are found by binary search.
+ * Only messages after the last one evicted can be handed out: a host asking
+ * from further back would be left with a gap. Thread safe, the delivering
+ * thread appends while another serves catch-ups.
+ */
+class DeliveryHistory {
+ public:
+  /**
+   * capacity bounds the payload bytes, and the messages held to one per
+   * CatchupBuilder::kEntryHeaderSize bytes of it. Throws std::runtime_error
+   * if it is zero.
+   */
+  explicit DeliveryHistory(std::size_t capacity);
+
+  /**
+   * Record msg, delivered after everything recorded so far.
+   */
+  void append(const messages::DataMessage& msg);
+
+  /**
+   * Append to batch the messages delivered after the one at (seq,
+   * proposer), in order and as many as fit. Returns kDone if that was all
+   * of them, kGone if the history no longer reaches back that far, or
+   * nothing fit, and kMore otherwise.
+   */
+  messages::CatchupBuilder::Status fill(uint32_t seq, uint32_t proposer,
+                                        messages::CatchupBuilder& batch) const;
+
+  /**
+   * Messages held.
+   */
+  std::size_t size() const;
+
+ private:
+  struct Entry {
+    uint32_t sender;
+    uint32_t msg_id;
+    uint32_t data;
+    uint32_t epoch;
+    uint32_t seq;
+    uint32_t proposer;
+    uint32_t size;
+    uint64_t position;
+  };
+
+  /**
+   * Does (seq, proposer) order before (other_seq, other_proposer).
+   */
+  static bool before(uint32_t seq, uint32_t proposer, uint32_t other_seq,
+                     uint32_t other_proposer) {
+    return seq < other_seq || (seq == other_seq && proposer < other_proposer);
+  }
+
+  void evict_front();
+
+  std::vector<char> bytes_;
+  std::size_t max_entries_;
+
+  // Guards everything below
+  mutable std::mutex mutex_{};
+  std::deque<Entry> entries_{};
+  // Where the next payload goes, only ever grows
+  uint64_t end_{};
+  // The last message evicted, if any
+  bool evicted_{};
+  uint32_t evicted_seq_{};
+  uint32_t evicted_proposer_{};
+};
+}  // namespace multicast
@@ -0,0 +1,400 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "dedup.hpp"
+#include "delivery.hpp"
+#include "messages.hpp"
+
+namespace multicast {
+
+/**
+ * Layout of a journal, a write-ahead log of the protocol state of one
+ * process in a memory mapped file. Records are appended to a ring like the
+ * one of shmlog: positions only ever grow, a record lives at position %
+ * capacity and never wraps, and fewer than a record header's bytes left at
+ * the end of the ring are skipped.
+ *
+ * Every so often the whole state is written out as a checkpoint record and
+ * header.checkpoint moved to it. Recovery applies the checkpoint and the
+ * records after it, up to the first that is not whole: one whose position
+ * is not where it lies, because it is left from an earlier lap, or whose
+ * checksum does not match, because the process died writing it. Nothing
+ * from the latest checkpoint on is ever overwritten.
+ */
+namespace journal {
+
+constexpr uint32_t kMagic{0x49534a4c};  // "ISJL"
+constexpr uint32_t kVersion{3};
+
+struct Header {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t capacity;
+  uint32_t process_id;
+  uint32_t group_size;
+  uint64_t checkpoint;  // position of the latest checkpoint record
+  uint32_t epoch;       // incarnation of the process the journal carries
+  uint32_t reserved;
+};
+
+enum RecordType : uint32_t {
+  kSent = 1,        // SentBody, an own message about to leave
+  kData = 2,        // DataBody, a DataMessage received for the first time
+  kProposed = 3,    // SeqBody, a proposal about to be acked
+  kSequenced = 4,   // SeqBody, a final sequence number sent or received
+  kDelivered = 5,   // DeliveredBody
+  kConfirmed = 6,   // ConfirmedBody, every host has an own message
+  kCheckpoint = 7,  // CheckpointBody
+  kPadding = 8,     // the rest of the ring
+  kHeld = 9,        // HeldBody, a StreamMessage held back
+  kEpoch = 10,      // EpochBody, a sender seen in a new incarnation
+};
+
+struct Record {
+  uint32_t size;  // whole record including the body, a multiple of 8
+  uint32_t type;
+  uint64_t position;
+  uint32_t checksum;  // of the body
+  uint32_t reserved;
+};
+
+struct SentBody {
+  uint32_t msg_id;
+  uint32_t size;
+  // size bytes of the message as sent, header and payload, follow
+};
+
+struct DataBody {
+  uint32_t sender;
+  uint32_t msg_id;
+  uint32_t data;
+  uint32_t payload_size;
+  // payload_size bytes of payload follow
+};
+
+struct SeqBody {
+  uint32_t sender;
+  uint32_t msg_id;
+  uint32_t seq;
+  uint32_t proposer;
+};
+
+struct DeliveredBody {
+  uint32_t sender;
+  uint32_t msg_id;
+  uint32_t seq;       // final or stream seq
+  uint32_t proposer;  // of the final seq, the sender for stream messages
+  uint32_t order;
+  uint32_t reserved;
+};
+
+struct ConfirmedBody {
+  uint32_t msg_id;
+  uint32_t reserved;
+};
+
+struct EpochBody {
+  uint32_t sender;
+  uint32_t epoch;
+};
+
+struct HeldBody {
+  uint32_t sender;
+  uint32_t msg_id;
+  uint32_t size;
+  uint32_t reserved;
+  // size bytes of the message as received, header, clock and payload,
+  // follow
+};
+
+/**
+ * Followed by a SenderState per sender, a PendingState per pending message,
+ * an OwnState per unconfirmed own message and a HeldBody per held back
+ * StreamMessage, each 8 byte aligned.
+ */
+struct CheckpointBody {
+  uint32_t next_msg_id;
+  uint32_t last_stream_seq;
+  uint32_t highest_seq;
+  uint32_t delivered_seq;
+  uint64_t delivered;
+  uint32_t senders;
+  uint32_t pending;
+  uint32_t own;
+  uint32_t held;
+  uint32_t delivered_proposer;
+  uint32_t reserved;
+};
+
+struct SenderState {
+  uint32_t window_base;
+  uint32_t stream_delivered;
+  uint32_t seen;  // ids above window_base seen, listed after this
+  uint32_t epoch;
+};
+
+struct PendingState {
+  DataBody data;
+  uint32_t proposal;   // 0 if not proposed
+  uint32_t final_seq;  // 0 if not sequenced
+  uint32_t final_seq_proposer;
+  uint32_t reserved;
+  // data.payload_size bytes of payload follow
+};
+
+struct OwnState {
+  uint32_t msg_id;
+  uint32_t final_seq;  // 0 if not known
+  uint32_t final_seq_proposer;
+  uint32_t size;
+  // size bytes of the message as sent follow
+};
+
+constexpr std::size_t kDataOffset{4096};
+
+/**
+ * The state a journal held when it was opened.
+ */
+struct Recovery {
+  struct Pending {
+    messages::DataMessage msg;  // final_seq 0 unless sequenced
+    uint32_t proposal;          // 0 if never proposed
+    std::vector<char> payload;
+  };
+
+  struct Own {
+    uint32_t msg_id;
+    uint32_t final_seq;  // 0 if not known
+    uint32_t final_seq_proposer;
+    std::vector<char> message;  // as sent, header and payload
+  };
+
+  // Incarnation of this process, kept for as long as the journal is
+  uint32_t epoch{};
+  // Next own msg_id and the last stream seq used
+  uint32_t next_msg_id{};
+  uint32_t last_stream_seq{};
+  // Largest sequence number proposed or seen, and the last delivered in the
+  // total order along with its proposer
+  uint32_t highest_seq{};
+  uint32_t delivered_seq{};
+  uint32_t delivered_proposer{};
+  uint64_t delivered{};
+  std::vector<DuplicateWindow> seen{};
+  std::vector<uint32_t> stream_delivered{};
+  // Incarnation each sender was last seen in, 0 if none
+  std::vector<uint32_t> sender_epoch{};
+  // Received messages not delivered yet
+  std::vector<Pending> pending{};
+  // Own messages not every host is known to have
+  std::vector<Own> own{};
+  // StreamMessages held back for the ones they depend on, as received
+  std::vector<std::vector<char>> held{};
+  // Records replayed after the checkpoint
+  std::size_t records{};
+};
+}  // namespace journal
+
+/**
+ * A journal that could not record a transition. Unlike malformed input it
+ * cannot be dropped, the process state would no longer match its journal.
+ */
+class JournalError : public std::runtime_error {
+ public:
+  using std::runtime_error::runtime_error;
+};
+
+/**
+ * Write-ahead journal of a Multicaster's protocol state, see journal.
+ *
+ * Each transition is recorded before the message it causes leaves, and each
+ * delivery before the sink sees it, so a process that restarts on the same
+ * journal neither reuses msg_ids nor proposes sequence numbers that go
+ * backwards, and still has the messages it had accepted. Records reach the
+ * page cache as they are written, which survives a crash of the process. A
+ * thread of its own syncs them to disk every sync_interval, one sync for
+ * everything written since the last (zero leaves it to the kernel).
+ *
+ * Opening an existing journal recovers its state in one pass from the
+ * latest checkpoint, which is written every checkpoint_records records or
+ * once half the ring is in use. A checkpoint of the whole state has to fit
+ * a quarter of the ring, since one is written while the last is still live
+ * and may be padded past the end of the ring. Nothing bounds how many
+ * messages wait at a host, so messages of up to message_size bytes, as
+ * sent, are only taken on while they fit that quarter and turned away
+ * otherwise, see admit(), data() and held(). Deliveries and confirmations
+ * make room again. Thread safe. Throws std::runtime_error if the file
+ * cannot be set up, has no room for a single message or belongs to another
+ * process.
+ *
+ * A new journal carries epoch, the incarnation of the process, which an
+ * existing one keeps.
+ */
+class Journal {
+ public:
+  Journal(const std::string& path, std::size_t capacity, uint32_t process_id,
+          uint32_t epoch, std::size_t group_size, std::size_t window,
+          std::size_t message_size, std::size_t checkpoint_records,
+          std::chrono::milliseconds sync_interval);
+  ~Journal();
+
+  Journal(const Journal&) = delete;
+  Journal& operator=(const Journal&) = delete;
+
+  /**
+   * What was recovered when the journal was opened, empty if it was new.
+   */
+  const journal::Recovery& recovery() const { return recovery_; }
+
+  /**
+   * Make room for an own message, to be recorded with sent(). False if
+   * there is none, in which case it must not be sent.
+   */
+  bool admit();
+
+  /**
+   * Record an own message made room for with admit().
+   */
+  void sent(uint32_t msg_id, const void* header, std::size_t header_len,
+            const void* payload, std::size_t len);
+
+  /**
+   * Record D, unless there is no room for it. A message that is not
+   * recorded must be dropped unanswered and taken when it comes again.
+   */
+  bool data(const messages::DataMessage& D);
+  void proposed(uint32_t sender, uint32_t msg_id, uint32_t seq);
+  void sequenced(const messages::SeqMessage& S);
+  void delivered(uint32_t sender, uint32_t msg_id, uint32_t seq,
+                 uint32_t proposer, DeliveryOrder order);
+  void confirmed(uint32_t msg_id);
+
+  /**
+   * Record M as held back, unless there is no room for it, see data().
+   */
+  bool held(const messages::StreamMessage& M);
+  /**
+   * sender is in incarnation epoch now. A change from an earlier one starts
+   * its msg_ids and stream over.
+   */
+  void epoch(uint32_t sender, uint32_t epoch);
+
+  /**
+   * Write out a checkpoint now.
+   */
+  void checkpoint();
+
+  /**
+   * Sync everything written so far to disk.
+   */
+  void sync();
+
+  std::size_t capacity() const { return capacity_; }
+
+ private:
+  // Where a payload lies in the ring
+  struct Bytes {
+    uint64_t position;
+    uint32_t size;
+  };
+
+  struct PendingRef {
+    uint32_t data;
+    uint32_t proposal;
+    uint32_t final_seq;
+    uint32_t final_seq_proposer;
+    Bytes payload;
+  };
+
+  struct OwnRef {
+    uint32_t final_seq;
+    uint32_t final_seq_proposer;
+    Bytes message;
+  };
+
+  static uint64_t key(uint32_t sender, uint32_t msg_id) {
+    return (uint64_t{sender} << 32) | msg_id;
+  }
+
+  void map(const std::string& path, std::size_t capacity);
+  /**
+   * Is there room for one more entry of entry_size bytes in a checkpoint.
+   */
+  bool fits(std::size_t entry_size) const {
+    return fixed_size_ + state_size_ + admitted_ + entry_size <=
+           capacity_ / 4;
+  }
+  void reset(uint32_t epoch);
+  void recover();
+
+  /**
+   * Room for a record with body_size bytes of body, its header filled in
+   * but for the checksum. Checkpoints first if it is time.
+   */
+  journal::Record* reserve(uint32_t type, std::size_t body_size);
+
+  /**
+   * Seal record and fold it into the state.
+   */
+  void commit(journal::Record* record);
+  void write_checkpoint();
+  void apply(const journal::Record* record);
+  void apply_checkpoint(const journal::Record* record);
+  const char* at(uint64_t position) const {
+    return data_ + (position & (capacity_ - 1));
+  }
+  char* at(uint64_t position) { return data_ + (position & (capacity_ - 1)); }
+
+  std::size_t capacity_{};
+  std::size_t mapped_size_{};
+  void* mapping_{};
+  journal::Header* header_{};
+  char* data_{};
+  uint32_t process_id_;
+  std::size_t group_size_;
+  std::size_t window_;
+  std::size_t checkpoint_records_;
+  std::size_t message_size_;
+  // Bytes of a checkpoint without messages, duplicate windows full
+  std::size_t fixed_size_{};
+  journal::Recovery recovery_{};
+
+  // Guards everything below
+  std::mutex mutex_{};
+  uint64_t end_{};
+  uint64_t synced_{};
+  std::size_t since_checkpoint_{};
+  uint32_t next_msg_id_{};
+  uint32_t last_stream_seq_{};
+  uint32_t highest_seq_{};
+  uint32_t delivered_seq_{};
+  uint32_t delivered_proposer_{};
+  uint64_t delivered_{};
+  // Bytes the messages of the state take in a checkpoint, and the bytes
+  // made room for own messages that are not recorded yet
+  std::size_t state_size_{};
+  std::size_t admitted_{};
+  std::vector<DuplicateWindow> seen_{};
+  std::vector<uint32_t> stream_delivered_{};
+  std::vector<uint32_t> sender_epoch_{};
+  std::unordered_map<uint64_t, PendingRef> pending_{};
+  std::map<uint32_t, OwnRef> own_{};
+  std::unordered_map<uint64_t, Bytes> held_{};
+
+  std::chrono::milliseconds sync_interval_;
+  std::mutex stop_mutex_{};
+  std::condition_variable stop_cv_{};
+  bool stopping_{};
+  std::thread syncer_{};
+};
+}  // namespace multicast
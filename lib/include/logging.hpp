@@ -0,0 +1,17 @@
+#pragma once
+#include <cstddef>
+
+#include <spdlog/spdlog.h>
+
+namespace multicast {
+
+/**
+ * Replace the default logger with one that formats and writes on a
+ * background thread. Log calls only queue the message; once queue_size
+ * messages are waiting the oldest are dropped rather than stalling the
+ * caller. Statements below SPDLOG_ACTIVE_LEVEL are compiled out entirely,
+ * level filters what remains at runtime.
+ */
+void init_async_logging(std::size_t queue_size,
+                        spdlog::level::level_enum level);
+}  // namespace multicast
@@ -0,0 +1,196 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <random>
+#include <vector>
+#include <boost/asio.hpp>
+
+#include "buffer.hpp"
+#include "transport.hpp"
+
+namespace multicast {
+
+/**
+ * Network conditions of a LoopbackNetwork. Every copy of a datagram, one per
+ * receiver, is lost or delayed on its own.
+ */
+struct LoopbackConfig {
+  // Delay every datagram by at least this much
+  std::chrono::microseconds delay{};
+  // Plus up to this much more, drawn uniformly, which reorders datagrams
+  std::chrono::microseconds jitter{};
+  // Extra delay of the link from one process to another, e.g. to have a
+  // message overtake one sent before it over another path
+  std::function<std::chrono::microseconds(uint32_t from, std::size_t to)>
+      link_delay{};
+  // Probability that a datagram is lost
+  double loss{};
+  // Lose every datagram it returns true for, e.g. to lose one particular
+  // message. Called with the network locked.
+  std::function<bool(uint32_t from, std::size_t to, const Segments& message)>
+      drop{};
+  // Seeds the draws for loss and jitter
+  uint64_t seed{1};
+  // Offer the whole group as a destination, as an IP multicast group would
+  bool group{true};
+};
+
+class LoopbackTransport;
+
+/**
+ * Wires the Multicasters of a group together in one process, without
+ * sockets, ports or hostnames. Each Multicaster is built with the factory
+ * transport() returns for its process id, and the network must outlive
+ * all of them.
+ *
+ * Datagrams are copied on send, so a receiver never sees the sender's
+ * buffers, and a datagram for a process that is not attached is lost.
+ */
+class LoopbackNetwork {
+ public:
+  explicit LoopbackNetwork(std::size_t size,
+                           const LoopbackConfig& config = LoopbackConfig{});
+
+  LoopbackNetwork(const LoopbackNetwork&) = delete;
+  LoopbackNetwork& operator=(const LoopbackNetwork&) = delete;
+
+  /**
+   * Factory for the transport of process_id, with paths receive paths.
+   */
+  TransportFactory transport(uint32_t process_id, std::size_t paths = 1);
+
+  std::size_t size() const { return members_.size(); }
+
+  /**
+   * Datagrams handed to a receiver.
+   */
+  std::size_t sent() const { return sent_; }
+
+  /**
+   * Datagrams lost, on purpose or for want of a receiver.
+   */
+  std::size_t dropped() const { return dropped_; }
+
+  /**
+   * Bytes of the largest datagram sent, whether it got through or not.
+   */
+  std::size_t largest() const { return largest_; }
+
+ private:
+  friend class LoopbackTransport;
+
+  void attach(uint32_t process_id, LoopbackTransport* transport);
+  void detach(uint32_t process_id);
+
+  /**
+   * Pass message from process from to destination, to every process if
+   * destination is size().
+   */
+  void send(uint32_t from, const Segments& message, std::size_t destination);
+
+  /**
+   * Hand message to the process at to, unless it is lost. Requires mutex_.
+   */
+  void send_one(uint32_t from, const Segments& message, std::size_t to);
+
+  LoopbackConfig config_;
+  // Guards the members and the draws. Held while a receiver copies a
+  // datagram, so a detached transport receives nothing more.
+  std::mutex mutex_{};
+  std::vector<LoopbackTransport*> members_;
+  std::mt19937_64 rng_;
+  std::uniform_real_distribution<double> loss_{0.0, 1.0};
+  std::uniform_int_distribution<int64_t> jitter_;
+  std::atomic<std::size_t> sent_{};
+  std::atomic<std::size_t> dropped_{};
+  std::atomic<std::size_t> largest_{};
+};
+
+/**
+ * Transport of one process on a LoopbackNetwork. Datagrams from a given
+ * process always take the same receive path. Delayed datagrams wait in a
+ * heap that a timer on the Multicaster's io_context drains.
+ */
+class LoopbackTransport : public Transport {
+ public:
+  LoopbackTransport(LoopbackNetwork& network,
+                    boost::asio::io_context& io_context, uint32_t process_id,
+                    std::size_t paths);
+  ~LoopbackTransport() override;
+
+  std::size_t receive_paths() const override { return paths_; }
+  bool has_group() const override { return network_.config_.group; }
+
+  void start(const std::vector<Strand>& strands,
+             ReceiveHandler handler) override;
+  void send(const Segments& message, std::size_t destination) override;
+  void close() override;
+
+ private:
+  friend class LoopbackNetwork;
+
+  using Clock = std::chrono::steady_clock;
+
+  /**
+   * A received datagram that is not due yet.
+   */
+  struct Delayed {
+    Clock::time_point due;
+    // Breaks ties so equal delays keep their order
+    uint64_t seq;
+    uint32_t from;
+    BufferRef buffer;
+    const char* data;
+    std::size_t len;
+
+    bool operator>(const Delayed& other) const {
+      return due != other.due ? due > other.due : seq > other.seq;
+    }
+  };
+
+  /**
+   * Copy a datagram from process from into a receive buffer and hand it
+   * over after delay. Called by the network with its mutex held.
+   */
+  void enqueue(uint32_t from, const Segments& message,
+               std::chrono::microseconds delay);
+
+  /**
+   * Hand a received datagram to the receive path of process from.
+   */
+  void dispatch(uint32_t from, BufferRef buffer, const char* data,
+                std::size_t len);
+
+  /**
+   * Wait for the earliest delayed datagram. Requires mutex_.
+   */
+  void arm_timer();
+
+  void handle_timer(const boost::system::error_code& error);
+
+  LoopbackNetwork& network_;
+  uint32_t process_id_;
+  std::size_t paths_;
+  std::vector<Strand> strands_{};
+  ReceiveHandler handler_{};
+  // Guards the receive buffer, the delayed datagrams and the timer
+  std::mutex mutex_{};
+  BufferPool receive_pool_{kReceiveBufferSize};
+  BufferRef receive_buffer_{};
+  std::size_t receive_offset_{};
+  std::priority_queue<Delayed, std::vector<Delayed>, std::greater<Delayed>>
+      delayed_{};
+  uint64_t next_seq_{};
+  boost::asio::steady_timer timer_;
+  // Stands in for the receive a socket always has outstanding, so the
+  // io_context does not run out of work between datagrams
+  boost::asio::executor_work_guard<boost::asio::io_context::executor_type>
+      work_;
+  std::atomic<bool> closing_{};
+};
+}  // namespace multicast
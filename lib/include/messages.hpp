@@ -1,31 +1,40 @@
 #pragma once
 #include <cstdint>
+#include <cstring>
 #include <vector>
 
+#include "codec.hpp"
+
 namespace messages {
 
 class Message {
  public:
   virtual ~Message() = default;
   virtual void serialize(std::vector<uint32_t>& buf) = 0;
+  virtual std::size_t encode(void* buf, std::size_t len) const = 0;
 };
 
 class DataMessage : Message {
  public:
   DataMessage(uint32_t sender, uint32_t msg_id, uint32_t data);
   DataMessage(std::vector<uint32_t>& buf);
+  DataMessage(const void* buf, std::size_t len);
   ~DataMessage() = default;
 
   void serialize(std::vector<uint32_t>& buf);
+  std::size_t encode(void* buf, std::size_t len) const;
 
   uint32_t type;                // must be 1
   uint32_t sender;              // sender's id
   uint32_t msg_id;              // id of the message generated by sender
   uint32_t data;                // dummy integer
+  uint32_t epoch;               // sender's incarnation, 0 if unknown
   bool deliverable;             // is the message deliverable
   uint32_t final_seq;           // sequence num if message deliverable
   uint32_t acks_received;       // number of acks received
   uint32_t final_seq_proposer;  // who proposed the final sequence number
+  const char* payload;          // bytes following the header, not owned
+  std::size_t payload_size;     // number of payload bytes
 };
 
 class AckMessage : Message {
@@ -33,9 +42,11 @@ class AckMessage : Message {
   AckMessage(uint32_t sender, uint32_t msg_id, uint32_t proposed_seq,
              uint32_t proposer);
   AckMessage(std::vector<uint32_t>& buf);
+  AckMessage(const void* buf, std::size_t len);
   ~AckMessage() = default;
 
   void serialize(std::vector<uint32_t>& buf);
+  std::size_t encode(void* buf, std::size_t len) const;
 
   uint32_t type;          // must be 2
   uint32_t sender;        // sender of DataMessage
@@ -49,9 +60,11 @@ class SeqMessage : Message {
   SeqMessage(uint32_t sender, uint32_t msg_id, uint32_t final_seq,
              uint32_t final_seq_proposer);
   SeqMessage(std::vector<uint32_t>& buf);
+  SeqMessage(const void* buf, std::size_t len);
   ~SeqMessage() = default;
 
   void serialize(std::vector<uint32_t>& buf);
+  std::size_t encode(void* buf, std::size_t len) const;
 
   uint32_t type;                // must be 3
   uint32_t sender;              // sender of DataMessage
@@ -60,4 +73,374 @@ class SeqMessage : Message {
   uint32_t final_seq_proposer;  // process id of the proposer who proposed
                                 // final_seq
 };
+
+/**
+ * Confirms to the sender of a DataMessage that its SeqMessage arrived, or to
+ * the sender of a StreamMessage that the message itself arrived, so the
+ * sender can stop retransmitting it.
+ */
+class SeqAckMessage : Message {
+ public:
+  SeqAckMessage(uint32_t sender, uint32_t msg_id, uint32_t acker);
+  SeqAckMessage(std::vector<uint32_t>& buf);
+  SeqAckMessage(const void* buf, std::size_t len);
+  ~SeqAckMessage() = default;
+
+  void serialize(std::vector<uint32_t>& buf);
+  std::size_t encode(void* buf, std::size_t len) const;
+
+  uint32_t type;    // must be 5
+  uint32_t sender;  // sender of DataMessage
+  uint32_t msg_id;  // id of DataMessage generated by sender
+  uint32_t acker;   // process id of the process confirming
+};
+
+/**
+ * A message delivered in FIFO or causal order instead of going through
+ * agreement. stream_seq numbers the StreamMessages of a sender from one. A
+ * causal message carries a vector clock of clock_size entries after its
+ * header: entry k is the number of StreamMessages from process k the sender
+ * had delivered when sending it, its own entry is stream_seq. A FIFO message
+ * carries no clock. The payload follows the clock.
+ */
+class StreamMessage : Message {
+ public:
+  StreamMessage(uint32_t sender, uint32_t msg_id, uint32_t data,
+                uint32_t order, uint32_t stream_seq);
+  StreamMessage(std::vector<uint32_t>& buf);
+  /**
+   * Throws std::runtime_error if the clock runs past len.
+   */
+  StreamMessage(const void* buf, std::size_t len);
+  ~StreamMessage() = default;
+
+  void serialize(std::vector<uint32_t>& buf);
+  /**
+   * Writes the header followed by the clock.
+   */
+  std::size_t encode(void* buf, std::size_t len) const;
+
+  /**
+   * Entry k of the vector clock.
+   */
+  uint32_t clock_at(std::size_t k) const {
+    uint32_t entry{};
+    std::memcpy(&entry, clock + k * sizeof(entry), sizeof(entry));
+    return ntohl(entry);
+  }
+
+  uint32_t type;             // must be 6
+  uint32_t sender;           // sender's id
+  uint32_t msg_id;           // id of the message generated by sender
+  uint32_t data;             // dummy integer
+  uint32_t order;            // a multicast::DeliveryOrder
+  uint32_t stream_seq;       // position among the sender's StreamMessages
+  uint32_t epoch;            // sender's incarnation, 0 if unknown
+  uint32_t clock_size;       // number of clock entries
+  const char* clock;         // clock entries in network order, not owned
+  const char* payload;       // bytes following the clock, not owned
+  std::size_t payload_size;  // number of payload bytes
+};
+
+/**
+ * Asks a peer for the kTotal messages it delivered after the one at
+ * (after_seq, after_proposer) in the total order. (0, 0) asks for all of
+ * them. Answered with batches built by CatchupBuilder.
+ */
+class CatchupRequestMessage : Message {
+ public:
+  CatchupRequestMessage(uint32_t requester, uint32_t after_seq,
+                        uint32_t after_proposer);
+  CatchupRequestMessage(std::vector<uint32_t>& buf);
+  CatchupRequestMessage(const void* buf, std::size_t len);
+  ~CatchupRequestMessage() = default;
+
+  void serialize(std::vector<uint32_t>& buf);
+  std::size_t encode(void* buf, std::size_t len) const;
+
+  uint32_t type;            // must be 7
+  uint32_t requester;       // process id of the host catching up
+  uint32_t after_seq;       // final seq of the last message it delivered
+  uint32_t after_proposer;  // and its proposer
+};
+
+/**
+ * A piece of a DataMessage or StreamMessage too large for one datagram:
+ * bytes_size bytes from offset of the message as it would have gone out
+ * whole, header included, size bytes in all. It is fragment index of
+ * count, and every fragment but the last carries the same number of bytes.
+ * The bytes follow the header.
+ */
+class FragmentMessage : Message {
+ public:
+  FragmentMessage(uint32_t sender, uint32_t msg_id, uint32_t size,
+                  uint32_t offset, uint32_t index, uint32_t count);
+  FragmentMessage(std::vector<uint32_t>& buf);
+  FragmentMessage(const void* buf, std::size_t len);
+  ~FragmentMessage() = default;
+
+  void serialize(std::vector<uint32_t>& buf);
+  std::size_t encode(void* buf, std::size_t len) const;
+
+  uint32_t type;           // must be 9
+  uint32_t sender;         // sender's id
+  uint32_t msg_id;         // id of the message generated by sender
+  uint32_t size;           // bytes of the whole message
+  uint32_t offset;         // of the bytes in the whole message
+  uint32_t index;          // position among the fragments
+  uint32_t count;          // fragments of the message
+  const char* bytes;       // bytes following the header, not owned
+  std::size_t bytes_size;  // number of bytes
+};
+
+/**
+ * Wire layouts. Only these fields go on the wire, everything else in a
+ * message is local bookkeeping. A DataMessage's payload is whatever follows
+ * its header in the datagram or frame record.
+ */
+namespace codec {
+template <>
+struct WireLayout<DataMessage>
+    : Layout<DataMessage, &DataMessage::type, &DataMessage::sender,
+             &DataMessage::msg_id, &DataMessage::data,
+             &DataMessage::epoch> {};
+
+template <>
+struct WireLayout<AckMessage>
+    : Layout<AckMessage, &AckMessage::type, &AckMessage::sender,
+             &AckMessage::msg_id, &AckMessage::proposed_seq,
+             &AckMessage::proposer> {};
+
+template <>
+struct WireLayout<SeqMessage>
+    : Layout<SeqMessage, &SeqMessage::type, &SeqMessage::sender,
+             &SeqMessage::msg_id, &SeqMessage::final_seq,
+             &SeqMessage::final_seq_proposer> {};
+
+template <>
+struct WireLayout<StreamMessage>
+    : Layout<StreamMessage, &StreamMessage::type, &StreamMessage::sender,
+             &StreamMessage::msg_id, &StreamMessage::data,
+             &StreamMessage::order, &StreamMessage::stream_seq,
+             &StreamMessage::epoch, &StreamMessage::clock_size> {};
+
+template <>
+struct WireLayout<SeqAckMessage>
+    : Layout<SeqAckMessage, &SeqAckMessage::type, &SeqAckMessage::sender,
+             &SeqAckMessage::msg_id, &SeqAckMessage::acker> {};
+
+template <>
+struct WireLayout<CatchupRequestMessage>
+    : Layout<CatchupRequestMessage, &CatchupRequestMessage::type,
+             &CatchupRequestMessage::requester,
+             &CatchupRequestMessage::after_seq,
+             &CatchupRequestMessage::after_proposer> {};
+
+template <>
+struct WireLayout<FragmentMessage>
+    : Layout<FragmentMessage, &FragmentMessage::type,
+             &FragmentMessage::sender, &FragmentMessage::msg_id,
+             &FragmentMessage::size, &FragmentMessage::offset,
+             &FragmentMessage::index, &FragmentMessage::count> {};
+}  // namespace codec
+
+inline std::size_t DataMessage::encode(void* buf, std::size_t len) const {
+  return codec::WireLayout<DataMessage>::encode(*this, buf, len);
+}
+
+inline std::size_t AckMessage::encode(void* buf, std::size_t len) const {
+  return codec::WireLayout<AckMessage>::encode(*this, buf, len);
+}
+
+inline std::size_t SeqMessage::encode(void* buf, std::size_t len) const {
+  return codec::WireLayout<SeqMessage>::encode(*this, buf, len);
+}
+
+inline std::size_t SeqAckMessage::encode(void* buf, std::size_t len) const {
+  return codec::WireLayout<SeqAckMessage>::encode(*this, buf, len);
+}
+
+inline std::size_t CatchupRequestMessage::encode(void* buf,
+                                                 std::size_t len) const {
+  return codec::WireLayout<CatchupRequestMessage>::encode(*this, buf, len);
+}
+
+inline std::size_t FragmentMessage::encode(void* buf, std::size_t len) const {
+  return codec::WireLayout<FragmentMessage>::encode(*this, buf, len);
+}
+
+/**
+ * Packs several messages into a single datagram.
+ * Layout: type (4) | count | count x (length in bytes | message padded to a
+ * multiple of 4 bytes). The buffer is allocated once at construction.
+ */
+class FrameBuilder {
+ public:
+  static constexpr uint32_t kType{4};
+  static constexpr std::size_t kHeaderSize{8};
+  static constexpr std::size_t kRecordHeaderSize{4};
+
+  explicit FrameBuilder(std::size_t max_size);
+
+  /**
+   * Append a serialized message. Returns false if it would not fit.
+   */
+  bool append(const void* record, std::size_t len);
+
+  /**
+   * Append a message given as a header and a payload that follows it.
+   */
+  bool append(const void* header, std::size_t header_len, const void* payload,
+              std::size_t payload_len);
+
+  /**
+   * Would a message of len bytes fit in the space left.
+   */
+  bool fits(std::size_t len) const;
+
+  void clear();
+  bool empty() const { return count_ == 0; }
+  uint32_t count() const { return count_; }
+  const char* data() const { return buf_.data(); }
+  std::size_t size() const { return size_; }
+
+ private:
+  static std::size_t padded(std::size_t len) { return (len + 3) & ~3u; }
+
+  std::vector<char> buf_;
+  std::size_t size_;
+  uint32_t count_;
+};
+
+/**
+ * Iterates over the messages in a frame built by FrameBuilder.
+ */
+class FrameReader {
+ public:
+  /**
+   * Throws std::runtime_error if buf does not start with a frame header.
+   */
+  FrameReader(const char* buf, std::size_t len);
+
+  /**
+   * Point record at the next message in the frame. Returns false once all
+   * messages have been read and throws std::runtime_error if a message runs
+   * past the end of the frame.
+   */
+  bool next(const char*& record, std::size_t& len);
+
+  uint32_t count() const { return count_; }
+
+ private:
+  const char* buf_;
+  std::size_t len_;
+  std::size_t offset_;
+  uint32_t count_;
+  uint32_t read_;
+};
+/**
+ * A batch of delivered kTotal messages sent to a host catching up, in answer
+ * to a CatchupRequestMessage. The messages are the ones following (after_seq,
+ * after_proposer) in the total order, consecutive and in order, so a host
+ * can tell a batch that follows on from where it is from one that does not.
+ * Layout: type (8) | responder | after_seq | after_proposer | status | count
+ * | count x (sender | msg_id | data | epoch | final_seq |
+ * final_seq_proposer | payload size | payload padded to a multiple of 4
+ * bytes). The buffer is allocated once at construction.
+ */
+class CatchupBuilder {
+ public:
+  static constexpr uint32_t kType{8};
+  static constexpr std::size_t kHeaderSize{24};
+  static constexpr std::size_t kEntryHeaderSize{28};
+
+  enum Status : uint32_t {
+    // Another batch follows unasked
+    kMore = 0,
+    // The responder has more, ask again from the last message
+    kPartial = 1,
+    // Everything the responder has delivered so far
+    kDone = 2,
+    // The responder no longer has the messages asked for
+    kGone = 3,
+  };
+
+  explicit CatchupBuilder(std::size_t max_size);
+
+  /**
+   * Clear the batch for the messages following (after_seq, after_proposer).
+   */
+  void start(uint32_t responder, uint32_t after_seq, uint32_t after_proposer);
+
+  /**
+   * Append a delivered message with its payload. Returns false if it would
+   * not fit.
+   */
+  bool append(const DataMessage& msg);
+
+  void set_status(Status status);
+
+  uint32_t count() const { return count_; }
+  const char* data() const { return buf_.data(); }
+  std::size_t size() const { return size_; }
+
+  /**
+   * Final seq and proposer of the last message appended, (after_seq,
+   * after_proposer) while the batch is empty.
+   */
+  uint32_t last_seq() const { return last_seq_; }
+  uint32_t last_proposer() const { return last_proposer_; }
+
+  /**
+   * Bytes a message with len bytes of payload takes up in a batch.
+   */
+  static std::size_t entry_size(std::size_t len) {
+    return kEntryHeaderSize + ((len + 3) & ~std::size_t{3});
+  }
+
+ private:
+  void put(std::size_t offset, uint32_t word);
+
+  std::vector<char> buf_;
+  std::size_t size_;
+  uint32_t count_;
+  uint32_t last_seq_;
+  uint32_t last_proposer_;
+};
+
+/**
+ * Iterates over the messages in a batch built by CatchupBuilder.
+ */
+class CatchupReader {
+ public:
+  /**
+   * Throws std::runtime_error if buf does not start with a batch header.
+   */
+  CatchupReader(const char* buf, std::size_t len);
+
+  /**
+   * Fill msg with the next message, deliverable at its final sequence
+   * number and with its payload pointing into the batch. Returns false once
+   * all messages have been read and throws std::runtime_error if a message
+   * runs past the end of the batch.
+   */
+  bool next(DataMessage& msg);
+
+  uint32_t responder() const { return responder_; }
+  uint32_t after_seq() const { return after_seq_; }
+  uint32_t after_proposer() const { return after_proposer_; }
+  CatchupBuilder::Status status() const { return status_; }
+  uint32_t count() const { return count_; }
+
+ private:
+  const char* buf_;
+  std::size_t len_;
+  std::size_t offset_;
+  uint32_t responder_;
+  uint32_t after_seq_;
+  uint32_t after_proposer_;
+  CatchupBuilder::Status status_;
+  uint32_t count_;
+  uint32_t read_;
+};
 }  // namespace messages
@@ -0,0 +1,86 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <boost/asio.hpp>
+
+#include "buffer.hpp"
+
+#ifdef __linux__
+#include <sys/socket.h>
+#endif
+
+namespace multicast {
+
+/**
+ * True if this platform has recvmmsg/sendmmsg.
+ */
+constexpr bool mmsg_supported() {
+#ifdef __linux__
+  return true;
+#else
+  return false;
+#endif
+}
+
+/**
+ * A datagram to send with send_batch().
+ */
+struct OutgoingDatagram {
+  Segments message;
+  const boost::asio::ip::udp::endpoint* endpoint;
+};
+
+/**
+ * Ring of receive buffers drained with a single recvmmsg call.
+ *
+ * Each slot is a pooled buffer. A datagram filling less than a quarter of
+ * its slot is copied out, back to back with the others, into a packed buffer
+ * of four slots' size, so that it only pins about its own size once
+ * retained. A larger one is handed out in its slot. A slot whose buffer is
+ * still referenced when the next batch is read, because a payload received
+ * into it has not been delivered yet, is given a fresh buffer instead of
+ * being overwritten.
+ */
+class MmsgReceiver {
+ public:
+  MmsgReceiver(std::size_t batch, std::size_t slot_size);
+
+  /**
+   * Read up to batch datagrams from the non-blocking socket fd without
+   * waiting. Returns the number read, zero if none were ready.
+   */
+  std::size_t receive(int fd, boost::system::error_code& error);
+
+  const char* data(std::size_t slot) const { return data_[slot]; }
+  const BufferRef& buffer(std::size_t slot) const { return buffers_[slot]; }
+  std::size_t size(std::size_t slot) const;
+  bool truncated(std::size_t slot) const;
+  std::size_t batch() const { return batch_; }
+
+ private:
+  std::size_t batch_;
+  std::size_t slot_size_;
+  BufferPool pool_;
+  std::vector<BufferRef> slots_;
+  BufferPool packed_pool_;
+  BufferRef packed_{};
+  std::size_t packed_offset_{};
+  // Where each datagram of the last batch ended up
+  std::vector<BufferRef> buffers_;
+  std::vector<const char*> data_;
+#ifdef __linux__
+  std::vector<struct iovec> iovecs_;
+  std::vector<struct mmsghdr> headers_;
+#endif
+};
+
+/**
+ * Send every datagram in one sendmmsg call where possible. Datagrams that
+ * fail with a hard error are skipped and reported through error. Returns the
+ * number of datagrams consumed from the front of datagrams; anything after
+ * that would have blocked and should be retried asynchronously.
+ */
+std::size_t send_batch(int fd, const std::vector<OutgoingDatagram>& datagrams,
+                       boost::system::error_code& error);
+}  // namespace multicast
@@ -1,22 +1,59 @@
 #pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 #include <boost/asio.hpp>
 
 #include <spdlog/spdlog.h>
 
+#include "acks.hpp"
+#include "buffer.hpp"
+#include "causal.hpp"
+#include "config.hpp"
+#include "dedup.hpp"
+#include "delivery.hpp"
+#include "history.hpp"
+#include "journal.hpp"
 #include "messages.hpp"
+#include "ordering.hpp"
+#include "pending.hpp"
+#include "pool.hpp"
+#include "reassembly.hpp"
+#include "rtt.hpp"
+#include "stats.hpp"
+#include "timer_wheel.hpp"
+#include "trace.hpp"
+#include "transport.hpp"
 
 namespace multicast {
 
-class Multicaster {
+class Multicaster : private OrderingOutput {
  public:
   /**
-   * Constructor and being listening for connections.
+   * Constructor and being listening for connections. Runs over a
+   * UdpTransport on port of every host.
    */
   Multicaster(std::vector<std::string>& hosts, uint16_t port,
-              uint32_t process_id);
-  ~Multicaster();
+              uint32_t process_id, const Config& config = Config{});
+
+  /**
+   * Member process_id of a group of group_size processes, running over the
+   * transport make_transport creates. The transport-specific parts of config
+   * are left to the transport.
+   */
+  Multicaster(std::size_t group_size, uint32_t process_id,
+              const TransportFactory& make_transport,
+              const Config& config = Config{});
+  ~Multicaster() override;
 
   /**
    * Construct a DataMessage with the provided data and multicast the message
@@ -25,62 +62,585 @@ class Multicaster {
   void multicast(uint32_t data);
 
   /**
-   * Check for activity and run ready handlers.
+   * Multicast len bytes of payload along with data, to be delivered in
+   * order. The payload is sent straight from the caller's buffer, which only
+   * needs to live for the duration of the call. Throws std::runtime_error if
+   * len is larger than Config::max_payload_size, or if the journal has no
+   * room for the message.
+   *
+   * kFifo and kCausal messages skip agreement: a host delivers one as soon as
+   * the earlier FIFO and causal messages of its sender, and for kCausal the
+   * ones its sender had delivered, have been delivered there. They are not
+   * ordered against kTotal messages, which are not held up by them either.
+   */
+  void multicast(const void* payload, std::size_t len, uint32_t data = 0,
+                 DeliveryOrder order = DeliveryOrder::kTotal);
+
+  /**
+   * multicast() unless Config::max_in_flight own messages are already in
+   * flight or the journal has no room for it, in which case nothing is sent
+   * and false is returned. The window open handler runs once a slot frees up
+   * again, or once deliveries have made room in the journal. multicast()
+   * itself ignores the window but its messages still occupy it.
+   */
+  bool try_multicast(const void* payload, std::size_t len, uint32_t data = 0,
+                     DeliveryOrder order = DeliveryOrder::kTotal);
+
+  using WindowHandler = std::function<void()>;
+
+  /**
+   * Set the handler run after a try_multicast() was refused, as soon as the
+   * window or the journal has room again. It runs on a thread driving the Multicaster and
+   * may call try_multicast(). Set it before start() or run().
+   */
+  void on_window_open(WindowHandler handler) {
+    on_window_open_ = std::move(handler);
+  }
+
+  /**
+   * Send delivered messages to sink, which must outlive the Multicaster.
+   * Without a sink deliveries are only counted. Set it before start() or
+   * run().
+   */
+  void set_sink(DeliverySink* sink) { sink_ = sink; }
+
+  /**
+   * Own messages multicast but not yet sequenced, or not yet received
+   * everywhere for FIFO and causal messages.
+   */
+  std::size_t in_flight() const { return in_flight_.load(); }
+
+  /**
+   * Check for activity and run ready handlers. Not to be mixed with run() or
+   * start().
    */
   void poll() { io_context_.poll(); }
 
+  /**
+   * Run handlers on the calling thread, waiting for work as
+   * Config::wait_strategy says, until stop(). Once it is under way
+   * multicast() may be called from other threads. A JournalError thrown
+   * by a handler propagates out of it, as out of poll().
+   */
+  void run();
+
+  /**
+   * Call run() on Config::threads worker threads. multicast() may be called
+   * from other threads as soon as this returns. A worker whose run() throws
+   * logs why and stops them all, see failed().
+   */
+  void start();
+
+  /**
+   * Has a worker thread of start() failed and stopped the Multicaster. Safe
+   * to call from any thread.
+   */
+  bool failed() const { return failed_.load(); }
+
+  /**
+   * Make every run() return and join the worker threads. Called on
+   * destruction.
+   */
+  void stop();
+
+  /**
+   * Fetch the kTotal messages delivered by peer that this host has not
+   * delivered, the ones after the last it did, and deliver them before
+   * carrying on with the live ones. For a host that was down or fell behind,
+   * on a journal or fresh. The messages come in batches of
+   * Config::catchup_batch_bytes, Config::catchup_window of them per
+   * request, which are sent apart from the ordering traffic. Live kTotal
+   * deliveries wait until peer has sent everything it has delivered, the
+   * live messages received meanwhile then follow on from the last message
+   * caught up. FIFO and causal messages are only received live.
+   *
+   * peer needs a Config::catchup_history that still holds the message after
+   * the last one delivered here, otherwise catching up ends with a warning
+   * and may be tried with another peer. Call it before start() or run() for
+   * nothing to be delivered ahead of the messages caught up. Throws
+   * std::runtime_error if peer is not another host of the group.
+   */
+  void catch_up(uint32_t peer);
+
+  /**
+   * Is a catch_up() still under way. Safe to call from any thread.
+   */
+  bool catching_up() const { return catching_up_.load(); }
+
+  /**
+   * Messages delivered through catch_up() so far, included in delivered().
+   * Safe to call from any thread.
+   */
+  std::size_t caught_up() const { return caught_up_.load(); }
+
+  /**
+   * Occupancy of the pool backing pending messages. Only consistent while no
+   * worker threads are running.
+   */
+  MessagePool::Stats pool_stats() const { return pool_.stats(); }
+
+  /**
+   * Number of messages delivered so far. Safe to call from any thread.
+   */
+  std::size_t delivered() const { return delivered_.load(); }
+
+  /**
+   * Retransmissions so far. Safe to call from any thread.
+   */
+  RetransmitStats retransmit_stats() const {
+    return RetransmitStats{data_retransmits_.load(std::memory_order_relaxed),
+                           seq_retransmits_.load(std::memory_order_relaxed)};
+  }
+
+  /**
+   * Duplicates dropped so far. Safe to call from any thread.
+   */
+  DuplicateStats duplicate_stats() const {
+    return DuplicateStats{duplicate_data_.load(std::memory_order_relaxed),
+                          duplicate_acks_.load(std::memory_order_relaxed),
+                          duplicate_seqs_.load(std::memory_order_relaxed),
+                          data_ahead_.load(std::memory_order_relaxed),
+                          journal_full_.load(std::memory_order_relaxed)};
+  }
+
+  /**
+   * Counters and latency histograms so far. Safe to call from any thread,
+   * though counters read while messages flow may be a message apart.
+   */
+  StatsSnapshot stats() const;
+
  private:
+  // One past the highest wire type, see messages.hpp
+  static constexpr std::size_t kMessageTypes{10};
+
   /**
-   * Receives a connection on the socket and reads the received message into
-   * recv_buffer_. Passes responsibility to handle_receive() to handle the
-   * message.
+   * One receive path of the transport. Every datagram from a given peer
+   * lands on the same shard and is decoded on that shard's strand. A shard
+   * also owns the ack collection of the own messages whose msg_id maps to
+   * it, along with their retransmit timers and the round trip times they
+   * sample.
    */
-  void start_receive();
+  struct Shard {
+    Shard(boost::asio::io_context& io_context, std::size_t index,
+          const Config& config, BufferPool& reassembly_pool,
+          std::size_t group_size)
+        : index{index},
+          strand{io_context.get_executor()},
+          retransmit_wheel{config.retransmit_tick, 1024},
+          retransmit_timer{io_context},
+          reassembler{reassembly_pool, group_size, config.reassembly_slots} {}
+
+    std::size_t index;
+    Strand strand;
+    AckCollector acks{};
+    TimingWheel retransmit_wheel;
+    boost::asio::steady_timer retransmit_timer;
+    bool retransmit_timer_armed{};
+    // Indexed by process id
+    std::vector<RttEstimator> rtt{};
+    // Fragments of the senders that map to this shard
+    Reassembler reassembler;
+  };
 
   /**
    * Determine the type of the received message and respond accordingly.
+   * With Ordering::kIsis:
    * DataMessage:
-   *  Mark message undeliverable.
-   *  Add message to queue.
-   *  Send Ack with proposed sequence number of last received seq + 1.
+   *  Propose max(last agreed seq, last proposed seq) + 1.
+   *  Add message to the pending store, undeliverable, at the proposed seq.
+   *  Send Ack with the proposed sequence number.
    * AckMessage:
    *  Collect acks from all hosts in hostsfile.
-   *  Determine final sequence number by max(proposed sequence).
+   *  Determine final sequence number by max(proposed sequence, proposer).
    *  Once all acks received send Seq to all hosts.
    * SeqMessage:
-   *  Mark message as deliverable and set final sequence number.
-   *  Go thorugh queue and deliver all messages that are deliverable with final
-   *    sequence number less than M's sequence.
+   *  Mark message as deliverable and move it to its final sequence number.
+   *  Deliver from the head of the pending store while the head is
+   *    deliverable.
+   *  Send SeqAck to the sender.
+   * SeqAckMessage:
+   *  Stop retransmitting Seq to the confirming host.
+   * FragmentMessage:
+   *  Copy it into the message it is part of. Once that is whole, handle it
+   *  as if it had arrived in one datagram.
+   * StreamMessage:
+   *  Deliver it, and whatever it was holding up, once it is deliverable in
+   *  FIFO or causal order. See CausalOrder.
+   *  Send SeqAck to the sender.
+   * With Ordering::kSequencer the sequencer sends Seq with the next sequence
+   * number as soon as it receives the Data, and hosts deliver in sequence
+   * number order. There are no acks. See OrderingEngine.
+   * Data, Seq and Stream handling runs on order_strand_, Ack and SeqAck
+   * handling on the strand of the shard owning the msg_id, Fragment
+   * handling on the strand of the shard owning the sender.
+   *
+   * Handle one received datagram, unpacking it if it is a frame. buffer is
+   * the pooled buffer the datagram lives in.
+   */
+  void handle_datagram(const BufferRef& buffer, const char* buf,
+                       std::size_t len);
+
+  /**
+   * Decode a single message, either a whole datagram or one record of a
+   * frame, and hand it to the strand that owns its state. See
+   * handle_datagram().
+   */
+  void handle_message(const BufferRef& buffer, const char* buf,
+                      std::size_t len);
+
+  void handle_data(messages::DataMessage& D, BufferRef buffer);
+  /**
+   * Note that sender sent a message in incarnation epoch. A sender back in
+   * a new one restarted without its state and counts its msg_ids and
+   * stream from the start again, so its duplicate window and stream are
+   * started over. Runs on order_strand_ before the message is looked at.
+   */
+  void check_epoch(uint32_t sender, uint32_t epoch);
+  void handle_ack(Shard& shard, const messages::AckMessage& A);
+  void handle_seq(const messages::SeqMessage& S);
+  void handle_seq_ack(Shard& shard, const messages::SeqAckMessage& SA);
+  void handle_stream(const messages::StreamMessage& M, BufferRef buffer);
+  void handle_fragment(Shard& shard, const messages::FragmentMessage& F);
+
+  /**
+   * Deliver pending messages from the head for as long as the engine lets
+   * them go.
+   */
+  void deliver_pending();
+
+  /**
+   * Start sending R.requester batches of what follows (R.after_seq,
+   * R.after_proposer), or start over from there. Runs on catchup_strand_.
+   */
+  void handle_catchup_request(const messages::CatchupRequestMessage& R);
+
+  /**
+   * Send requester its next batch and queue the one after, if the window
+   * has room. Runs on catchup_strand_.
+   */
+  void serve_catchup(uint32_t requester);
+
+  /**
+   * Deliver the messages of a batch that follows on from the last one
+   * delivered, and ask for more or finish once the peer says so.
+   */
+  void handle_catchup(messages::CatchupReader& batch, BufferRef buffer);
+
+  /**
+   * Whether every message of batch is whole and from a process of the group.
+   */
+  bool valid_catchup(const messages::CatchupReader& batch) const;
+
+  /**
+   * Ask catchup_peer_ for what follows the last message delivered.
+   */
+  void send_catchup_request();
+
+  /**
+   * Ask again if no batch followed on since the timer was last set.
+   */
+  void arm_catchup_timer();
+
+  /**
+   * Resume live delivery after the last message caught up.
+   */
+  void finish_catch_up();
+
+  /**
+   * Carry on from the state a journal held: counters, duplicate windows,
+   * pending messages and own messages to see through. Runs in the
+   * constructor, before any handler.
+   */
+  void recover(const journal::Recovery& recovery);
+
+  /**
+   * Tell sender that this host has message msg_id.
+   */
+  void send_seq_ack(uint32_t sender, uint32_t msg_id);
+
+  /**
+   * Hand delivery_batch_ to the sink.
+   */
+  void flush_deliveries();
+
+  /**
+   * Record an event about message msg_id of sender if tracing.
+   */
+  void record_trace(trace::Kind kind, uint32_t type, uint32_t sender,
+                    uint32_t msg_id, uint32_t seq, uint32_t peer) {
+    if (tracer_) tracer_->record(kind, type, sender, msg_id, seq, peer);
+  }
+
+  /**
+   * Count the message starting at buf under its wire type in counts.
+   */
+  static void count(std::array<std::atomic<uint64_t>, kMessageTypes>& counts,
+                    const char* buf, std::size_t len);
+
+  /**
+   * Record the sequence the sequencer gave an own message and free its
+   * window slot.
+   */
+  void handle_own_seq(Shard& shard, const messages::SeqMessage& S);
+
+  /**
+   * OrderingOutput, called on order_strand_ or the shard strands.
+   */
+  void send_ack(const messages::AckMessage& A) override;
+  void send_seq(const messages::SeqMessage& S, uint32_t hostnum) override;
+  void send_seq_all(const messages::SeqMessage& S) override;
+
+  /**
+   * Arm the retransmit timer of state for the slowest peer it is waiting
+   * on, backing off with every retransmission.
+   */
+  void schedule_retransmit(Shard& shard, AckState& state);
+
+  /**
+   * Tick the shard's retransmit wheel while it has timers.
+   */
+  void arm_retransmit_timer(Shard& shard);
+
+  /**
+   * Resend whatever the peers are still missing of own message msg_id, if
+   * tick is still its current deadline.
+   */
+  void retransmit(Shard& shard, uint32_t msg_id, uint64_t tick);
+
+  /**
+   * Run handler on strand, or right away when there is only one shard and
+   * everything already runs serialized on it.
+   */
+  template <typename Handler>
+  void run_on(Strand& strand, Handler&& handler) {
+    if (shards_.size() == 1) {
+      handler();
+    } else {
+      boost::asio::post(strand, std::forward<Handler>(handler));
+    }
+  }
+
+  /**
+   * Encode and send a DataMessage, or a StreamMessage for anything but
+   * kTotal, that already holds a window slot.
+   */
+  void send_data(const void* payload, std::size_t len, uint32_t data,
+                 DeliveryOrder order);
+
+  /**
+   * Does an own message of size bytes go out in fragments.
+   */
+  bool fragmented(std::size_t size) const {
+    return config_.fragment_size && size > config_.fragment_size;
+  }
+
+  /**
+   * Split own message msg_id, size bytes as it would go out whole, into
+   * fragments of Config::fragment_size and hand each to send.
+   */
+  template <typename Send>
+  void fragment(uint32_t msg_id, const char* message, std::size_t size,
+                Send&& send) {
+    constexpr std::size_t kHeaderSize{
+        messages::codec::WireLayout<messages::FragmentMessage>::kSize};
+    std::size_t slice{config_.fragment_size - kHeaderSize};
+    uint32_t count{static_cast<uint32_t>((size + slice - 1) / slice)};
+    char header[kHeaderSize];
+    for (uint32_t i = 0; i < count; i++) {
+      std::size_t offset{i * slice};
+      messages::FragmentMessage F{process_id_, msg_id,
+                                  static_cast<uint32_t>(size),
+                                  static_cast<uint32_t>(offset), i, count};
+      F.encode(header, sizeof(header));
+      send(Segments{boost::asio::buffer(header, kHeaderSize),
+                    boost::asio::buffer(message + offset,
+                                        std::min(slice, size - offset))});
+    }
+  }
+
+  /**
+   * Encode the header of a StreamMessage with its vector clock into buf.
+   */
+  std::size_t encode_stream(uint32_t msg_id, uint32_t data,
+                            DeliveryOrder order, char* buf, std::size_t len);
+
+  /**
+   * Take a slot in the in-flight window if there is one.
+   */
+  bool acquire_window_slot();
+
+  /**
+   * Give back the slot of a sequenced message and report the window open if
+   * a try_multicast() was refused.
+   */
+  void release_window_slot();
+
+  /**
+   * Report the window open if a try_multicast() was refused for want of
+   * room in the journal, which was just made.
+   */
+  void journal_room_made();
+
+  /**
+   * Point data at a copy of its size bytes and return the buffer the copy
+   * lives in, so that keeping them does not pin the receive buffer they
+   * share with other datagrams. Copies are packed back to back into buffers
+   * of the largest message. Bytes taking up a quarter of their buffer or
+   * more stay where they are. Order strand only.
+   */
+  BufferRef retain(const BufferRef& buffer, const char*& data,
+                   std::size_t size);
+
+  /**
+   * Record that every peer has the final sequence number of own message
+   * msg_id, which makes room in the journal.
+   */
+  void confirmed(uint32_t msg_id);
+
+  /**
+   * The kSpinThenBlock loop of run().
+   */
+  void run_spin_then_block();
+
+  /**
+   * Shard owning the ack collection of own message msg_id.
+   */
+  Shard& ack_shard(uint32_t msg_id) {
+    return *shards_[msg_id % shards_.size()];
+  }
+
+  /*
+   * Everything below sends and requires send_mutex_ to be held, except for
+   * send_record() and send_record_multi() which take it.
+   */
+
+  /**
+   * Send message to all hosts, a datagram each.
+   */
+  void send_multi(const Segments& message);
+
+  /**
+   * Queue a message for hostnum in that host's frame. Sent immediately when
+   * batching is disabled or the message is too large for a frame.
+   */
+  void send_record(const Segments& message, std::size_t hostnum);
+
+  /**
+   * send_record() with send_mutex_ already held.
    */
-  void handle_receive(const boost::system::error_code& error,
-                      std::size_t /*bytes_transferred*/);
+  void append_record(const Segments& message, std::size_t hostnum);
 
   /**
-   * Send buffer to host indexed with hostnum in hostsfile.
+   * Queue a message for all hosts, see send_record(). If the transport has a
+   * group it is queued for the group instead.
    */
-  void send_single(boost::asio::mutable_buffer message, int hostnum);
+  void send_record_multi(const Segments& message);
 
   /**
-   * Send buffer to all hosts.
+   * Send the frame queued for hostnum, if any.
    */
-  void send_multi(boost::asio::mutable_buffer message);
+  void flush(std::size_t hostnum);
 
   /**
-   * Dummy handle for async sending of message.
+   * Send every queued frame in one go. Runs when the batch delay expires.
    */
-  void handle_send(boost::asio::mutable_buffer /*message*/,
-                   const boost::system::error_code& /*error*/,
-                   std::size_t /*bytes_transferred*/) {}
+  void flush_all();
 
+  Config config_;
   boost::asio::io_context io_context_{};
-  boost::asio::ip::udp::socket socket_;
-  std::string port_;
-  std::vector<std::string> hosts_;
-  boost::asio::ip::udp::endpoint remote_endpoint_;
-  std::vector<uint32_t> recv_buffer_;
-  std::vector<messages::DataMessage*> queue_{};
-  uint32_t last_seq_received_{};
+  // Its receive buffers must outlive the pending messages that point into
+  // them
+  std::unique_ptr<Transport> transport_;
+  std::size_t group_size_;
+  // Hosts, plus the group if the transport has one
+  std::size_t destinations_;
+  // Serializes the send path: frames and the transport
+  std::mutex send_mutex_{};
   uint32_t process_id_;
-  uint32_t last_msg_id_{};
+  // Copies of own DataMessages kept for retransmission, outlives the shards
+  BufferPool retransmit_pool_;
+  // Messages put together from fragments, outlives the shards too
+  BufferPool reassembly_pool_;
+  // Copies of received messages kept past their handler, see retain(). The
+  // buffer copied into last and its use are only touched on order_strand_.
+  BufferPool retained_pool_;
+  BufferRef retained_buffer_{};
+  std::size_t retained_offset_{};
+  std::vector<std::unique_ptr<Shard>> shards_{};
+  std::vector<Outgoing> outgoing_{};
+  std::vector<messages::FrameBuilder> outbox_{};
+  // Largest frame the coalescer builds, no larger than a fragment
+  std::size_t frame_size_{};
+  boost::asio::steady_timer flush_timer_;
+  bool flush_pending_{};
+  // Ordering state, only touched on order_strand_, which is the shard strand
+  // when there is only one shard
+  Strand order_strand_;
+  MessagePool pool_{};
+  PendingStore pending_{pool_};
+  std::unique_ptr<OrderingEngine> engine_{};
+  CausalOrder causal_;
+  // Data msg_ids seen per sender, and the incarnation they belong to
+  std::vector<DuplicateWindow> seen_{};
+  std::vector<uint32_t> sender_epoch_{};
+  // Seqs that overtook their Data, by sender and msg_id
+  std::unordered_map<uint64_t, messages::SeqMessage> early_seqs_{};
+  std::vector<Delivery> delivery_batch_{};
+  DeliverySink* sink_{};
+  // Incarnation of this process, new on every start without a journal
+  uint32_t epoch_{};
+  std::atomic<uint32_t> last_msg_id_{};
+  std::atomic<uint32_t> last_stream_seq_{};
+  // What causal_ has delivered per sender, read by senders for their clocks
+  std::unique_ptr<std::atomic<uint32_t>[]> stream_delivered_;
+  std::atomic<std::size_t> delivered_{};
+  std::atomic<std::size_t> in_flight_{};
+  std::atomic<std::size_t> data_retransmits_{};
+  std::atomic<std::size_t> seq_retransmits_{};
+  std::atomic<std::size_t> duplicate_data_{};
+  std::atomic<std::size_t> duplicate_acks_{};
+  std::atomic<std::size_t> duplicate_seqs_{};
+  std::atomic<std::size_t> data_ahead_{};
+  std::atomic<std::size_t> journal_full_{};
+  // Messages by wire type, see count()
+  std::array<std::atomic<uint64_t>, kMessageTypes> sent_{};
+  std::array<std::atomic<uint64_t>, kMessageTypes> received_{};
+  std::atomic<std::size_t> pending_depth_{};
+  LatencyHistogram data_to_acks_{};
+  LatencyHistogram acks_to_seq_{};
+  LatencyHistogram seq_to_delivery_{};
+  std::unique_ptr<Tracer> tracer_{};
+  std::unique_ptr<Journal> journal_{};
+  // Catching up, see catch_up(). The history is appended to on
+  // order_strand_ and served from catchup_strand_.
+  std::unique_ptr<DeliveryHistory> history_{};
+  Strand catchup_strand_;
+  struct CatchupSession {
+    uint32_t seq;
+    uint32_t proposer;
+    std::size_t batches;  // left to send unasked
+  };
+  // Indexed by requester, only touched on catchup_strand_
+  std::vector<CatchupSession> catchup_sessions_{};
+  messages::CatchupBuilder catchup_batch_;
+  // The last kTotal message delivered, and catching up from it, only
+  // touched on order_strand_
+  uint32_t delivered_seq_{};
+  uint32_t delivered_proposer_{};
+  uint32_t catchup_peer_{};
+  bool catchup_progress_{};
+  boost::asio::steady_timer catchup_timer_;
+  std::atomic<bool> catching_up_{};
+  std::atomic<std::size_t> caught_up_{};
+  // Set when try_multicast() is refused until the window reopens
+  std::atomic<bool> window_blocked_{};
+  // A try_multicast() was refused for want of room in the journal
+  std::atomic<bool> journal_blocked_{};
+  WindowHandler on_window_open_{};
+  std::vector<std::thread> workers_{};
+  // Set while anything may be running handlers besides the caller
+  std::atomic<bool> running_{};
+  std::atomic<bool> failed_{};
+  bool closing_{};
 };
 } // namespace multicast
\ No newline at end of file
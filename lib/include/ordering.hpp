@@ -0,0 +1,180 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "buffer.hpp"
+#include "messages.hpp"
+#include "pending.hpp"
+
+namespace multicast {
+
+/**
+ * How the group agrees on a total order.
+ */
+enum class Ordering {
+  // Three phase ISIS agreement. Every host proposes a sequence number for a
+  // message and its sender picks the largest. No host is special.
+  kIsis,
+  // A fixed sequencer process numbers messages in the order it receives
+  // them. An order is known after two hops instead of three, but the
+  // sequencer is a single point of failure.
+  kSequencer,
+};
+
+/**
+ * The sends an OrderingEngine makes, provided by the Multicaster.
+ */
+class OrderingOutput {
+ public:
+  virtual ~OrderingOutput() = default;
+
+  /**
+   * Send A to the sender of the message it acks.
+   */
+  virtual void send_ack(const messages::AckMessage& A) = 0;
+
+  /**
+   * Send S to the host indexed with hostnum in the hostsfile.
+   */
+  virtual void send_seq(const messages::SeqMessage& S, uint32_t hostnum) = 0;
+
+  /**
+   * Send S to all hosts.
+   */
+  virtual void send_seq_all(const messages::SeqMessage& S) = 0;
+};
+
+/**
+ * The receiving side of an ordering protocol: what a host does with the
+ * DataMessages and SeqMessages it receives, and when a pending message may
+ * be delivered. Duplicates are weeded out before the engine sees a message.
+ * Collecting acks and retransmitting an own message stays with the
+ * Multicaster. Not thread safe, the Multicaster runs it on its order strand.
+ */
+class OrderingEngine {
+ public:
+  OrderingEngine(PendingStore& pending, OrderingOutput& output,
+                 uint32_t process_id)
+      : pending_{pending}, output_{output}, process_id_{process_id} {}
+  virtual ~OrderingEngine() = default;
+
+  OrderingEngine(const OrderingEngine&) = delete;
+  OrderingEngine& operator=(const OrderingEngine&) = delete;
+
+  /**
+   * A DataMessage received for the first time. buffer holds its payload.
+   */
+  virtual void on_data(const messages::DataMessage& D, BufferRef buffer) = 0;
+
+  /**
+   * A DataMessage received again, presumably retransmitted. pending is its
+   * entry in the pending store, nullptr once it has been delivered.
+   */
+  virtual void on_duplicate_data(const messages::DataMessage& D,
+                                 messages::DataMessage* pending) = 0;
+
+  /**
+   * The first SeqMessage for pending message m.
+   */
+  virtual void on_seq(messages::DataMessage* m,
+                      const messages::SeqMessage& S) = 0;
+
+  /**
+   * Remove the next message to deliver from the pending store. Returns an
+   * empty handle if it is not known yet.
+   */
+  virtual PendingStore::Handle pop_deliverable() = 0;
+
+  /**
+   * Whether the sender of a message collects an AckMessage from every host
+   * and sends the SeqMessage itself. Otherwise the engine sequences it and
+   * the sender only waits for the hosts to confirm.
+   */
+  virtual bool sender_collects_acks() const = 0;
+
+  /**
+   * Pick up after a restart: highest_seq is the largest sequence number
+   * this process had proposed, assigned or seen and delivered_seq the
+   * largest it had delivered. Called before any message is handled, and
+   * again once messages up to delivered_seq were caught up on from a peer.
+   * Never moves either backwards.
+   */
+  virtual void restore(uint32_t highest_seq, uint32_t delivered_seq) = 0;
+
+ protected:
+  PendingStore& pending_;
+  OrderingOutput& output_;
+  uint32_t process_id_;
+};
+
+/**
+ * ISIS agreement. Each host proposes one past anything it has agreed on or
+ * proposed and a message is delivered once it is final and orders before
+ * every other pending message.
+ */
+class IsisEngine : public OrderingEngine {
+ public:
+  using OrderingEngine::OrderingEngine;
+
+  void on_data(const messages::DataMessage& D, BufferRef buffer) override;
+  void on_duplicate_data(const messages::DataMessage& D,
+                         messages::DataMessage* pending) override;
+  void on_seq(messages::DataMessage* m,
+              const messages::SeqMessage& S) override;
+  PendingStore::Handle pop_deliverable() override;
+  bool sender_collects_acks() const override { return true; }
+  void restore(uint32_t highest_seq, uint32_t delivered_seq) override;
+
+ private:
+  uint32_t last_seq_received_{};
+  uint32_t last_seq_proposed_{};
+};
+
+/**
+ * Fixed sequencer ordering. The sequencer hands out consecutive sequence
+ * numbers to messages as they arrive and multicasts them as SeqMessages.
+ * Every host delivers in sequence number order without gaps, so a message
+ * waits for the ones numbered before it. Messages stay out of the delivery
+ * order until their SeqMessage arrives.
+ *
+ * The sequencer remembers the last history numbers it gave each sender, so
+ * it can answer a retransmitted DataMessage whose SeqMessage its sender
+ * missed.
+ */
+class SequencerEngine : public OrderingEngine {
+ public:
+  /**
+   * history is rounded up to a power of two.
+   */
+  SequencerEngine(PendingStore& pending, OrderingOutput& output,
+                  uint32_t process_id, uint32_t sequencer, std::size_t hosts,
+                  std::size_t history = 4096);
+
+  void on_data(const messages::DataMessage& D, BufferRef buffer) override;
+  void on_duplicate_data(const messages::DataMessage& D,
+                         messages::DataMessage* pending) override;
+  void on_seq(messages::DataMessage* m,
+              const messages::SeqMessage& S) override;
+  PendingStore::Handle pop_deliverable() override;
+  bool sender_collects_acks() const override { return false; }
+  void restore(uint32_t highest_seq, uint32_t delivered_seq) override;
+
+  bool is_sequencer() const { return process_id_ == sequencer_; }
+
+ private:
+  struct Assignment {
+    uint32_t msg_id;
+    uint32_t seq;  // zero if the slot was never assigned
+  };
+
+  uint32_t sequencer_;
+  // Next number to hand out, sequencer only
+  uint32_t next_assigned_{1};
+  // Next number to deliver
+  uint32_t next_delivered_{1};
+  // Recent assignments per sender indexed by msg_id, sequencer only
+  std::vector<std::vector<Assignment>> history_{};
+  std::size_t history_mask_{};
+};
+}  // namespace multicast
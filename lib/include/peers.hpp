@@ -0,0 +1,103 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <boost/asio.hpp>
+
+namespace multicast {
+
+/**
+ * Table of peer endpoints indexed by process id.
+ *
+ * Host names are resolved once, in parallel, on a small resolver pool so the
+ * send path never performs a name lookup. Completions are posted back to the
+ * owning io_context, which is the only place the table is modified. Entries
+ * can optionally be refreshed on an interval; the previous endpoint keeps
+ * serving sends until the refreshed one is available. Lookups may come from
+ * any thread running the io_context.
+ */
+class PeerDirectory {
+ public:
+  using ResolveHandler = std::function<void(std::size_t /*peer*/)>;
+
+  PeerDirectory(boost::asio::io_context& io_context,
+                const std::vector<std::string>& hosts, const std::string& port,
+                std::chrono::milliseconds refresh_interval);
+  ~PeerDirectory();
+
+  PeerDirectory(const PeerDirectory&) = delete;
+  PeerDirectory& operator=(const PeerDirectory&) = delete;
+
+  /**
+   * Kick off resolution of every host. on_resolved is invoked on the
+   * io_context the first time each peer becomes resolvable.
+   */
+  void start(ResolveHandler on_resolved);
+
+  /**
+   * Copy the endpoint of peer into endpoint. Returns false, leaving endpoint
+   * untouched, if the peer has not been resolved yet.
+   */
+  bool endpoint(std::size_t peer,
+                boost::asio::ip::udp::endpoint& endpoint) const {
+    std::lock_guard<std::mutex> lock{mutex_};
+    if (!peers_[peer].resolved) return false;
+    endpoint = peers_[peer].endpoint;
+    return true;
+  }
+
+  bool all_resolved() const {
+    std::lock_guard<std::mutex> lock{mutex_};
+    return unresolved_ == 0;
+  }
+  std::size_t size() const { return peers_.size(); }
+  const std::string& host(std::size_t peer) const { return peers_[peer].host; }
+
+ private:
+  struct Peer {
+    Peer(boost::asio::io_context& io_context, const std::string& host)
+        : host{host}, timer{io_context} {}
+
+    std::string host;
+    boost::asio::ip::udp::endpoint endpoint{};
+    bool resolved{};
+    boost::asio::steady_timer timer;
+  };
+
+  /**
+   * Resolve peer on the resolver pool and post the result back.
+   */
+  void resolve(std::size_t peer);
+
+  /**
+   * Apply a resolution result on the io_context and schedule the next one.
+   */
+  void handle_resolve(std::size_t peer, const boost::system::error_code& error,
+                      const boost::asio::ip::udp::endpoint& endpoint);
+
+  /**
+   * Arm the peer's timer to resolve it again after delay.
+   */
+  void schedule(std::size_t peer, std::chrono::milliseconds delay);
+
+  static constexpr std::chrono::milliseconds kRetryDelay{1000};
+  static constexpr std::size_t kMaxResolverThreads{8};
+
+  boost::asio::io_context& io_context_;
+  std::string port_;
+  std::chrono::milliseconds refresh_interval_;
+  // Guards the endpoint, resolved flag and unresolved_ count
+  mutable std::mutex mutex_{};
+  std::vector<Peer> peers_{};
+  std::size_t unresolved_;
+  ResolveHandler on_resolved_{};
+  // Released on destruction so completions still in flight on the pool are
+  // discarded instead of touching a dead directory.
+  std::shared_ptr<bool> alive_;
+  boost::asio::thread_pool resolver_pool_;
+};
+}  // namespace multicast
@@ -0,0 +1,179 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <vector>
+#include <boost/intrusive/unordered_set.hpp>
+
+#include "buffer.hpp"
+#include "messages.hpp"
+#include "pool.hpp"
+
+namespace multicast {
+
+/**
+ * Identifies a DataMessage across the group. msg_id alone is only unique per
+ * sender.
+ */
+struct MessageKey {
+  uint32_t sender;
+  uint32_t msg_id;
+
+  bool operator==(const MessageKey& other) const {
+    return sender == other.sender && msg_id == other.msg_id;
+  }
+};
+
+struct MessageKeyHash {
+  std::size_t operator()(const MessageKey& key) const {
+    return std::hash<uint64_t>{}((static_cast<uint64_t>(key.sender) << 32) |
+                                 key.msg_id);
+  }
+};
+
+/**
+ * Pooled storage for a pending message, linked directly into the store's
+ * index so indexing never allocates. msg.payload points into payload_buffer,
+ * which is held until the entry is delivered.
+ */
+struct PendingEntry {
+  PendingEntry(const messages::DataMessage& msg, BufferRef payload_buffer)
+      : msg{msg},
+        key{msg.sender, msg.msg_id},
+        payload_buffer{std::move(payload_buffer)} {}
+
+  messages::DataMessage msg;
+  MessageKey key;
+  BufferRef payload_buffer;
+  // When the message became deliverable, for the latency stats
+  std::chrono::steady_clock::time_point sequenced_at{};
+  boost::intrusive::unordered_set_member_hook<> hook{};
+};
+
+using MessagePool = ObjectPool<PendingEntry>;
+
+/**
+ * Messages that have been received but not yet delivered.
+ *
+ * Messages are indexed by (sender, msg_id) for constant time lookup when an
+ * ack or seq arrives, and kept in a min-heap on
+ * (final_seq, final_seq_proposer) so delivery only has to look at the head.
+ * While a message is undeliverable final_seq holds the locally proposed (or
+ * best known) sequence number. Priorities only ever increase, so reordering
+ * pushes a fresh heap node and the outdated one is discarded lazily when it
+ * reaches the head.
+ *
+ * A message stored with final_seq kUnordered is only indexed. It joins the
+ * delivery order when reorder() gives it a sequence number.
+ *
+ * Entries come from a MessagePool and go back to it when the Handle returned
+ * by pop_head() is dropped, so a store that has reached its working set does
+ * no heap allocation per message.
+ */
+class PendingStore {
+ public:
+  using Handle = MessagePool::Handle;
+
+  // final_seq of a message that has no place in the delivery order yet
+  static constexpr uint32_t kUnordered{0xffffffffu};
+
+  explicit PendingStore(MessagePool& pool, std::size_t capacity_hint = 1024);
+  ~PendingStore();
+
+  PendingStore(const PendingStore&) = delete;
+  PendingStore& operator=(const PendingStore&) = delete;
+
+  /**
+   * Take a copy of msg, keeping payload_buffer (the buffer msg's payload
+   * lives in, if any) alive with it. Returns the stored message, or nullptr if
+   * a message with the same key is already pending.
+   */
+  messages::DataMessage* insert(const messages::DataMessage& msg,
+                                BufferRef payload_buffer = BufferRef{});
+
+  /**
+   * Find the pending message sent by sender with msg_id, nullptr if absent.
+   */
+  messages::DataMessage* find(uint32_t sender, uint32_t msg_id);
+
+  /**
+   * The entry of that message, nullptr if absent.
+   */
+  PendingEntry* find_entry(uint32_t sender, uint32_t msg_id);
+
+  /**
+   * Update the ordering fields of a pending message and restore heap order.
+   */
+  void reorder(messages::DataMessage* msg, uint32_t seq, uint32_t proposer,
+               bool deliverable);
+
+  /**
+   * The message that orders first, provided it is deliverable. nullptr if the
+   * store is empty or the head is still waiting for its final sequence.
+   */
+  messages::DataMessage* deliverable_head();
+
+  /**
+   * Remove the head returned by deliverable_head(). The entry returns to the
+   * pool when the handle is dropped.
+   */
+  Handle pop_head();
+
+  /**
+   * Take the message sent by sender with msg_id out of the store wherever
+   * it orders, an empty handle if absent. Its heap nodes are discarded
+   * lazily.
+   */
+  Handle remove(uint32_t sender, uint32_t msg_id);
+
+  std::size_t size() const { return index_.size(); }
+  bool empty() const { return index_.empty(); }
+
+ private:
+  struct HeapNode {
+    uint32_t seq;
+    uint32_t proposer;
+    MessageKey key;
+  };
+
+  struct OrdersAfter {
+    bool operator()(const HeapNode& a, const HeapNode& b) const {
+      if (a.seq != b.seq) return a.seq > b.seq;
+      if (a.proposer != b.proposer) return a.proposer > b.proposer;
+      if (a.key.sender != b.key.sender) return a.key.sender > b.key.sender;
+      return a.key.msg_id > b.key.msg_id;
+    }
+  };
+
+  struct EntryKey {
+    using type = MessageKey;
+    const MessageKey& operator()(const PendingEntry& entry) const {
+      return entry.key;
+    }
+  };
+
+  using Index = boost::intrusive::unordered_set<
+      PendingEntry,
+      boost::intrusive::member_hook<PendingEntry,
+                                    boost::intrusive::unordered_set_member_hook<>,
+                                    &PendingEntry::hook>,
+      boost::intrusive::key_of_value<EntryKey>,
+      boost::intrusive::hash<MessageKeyHash>,
+      boost::intrusive::power_2_buckets<true>>;
+
+  /**
+   * Pop heap nodes that no longer describe a pending message.
+   */
+  void discard_stale();
+
+  /**
+   * Double the bucket array once the load factor reaches one.
+   */
+  void grow_index();
+
+  MessagePool& pool_;
+  std::vector<Index::bucket_type> buckets_;
+  Index index_;
+  std::priority_queue<HeapNode, std::vector<HeapNode>, OrdersAfter> order_;
+};
+}  // namespace multicast
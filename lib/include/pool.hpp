@@ -0,0 +1,114 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace multicast {
+
+/**
+ * Slab allocated free-list pool of T.
+ *
+ * Storage is carved out of slabs of slab_size objects that are only ever
+ * returned to the heap when the pool is destroyed, so once the pool has grown
+ * to the working set acquiring and releasing objects never allocates.
+ * Objects are handed out as Handles which destroy the object and return its
+ * slot to the pool when they go out of scope. The pool must outlive every
+ * Handle it has issued. Not thread safe.
+ */
+template <typename T>
+class ObjectPool {
+ public:
+  struct Stats {
+    std::size_t capacity;    // slots allocated across all slabs
+    std::size_t in_use;      // slots currently handed out
+    std::size_t high_water;  // largest in_use seen
+    std::size_t slabs;       // number of slabs allocated
+  };
+
+  class Deleter {
+   public:
+    Deleter() = default;
+    explicit Deleter(ObjectPool* pool) : pool_{pool} {}
+    void operator()(T* object) const { pool_->release(object); }
+
+   private:
+    ObjectPool* pool_{};
+  };
+
+  using Handle = std::unique_ptr<T, Deleter>;
+
+  explicit ObjectPool(std::size_t slab_size = 256) : slab_size_{slab_size} {}
+  ~ObjectPool() = default;
+
+  ObjectPool(const ObjectPool&) = delete;
+  ObjectPool& operator=(const ObjectPool&) = delete;
+
+  /**
+   * Construct a T from args in a free slot, growing by one slab if needed.
+   */
+  template <typename... Args>
+  Handle acquire(Args&&... args) {
+    if (!free_) {
+      grow();
+    }
+    Slot* slot = free_;
+    free_ = slot->next;
+    T* object = new (&slot->storage) T(std::forward<Args>(args)...);
+    in_use_++;
+    if (in_use_ > high_water_) high_water_ = in_use_;
+    return Handle{object, Deleter{this}};
+  }
+
+  /**
+   * Take back ownership of an object previously released from its Handle.
+   */
+  Handle adopt(T* object) { return Handle{object, Deleter{this}}; }
+
+  /**
+   * Make sure at least count objects can be acquired without allocating.
+   */
+  void reserve(std::size_t count) {
+    while (capacity_ - in_use_ < count) {
+      grow();
+    }
+  }
+
+  Stats stats() const {
+    return Stats{capacity_, in_use_, high_water_, slabs_.size()};
+  }
+
+ private:
+  union Slot {
+    Slot* next;
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+  };
+
+  void grow() {
+    std::unique_ptr<Slot[]> slab{new Slot[slab_size_]};
+    for (std::size_t i = 0; i < slab_size_; i++) {
+      slab[i].next = free_;
+      free_ = &slab[i];
+    }
+    slabs_.push_back(std::move(slab));
+    capacity_ += slab_size_;
+  }
+
+  void release(T* object) {
+    object->~T();
+    Slot* slot = reinterpret_cast<Slot*>(object);
+    slot->next = free_;
+    free_ = slot;
+    in_use_--;
+  }
+
+  std::size_t slab_size_;
+  std::vector<std::unique_ptr<Slot[]>> slabs_{};
+  Slot* free_{};
+  std::size_t capacity_{};
+  std::size_t in_use_{};
+  std::size_t high_water_{};
+};
+}  // namespace multicast
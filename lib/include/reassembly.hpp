@@ -0,0 +1,69 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "buffer.hpp"
+#include "messages.hpp"
+
+namespace multicast {
+
+/**
+ * Puts messages sent as FragmentMessages back together.
+ *
+ * Each message is reassembled in a buffer from pool, which must be large
+ * enough for a whole message: every fragment is copied straight to its
+ * offset there, and once the last one is in the buffer holds the message as
+ * if it had arrived in one datagram, so its payload is delivered from where
+ * it was put together. A fragment repeated by a retransmission is ignored.
+ *
+ * Memory is bounded per sender: at most slots messages of a sender are
+ * reassembled at once. A fragment of yet another message takes the slot of
+ * the one that has gone longest without a fragment, which is dropped for
+ * its sender to retransmit. Not thread safe, every fragment of a sender
+ * must come through the same Reassembler.
+ */
+class Reassembler {
+ public:
+  Reassembler(BufferPool& pool, std::size_t senders, std::size_t slots);
+
+  /**
+   * Copy the bytes of fragment into place. Returns true once they complete
+   * their message, with buffer holding the fragment.size bytes of it from
+   * the start. Throws std::runtime_error for a fragment that does not fit
+   * its message or a buffer of the pool, or that disagrees with the other
+   * fragments of its message.
+   */
+  bool add(const messages::FragmentMessage& fragment, BufferRef& buffer);
+
+  /**
+   * Messages partly reassembled.
+   */
+  std::size_t in_progress() const;
+
+  /**
+   * Messages dropped so far to make room for others.
+   */
+  std::size_t evicted() const { return evicted_; }
+
+ private:
+  struct Slot {
+    uint32_t msg_id{};
+    uint32_t size{};
+    uint32_t count{};
+    uint32_t received{};
+    // When a fragment last came in, for eviction
+    uint64_t used{};
+    // Empty while the slot is free
+    BufferRef buffer{};
+    // Bit per fragment received
+    std::vector<uint64_t> have{};
+  };
+
+  BufferPool& pool_;
+  // Indexed by sender
+  std::vector<std::vector<Slot>> slots_;
+  uint64_t clock_{};
+  std::size_t evicted_{};
+};
+}  // namespace multicast
@@ -0,0 +1,164 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace multicast {
+
+/**
+ * Bounded lock-free queue between exactly one producer thread and one
+ * consumer thread.
+ *
+ * Each side owns one index and keeps a cached copy of the other's, so the
+ * shared cache lines are only read when the cached view says the ring is
+ * full or empty. Elements are moved in and out of preallocated slots and
+ * never allocate. T must be default constructible.
+ */
+template <typename T>
+class SpscRing {
+ public:
+  /**
+   * capacity is rounded up to a power of two.
+   */
+  explicit SpscRing(std::size_t capacity)
+      : slots_(round_up(capacity)), mask_{slots_.size() - 1} {}
+
+  SpscRing(const SpscRing&) = delete;
+  SpscRing& operator=(const SpscRing&) = delete;
+
+  /**
+   * Producer only. Returns false, leaving value untouched, if the ring is
+   * full.
+   */
+  bool try_push(T&& value) {
+    std::size_t tail{tail_.load(std::memory_order_relaxed)};
+    if (tail - cached_head_ == slots_.size()) {
+      cached_head_ = head_.load(std::memory_order_acquire);
+      if (tail - cached_head_ == slots_.size()) return false;
+    }
+    slots_[tail & mask_] = std::move(value);
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * Consumer only. Returns false if the ring is empty.
+   */
+  bool try_pop(T& value) {
+    std::size_t head{head_.load(std::memory_order_relaxed)};
+    if (head == cached_tail_) {
+      cached_tail_ = tail_.load(std::memory_order_acquire);
+      if (head == cached_tail_) return false;
+    }
+    value = std::move(slots_[head & mask_]);
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * Number of queued elements. Exact only on a quiet ring.
+   */
+  std::size_t size() const {
+    return tail_.load(std::memory_order_acquire) -
+           head_.load(std::memory_order_acquire);
+  }
+
+  std::size_t capacity() const { return slots_.size(); }
+
+ private:
+  static std::size_t round_up(std::size_t n) {
+    std::size_t p{1};
+    while (p < n) p <<= 1;
+    return p;
+  }
+
+  static constexpr std::size_t kCacheLine{64};
+
+  std::vector<T> slots_;
+  std::size_t mask_;
+  // Consumer side
+  char pad0_[kCacheLine];
+  std::atomic<std::size_t> head_{};
+  std::size_t cached_tail_{};
+  // Producer side
+  char pad1_[kCacheLine];
+  std::atomic<std::size_t> tail_{};
+  std::size_t cached_head_{};
+  char pad2_[kCacheLine];
+};
+
+/**
+ * Unbounded lock-free queue between exactly one producer thread and one
+ * consumer thread.
+ *
+ * A chain of SpscRing segments: the producer links a new segment once the
+ * last one is full, and the consumer frees each segment it has emptied
+ * after the producer moved on from it. Only linking a segment allocates.
+ */
+template <typename T>
+class SpscQueue {
+ public:
+  /**
+   * segment_size is rounded up to a power of two.
+   */
+  explicit SpscQueue(std::size_t segment_size)
+      : segment_size_{segment_size},
+        head_{new Segment{segment_size}},
+        tail_{head_} {}
+
+  ~SpscQueue() {
+    while (head_) {
+      Segment* next{head_->next.load(std::memory_order_relaxed)};
+      delete head_;
+      head_ = next;
+    }
+  }
+
+  SpscQueue(const SpscQueue&) = delete;
+  SpscQueue& operator=(const SpscQueue&) = delete;
+
+  /**
+   * Producer only.
+   */
+  void push(T&& value) {
+    if (tail_->ring.try_push(std::move(value))) return;
+    Segment* segment{new Segment{segment_size_}};
+    segment->ring.try_push(std::move(value));
+    tail_->next.store(segment, std::memory_order_release);
+    tail_ = segment;
+  }
+
+  /**
+   * Consumer only. Returns false if the queue is empty.
+   */
+  bool try_pop(T& value) {
+    for (;;) {
+      if (head_->ring.try_pop(value)) return true;
+      Segment* next{head_->next.load(std::memory_order_acquire)};
+      if (!next) return false;
+      // Everything pushed to head_ was pushed before next was linked
+      if (head_->ring.try_pop(value)) return true;
+      delete head_;
+      head_ = next;
+    }
+  }
+
+ private:
+  struct Segment {
+    explicit Segment(std::size_t capacity) : ring{capacity} {}
+
+    SpscRing<T> ring;
+    std::atomic<Segment*> next{};
+  };
+
+  static constexpr std::size_t kCacheLine{64};
+
+  std::size_t segment_size_;
+  // Consumer side
+  Segment* head_;
+  // Producer side
+  char pad0_[kCacheLine];
+  Segment* tail_;
+};
+}  // namespace multicast
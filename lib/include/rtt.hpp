@@ -0,0 +1,39 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+
+namespace multicast {
+
+/**
+ * Round trip time to one peer and the retransmission timeout derived from
+ * it, after Jacobson and Karels as in RFC 6298: the smoothed rtt and its
+ * mean deviation are moving averages with gains 1/8 and 1/4 and the timeout
+ * is srtt + 4 * rttvar, clamped to [min_rto, max_rto]. Samples must come from
+ * exchanges that were not retransmitted, or an ack could be matched to the
+ * wrong send.
+ */
+class RttEstimator {
+ public:
+  using Duration = std::chrono::nanoseconds;
+
+  /**
+   * initial_rto is the timeout until the first sample.
+   */
+  RttEstimator(Duration initial_rto, Duration min_rto, Duration max_rto);
+
+  void sample(Duration rtt);
+
+  Duration rto() const { return rto_; }
+  Duration srtt() const { return srtt_; }
+  Duration rttvar() const { return rttvar_; }
+  std::size_t samples() const { return samples_; }
+
+ private:
+  Duration min_rto_;
+  Duration max_rto_;
+  Duration srtt_{};
+  Duration rttvar_{};
+  Duration rto_;
+  std::size_t samples_{};
+};
+}  // namespace multicast
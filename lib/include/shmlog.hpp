@@ -0,0 +1,156 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "delivery.hpp"
+
+namespace multicast {
+
+/**
+ * Layout of a delivery log, a ring of records in a memory mapped file
+ * (normally under /dev/shm) written by one ShmLogSink and read by any number
+ * of ShmLogReaders in other processes.
+ *
+ * Positions are byte offsets that only ever grow; a record lives at
+ * position % capacity. Records never wrap, the tail end of the ring is
+ * skipped with a padding record instead. The writer announces the region it
+ * is about to overwrite in reserved before touching it and publishes
+ * complete records by advancing published, so a reader can tell whether
+ * what it read was overwritten underneath it.
+ */
+namespace shmlog {
+
+constexpr uint32_t kMagic{0x49534c47};  // "ISLG"
+constexpr uint32_t kVersion{1};
+
+struct Header {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t capacity;
+  // Records before this position may already be overwritten, plus capacity
+  alignas(64) std::atomic<uint64_t> reserved;
+  // Start of the oldest record still in the ring
+  std::atomic<uint64_t> oldest;
+  // End of the last complete record and the number of deliveries up to it
+  alignas(64) std::atomic<uint64_t> published;
+  std::atomic<uint64_t> records;
+};
+
+enum RecordType : uint32_t { kDelivery = 1, kPadding = 2 };
+
+struct Record {
+  uint32_t size;  // whole record including payload, a multiple of 8
+  uint32_t type;
+  uint64_t index;  // number of deliveries before this one
+  uint32_t sender;
+  uint32_t msg_id;
+  uint32_t data;
+  uint32_t final_seq;
+  uint32_t final_seq_proposer;
+  uint32_t payload_size;
+  // payload_size bytes of payload follow
+};
+
+constexpr std::size_t kDataOffset{256};
+}  // namespace shmlog
+
+/**
+ * Appends delivered messages to a delivery log, see shmlog. The file is
+ * created, or truncated, with room for capacity bytes of records (rounded up
+ * to a power of two) and left behind on destruction for readers. Every batch
+ * is published at once. Throws std::runtime_error if the file cannot be set
+ * up.
+ */
+class ShmLogSink : public DeliverySink {
+ public:
+  ShmLogSink(const std::string& path, std::size_t capacity);
+  ~ShmLogSink() override;
+
+  ShmLogSink(const ShmLogSink&) = delete;
+  ShmLogSink& operator=(const ShmLogSink&) = delete;
+
+  void deliver(Delivery* deliveries, std::size_t count) override;
+
+  std::size_t capacity() const { return capacity_; }
+
+ private:
+  /**
+   * Write one record of size bytes at the current position, skipping to the
+   * start of the ring first if it would not fit before the end.
+   */
+  shmlog::Record* reserve(std::size_t size);
+
+  std::string path_;
+  std::size_t capacity_;
+  std::size_t mapped_size_;
+  void* mapping_{};
+  shmlog::Header* header_{};
+  char* data_{};
+  // Writer side copies of the header cursors
+  uint64_t position_{};
+  uint64_t oldest_{};
+  uint64_t records_{};
+};
+
+/**
+ * Follows a delivery log written by a ShmLogSink, in another process or not.
+ * Entries point straight into the mapping; an entry stays intact until the
+ * writer laps it, which valid() tells. Throws std::runtime_error if the file
+ * cannot be mapped or is not a delivery log.
+ */
+class ShmLogReader {
+ public:
+  struct Entry {
+    const shmlog::Record* record;
+    const char* payload;
+    uint64_t position;
+  };
+
+  enum class Status { kEntry, kEmpty, kLapped };
+
+  /**
+   * Open the log at path, reading from the oldest record still in it or,
+   * with from_latest, only what is published from now on.
+   */
+  explicit ShmLogReader(const std::string& path, bool from_latest = false);
+  ~ShmLogReader();
+
+  ShmLogReader(const ShmLogReader&) = delete;
+  ShmLogReader& operator=(const ShmLogReader&) = delete;
+
+  /**
+   * Read the next published entry. kLapped means the writer overwrote
+   * records before they were read; the reader skips to the oldest record
+   * still in the log and the next call carries on from there.
+   */
+  Status next(Entry& entry);
+
+  /**
+   * True if entry has not been overwritten since it was read.
+   */
+  bool valid(const Entry& entry) const;
+
+  /**
+   * Deliveries published so far.
+   */
+  uint64_t published() const;
+
+  /**
+   * Deliveries lost to the writer lapping this reader.
+   */
+  uint64_t lost() const { return lost_; }
+
+ private:
+  std::size_t mapped_size_{};
+  void* mapping_{};
+  const shmlog::Header* header_{};
+  const char* data_{};
+  uint64_t capacity_{};
+  uint64_t position_{};
+  // Index the next delivery should have, for counting losses
+  uint64_t next_index_{};
+  uint64_t lost_{};
+};
+}  // namespace multicast
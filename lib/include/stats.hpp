@@ -0,0 +1,117 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <boost/asio.hpp>
+
+#include "histogram.hpp"
+
+namespace multicast {
+
+/**
+ * Datagrams resent because a peer did not answer in time.
+ */
+struct RetransmitStats {
+  std::size_t data;  // DataMessages resent to peers missing their ack
+  std::size_t seq;   // SeqMessages resent to peers missing their confirmation
+};
+
+/**
+ * Received messages dropped as duplicates.
+ */
+struct DuplicateStats {
+  std::size_t data;   // DataMessages seen before
+  std::size_t acks;   // AckMessages from a peer that had already acked
+  std::size_t seqs;   // SeqMessages for messages already sequenced
+  std::size_t ahead;  // DataMessages beyond the duplicate window
+  // Data and stream messages the journal had no room for
+  std::size_t journal_full;
+};
+
+/**
+ * Messages by type. A message multicast to the group counts once however
+ * many datagrams it takes, a message unicast counts once per peer.
+ */
+struct MessageCounts {
+  uint64_t data;
+  uint64_t acks;
+  uint64_t seqs;
+  uint64_t seq_acks;
+  uint64_t stream;
+};
+
+/**
+ * Everything a Multicaster counts and times, at one point in time.
+ */
+struct StatsSnapshot {
+  MessageCounts sent;
+  MessageCounts received;
+  uint64_t delivered;
+  // Own messages in flight and messages waiting in the pending store
+  uint64_t in_flight;
+  uint64_t pending;
+  RetransmitStats retransmits;
+  DuplicateStats duplicates;
+  // Own message, multicast() to the last peer's ack. ISIS only.
+  HistogramSnapshot data_to_acks;
+  // Own message, the last ack, or the sequencer's Seq, to every peer
+  // confirming it holds the Seq
+  HistogramSnapshot acks_to_seq;
+  // Any message, its Seq arriving to its delivery, the time it waited
+  // behind messages ordered before it
+  HistogramSnapshot seq_to_delivery;
+
+  /**
+   * Acks received per DataMessage sent, duplicates included.
+   */
+  double acks_per_message() const {
+    return sent.data ? static_cast<double>(received.acks) / sent.data : 0;
+  }
+};
+
+/**
+ * snapshot as a single line of JSON, with latencies in nanoseconds.
+ */
+std::string to_json(const StatsSnapshot& snapshot);
+
+/**
+ * Publishes snapshots taken by source as JSON from a thread of its own.
+ *
+ * A target of the form unix:PATH listens on a Unix domain socket at PATH.
+ * Every client that connects is sent a fresh snapshot and disconnected,
+ * which is all a scraper needs. Any other target is a file that the latest
+ * snapshot replaces every interval, by rename so a reader never sees half
+ * of one.
+ */
+class StatsReporter {
+ public:
+  using Source = std::function<StatsSnapshot()>;
+
+  /**
+   * Throws boost::system::system_error if the socket cannot be bound.
+   */
+  StatsReporter(Source source, const std::string& target,
+                std::chrono::milliseconds interval);
+  ~StatsReporter();
+
+  StatsReporter(const StatsReporter&) = delete;
+  StatsReporter& operator=(const StatsReporter&) = delete;
+
+ private:
+  void start_accept();
+  void start_timer();
+  void write_file();
+
+  Source source_;
+  std::string path_;
+  std::chrono::milliseconds interval_;
+  boost::asio::io_context io_context_{};
+  boost::asio::steady_timer timer_{io_context_};
+  std::unique_ptr<boost::asio::local::stream_protocol::acceptor> acceptor_{};
+  std::thread thread_{};
+};
+}  // namespace multicast
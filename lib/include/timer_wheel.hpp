@@ -0,0 +1,109 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace multicast {
+
+/**
+ * Hashed timing wheel of timers identified by a 32 bit id.
+ *
+ * Time is cut into ticks and a timer due on tick t sits in slot
+ * t % slots, so scheduling is constant time and advancing only visits the
+ * slots of the ticks that went by. Timers more than one revolution out stay
+ * in their slot until the wheel comes round to their tick.
+ *
+ * There is no cancel. Scheduling an id again leaves the earlier timer in
+ * place, so the owner remembers the tick schedule() returned last and ignores
+ * expiries for any other tick, the same way PendingStore drops stale heap
+ * nodes. Slots keep their storage, so a wheel that has reached its working
+ * set does not allocate. Not thread safe.
+ */
+class TimingWheel {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  /**
+   * slots is rounded up to a power of two.
+   */
+  TimingWheel(Clock::duration tick, std::size_t slots,
+              Clock::time_point start = Clock::now());
+
+  /**
+   * Arm a timer for id that expires no earlier than now + delay. Returns the
+   * tick it expires on.
+   */
+  uint64_t schedule(uint32_t id, Clock::duration delay,
+                    Clock::time_point now = Clock::now());
+
+  /**
+   * Expire every timer due by now, calling expired(id, tick) for each.
+   * expired may schedule new timers. Returns the number expired.
+   */
+  template <typename Expired>
+  std::size_t advance(Clock::time_point now, Expired&& expired);
+
+  /**
+   * When the tick after the current one begins.
+   */
+  Clock::time_point next_tick() const {
+    return start_ + static_cast<Clock::rep>(current_ + 1) * tick_;
+  }
+
+  uint64_t current_tick() const { return current_; }
+  std::size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+ private:
+  struct Timer {
+    uint64_t tick;
+    uint32_t id;
+  };
+
+  uint64_t tick_of(Clock::time_point time) const;
+
+  Clock::duration tick_;
+  Clock::time_point start_;
+  std::vector<std::vector<Timer>> slots_;
+  std::size_t mask_;
+  // Expiries of the slot being advanced over
+  std::vector<Timer> due_{};
+  uint64_t current_{};
+  std::size_t size_{};
+};
+
+template <typename Expired>
+std::size_t TimingWheel::advance(Clock::time_point now, Expired&& expired) {
+  uint64_t target{tick_of(now)};
+  std::size_t count{};
+  while (current_ < target) {
+    if (size_ == 0) {
+      // Nothing can expire on the ticks in between
+      current_ = target;
+      break;
+    }
+    current_++;
+    std::vector<Timer>& slot = slots_[current_ & mask_];
+    if (slot.empty()) continue;
+    // Timers a revolution or more away go back, expired ones are handed out
+    // once the slot is consistent again since expired may schedule into it
+    due_.clear();
+    std::size_t kept{};
+    for (std::size_t i = 0; i < slot.size(); i++) {
+      if (slot[i].tick <= current_) {
+        due_.push_back(slot[i]);
+      } else {
+        slot[kept++] = slot[i];
+      }
+    }
+    slot.resize(kept);
+    size_ -= due_.size();
+    for (std::size_t i = 0; i < due_.size(); i++) {
+      expired(due_[i].id, due_[i].tick);
+    }
+    count += due_.size();
+  }
+  return count;
+}
+}  // namespace multicast
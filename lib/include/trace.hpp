@@ -0,0 +1,167 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace multicast {
+
+/**
+ * Layout of a trace file, a header followed by fixed size events in the
+ * order they were flushed. Events of one thread are in time order, events
+ * of different threads are not; sort by time before reading a timeline.
+ *
+ * Times are wall clock so that the files of every host line up, to within
+ * how well their clocks are synchronised.
+ */
+namespace trace {
+
+constexpr uint32_t kMagic{0x49535452};  // "ISTR"
+constexpr uint32_t kVersion{1};
+
+struct FileHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t node;  // process id of the host that wrote the file
+  uint32_t group_size;
+  uint32_t event_size;
+  uint32_t reserved;
+};
+
+enum class Kind : uint8_t { kSent = 1, kReceived = 2, kDelivered = 3 };
+
+// peer of a message sent to the whole group at once
+constexpr uint32_t kGroup{UINT32_MAX};
+
+struct Event {
+  uint64_t time_ns;  // since the epoch
+  uint32_t node;     // host that recorded it
+  uint32_t sender;   // of the DataMessage it concerns
+  uint32_t msg_id;
+  uint32_t seq;   // proposed, final or stream seq, 0 if it has none
+  uint32_t peer;  // destination of a send, origin of a receipt
+  Kind kind;
+  uint8_t type;  // wire type
+  uint16_t reserved;
+};
+static_assert(sizeof(Event) == 32, "Events are written as they are");
+
+/**
+ * Header and events of the trace file at path. Throws std::runtime_error if
+ * it cannot be read or is not a trace file.
+ */
+std::pair<FileHeader, std::vector<Event>> read_file(const std::string& path);
+
+// A phase the trace holds no events for
+constexpr int64_t kMissing{-1};
+
+/**
+ * Where the time of one message went, from its sender multicasting it to
+ * the last host delivering it, in nanoseconds. A message's order is fixed
+ * once its Seq goes out, so everything before that holds up every host,
+ * and after it only the slowest host matters.
+ */
+struct CriticalPath {
+  uint32_t sender;
+  uint32_t msg_id;
+  uint32_t last_node;  // the host that delivered it last
+  int64_t total;
+  // Data sent to the last ack arriving, or to the Data reaching the
+  // sequencer. kMissing for stream messages.
+  int64_t to_order;
+  // Then to the Seq going out. kMissing for stream messages.
+  int64_t to_seq;
+  // Then to the Seq, or for a stream message its Data, reaching last_node
+  int64_t to_last;
+  // Then to last_node delivering it, behind the messages ordered before it
+  int64_t to_deliver;
+};
+
+/**
+ * The critical path of every message that was both sent and delivered in
+ * events, which may come from any number of hosts. Sorts events by time.
+ */
+std::vector<CriticalPath> critical_paths(std::vector<Event>& events);
+}  // namespace trace
+
+/**
+ * Records trace::Events into a ring per thread that a thread of its own
+ * drains into a trace file every flush interval.
+ *
+ * record() takes no lock and never waits: it reads the clock and copies the
+ * event into the calling thread's ring. An event that finds its ring full
+ * is dropped and counted. Throws std::runtime_error if the file cannot be
+ * created.
+ */
+class Tracer {
+ public:
+  Tracer(const std::string& path, uint32_t node, uint32_t group_size,
+         std::size_t ring_size = 16384,
+         std::chrono::milliseconds flush_interval =
+             std::chrono::milliseconds{10});
+  /**
+   * Flushes what is left. Every thread must be done recording by now.
+   */
+  ~Tracer();
+
+  Tracer(const Tracer&) = delete;
+  Tracer& operator=(const Tracer&) = delete;
+
+  void record(trace::Kind kind, uint32_t type, uint32_t sender,
+              uint32_t msg_id, uint32_t seq, uint32_t peer);
+
+  /**
+   * Write out everything recorded so far.
+   */
+  void flush();
+
+  uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+ private:
+  /**
+   * Single producer, single consumer. head is only advanced by the flush,
+   * tail only by the owning thread.
+   */
+  struct Ring {
+    explicit Ring(std::size_t size)
+        : events{new trace::Event[size]}, mask{size - 1} {}
+
+    std::unique_ptr<trace::Event[]> events;
+    std::size_t mask;
+    std::atomic<uint64_t> head{};
+    // Keeps head and tail off each other's cache line
+    char padding[64 - sizeof(std::atomic<uint64_t>)];
+    std::atomic<uint64_t> tail{};
+  };
+
+  /**
+   * The calling thread's ring, created on its first event.
+   */
+  Ring& ring();
+  Ring& add_ring();
+
+  // Tells apart tracers that reuse an address, for the per-thread cache
+  const uint64_t id_;
+  const uint32_t node_;
+  const std::size_t ring_size_;
+  const std::chrono::milliseconds flush_interval_;
+  std::atomic<uint64_t> dropped_{};
+  std::mutex rings_mutex_{};
+  std::vector<std::pair<std::thread::id, std::unique_ptr<Ring>>> rings_{};
+  // Held while writing, flush() may race the flushing thread
+  std::mutex file_mutex_{};
+  std::ofstream file_;
+  std::mutex stop_mutex_{};
+  std::condition_variable stop_cv_{};
+  bool stopping_{};
+  std::thread flusher_{};
+};
+}  // namespace multicast
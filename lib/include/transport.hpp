@@ -0,0 +1,100 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <boost/asio.hpp>
+
+#include "buffer.hpp"
+
+namespace multicast {
+
+using Strand = boost::asio::strand<boost::asio::io_context::executor_type>;
+
+// Largest datagram the receive path accepts.
+constexpr std::size_t kMaxDatagramSize{65536};
+
+// Datagrams are received back to back into buffers of this size, so a
+// buffer is only pinned by the payloads that were received into it.
+constexpr std::size_t kReceiveBufferSize{4 * kMaxDatagramSize};
+
+/**
+ * A datagram for one destination, see Transport::send().
+ */
+struct Outgoing {
+  Segments message;
+  std::size_t destination;
+};
+
+/**
+ * Moves datagrams between the processes of a group for a Multicaster.
+ *
+ * Destinations are process ids. If has_group() the process count itself
+ * names the whole group, this process included, and a datagram sent to it
+ * is to reach every process at the cost of one send. Datagrams may be lost,
+ * duplicated or reordered; the Multicaster copes.
+ *
+ * Sends come from the Multicaster with its send lock held, so they never
+ * overlap, but from any thread. Received datagrams are handed back on the
+ * strands passed to start().
+ */
+class Transport {
+ public:
+  /**
+   * Handles one received datagram of len bytes at data, which lives in
+   * buffer. Holding on to buffer keeps data alive.
+   */
+  using ReceiveHandler = std::function<void(const BufferRef& buffer,
+                                            const char* data,
+                                            std::size_t len)>;
+
+  virtual ~Transport() = default;
+
+  /**
+   * Number of independent receive paths. The Multicaster creates a strand
+   * for each.
+   */
+  virtual std::size_t receive_paths() const = 0;
+
+  /**
+   * Whether destination process count reaches every process at once.
+   */
+  virtual bool has_group() const { return false; }
+
+  /**
+   * Start handing received datagrams to handler, those of receive path i on
+   * strands[i]. Datagrams of one peer always take the same path.
+   */
+  virtual void start(const std::vector<Strand>& strands,
+                     ReceiveHandler handler) = 0;
+
+  /**
+   * Send message to destination without blocking. The segments only need
+   * to live for the duration of the call.
+   */
+  virtual void send(const Segments& message, std::size_t destination) = 0;
+
+  /**
+   * Send count datagrams, with as few system calls as the transport can
+   * manage.
+   */
+  virtual void send(const Outgoing* datagrams, std::size_t count) {
+    for (std::size_t i = 0; i < count; i++) {
+      send(datagrams[i].message, datagrams[i].destination);
+    }
+  }
+
+  /**
+   * Stop receiving. Handlers already queued on the strands find the
+   * transport closed and drop their datagram. Called by the Multicaster
+   * before it drains its io_context on destruction.
+   */
+  virtual void close() = 0;
+};
+
+/**
+ * Creates the transport of a Multicaster on the Multicaster's io_context.
+ */
+using TransportFactory =
+    std::function<std::unique_ptr<Transport>(boost::asio::io_context&)>;
+}  // namespace multicast
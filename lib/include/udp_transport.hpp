@@ -0,0 +1,153 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <boost/asio.hpp>
+
+#include "buffer.hpp"
+#include "config.hpp"
+#include "mmsg.hpp"
+#include "peers.hpp"
+#include "transport.hpp"
+
+namespace multicast {
+
+/**
+ * Transport over UDP. Every process listens on the same port of its own
+ * host, hosts are named in a hostsfile and resolved by a PeerDirectory.
+ *
+ * With Config::threads above one the port is bound by that many sockets
+ * through SO_REUSEPORT, one per receive path. The kernel hashes on the
+ * source address, so every datagram from a given peer takes the same path.
+ * With Config::multicast_group every process also joins an IP multicast
+ * group, which has a receive path of its own and is the group destination.
+ */
+class UdpTransport : public Transport {
+ public:
+  /**
+   * Bind port and join the multicast group, if any. Throws
+   * boost::system::system_error if a socket cannot be set up and
+   * std::runtime_error if the group is not a multicast address or has no
+   * port.
+   */
+  UdpTransport(boost::asio::io_context& io_context,
+               const std::vector<std::string>& hosts, uint16_t port,
+               uint32_t process_id, const Config& config);
+  ~UdpTransport() override;
+
+  std::size_t receive_paths() const override { return paths_.size(); }
+  bool has_group() const override { return static_cast<bool>(group_path_); }
+
+  /**
+   * Also starts resolving the hosts. Datagrams for a host that is not
+   * resolved yet are copied and sent once it is.
+   */
+  void start(const std::vector<Strand>& strands,
+             ReceiveHandler handler) override;
+  void send(const Segments& message, std::size_t destination) override;
+
+  /**
+   * Gathers the datagrams into one sendmmsg with Config::use_mmsg.
+   */
+  void send(const Outgoing* datagrams, std::size_t count) override;
+  void close() override;
+
+ private:
+  /**
+   * One socket's receive side.
+   */
+  struct ReceivePath {
+    ReceivePath(boost::asio::io_context& io_context,
+                boost::asio::ip::udp::socket* socket)
+        : socket{socket}, strand{io_context.get_executor()} {}
+
+    // socket_ for the first path, owned_socket for the rest
+    boost::asio::ip::udp::socket* socket;
+    std::unique_ptr<boost::asio::ip::udp::socket> owned_socket{};
+    Strand strand;
+    boost::asio::ip::udp::endpoint remote_endpoint{};
+    // Receive buffers must outlive the pending messages that point into them
+    BufferPool receive_pool{kReceiveBufferSize};
+    BufferRef receive_buffer{};
+    std::size_t receive_offset{};
+    std::unique_ptr<MmsgReceiver> mmsg_receiver{};
+  };
+
+  using Datagram = std::vector<char>;
+
+  /**
+   * Receives a datagram on the path's socket into the free space of its
+   * receive buffer. Passes responsibility to handle_receive().
+   */
+  void start_receive(ReceivePath& path);
+
+  void handle_receive(ReceivePath& path,
+                      const boost::system::error_code& error,
+                      std::size_t bytes_transferred);
+
+  /**
+   * Socket became readable in mmsg mode. Drains it with recvmmsg.
+   */
+  void handle_readable(ReceivePath& path,
+                       const boost::system::error_code& error);
+
+  /**
+   * Endpoint of destination, host or group. Returns false if the host is
+   * not resolved yet.
+   */
+  bool endpoint(std::size_t destination,
+                boost::asio::ip::udp::endpoint& endpoint);
+
+  /**
+   * Name of destination, for logging.
+   */
+  const std::string& name(std::size_t destination) const {
+    return destination < hosts_.size() ? hosts_[destination]
+                                       : config_.multicast_group;
+  }
+
+  /*
+   * Everything below sends and requires mutex_ to be held, except for
+   * handle_resolved() which takes it.
+   */
+
+  /**
+   * Send message to destination, or hold a copy until it is resolved.
+   */
+  void send_single(const Segments& message, std::size_t destination);
+
+  /**
+   * Hand message to the kernel for endpoint without blocking, gathering its
+   * segments. If the socket is full a copy is queued with asio.
+   */
+  void send_to(const Segments& message,
+               const boost::asio::ip::udp::endpoint& receiver_endpoint);
+
+  /**
+   * Flush datagrams that were waiting on hostnum to be resolved.
+   */
+  void handle_resolved(std::size_t hostnum);
+
+  Config config_;
+  boost::asio::io_context& io_context_;
+  boost::asio::ip::udp::socket socket_;
+  std::vector<std::string> hosts_;
+  std::string port_;
+  uint32_t process_id_;
+  PeerDirectory peers_;
+  // Serializes sends with flushing deferred datagrams
+  std::mutex mutex_{};
+  std::vector<std::vector<std::shared_ptr<Datagram>>> unresolved_sends_;
+  // Copies of the endpoints that batch_ entries point at
+  std::vector<boost::asio::ip::udp::endpoint> batch_endpoints_{};
+  std::vector<OutgoingDatagram> batch_{};
+  std::vector<std::unique_ptr<ReceivePath>> paths_{};
+  std::unique_ptr<ReceivePath> group_path_{};
+  boost::asio::ip::udp::endpoint group_endpoint_{};
+  ReceiveHandler handler_{};
+  bool closing_{};
+};
+}  // namespace multicast
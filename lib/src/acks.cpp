@@ -0,0 +1,100 @@
+#include "acks.hpp"
+
+using namespace multicast;
+
+namespace {
+std::size_t next_power_of_2(std::size_t n) {
+  std::size_t p{1};
+  while (p < n) p <<= 1;
+  return p;
+}
+}  // namespace
+
+AckCollector::AckCollector(std::size_t capacity_hint)
+    : slots_(next_power_of_2(capacity_hint)), mask_{slots_.size() - 1} {}
+
+bool AckCollector::track(uint32_t msg_id) {
+  while (slot(msg_id).in_use) {
+    if (slot(msg_id).msg_id == msg_id) return false;
+    grow();
+  }
+  AckState& state = slot(msg_id);
+  state = AckState{};
+  state.msg_id = msg_id;
+  state.in_use = true;
+  size_++;
+  return true;
+}
+
+AckState* AckCollector::add(uint32_t msg_id, uint32_t proposed_seq,
+                            uint32_t proposer) {
+  AckState* state = find(msg_id);
+  if (!state || state->sequenced || proposer >= kMaxGroupSize) {
+    return nullptr;
+  }
+  uint64_t bit{uint64_t{1} << proposer};
+  if (state->acked & bit) {
+    return nullptr;
+  }
+  state->acked |= bit;
+  state->acks_received++;
+  if (proposed_seq > state->final_seq ||
+      (proposed_seq == state->final_seq &&
+       proposer > state->final_seq_proposer)) {
+    state->final_seq = proposed_seq;
+    state->final_seq_proposer = proposer;
+  }
+  return state;
+}
+
+AckState* AckCollector::confirm(uint32_t msg_id, uint32_t acker) {
+  AckState* state = find(msg_id);
+  if (!state || !state->sequenced || acker >= kMaxGroupSize) {
+    return nullptr;
+  }
+  uint64_t bit{uint64_t{1} << acker};
+  if (state->confirmed & bit) {
+    return nullptr;
+  }
+  state->confirmed |= bit;
+  state->confirmations++;
+  return state;
+}
+
+AckState* AckCollector::find(uint32_t msg_id) {
+  AckState& state = slot(msg_id);
+  if (!state.in_use || state.msg_id != msg_id) {
+    return nullptr;
+  }
+  return &state;
+}
+
+void AckCollector::erase(uint32_t msg_id) {
+  AckState& state = slot(msg_id);
+  if (state.in_use && state.msg_id == msg_id) {
+    // Drop the retained message straight away rather than on reuse
+    state = AckState{};
+    size_--;
+  }
+}
+
+void AckCollector::grow() {
+  std::vector<AckState> old{};
+  old.swap(slots_);
+  std::size_t capacity{old.size()};
+  bool collided{true};
+  while (collided) {
+    capacity *= 2;
+    slots_.assign(capacity, AckState{});
+    mask_ = capacity - 1;
+    collided = false;
+    for (auto& state : old) {
+      if (!state.in_use) continue;
+      if (slot(state.msg_id).in_use) {
+        collided = true;
+        break;
+      }
+      slot(state.msg_id) = state;
+    }
+  }
+}
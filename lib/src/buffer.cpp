@@ -0,0 +1,44 @@
+#include "buffer.hpp"
+
+using namespace multicast;
+
+void BufferRef::reset() {
+  if (buffer_ &&
+      buffer_->refs_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    buffer_->pool_->release(buffer_);
+  }
+  buffer_ = nullptr;
+}
+
+BufferPool::BufferPool(std::size_t buffer_size, std::size_t initial)
+    : buffer_size_{buffer_size} {
+  for (std::size_t i = 0; i < initial; i++) {
+    grow();
+  }
+}
+
+BufferRef BufferPool::acquire() {
+  std::lock_guard<std::mutex> lock{mutex_};
+  if (!free_) {
+    grow();
+  }
+  Buffer* buffer = free_;
+  free_ = buffer->next_;
+  buffer->next_ = nullptr;
+  in_use_++;
+  if (in_use_ > high_water_) high_water_ = in_use_;
+  return BufferRef{buffer};
+}
+
+void BufferPool::release(Buffer* buffer) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  buffer->next_ = free_;
+  free_ = buffer;
+  in_use_--;
+}
+
+void BufferPool::grow() {
+  buffers_.emplace_back(new Buffer{this, buffer_size_});
+  buffers_.back()->next_ = free_;
+  free_ = buffers_.back().get();
+}
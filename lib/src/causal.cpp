@@ -0,0 +1,33 @@
+#include "causal.hpp"
+
+#include <algorithm>
+
+using namespace multicast;
+
+CausalOrder::CausalOrder(std::size_t hosts)
+    : delivered_(hosts, 0), held_(hosts) {}
+
+void CausalOrder::reset(uint32_t sender) {
+  held_count_ -= held_[sender].size();
+  held_[sender].clear();
+  delivered_[sender] = 0;
+}
+
+bool CausalOrder::ready(const messages::StreamMessage& M) const {
+  if (M.stream_seq != delivered_[M.sender] + 1) {
+    return false;
+  }
+  if (M.order != static_cast<uint32_t>(DeliveryOrder::kCausal)) {
+    return true;
+  }
+  std::size_t entries{std::min<std::size_t>(M.clock_size, delivered_.size())};
+  for (std::size_t k = 0; k < entries; k++) {
+    if (k == M.sender) continue;
+    // Relative, so the counts may wrap
+    uint32_t ahead{M.clock_at(k) - delivered_[k]};
+    if (ahead != 0 && ahead < 0x80000000u) {
+      return false;
+    }
+  }
+  return true;
+}
@@ -0,0 +1,61 @@
+#include "dedup.hpp"
+
+using namespace multicast;
+
+namespace {
+std::size_t next_power_of_2(std::size_t n) {
+  std::size_t p{64};
+  while (p < n) p <<= 1;
+  return p;
+}
+}  // namespace
+
+DuplicateWindow::DuplicateWindow(std::size_t size, uint32_t base)
+    : bits_(next_power_of_2(size) / 64),
+      size_{bits_.size() * 64},
+      mask_{size_ - 1},
+      base_{base} {}
+
+DuplicateWindow::Result DuplicateWindow::insert(uint32_t id) {
+  uint32_t offset{id - base_};
+  if (offset >= 0x80000000u) {
+    // Behind the window
+    return Result::kDuplicate;
+  }
+  if (offset >= size_) {
+    return Result::kAhead;
+  }
+  uint64_t& word = bits_[(id & mask_) >> 6];
+  uint64_t bit{uint64_t{1} << (id & 63)};
+  if (word & bit) {
+    return Result::kDuplicate;
+  }
+  word |= bit;
+  // Slide past the ids at the bottom that are now all seen, clearing their
+  // bits for the ids that will wrap onto them
+  while (test(base_)) {
+    uint64_t& bottom = bits_[(base_ & mask_) >> 6];
+    if ((base_ & 63) == 0 && bottom == ~uint64_t{0}) {
+      bottom = 0;
+      base_ += 64;
+      continue;
+    }
+    bottom &= ~(uint64_t{1} << (base_ & 63));
+    base_++;
+  }
+  return Result::kNew;
+}
+
+DuplicateWindow::Result DuplicateWindow::check(uint32_t id) const {
+  uint32_t offset{id - base_};
+  if (offset >= 0x80000000u) return Result::kDuplicate;
+  if (offset >= size_) return Result::kAhead;
+  return test(id) ? Result::kDuplicate : Result::kNew;
+}
+
+bool DuplicateWindow::seen(uint32_t id) const {
+  uint32_t offset{id - base_};
+  if (offset >= 0x80000000u) return true;
+  if (offset >= size_) return false;
+  return test(id);
+}
@@ -0,0 +1,38 @@
+#include "delivery.hpp"
+
+using namespace multicast;
+
+RingSink::RingSink(std::size_t capacity)
+    : ring_{capacity}, overflow_{capacity} {}
+
+void RingSink::deliver(Delivery* deliveries, std::size_t count) {
+  bool overflowing{overflowed_.load(std::memory_order_relaxed) !=
+                   drained_.load(std::memory_order_acquire)};
+  for (std::size_t i = 0; i < count; i++) {
+    if (!overflowing && ring_.try_push(std::move(deliveries[i]))) {
+      continue;
+    }
+    overflowing = true;
+    overflow_.push(std::move(deliveries[i]));
+    overflowed_.fetch_add(1, std::memory_order_release);
+  }
+}
+
+bool RingSink::try_pop(Delivery& delivery) {
+  if (ring_.try_pop(delivery)) {
+    return true;
+  }
+  if (overflowed_.load(std::memory_order_acquire) ==
+      drained_.load(std::memory_order_relaxed)) {
+    return false;
+  }
+  // What went to the ring before the overflow may have arrived since the
+  // ring was found empty, and comes first. Nothing goes to the ring after
+  // until the overflow is drained.
+  if (ring_.try_pop(delivery)) {
+    return true;
+  }
+  overflow_.try_pop(delivery);
+  drained_.fetch_add(1, std::memory_order_release);
+  return true;
+}
@@ -0,0 +1,88 @@
+#include "histogram.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace multicast;
+
+namespace {
+constexpr std::size_t kExact{std::size_t{1}
+                             << LatencyHistogram::kSubBucketBits};
+constexpr std::size_t kHalf{kExact / 2};
+constexpr uint64_t kMaxValue{(uint64_t{1} << LatencyHistogram::kMaxBits) - 1};
+
+/**
+ * Index of the highest set bit of v, which must not be zero.
+ */
+unsigned msb(uint64_t v) { return 63 - __builtin_clzll(v); }
+}  // namespace
+
+std::size_t LatencyHistogram::bucket(uint64_t ns) {
+  ns = std::min(ns, kMaxValue);
+  if (ns < kExact) {
+    return static_cast<std::size_t>(ns);
+  }
+  // Keep the top kSubBucketBits - 1 bits below the leading one
+  unsigned shift{msb(ns) - (kSubBucketBits - 1)};
+  return kExact + (shift - 1) * kHalf + ((ns >> shift) - kHalf);
+}
+
+uint64_t LatencyHistogram::highest(std::size_t index) {
+  if (index < kExact) {
+    return index;
+  }
+  std::size_t k{index - kExact};
+  unsigned shift{static_cast<unsigned>(k / kHalf + 1)};
+  uint64_t sub{k % kHalf + kHalf};
+  return ((sub + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(uint64_t ns) {
+  counts_[bucket(ns)].fetch_add(1, std::memory_order_relaxed);
+  count_.fetch_add(1, std::memory_order_relaxed);
+  sum_.fetch_add(ns, std::memory_order_relaxed);
+  uint64_t min{min_.load(std::memory_order_relaxed)};
+  while (ns < min &&
+         !min_.compare_exchange_weak(min, ns, std::memory_order_relaxed)) {
+  }
+  uint64_t max{max_.load(std::memory_order_relaxed)};
+  while (ns > max &&
+         !max_.compare_exchange_weak(max, ns, std::memory_order_relaxed)) {
+  }
+}
+
+HistogramSnapshot LatencyHistogram::snapshot() const {
+  HistogramSnapshot snapshot{};
+  snapshot.count = count_.load(std::memory_order_relaxed);
+  if (!snapshot.count) {
+    return snapshot;
+  }
+  snapshot.sum = sum_.load(std::memory_order_relaxed);
+  snapshot.min = min_.load(std::memory_order_relaxed);
+  snapshot.max = max_.load(std::memory_order_relaxed);
+  snapshot.counts.resize(kBuckets);
+  for (std::size_t i = 0; i < kBuckets; i++) {
+    snapshot.counts[i] = counts_[i].load(std::memory_order_relaxed);
+  }
+  return snapshot;
+}
+
+uint64_t HistogramSnapshot::percentile(double q) const {
+  uint64_t total{};
+  for (uint64_t c : counts) total += c;
+  if (!total) {
+    return 0;
+  }
+  q = std::min(std::max(q, 0.0), 1.0);
+  auto rank = static_cast<uint64_t>(std::ceil(q * total));
+  rank = std::max<uint64_t>(rank, 1);
+  uint64_t seen{};
+  for (std::size_t i = 0; i < counts.size(); i++) {
+    seen += counts[i];
+    if (seen >= rank) {
+      // The bucket's bound may overshoot what was actually recorded
+      return std::min(LatencyHistogram::highest(i), max);
+    }
+  }
+  return max;
+}
@@ -0,0 +1,90 @@
+#include "history.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+using namespace multicast;
+
+DeliveryHistory::DeliveryHistory(std::size_t capacity)
+    : bytes_(capacity),
+      max_entries_{std::max<std::size_t>(
+          1, capacity / messages::CatchupBuilder::kEntryHeaderSize)} {
+  if (!capacity) {
+    throw std::runtime_error("Delivery history without room");
+  }
+}
+
+void DeliveryHistory::append(const messages::DataMessage& msg) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  std::size_t len{msg.payload_size};
+  if (len > bytes_.size()) {
+    // Too large to keep, nothing before it can be handed out either
+    while (!entries_.empty()) {
+      evict_front();
+    }
+    evicted_ = true;
+    evicted_seq_ = msg.final_seq;
+    evicted_proposer_ = msg.final_seq_proposer;
+    return;
+  }
+  uint64_t position{end_};
+  std::size_t offset{static_cast<std::size_t>(position % bytes_.size())};
+  if (offset + len > bytes_.size()) {
+    // Skip the end of the ring rather than wrap
+    position += bytes_.size() - offset;
+    offset = 0;
+  }
+  while (!entries_.empty() &&
+         (entries_.front().position + bytes_.size() < position + len ||
+          entries_.size() >= max_entries_)) {
+    evict_front();
+  }
+  if (len) {
+    std::memcpy(&bytes_[offset], msg.payload, len);
+  }
+  entries_.push_back(Entry{msg.sender, msg.msg_id, msg.data, msg.epoch,
+                           msg.final_seq, msg.final_seq_proposer,
+                           static_cast<uint32_t>(len), position});
+  end_ = position + len;
+}
+
+void DeliveryHistory::evict_front() {
+  evicted_ = true;
+  evicted_seq_ = entries_.front().seq;
+  evicted_proposer_ = entries_.front().proposer;
+  entries_.pop_front();
+}
+
+messages::CatchupBuilder::Status DeliveryHistory::fill(
+    uint32_t seq, uint32_t proposer, messages::CatchupBuilder& batch) const {
+  std::lock_guard<std::mutex> lock{mutex_};
+  if (evicted_ && before(seq, proposer, evicted_seq_, evicted_proposer_)) {
+    return messages::CatchupBuilder::kGone;
+  }
+  auto it = std::upper_bound(
+      entries_.begin(), entries_.end(), std::make_pair(seq, proposer),
+      [](const std::pair<uint32_t, uint32_t>& key, const Entry& entry) {
+        return before(key.first, key.second, entry.seq, entry.proposer);
+      });
+  uint32_t count{batch.count()};
+  for (; it != entries_.end(); ++it) {
+    messages::DataMessage msg{it->sender, it->msg_id, it->data};
+    msg.epoch = it->epoch;
+    msg.final_seq = it->seq;
+    msg.final_seq_proposer = it->proposer;
+    msg.payload = it->size ? &bytes_[it->position % bytes_.size()] : nullptr;
+    msg.payload_size = it->size;
+    if (!batch.append(msg)) {
+      return batch.count() == count ? messages::CatchupBuilder::kGone
+                                    : messages::CatchupBuilder::kMore;
+    }
+  }
+  return messages::CatchupBuilder::kDone;
+}
+
+std::size_t DeliveryHistory::size() const {
+  std::lock_guard<std::mutex> lock{mutex_};
+  return entries_.size();
+}
@@ -0,0 +1,767 @@
+#include "journal.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <spdlog/spdlog.h>
+
+using namespace multicast;
+
+namespace {
+std::size_t next_power_of_2(std::size_t n) {
+  std::size_t p{1};
+  while (p < n) p <<= 1;
+  return p;
+}
+
+std::runtime_error system_failure(const std::string& what,
+                                  const std::string& path) {
+  return std::runtime_error{what + " " + path + ": " + std::strerror(errno)};
+}
+
+constexpr std::size_t kMinCapacity{1 << 20};
+
+std::size_t align8(std::size_t size) { return (size + 7) & ~std::size_t{7}; }
+
+/**
+ * Bytes a message of size bytes takes in a checkpoint, as each kind of
+ * entry.
+ */
+std::size_t pending_entry(std::size_t size) {
+  return sizeof(journal::PendingState) + align8(size);
+}
+
+std::size_t own_entry(std::size_t size) {
+  return sizeof(journal::OwnState) + align8(size);
+}
+
+std::size_t held_entry(std::size_t size) {
+  return sizeof(journal::HeldBody) + align8(size);
+}
+
+/**
+ * FNV-1a, enough to tell a record the process died writing.
+ */
+uint32_t checksum(const char* data, std::size_t len) {
+  uint32_t hash{2166136261u};
+  for (std::size_t i = 0; i < len; i++) {
+    hash ^= static_cast<unsigned char>(data[i]);
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+uint32_t body_checksum(const journal::Record* record) {
+  return checksum(reinterpret_cast<const char*>(record + 1),
+                  record->size - sizeof(journal::Record));
+}
+
+/**
+ * Is a later than b, allowing for wrap around.
+ */
+bool after(uint32_t a, uint32_t b) {
+  return static_cast<int32_t>(a - b) > 0;
+}
+
+template <typename T>
+const T* body(const journal::Record* record) {
+  return reinterpret_cast<const T*>(record + 1);
+}
+}  // namespace
+
+static_assert(sizeof(journal::Header) <= journal::kDataOffset,
+              "Header must fit before the data");
+static_assert(sizeof(journal::Record) % 8 == 0 &&
+                  sizeof(journal::SentBody) % 8 == 0 &&
+                  sizeof(journal::DataBody) % 8 == 0 &&
+                  sizeof(journal::CheckpointBody) % 8 == 0 &&
+                  sizeof(journal::SenderState) % 8 == 0 &&
+                  sizeof(journal::PendingState) % 8 == 0 &&
+                  sizeof(journal::OwnState) % 8 == 0 &&
+                  sizeof(journal::HeldBody) % 8 == 0 &&
+                  sizeof(journal::EpochBody) % 8 == 0,
+              "Records must keep the ring 8 byte aligned");
+
+Journal::Journal(const std::string& path, std::size_t capacity,
+                 uint32_t process_id, uint32_t epoch,
+                 std::size_t group_size,
+                 std::size_t window, std::size_t message_size,
+                 std::size_t checkpoint_records,
+                 std::chrono::milliseconds sync_interval)
+    : process_id_{process_id},
+      group_size_{group_size},
+      window_{window},
+      checkpoint_records_{std::max<std::size_t>(checkpoint_records, 1)},
+      message_size_{message_size},
+      sync_interval_{sync_interval} {
+  fixed_size_ = sizeof(journal::Record) + sizeof(journal::CheckpointBody) +
+                group_size_ * (sizeof(journal::SenderState) +
+                               DuplicateWindow{window_}.size() *
+                                   sizeof(uint32_t));
+  map(path, capacity);
+  if (!fits(std::max({pending_entry(message_size_),
+                      own_entry(message_size_),
+                      held_entry(message_size_)}))) {
+    // Refused before a new journal is marked, so it may be opened again
+    // larger
+    ::munmap(mapping_, mapped_size_);
+    throw std::runtime_error{"Journal " + path + " of " +
+                             std::to_string(capacity_) +
+                             " bytes has no room for a message"};
+  }
+  if (header_->magic == journal::kMagic) {
+    recover();
+  } else {
+    reset(epoch);
+  }
+  if (sync_interval_.count()) {
+    syncer_ = std::thread{[this]() {
+      std::unique_lock<std::mutex> lock{stop_mutex_};
+      while (!stop_cv_.wait_for(lock, sync_interval_,
+                                [this]() { return stopping_; })) {
+        sync();
+      }
+    }};
+  }
+}
+
+Journal::~Journal() {
+  if (syncer_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock{stop_mutex_};
+      stopping_ = true;
+    }
+    stop_cv_.notify_one();
+    syncer_.join();
+    sync();
+  }
+  if (mapping_) ::munmap(mapping_, mapped_size_);
+}
+
+void Journal::map(const std::string& path, std::size_t capacity) {
+  int fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+  if (fd < 0) {
+    throw system_failure("Unable to open", path);
+  }
+  struct stat st {};
+  journal::Header header{};
+  bool existing{::fstat(fd, &st) == 0 &&
+                static_cast<std::size_t>(st.st_size) >= journal::kDataOffset &&
+                ::pread(fd, &header, sizeof(header), 0) ==
+                    static_cast<ssize_t>(sizeof(header)) &&
+                header.magic == journal::kMagic &&
+                header.version == journal::kVersion &&
+                header.capacity >= kMinCapacity &&
+                next_power_of_2(header.capacity) == header.capacity &&
+                static_cast<std::size_t>(st.st_size) ==
+                    journal::kDataOffset + header.capacity};
+  if (existing && (header.process_id != process_id_ ||
+                   header.group_size != group_size_)) {
+    ::close(fd);
+    throw std::runtime_error{"Journal " + path + " belongs to process " +
+                             std::to_string(header.process_id) + " of " +
+                             std::to_string(header.group_size)};
+  }
+  if (existing) {
+    capacity_ = header.capacity;
+  } else {
+    capacity_ = next_power_of_2(std::max(capacity, kMinCapacity));
+    // Start from zeros, nothing of an earlier file may pass for a record
+    if (::ftruncate(fd, 0) != 0) {
+      ::close(fd);
+      throw system_failure("Unable to truncate", path);
+    }
+  }
+  mapped_size_ = journal::kDataOffset + capacity_;
+  if (::ftruncate(fd, static_cast<off_t>(mapped_size_)) != 0) {
+    ::close(fd);
+    throw system_failure("Unable to size", path);
+  }
+  mapping_ = ::mmap(nullptr, mapped_size_, PROT_READ | PROT_WRITE, MAP_SHARED,
+                    fd, 0);
+  ::close(fd);
+  if (mapping_ == MAP_FAILED) {
+    mapping_ = nullptr;
+    throw system_failure("Unable to map", path);
+  }
+  header_ = static_cast<journal::Header*>(mapping_);
+  data_ = static_cast<char*>(mapping_) + journal::kDataOffset;
+}
+
+void Journal::reset(uint32_t epoch) {
+  header_->version = journal::kVersion;
+  header_->epoch = epoch;
+  header_->capacity = capacity_;
+  header_->process_id = process_id_;
+  header_->group_size = static_cast<uint32_t>(group_size_);
+  seen_.assign(group_size_, DuplicateWindow{window_});
+  stream_delivered_.assign(group_size_, 0);
+  sender_epoch_.assign(group_size_, 0);
+  recovery_.epoch = epoch;
+  recovery_.seen = seen_;
+  recovery_.stream_delivered = stream_delivered_;
+  recovery_.sender_epoch = sender_epoch_;
+  write_checkpoint();
+  // Only trusted once the first checkpoint is in
+  std::atomic_thread_fence(std::memory_order_release);
+  header_->magic = journal::kMagic;
+}
+
+void Journal::recover() {
+  uint64_t position{header_->checkpoint};
+  auto checkpoint = reinterpret_cast<const journal::Record*>(at(position));
+  if (checkpoint->position != position ||
+      checkpoint->type != journal::kCheckpoint ||
+      checkpoint->size > capacity_ ||
+      body_checksum(checkpoint) != checkpoint->checksum) {
+    throw std::runtime_error{"Journal checkpoint is damaged"};
+  }
+  std::size_t records{};
+  while (true) {
+    std::size_t offset{static_cast<std::size_t>(position & (capacity_ - 1))};
+    if (capacity_ - offset < sizeof(journal::Record)) {
+      position += capacity_ - offset;
+      continue;
+    }
+    auto record = reinterpret_cast<const journal::Record*>(data_ + offset);
+    if (record->position != position ||
+        record->size < sizeof(journal::Record) || record->size % 8 ||
+        offset + record->size > capacity_ ||
+        body_checksum(record) != record->checksum) {
+      break;
+    }
+    apply(record);
+    position += record->size;
+    records++;
+  }
+  end_ = position;
+  synced_ = position;
+  since_checkpoint_ = records - 1;
+
+  recovery_.epoch = header_->epoch;
+  recovery_.next_msg_id = next_msg_id_;
+  recovery_.last_stream_seq = last_stream_seq_;
+  recovery_.highest_seq = highest_seq_;
+  recovery_.delivered_seq = delivered_seq_;
+  recovery_.delivered_proposer = delivered_proposer_;
+  recovery_.delivered = delivered_;
+  recovery_.seen = seen_;
+  recovery_.stream_delivered = stream_delivered_;
+  recovery_.sender_epoch = sender_epoch_;
+  recovery_.records = records - 1;
+  for (const auto& entry : pending_) {
+    const PendingRef& p = entry.second;
+    journal::Recovery::Pending pending{
+        messages::DataMessage{static_cast<uint32_t>(entry.first >> 32),
+                              static_cast<uint32_t>(entry.first), p.data},
+        p.proposal, std::vector<char>(p.payload.size)};
+    pending.msg.final_seq = p.final_seq;
+    pending.msg.final_seq_proposer = p.final_seq_proposer;
+    if (p.payload.size) {
+      std::memcpy(pending.payload.data(), at(p.payload.position),
+                  p.payload.size);
+    }
+    recovery_.pending.push_back(std::move(pending));
+  }
+  for (const auto& entry : own_) {
+    const OwnRef& o = entry.second;
+    journal::Recovery::Own own{entry.first, o.final_seq,
+                               o.final_seq_proposer,
+                               std::vector<char>(o.message.size)};
+    std::memcpy(own.message.data(), at(o.message.position), o.message.size);
+    recovery_.own.push_back(std::move(own));
+  }
+  for (const auto& entry : held_) {
+    const char* bytes = at(entry.second.position);
+    recovery_.held.emplace_back(bytes, bytes + entry.second.size);
+  }
+  spdlog::info("Recovered journal: {} records after the checkpoint, {} "
+               "pending, {} held and {} own messages unconfirmed",
+               recovery_.records, recovery_.pending.size(),
+               recovery_.held.size(), recovery_.own.size());
+}
+
+bool Journal::admit() {
+  std::lock_guard<std::mutex> lock{mutex_};
+  std::size_t entry{own_entry(message_size_)};
+  if (!fits(entry)) return false;
+  admitted_ += entry;
+  return true;
+}
+
+void Journal::sent(uint32_t msg_id, const void* header, std::size_t header_len,
+                   const void* payload, std::size_t len) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  admitted_ -= std::min(admitted_, own_entry(message_size_));
+  journal::Record* record =
+      reserve(journal::kSent, sizeof(journal::SentBody) + header_len + len);
+  auto sent = reinterpret_cast<journal::SentBody*>(record + 1);
+  sent->msg_id = msg_id;
+  sent->size = static_cast<uint32_t>(header_len + len);
+  char* bytes = reinterpret_cast<char*>(sent + 1);
+  std::memcpy(bytes, header, header_len);
+  if (len) std::memcpy(bytes + header_len, payload, len);
+  commit(record);
+}
+
+bool Journal::data(const messages::DataMessage& D) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  if (!fits(pending_entry(D.payload_size))) return false;
+  journal::Record* record =
+      reserve(journal::kData, sizeof(journal::DataBody) + D.payload_size);
+  auto data = reinterpret_cast<journal::DataBody*>(record + 1);
+  *data = journal::DataBody{D.sender, D.msg_id, D.data,
+                            static_cast<uint32_t>(D.payload_size)};
+  if (D.payload_size) std::memcpy(data + 1, D.payload, D.payload_size);
+  commit(record);
+  return true;
+}
+
+void Journal::proposed(uint32_t sender, uint32_t msg_id, uint32_t seq) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  journal::Record* record =
+      reserve(journal::kProposed, sizeof(journal::SeqBody));
+  *reinterpret_cast<journal::SeqBody*>(record + 1) =
+      journal::SeqBody{sender, msg_id, seq, process_id_};
+  commit(record);
+}
+
+void Journal::sequenced(const messages::SeqMessage& S) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  journal::Record* record =
+      reserve(journal::kSequenced, sizeof(journal::SeqBody));
+  *reinterpret_cast<journal::SeqBody*>(record + 1) = journal::SeqBody{
+      S.sender, S.msg_id, S.final_seq, S.final_seq_proposer};
+  commit(record);
+}
+
+void Journal::delivered(uint32_t sender, uint32_t msg_id, uint32_t seq,
+                        uint32_t proposer, DeliveryOrder order) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  journal::Record* record =
+      reserve(journal::kDelivered, sizeof(journal::DeliveredBody));
+  *reinterpret_cast<journal::DeliveredBody*>(record + 1) =
+      journal::DeliveredBody{sender, msg_id, seq, proposer,
+                             static_cast<uint32_t>(order), 0};
+  commit(record);
+}
+
+void Journal::confirmed(uint32_t msg_id) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  journal::Record* record =
+      reserve(journal::kConfirmed, sizeof(journal::ConfirmedBody));
+  *reinterpret_cast<journal::ConfirmedBody*>(record + 1) =
+      journal::ConfirmedBody{msg_id, 0};
+  commit(record);
+}
+
+bool Journal::held(const messages::StreamMessage& M) {
+  std::size_t header_len{
+      messages::codec::WireLayout<messages::StreamMessage>::kSize +
+      std::size_t{M.clock_size} * sizeof(uint32_t)};
+  std::size_t size{header_len + M.payload_size};
+  std::lock_guard<std::mutex> lock{mutex_};
+  if (!fits(held_entry(size))) return false;
+  journal::Record* record =
+      reserve(journal::kHeld, sizeof(journal::HeldBody) + size);
+  auto held = reinterpret_cast<journal::HeldBody*>(record + 1);
+  *held = journal::HeldBody{M.sender, M.msg_id, static_cast<uint32_t>(size),
+                            0};
+  char* bytes = reinterpret_cast<char*>(held + 1);
+  M.encode(bytes, header_len);
+  if (M.payload_size) {
+    std::memcpy(bytes + header_len, M.payload, M.payload_size);
+  }
+  commit(record);
+  return true;
+}
+
+void Journal::epoch(uint32_t sender, uint32_t epoch) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  journal::Record* record =
+      reserve(journal::kEpoch, sizeof(journal::EpochBody));
+  *reinterpret_cast<journal::EpochBody*>(record + 1) =
+      journal::EpochBody{sender, epoch};
+  commit(record);
+}
+
+void Journal::checkpoint() {
+  std::lock_guard<std::mutex> lock{mutex_};
+  write_checkpoint();
+}
+
+void Journal::sync() {
+  uint64_t from{};
+  uint64_t to{};
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    from = synced_;
+    to = end_;
+  }
+  if (from == to) return;
+  const std::size_t page{static_cast<std::size_t>(::sysconf(_SC_PAGESIZE))};
+  auto flush = [this, page](std::size_t begin, std::size_t end) {
+    std::size_t aligned{begin / page * page};
+    if (::msync(data_ + aligned, end - aligned, MS_SYNC) != 0) {
+      spdlog::warn("Unable to sync journal: {}", std::strerror(errno));
+    }
+  };
+  std::size_t begin{static_cast<std::size_t>(from & (capacity_ - 1))};
+  std::size_t end{static_cast<std::size_t>(to & (capacity_ - 1))};
+  if (to - from >= capacity_) {
+    flush(0, capacity_);
+  } else if (begin < end) {
+    flush(begin, end);
+  } else {
+    flush(begin, capacity_);
+    if (end) flush(0, end);
+  }
+  // The header last, a checkpoint it points to is on disk by now
+  ::msync(mapping_, journal::kDataOffset, MS_SYNC);
+  std::lock_guard<std::mutex> lock{mutex_};
+  synced_ = std::max(synced_, to);
+}
+
+journal::Record* Journal::reserve(uint32_t type, std::size_t body_size) {
+  std::size_t size{align8(sizeof(journal::Record) + body_size)};
+  if (type != journal::kCheckpoint &&
+      (since_checkpoint_ >= checkpoint_records_ ||
+       end_ + size - header_->checkpoint > capacity_ / 2)) {
+    write_checkpoint();
+  }
+  std::size_t offset{static_cast<std::size_t>(end_ & (capacity_ - 1))};
+  if (offset + size > capacity_) {
+    std::size_t rest{capacity_ - offset};
+    if (rest >= sizeof(journal::Record)) {
+      auto padding = reinterpret_cast<journal::Record*>(data_ + offset);
+      *padding = journal::Record{static_cast<uint32_t>(rest),
+                                 journal::kPadding, end_, 0, 0};
+      padding->checksum = body_checksum(padding);
+    }
+    end_ += rest;
+  }
+  if (end_ + size - header_->checkpoint > capacity_) {
+    throw JournalError{"Journal too small for its state"};
+  }
+  auto record = reinterpret_cast<journal::Record*>(at(end_));
+  *record = journal::Record{static_cast<uint32_t>(size), type, end_, 0, 0};
+  end_ += size;
+  return record;
+}
+
+void Journal::commit(journal::Record* record) {
+  record->checksum = body_checksum(record);
+  apply(record);
+  since_checkpoint_++;
+}
+
+void Journal::write_checkpoint() {
+  std::vector<std::vector<uint32_t>> seen(group_size_);
+  std::size_t size{sizeof(journal::CheckpointBody)};
+  for (std::size_t p = 0; p < group_size_; p++) {
+    const DuplicateWindow& window = seen_[p];
+    for (uint32_t i = 1; i < window.size(); i++) {
+      if (window.seen(window.base() + i)) seen[p].push_back(window.base() + i);
+    }
+    size += sizeof(journal::SenderState) +
+            align8(seen[p].size() * sizeof(uint32_t));
+  }
+  for (const auto& entry : pending_) {
+    size += sizeof(journal::PendingState) +
+            align8(entry.second.payload.size);
+  }
+  for (const auto& entry : own_) {
+    size += sizeof(journal::OwnState) + align8(entry.second.message.size);
+  }
+  for (const auto& entry : held_) {
+    size += sizeof(journal::HeldBody) + align8(entry.second.size);
+  }
+  if (sizeof(journal::Record) + size > capacity_ / 2) {
+    throw JournalError{"Journal too small to checkpoint its state"};
+  }
+
+  journal::Record* record = reserve(journal::kCheckpoint, size);
+  char* out = reinterpret_cast<char*>(record + 1);
+  auto put = [&out](const void* data, std::size_t len) {
+    std::memcpy(out, data, len);
+    std::memset(out + len, 0, align8(len) - len);
+    out += align8(len);
+  };
+  journal::CheckpointBody body{next_msg_id_,
+                               last_stream_seq_,
+                               highest_seq_,
+                               delivered_seq_,
+                               delivered_,
+                               static_cast<uint32_t>(group_size_),
+                               static_cast<uint32_t>(pending_.size()),
+                               static_cast<uint32_t>(own_.size()),
+                               static_cast<uint32_t>(held_.size()),
+                               delivered_proposer_,
+                               0};
+  put(&body, sizeof(body));
+  for (std::size_t p = 0; p < group_size_; p++) {
+    journal::SenderState sender{seen_[p].base(), stream_delivered_[p],
+                                static_cast<uint32_t>(seen[p].size()),
+                                sender_epoch_[p]};
+    put(&sender, sizeof(sender));
+    put(seen[p].data(), seen[p].size() * sizeof(uint32_t));
+  }
+  for (const auto& entry : pending_) {
+    const PendingRef& p = entry.second;
+    journal::PendingState pending{
+        journal::DataBody{static_cast<uint32_t>(entry.first >> 32),
+                          static_cast<uint32_t>(entry.first), p.data,
+                          p.payload.size},
+        p.proposal, p.final_seq, p.final_seq_proposer, 0};
+    put(&pending, sizeof(pending));
+    put(at(p.payload.position), p.payload.size);
+  }
+  for (const auto& entry : own_) {
+    const OwnRef& o = entry.second;
+    journal::OwnState own{entry.first, o.final_seq, o.final_seq_proposer,
+                          o.message.size};
+    put(&own, sizeof(own));
+    put(at(o.message.position), o.message.size);
+  }
+  for (const auto& entry : held_) {
+    journal::HeldBody held{static_cast<uint32_t>(entry.first >> 32),
+                           static_cast<uint32_t>(entry.first),
+                           entry.second.size, 0};
+    put(&held, sizeof(held));
+    put(at(entry.second.position), entry.second.size);
+  }
+  record->checksum = body_checksum(record);
+  // Everything now refers into the checkpoint, the records before it are
+  // free to be overwritten
+  apply_checkpoint(record);
+  header_->checkpoint = record->position;
+  since_checkpoint_ = 0;
+}
+
+void Journal::apply(const journal::Record* record) {
+  uint64_t position{record->position + sizeof(journal::Record)};
+  switch (record->type) {
+    case journal::kSent: {
+      auto sent = body<journal::SentBody>(record);
+      auto inserted = own_.emplace(sent->msg_id, OwnRef{});
+      if (!inserted.second) {
+        state_size_ -= own_entry(inserted.first->second.message.size);
+      }
+      inserted.first->second = OwnRef{
+          0, 0, Bytes{position + sizeof(journal::SentBody), sent->size}};
+      state_size_ += own_entry(sent->size);
+      if (after(sent->msg_id + 1, next_msg_id_)) {
+        next_msg_id_ = sent->msg_id + 1;
+      }
+      const char* bytes = reinterpret_cast<const char*>(sent + 1);
+      if (messages::codec::peek_type(bytes, sent->size) == 6) {
+        messages::StreamMessage M{bytes, sent->size};
+        if (after(M.stream_seq, last_stream_seq_)) {
+          last_stream_seq_ = M.stream_seq;
+        }
+      }
+      break;
+    }
+    case journal::kData: {
+      auto data = body<journal::DataBody>(record);
+      auto inserted = pending_.emplace(key(data->sender, data->msg_id),
+                                       PendingRef{});
+      if (!inserted.second) {
+        state_size_ -= pending_entry(inserted.first->second.payload.size);
+      }
+      inserted.first->second = PendingRef{
+          data->data, 0, 0, 0,
+          Bytes{position + sizeof(journal::DataBody), data->payload_size}};
+      state_size_ += pending_entry(data->payload_size);
+      if (data->sender < group_size_) {
+        seen_[data->sender].insert(data->msg_id);
+      }
+      break;
+    }
+    case journal::kProposed: {
+      auto seq = body<journal::SeqBody>(record);
+      highest_seq_ = std::max(highest_seq_, seq->seq);
+      auto it = pending_.find(key(seq->sender, seq->msg_id));
+      if (it != pending_.end()) it->second.proposal = seq->seq;
+      break;
+    }
+    case journal::kSequenced: {
+      auto seq = body<journal::SeqBody>(record);
+      highest_seq_ = std::max(highest_seq_, seq->seq);
+      auto it = pending_.find(key(seq->sender, seq->msg_id));
+      if (it != pending_.end()) {
+        it->second.final_seq = seq->seq;
+        it->second.final_seq_proposer = seq->proposer;
+      }
+      if (seq->sender == process_id_) {
+        auto own = own_.find(seq->msg_id);
+        if (own != own_.end()) {
+          own->second.final_seq = seq->seq;
+          own->second.final_seq_proposer = seq->proposer;
+        }
+      }
+      break;
+    }
+    case journal::kDelivered: {
+      auto delivered = body<journal::DeliveredBody>(record);
+      delivered_++;
+      if (delivered->order == static_cast<uint32_t>(DeliveryOrder::kTotal)) {
+        auto pending = pending_.find(key(delivered->sender, delivered->msg_id));
+        if (pending != pending_.end()) {
+          state_size_ -= pending_entry(pending->second.payload.size);
+          pending_.erase(pending);
+        }
+        // Caught up messages were never received as Data, and a window
+        // too far behind them starts over where they are, as it did live
+        if (delivered->sender < group_size_ &&
+            seen_[delivered->sender].insert(delivered->msg_id) ==
+                DuplicateWindow::Result::kAhead) {
+          seen_[delivered->sender] =
+              DuplicateWindow{window_, delivered->msg_id};
+          seen_[delivered->sender].insert(delivered->msg_id);
+        }
+        if (delivered->seq > delivered_seq_ ||
+            (delivered->seq == delivered_seq_ &&
+             delivered->proposer > delivered_proposer_)) {
+          delivered_seq_ = delivered->seq;
+          delivered_proposer_ = delivered->proposer;
+        }
+      } else if (delivered->sender < group_size_) {
+        auto held = held_.find(key(delivered->sender, delivered->msg_id));
+        if (held != held_.end()) {
+          state_size_ -= held_entry(held->second.size);
+          held_.erase(held);
+        }
+        seen_[delivered->sender].insert(delivered->msg_id);
+        if (after(delivered->seq, stream_delivered_[delivered->sender])) {
+          stream_delivered_[delivered->sender] = delivered->seq;
+        }
+      }
+      break;
+    }
+    case journal::kConfirmed: {
+      auto own = own_.find(body<journal::ConfirmedBody>(record)->msg_id);
+      if (own != own_.end()) {
+        state_size_ -= own_entry(own->second.message.size);
+        own_.erase(own);
+      }
+      break;
+    }
+    case journal::kHeld: {
+      auto held = body<journal::HeldBody>(record);
+      auto inserted = held_.emplace(key(held->sender, held->msg_id), Bytes{});
+      if (!inserted.second) {
+        state_size_ -= held_entry(inserted.first->second.size);
+      }
+      inserted.first->second =
+          Bytes{position + sizeof(journal::HeldBody), held->size};
+      state_size_ += held_entry(held->size);
+      break;
+    }
+    case journal::kEpoch: {
+      auto epoch = body<journal::EpochBody>(record);
+      uint32_t sender{epoch->sender};
+      if (sender >= group_size_) break;
+      if (sender_epoch_[sender] && sender_epoch_[sender] != epoch->epoch) {
+        // Restarted without its state, its ids and stream begin anew
+        seen_[sender] = DuplicateWindow{window_};
+        stream_delivered_[sender] = 0;
+        for (auto it = held_.begin(); it != held_.end();) {
+          if (it->first >> 32 == sender) {
+            state_size_ -= held_entry(it->second.size);
+            it = held_.erase(it);
+          } else {
+            ++it;
+          }
+        }
+      }
+      sender_epoch_[sender] = epoch->epoch;
+      break;
+    }
+    case journal::kCheckpoint:
+      apply_checkpoint(record);
+      break;
+    default:
+      break;
+  }
+}
+
+void Journal::apply_checkpoint(const journal::Record* record) {
+  uint64_t position{record->position + sizeof(journal::Record)};
+  const char* in = reinterpret_cast<const char*>(record + 1);
+  auto skip = [&position, &in](std::size_t len) {
+    position += align8(len);
+    in += align8(len);
+  };
+  journal::CheckpointBody body{};
+  std::memcpy(&body, in, sizeof(body));
+  skip(sizeof(body));
+  next_msg_id_ = body.next_msg_id;
+  last_stream_seq_ = body.last_stream_seq;
+  highest_seq_ = body.highest_seq;
+  delivered_seq_ = body.delivered_seq;
+  delivered_proposer_ = body.delivered_proposer;
+  delivered_ = body.delivered;
+
+  seen_.clear();
+  stream_delivered_.clear();
+  sender_epoch_.clear();
+  for (uint32_t p = 0; p < body.senders; p++) {
+    journal::SenderState sender{};
+    std::memcpy(&sender, in, sizeof(sender));
+    skip(sizeof(sender));
+    seen_.emplace_back(window_, sender.window_base);
+    stream_delivered_.push_back(sender.stream_delivered);
+    sender_epoch_.push_back(sender.epoch);
+    for (uint32_t i = 0; i < sender.seen; i++) {
+      uint32_t id{};
+      std::memcpy(&id, in + i * sizeof(id), sizeof(id));
+      seen_.back().insert(id);
+    }
+    skip(sender.seen * sizeof(uint32_t));
+  }
+
+  state_size_ = 0;
+  pending_.clear();
+  for (uint32_t i = 0; i < body.pending; i++) {
+    journal::PendingState pending{};
+    std::memcpy(&pending, in, sizeof(pending));
+    skip(sizeof(pending));
+    pending_[key(pending.data.sender, pending.data.msg_id)] =
+        PendingRef{pending.data.data, pending.proposal, pending.final_seq,
+                   pending.final_seq_proposer,
+                   Bytes{position, pending.data.payload_size}};
+    state_size_ += pending_entry(pending.data.payload_size);
+    skip(pending.data.payload_size);
+  }
+
+  own_.clear();
+  for (uint32_t i = 0; i < body.own; i++) {
+    journal::OwnState own{};
+    std::memcpy(&own, in, sizeof(own));
+    skip(sizeof(own));
+    own_[own.msg_id] = OwnRef{own.final_seq, own.final_seq_proposer,
+                              Bytes{position, own.size}};
+    state_size_ += own_entry(own.size);
+    skip(own.size);
+  }
+
+  held_.clear();
+  for (uint32_t i = 0; i < body.held; i++) {
+    journal::HeldBody held{};
+    std::memcpy(&held, in, sizeof(held));
+    skip(sizeof(held));
+    held_[key(held.sender, held.msg_id)] = Bytes{position, held.size};
+    state_size_ += held_entry(held.size);
+    skip(held.size);
+  }
+}
@@ -0,0 +1,19 @@
+#include "logging.hpp"
+
+#include <memory>
+
+#include <spdlog/async.h>
+#include <spdlog/sinks/stdout_color_sinks.h>
+
+void multicast::init_async_logging(std::size_t queue_size,
+                                   spdlog::level::level_enum level) {
+  spdlog::init_thread_pool(queue_size, 1);
+  auto sink = std::make_shared<spdlog::sinks::stdout_color_sink_mt>();
+  auto logger = std::make_shared<spdlog::async_logger>(
+      "multicast", sink, spdlog::thread_pool(),
+      spdlog::async_overflow_policy::overrun_oldest);
+  logger->set_level(level);
+  // Problems should not sit in the queue
+  logger->flush_on(spdlog::level::warn);
+  spdlog::set_default_logger(logger);
+}
@@ -0,0 +1,174 @@
+#include "loopback.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+using namespace multicast;
+
+LoopbackNetwork::LoopbackNetwork(std::size_t size,
+                                 const LoopbackConfig& config)
+    : config_{config},
+      members_(size, nullptr),
+      rng_{config.seed},
+      jitter_{0, config.jitter.count()} {
+  if (config_.loss < 0.0 || config_.loss > 1.0) {
+    throw std::runtime_error("Loss is not a probability");
+  }
+}
+
+TransportFactory LoopbackNetwork::transport(uint32_t process_id,
+                                            std::size_t paths) {
+  if (process_id >= members_.size()) {
+    throw std::runtime_error("Process id outside the loopback network");
+  }
+  return [this, process_id, paths](boost::asio::io_context& io_context) {
+    return std::unique_ptr<Transport>{new LoopbackTransport{
+        *this, io_context, process_id, std::max<std::size_t>(1, paths)}};
+  };
+}
+
+void LoopbackNetwork::attach(uint32_t process_id,
+                             LoopbackTransport* transport) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  if (members_[process_id]) {
+    throw std::runtime_error("Process already attached to loopback network");
+  }
+  members_[process_id] = transport;
+}
+
+void LoopbackNetwork::detach(uint32_t process_id) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  members_[process_id] = nullptr;
+}
+
+void LoopbackNetwork::send(uint32_t from, const Segments& message,
+                           std::size_t destination) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  largest_ = std::max<std::size_t>(largest_, segments_size(message));
+  if (destination < members_.size()) {
+    send_one(from, message, destination);
+    return;
+  }
+  for (std::size_t to = 0; to < members_.size(); to++) {
+    send_one(from, message, to);
+  }
+}
+
+void LoopbackNetwork::send_one(uint32_t from, const Segments& message,
+                               std::size_t to) {
+  if (!members_[to] || segments_size(message) > kMaxDatagramSize ||
+      (config_.loss > 0.0 && loss_(rng_) < config_.loss) ||
+      (config_.drop && config_.drop(from, to, message))) {
+    dropped_++;
+    return;
+  }
+  std::chrono::microseconds delay{config_.delay};
+  if (config_.link_delay) {
+    delay += config_.link_delay(from, to);
+  }
+  if (config_.jitter.count() > 0) {
+    delay += std::chrono::microseconds{jitter_(rng_)};
+  }
+  sent_++;
+  members_[to]->enqueue(from, message, delay);
+}
+
+LoopbackTransport::LoopbackTransport(LoopbackNetwork& network,
+                                     boost::asio::io_context& io_context,
+                                     uint32_t process_id, std::size_t paths)
+    : network_{network},
+      process_id_{process_id},
+      paths_{paths},
+      timer_{io_context},
+      work_{io_context.get_executor()} {}
+
+LoopbackTransport::~LoopbackTransport() { close(); }
+
+void LoopbackTransport::start(const std::vector<Strand>& strands,
+                              ReceiveHandler handler) {
+  strands_ = strands;
+  handler_ = std::move(handler);
+  network_.attach(process_id_, this);
+}
+
+void LoopbackTransport::send(const Segments& message,
+                             std::size_t destination) {
+  network_.send(process_id_, message, destination);
+}
+
+void LoopbackTransport::close() {
+  if (closing_.exchange(true)) return;
+  network_.detach(process_id_);
+  work_.reset();
+  std::lock_guard<std::mutex> lock{mutex_};
+  timer_.cancel();
+  delayed_ = decltype(delayed_){};
+}
+
+void LoopbackTransport::enqueue(uint32_t from, const Segments& message,
+                                std::chrono::microseconds delay) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  // Pack datagrams back to back as the UDP receive path does, starting over
+  // once nothing copied into the buffer is still referenced.
+  if (receive_buffer_.use_count() == 1) {
+    receive_offset_ = 0;
+  }
+  std::size_t len{segments_size(message)};
+  if (!receive_buffer_ ||
+      receive_buffer_->capacity() - receive_offset_ < len) {
+    receive_buffer_ = receive_pool_.acquire();
+    receive_offset_ = 0;
+  }
+  char* data = receive_buffer_->data() + receive_offset_;
+  std::memcpy(data, message[0].data(), message[0].size());
+  if (message[1].size()) {
+    std::memcpy(data + message[0].size(), message[1].data(),
+                message[1].size());
+  }
+  // Keep the next datagram 8 byte aligned
+  receive_offset_ += (len + 7) & ~std::size_t{7};
+
+  if (delay.count() == 0) {
+    dispatch(from, receive_buffer_, data, len);
+    return;
+  }
+  Clock::time_point due{Clock::now() + delay};
+  bool earliest{delayed_.empty() || due < delayed_.top().due};
+  delayed_.push(Delayed{due, next_seq_++, from, receive_buffer_, data, len});
+  if (earliest) {
+    arm_timer();
+  }
+}
+
+void LoopbackTransport::dispatch(uint32_t from, BufferRef buffer,
+                                 const char* data, std::size_t len) {
+  boost::asio::post(strands_[from % strands_.size()],
+                    [this, buffer, data, len]() {
+                      if (closing_) return;
+                      handler_(buffer, data, len);
+                    });
+}
+
+void LoopbackTransport::arm_timer() {
+  timer_.expires_at(delayed_.top().due);
+  timer_.async_wait(
+      [this](const boost::system::error_code& e) { handle_timer(e); });
+}
+
+void LoopbackTransport::handle_timer(const boost::system::error_code& error) {
+  // Superseded by an earlier datagram or closed
+  if (error == boost::asio::error::operation_aborted || closing_) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock{mutex_};
+  Clock::time_point now{Clock::now()};
+  while (!delayed_.empty() && delayed_.top().due <= now) {
+    const Delayed& next = delayed_.top();
+    dispatch(next.from, next.buffer, next.data, next.len);
+    delayed_.pop();
+  }
+  if (!delayed_.empty()) {
+    arm_timer();
+  }
+}
@@ -1,5 +1,7 @@
 #include "messages.hpp"
 
+#include <algorithm>
+#include <cstring>
 #include <boost/asio.hpp>
 
 using namespace messages;
@@ -9,22 +11,29 @@ DataMessage::DataMessage(uint32_t sender, uint32_t msg_id, uint32_t data)
       sender{sender},
       msg_id{msg_id},
       data{data},
+      epoch{},
       deliverable{false},
       final_seq{},
       acks_received{},
-      final_seq_proposer{} {}
+      final_seq_proposer{},
+      payload{},
+      payload_size{} {}
 
 DataMessage::DataMessage(std::vector<uint32_t>& buf)
-    : type{ntohl(buf[0])},
-      sender{ntohl(buf[1])},
-      msg_id{ntohl(buf[2])},
-      data{ntohl(buf[3])},
-      deliverable{false},
+    : DataMessage(buf.data(), buf.size() * sizeof(uint32_t)) {}
+
+DataMessage::DataMessage(const void* buf, std::size_t len)
+    : deliverable{false},
       final_seq{},
       acks_received{},
-      final_seq_proposer{} {
-  if (buf.size() < 4) {
-    throw std::runtime_error("Attempted to deserialize from short buf");
+      final_seq_proposer{},
+      payload{},
+      payload_size{} {
+  codec::WireLayout<DataMessage>::decode(*this, buf, len);
+  std::size_t header_size{codec::WireLayout<DataMessage>::kSize};
+  if (len > header_size) {
+    payload = static_cast<const char*>(buf) + header_size;
+    payload_size = len - header_size;
   }
 }
 
@@ -32,10 +41,8 @@ void DataMessage::serialize(std::vector<uint32_t>& buf) {
   if (!buf.empty()) {
     throw std::runtime_error("Attempted to serialize with non empty buf");
   }
-  buf.push_back(htonl(this->type));
-  buf.push_back(htonl(this->sender));
-  buf.push_back(htonl(this->msg_id));
-  buf.push_back(htonl(this->data));
+  buf.resize(codec::WireLayout<DataMessage>::kFields);
+  encode(buf.data(), buf.size() * sizeof(uint32_t));
 }
 
 AckMessage::AckMessage(uint32_t sender, uint32_t msg_id, uint32_t proposed_seq,
@@ -47,25 +54,18 @@ AckMessage::AckMessage(uint32_t sender, uint32_t msg_id, uint32_t proposed_seq,
       proposer{proposer} {}
 
 AckMessage::AckMessage(std::vector<uint32_t>& buf)
-    : type{ntohl(buf[0])},
-      sender{ntohl(buf[1])},
-      msg_id{ntohl(buf[2])},
-      proposed_seq{ntohl(buf[3])},
-      proposer{ntohl(buf[4])} {
-  if (buf.size() < 5) {
-    throw std::runtime_error("Attempted to deserialize from short buf");
-  }
+    : AckMessage(buf.data(), buf.size() * sizeof(uint32_t)) {}
+
+AckMessage::AckMessage(const void* buf, std::size_t len) {
+  codec::WireLayout<AckMessage>::decode(*this, buf, len);
 }
 
 void AckMessage::serialize(std::vector<uint32_t>& buf) {
   if (!buf.empty()) {
     throw std::runtime_error("Attempted to serialize with non empty buf");
   }
-  buf.push_back(htonl(this->type));
-  buf.push_back(htonl(this->sender));
-  buf.push_back(htonl(this->msg_id));
-  buf.push_back(htonl(this->proposed_seq));
-  buf.push_back(htonl(this->proposer));
+  buf.resize(codec::WireLayout<AckMessage>::kFields);
+  encode(buf.data(), buf.size() * sizeof(uint32_t));
 }
 
 SeqMessage::SeqMessage(uint32_t sender, uint32_t msg_id, uint32_t final_seq,
@@ -77,23 +77,336 @@ SeqMessage::SeqMessage(uint32_t sender, uint32_t msg_id, uint32_t final_seq,
       final_seq_proposer{final_seq_proposer} {}
 
 SeqMessage::SeqMessage(std::vector<uint32_t>& buf)
-    : type{ntohl(buf[0])},
-      sender{ntohl(buf[1])},
-      msg_id{ntohl(buf[2])},
-      final_seq{ntohl(buf[3])},
-      final_seq_proposer{ntohl(buf[4])} {
-  if (buf.size() < 5) {
-    throw std::runtime_error("Attempted to deserialize from short buf");
-  }
+    : SeqMessage(buf.data(), buf.size() * sizeof(uint32_t)) {}
+
+SeqMessage::SeqMessage(const void* buf, std::size_t len) {
+  codec::WireLayout<SeqMessage>::decode(*this, buf, len);
 }
 
 void SeqMessage::serialize(std::vector<uint32_t>& buf) {
   if (!buf.empty()) {
     throw std::runtime_error("Attempted to serialize with non empty buf");
   }
-  buf.push_back(htonl(this->type));
-  buf.push_back(htonl(this->sender));
-  buf.push_back(htonl(this->msg_id));
-  buf.push_back(htonl(this->final_seq));
-  buf.push_back(htonl(this->final_seq_proposer));
-}
\ No newline at end of file
+  buf.resize(codec::WireLayout<SeqMessage>::kFields);
+  encode(buf.data(), buf.size() * sizeof(uint32_t));
+}
+SeqAckMessage::SeqAckMessage(uint32_t sender, uint32_t msg_id, uint32_t acker)
+    : type{5}, sender{sender}, msg_id{msg_id}, acker{acker} {}
+
+SeqAckMessage::SeqAckMessage(std::vector<uint32_t>& buf)
+    : SeqAckMessage(buf.data(), buf.size() * sizeof(uint32_t)) {}
+
+SeqAckMessage::SeqAckMessage(const void* buf, std::size_t len) {
+  codec::WireLayout<SeqAckMessage>::decode(*this, buf, len);
+}
+
+void SeqAckMessage::serialize(std::vector<uint32_t>& buf) {
+  if (!buf.empty()) {
+    throw std::runtime_error("Attempted to serialize with non empty buf");
+  }
+  buf.resize(codec::WireLayout<SeqAckMessage>::kFields);
+  encode(buf.data(), buf.size() * sizeof(uint32_t));
+}
+
+CatchupRequestMessage::CatchupRequestMessage(uint32_t requester,
+                                             uint32_t after_seq,
+                                             uint32_t after_proposer)
+    : type{7},
+      requester{requester},
+      after_seq{after_seq},
+      after_proposer{after_proposer} {}
+
+CatchupRequestMessage::CatchupRequestMessage(std::vector<uint32_t>& buf)
+    : CatchupRequestMessage(buf.data(), buf.size() * sizeof(uint32_t)) {}
+
+CatchupRequestMessage::CatchupRequestMessage(const void* buf,
+                                             std::size_t len) {
+  codec::WireLayout<CatchupRequestMessage>::decode(*this, buf, len);
+}
+
+void CatchupRequestMessage::serialize(std::vector<uint32_t>& buf) {
+  if (!buf.empty()) {
+    throw std::runtime_error("Attempted to serialize with non empty buf");
+  }
+  buf.resize(codec::WireLayout<CatchupRequestMessage>::kFields);
+  encode(buf.data(), buf.size() * sizeof(uint32_t));
+}
+
+FragmentMessage::FragmentMessage(uint32_t sender, uint32_t msg_id,
+                                 uint32_t size, uint32_t offset,
+                                 uint32_t index, uint32_t count)
+    : type{9},
+      sender{sender},
+      msg_id{msg_id},
+      size{size},
+      offset{offset},
+      index{index},
+      count{count},
+      bytes{},
+      bytes_size{} {}
+
+FragmentMessage::FragmentMessage(std::vector<uint32_t>& buf)
+    : FragmentMessage(buf.data(), buf.size() * sizeof(uint32_t)) {}
+
+FragmentMessage::FragmentMessage(const void* buf, std::size_t len)
+    : bytes{}, bytes_size{} {
+  codec::WireLayout<FragmentMessage>::decode(*this, buf, len);
+  std::size_t header_size{codec::WireLayout<FragmentMessage>::kSize};
+  if (len > header_size) {
+    bytes = static_cast<const char*>(buf) + header_size;
+    bytes_size = len - header_size;
+  }
+}
+
+void FragmentMessage::serialize(std::vector<uint32_t>& buf) {
+  if (!buf.empty()) {
+    throw std::runtime_error("Attempted to serialize with non empty buf");
+  }
+  buf.resize(codec::WireLayout<FragmentMessage>::kFields);
+  encode(buf.data(), buf.size() * sizeof(uint32_t));
+}
+
+StreamMessage::StreamMessage(uint32_t sender, uint32_t msg_id, uint32_t data,
+                             uint32_t order, uint32_t stream_seq)
+    : type{6},
+      sender{sender},
+      msg_id{msg_id},
+      data{data},
+      order{order},
+      stream_seq{stream_seq},
+      epoch{},
+      clock_size{},
+      clock{},
+      payload{},
+      payload_size{} {}
+
+StreamMessage::StreamMessage(std::vector<uint32_t>& buf)
+    : StreamMessage(buf.data(), buf.size() * sizeof(uint32_t)) {}
+
+StreamMessage::StreamMessage(const void* buf, std::size_t len)
+    : clock{}, payload{}, payload_size{} {
+  codec::WireLayout<StreamMessage>::decode(*this, buf, len);
+  std::size_t header_size{codec::WireLayout<StreamMessage>::kSize};
+  std::size_t clock_bytes{std::size_t{clock_size} * sizeof(uint32_t)};
+  if (clock_bytes > len - header_size) {
+    throw std::runtime_error("Clock runs past the end of the message");
+  }
+  clock = static_cast<const char*>(buf) + header_size;
+  if (len > header_size + clock_bytes) {
+    payload = clock + clock_bytes;
+    payload_size = len - header_size - clock_bytes;
+  }
+}
+
+std::size_t StreamMessage::encode(void* buf, std::size_t len) const {
+  std::size_t header_size{codec::WireLayout<StreamMessage>::kSize};
+  std::size_t clock_bytes{std::size_t{clock_size} * sizeof(uint32_t)};
+  if (len < header_size + clock_bytes) {
+    throw std::runtime_error("Attempted to serialize into short buf");
+  }
+  codec::WireLayout<StreamMessage>::encode(*this, buf, len);
+  if (clock_bytes) {
+    std::memcpy(static_cast<char*>(buf) + header_size, clock, clock_bytes);
+  }
+  return header_size + clock_bytes;
+}
+
+void StreamMessage::serialize(std::vector<uint32_t>& buf) {
+  if (!buf.empty()) {
+    throw std::runtime_error("Attempted to serialize with non empty buf");
+  }
+  buf.resize(codec::WireLayout<StreamMessage>::kFields + clock_size);
+  encode(buf.data(), buf.size() * sizeof(uint32_t));
+}
+
+constexpr uint32_t FrameBuilder::kType;
+constexpr std::size_t FrameBuilder::kHeaderSize;
+constexpr std::size_t FrameBuilder::kRecordHeaderSize;
+
+FrameBuilder::FrameBuilder(std::size_t max_size)
+    : buf_(max_size, 0), size_{kHeaderSize}, count_{} {
+  if (max_size < kHeaderSize) {
+    throw std::runtime_error("Frame size smaller than frame header");
+  }
+  uint32_t type{htonl(kType)};
+  std::memcpy(&buf_[0], &type, sizeof(type));
+}
+
+bool FrameBuilder::fits(std::size_t len) const {
+  return size_ + kRecordHeaderSize + padded(len) <= buf_.size();
+}
+
+bool FrameBuilder::append(const void* record, std::size_t len) {
+  return append(record, len, nullptr, 0);
+}
+
+bool FrameBuilder::append(const void* header, std::size_t header_len,
+                          const void* payload, std::size_t payload_len) {
+  std::size_t len{header_len + payload_len};
+  if (!fits(len)) {
+    return false;
+  }
+  uint32_t record_len{htonl(static_cast<uint32_t>(len))};
+  std::memcpy(&buf_[size_], &record_len, sizeof(record_len));
+  size_ += kRecordHeaderSize;
+  std::memcpy(&buf_[size_], header, header_len);
+  if (payload_len) {
+    std::memcpy(&buf_[size_ + header_len], payload, payload_len);
+  }
+  std::memset(&buf_[size_ + len], 0, padded(len) - len);
+  size_ += padded(len);
+
+  count_++;
+  uint32_t count{htonl(count_)};
+  std::memcpy(&buf_[4], &count, sizeof(count));
+  return true;
+}
+
+void FrameBuilder::clear() {
+  size_ = kHeaderSize;
+  count_ = 0;
+  std::memset(&buf_[4], 0, 4);
+}
+
+FrameReader::FrameReader(const char* buf, std::size_t len)
+    : buf_{buf}, len_{len}, offset_{FrameBuilder::kHeaderSize}, read_{} {
+  if (len < FrameBuilder::kHeaderSize) {
+    throw std::runtime_error("Attempted to read frame from short buf");
+  }
+  uint32_t word{};
+  std::memcpy(&word, buf, sizeof(word));
+  if (ntohl(word) != FrameBuilder::kType) {
+    throw std::runtime_error("Attempted to read frame from non frame buf");
+  }
+  std::memcpy(&word, buf + 4, sizeof(word));
+  count_ = ntohl(word);
+}
+
+bool FrameReader::next(const char*& record, std::size_t& len) {
+  if (read_ == count_) {
+    return false;
+  }
+  if (len_ - offset_ < FrameBuilder::kRecordHeaderSize) {
+    throw std::runtime_error("Frame truncated before record header");
+  }
+  uint32_t record_len{};
+  std::memcpy(&record_len, buf_ + offset_, sizeof(record_len));
+  record_len = ntohl(record_len);
+  offset_ += FrameBuilder::kRecordHeaderSize;
+  if (len_ - offset_ < record_len) {
+    throw std::runtime_error("Frame truncated inside record");
+  }
+  record = buf_ + offset_;
+  len = record_len;
+  offset_ = std::min(len_, offset_ + ((record_len + 3) & ~3u));
+  read_++;
+  return true;
+}
+
+constexpr uint32_t CatchupBuilder::kType;
+constexpr std::size_t CatchupBuilder::kHeaderSize;
+constexpr std::size_t CatchupBuilder::kEntryHeaderSize;
+
+CatchupBuilder::CatchupBuilder(std::size_t max_size)
+    : buf_(max_size, 0),
+      size_{kHeaderSize},
+      count_{},
+      last_seq_{},
+      last_proposer_{} {
+  if (max_size < kHeaderSize) {
+    throw std::runtime_error("Batch size smaller than batch header");
+  }
+  put(0, kType);
+}
+
+void CatchupBuilder::start(uint32_t responder, uint32_t after_seq,
+                           uint32_t after_proposer) {
+  size_ = kHeaderSize;
+  count_ = 0;
+  last_seq_ = after_seq;
+  last_proposer_ = after_proposer;
+  put(4, responder);
+  put(8, after_seq);
+  put(12, after_proposer);
+  put(16, kMore);
+  put(20, 0);
+}
+
+bool CatchupBuilder::append(const DataMessage& msg) {
+  std::size_t len{entry_size(msg.payload_size)};
+  if (size_ + len > buf_.size()) {
+    return false;
+  }
+  put(size_, msg.sender);
+  put(size_ + 4, msg.msg_id);
+  put(size_ + 8, msg.data);
+  put(size_ + 12, msg.epoch);
+  put(size_ + 16, msg.final_seq);
+  put(size_ + 20, msg.final_seq_proposer);
+  put(size_ + 24, static_cast<uint32_t>(msg.payload_size));
+  char* payload{&buf_[size_ + kEntryHeaderSize]};
+  if (msg.payload_size) {
+    std::memcpy(payload, msg.payload, msg.payload_size);
+  }
+  std::memset(payload + msg.payload_size, 0,
+              len - kEntryHeaderSize - msg.payload_size);
+  size_ += len;
+  last_seq_ = msg.final_seq;
+  last_proposer_ = msg.final_seq_proposer;
+  put(20, ++count_);
+  return true;
+}
+
+void CatchupBuilder::set_status(Status status) { put(16, status); }
+
+void CatchupBuilder::put(std::size_t offset, uint32_t word) {
+  word = htonl(word);
+  std::memcpy(&buf_[offset], &word, sizeof(word));
+}
+
+CatchupReader::CatchupReader(const char* buf, std::size_t len)
+    : buf_{buf}, len_{len}, offset_{CatchupBuilder::kHeaderSize}, read_{} {
+  if (len < CatchupBuilder::kHeaderSize) {
+    throw std::runtime_error("Attempted to read batch from short buf");
+  }
+  uint32_t words[CatchupBuilder::kHeaderSize / sizeof(uint32_t)];
+  std::memcpy(words, buf, sizeof(words));
+  if (ntohl(words[0]) != CatchupBuilder::kType) {
+    throw std::runtime_error("Attempted to read batch from non batch buf");
+  }
+  responder_ = ntohl(words[1]);
+  after_seq_ = ntohl(words[2]);
+  after_proposer_ = ntohl(words[3]);
+  uint32_t status{ntohl(words[4])};
+  if (status > CatchupBuilder::kGone) {
+    throw std::runtime_error("Batch with unknown status");
+  }
+  status_ = static_cast<CatchupBuilder::Status>(status);
+  count_ = ntohl(words[5]);
+}
+
+bool CatchupReader::next(DataMessage& msg) {
+  if (read_ == count_) {
+    return false;
+  }
+  if (len_ - offset_ < CatchupBuilder::kEntryHeaderSize) {
+    throw std::runtime_error("Batch truncated before message header");
+  }
+  uint32_t words[CatchupBuilder::kEntryHeaderSize / sizeof(uint32_t)];
+  std::memcpy(words, buf_ + offset_, sizeof(words));
+  offset_ += CatchupBuilder::kEntryHeaderSize;
+  std::size_t payload_size{ntohl(words[6])};
+  if (len_ - offset_ < payload_size) {
+    throw std::runtime_error("Batch truncated inside message");
+  }
+  msg = DataMessage{ntohl(words[0]), ntohl(words[1]), ntohl(words[2])};
+  msg.epoch = ntohl(words[3]);
+  msg.final_seq = ntohl(words[4]);
+  msg.final_seq_proposer = ntohl(words[5]);
+  msg.deliverable = true;
+  msg.payload = payload_size ? buf_ + offset_ : nullptr;
+  msg.payload_size = payload_size;
+  offset_ = std::min(len_, offset_ + ((payload_size + 3) & ~std::size_t{3}));
+  read_++;
+  return true;
+}
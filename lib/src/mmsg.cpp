@@ -0,0 +1,148 @@
+#include "mmsg.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+using namespace multicast;
+
+#ifdef __linux__
+
+MmsgReceiver::MmsgReceiver(std::size_t batch, std::size_t slot_size)
+    : batch_{batch},
+      slot_size_{slot_size},
+      pool_{slot_size, batch},
+      slots_(batch),
+      packed_pool_{4 * slot_size},
+      buffers_(batch),
+      data_(batch),
+      iovecs_(batch),
+      headers_(batch) {
+  for (std::size_t slot = 0; slot < batch_; slot++) {
+    slots_[slot] = pool_.acquire();
+    iovecs_[slot].iov_base = slots_[slot]->data();
+    iovecs_[slot].iov_len = slot_size_;
+    std::memset(&headers_[slot], 0, sizeof(headers_[slot]));
+    headers_[slot].msg_hdr.msg_iov = &iovecs_[slot];
+    headers_[slot].msg_hdr.msg_iovlen = 1;
+  }
+}
+
+std::size_t MmsgReceiver::receive(int fd, boost::system::error_code& error) {
+  for (std::size_t slot = 0; slot < batch_; slot++) {
+    buffers_[slot].reset();
+    if (slots_[slot].use_count() > 1) {
+      slots_[slot] = pool_.acquire();
+      iovecs_[slot].iov_base = slots_[slot]->data();
+    }
+  }
+  int received = ::recvmmsg(fd, headers_.data(), batch_, MSG_DONTWAIT, nullptr);
+  if (received < 0) {
+    if (errno != EAGAIN && errno != EWOULDBLOCK) {
+      error.assign(errno, boost::system::system_category());
+    }
+    return 0;
+  }
+  for (int slot = 0; slot < received; slot++) {
+    std::size_t len{headers_[slot].msg_len};
+    if (len >= slot_size_ / 4 || truncated(slot)) {
+      buffers_[slot] = slots_[slot];
+      data_[slot] = slots_[slot]->data();
+      continue;
+    }
+    // Start over once nothing copied into the packed buffer is still
+    // referenced, move on once there is no room left
+    if (packed_.use_count() == 1) {
+      packed_offset_ = 0;
+    }
+    if (!packed_ || packed_->capacity() - packed_offset_ < len) {
+      packed_ = packed_pool_.acquire();
+      packed_offset_ = 0;
+    }
+    char* data = packed_->data() + packed_offset_;
+    std::memcpy(data, slots_[slot]->data(), len);
+    // Keep the next datagram 8 byte aligned
+    packed_offset_ += (len + 7) & ~std::size_t{7};
+    buffers_[slot] = packed_;
+    data_[slot] = data;
+  }
+  return static_cast<std::size_t>(received);
+}
+
+std::size_t MmsgReceiver::size(std::size_t slot) const {
+  return headers_[slot].msg_len;
+}
+
+bool MmsgReceiver::truncated(std::size_t slot) const {
+  return headers_[slot].msg_hdr.msg_flags & MSG_TRUNC;
+}
+
+std::size_t multicast::send_batch(
+    int fd, const std::vector<OutgoingDatagram>& datagrams,
+    boost::system::error_code& error) {
+  constexpr std::size_t kMaxBatch{64};
+  struct iovec iovecs[kMaxBatch][2];
+  struct mmsghdr headers[kMaxBatch];
+
+  std::size_t sent{};
+  while (sent < datagrams.size()) {
+    std::size_t batch = std::min(kMaxBatch, datagrams.size() - sent);
+    std::memset(headers, 0, sizeof(headers[0]) * batch);
+    for (std::size_t i = 0; i < batch; i++) {
+      const OutgoingDatagram& d = datagrams[sent + i];
+      for (std::size_t segment = 0; segment < 2; segment++) {
+        iovecs[i][segment].iov_base =
+            const_cast<void*>(d.message[segment].data());
+        iovecs[i][segment].iov_len = d.message[segment].size();
+      }
+      headers[i].msg_hdr.msg_name = const_cast<struct sockaddr*>(
+          reinterpret_cast<const struct sockaddr*>(d.endpoint->data()));
+      headers[i].msg_hdr.msg_namelen = d.endpoint->size();
+      headers[i].msg_hdr.msg_iov = iovecs[i];
+      headers[i].msg_hdr.msg_iovlen = d.message[1].size() ? 2 : 1;
+    }
+
+    int result = ::sendmmsg(fd, headers, batch, MSG_DONTWAIT);
+    if (result < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        return sent;
+      }
+      // The first datagram failed outright, drop it and carry on
+      error.assign(errno, boost::system::system_category());
+      sent++;
+      continue;
+    }
+    sent += result;
+  }
+  return sent;
+}
+
+#else
+
+MmsgReceiver::MmsgReceiver(std::size_t batch, std::size_t slot_size)
+    : batch_{batch},
+      slot_size_{slot_size},
+      pool_{slot_size},
+      slots_{},
+      packed_pool_{4 * slot_size},
+      buffers_{},
+      data_{} {}
+
+std::size_t MmsgReceiver::receive(int /*fd*/,
+                                  boost::system::error_code& error) {
+  error = boost::asio::error::operation_not_supported;
+  return 0;
+}
+
+std::size_t MmsgReceiver::size(std::size_t /*slot*/) const { return 0; }
+
+bool MmsgReceiver::truncated(std::size_t /*slot*/) const { return false; }
+
+std::size_t multicast::send_batch(
+    int /*fd*/, const std::vector<OutgoingDatagram>& /*datagrams*/,
+    boost::system::error_code& error) {
+  error = boost::asio::error::operation_not_supported;
+  return 0;
+}
+
+#endif
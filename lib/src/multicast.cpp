@@ -1,167 +1,1585 @@
 #include "multicast.hpp"
 
-#include <iostream>
-#include <boost/bind/bind.hpp>
+#include <cstring>
+#include <random>
+
+#ifdef __linux__
+#include <pthread.h>
+#endif
 
 #include "messages.hpp"
+#include "udp_transport.hpp"
 
 using namespace multicast;
-using boost::asio::ip::udp;
+
+namespace {
+// Largest header an own message goes out with, a StreamMessage carrying a
+// clock entry for every host
+constexpr std::size_t kMaxHeaderSize{
+    messages::codec::WireLayout<messages::StreamMessage>::kSize +
+    kMaxGroupSize * sizeof(uint32_t)};
+
+// Largest datagram a UDP socket sends over IPv4
+constexpr std::size_t kMaxUdpPayload{65507};
+
+// Seqs kept for Data that has not arrived yet. Any beyond are dropped and
+// left for their sender to resend.
+constexpr std::size_t kMaxEarlySeqs{4096};
+
+uint64_t message_key(uint32_t sender, uint32_t msg_id) {
+  return (uint64_t{sender} << 32) | msg_id;
+}
+
+/**
+ * Bytes of a catch-up batch, room for at least one message of the largest
+ * payload unless that would not fit a datagram.
+ */
+std::size_t catchup_batch_size(const Config& config) {
+  std::size_t smallest{
+      messages::CatchupBuilder::kHeaderSize +
+      messages::CatchupBuilder::entry_size(config.max_payload_size)};
+  return std::min(kMaxUdpPayload,
+                  std::max(config.catchup_batch_bytes, smallest));
+}
+
+/**
+ * A new incarnation for a process starting without its state, never 0.
+ */
+uint32_t fresh_epoch() {
+  std::random_device device{};
+  uint32_t epoch{};
+  while (!epoch) epoch = device();
+  return epoch;
+}
+
+/**
+ * Pin the calling thread to cpu.
+ */
+void pin_thread(int cpu) {
+#ifdef __linux__
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  CPU_SET(cpu, &cpus);
+  int error = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+  if (error) {
+    spdlog::warn("Unable to pin thread to cpu {}: {}", cpu,
+                 std::strerror(error));
+  }
+#else
+  spdlog::warn("Thread pinning unsupported, cpu {} ignored", cpu);
+#endif
+}
+
+/**
+ * Tell the CPU we are spinning.
+ */
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  asm volatile("yield");
+#endif
+}
+}  // namespace
 
 Multicaster::Multicaster(std::vector<std::string>& hosts, uint16_t port,
-                         uint32_t process_id)
-    : socket_{io_context_, udp::endpoint{udp::v4(), port}},
-      hosts_{hosts},
-      port_{std::to_string(port)},
+                         uint32_t process_id, const Config& config)
+    : Multicaster{hosts.size(), process_id,
+                  [&](boost::asio::io_context& io_context) {
+                    return std::unique_ptr<Transport>{new UdpTransport{
+                        io_context, hosts, port, process_id, config}};
+                  },
+                  config} {}
+
+Multicaster::Multicaster(std::size_t group_size, uint32_t process_id,
+                         const TransportFactory& make_transport,
+                         const Config& config)
+    : config_{config},
+      transport_{make_transport(io_context_)},
+      group_size_{group_size},
+      destinations_{group_size + (transport_->has_group() ? 1 : 0)},
       process_id_{process_id},
-      recv_buffer_(5, 0) {
-  start_receive();
+      retransmit_pool_{kMaxHeaderSize + config_.max_payload_size},
+      reassembly_pool_{kMaxHeaderSize + config_.max_payload_size},
+      retained_pool_{kMaxHeaderSize + config_.max_payload_size},
+      flush_timer_{io_context_},
+      order_strand_{io_context_.get_executor()},
+      causal_{group_size},
+      stream_delivered_{new std::atomic<uint32_t>[group_size]()},
+      catchup_strand_{io_context_.get_executor()},
+      catchup_batch_{catchup_batch_size(config_)},
+      catchup_timer_{io_context_} {
+  if (group_size_ > kMaxGroupSize) {
+    throw std::runtime_error("More hosts than kMaxGroupSize");
+  }
+  if (process_id_ >= group_size_) {
+    throw std::runtime_error("Process id outside the group");
+  }
+  if (config_.fragment_size &&
+      (config_.fragment_size <=
+           messages::codec::WireLayout<messages::FragmentMessage>::kSize ||
+       config_.fragment_size > kMaxUdpPayload)) {
+    throw std::runtime_error("No room for a fragment in fragment_size");
+  }
+  if (config_.catchup_history &&
+      messages::CatchupBuilder::kHeaderSize +
+              messages::CatchupBuilder::entry_size(config_.max_payload_size) >
+          kMaxUdpPayload) {
+    // One that did not fit would end every catch-up that reached it
+    throw std::runtime_error("No room for a message of max_payload_size in "
+                             "a catch-up batch");
+  }
+  if (config_.ordering == Ordering::kSequencer) {
+    if (config_.sequencer >= group_size_) {
+      throw std::runtime_error("Sequencer is not one of the hosts");
+    }
+    engine_.reset(new SequencerEngine{pending_, *this, process_id_,
+                                      config_.sequencer, group_size_});
+  } else {
+    engine_.reset(new IsisEngine{pending_, *this, process_id_});
+  }
+  if (config_.batch_max_bytes) {
+    // Frames are datagrams too, bound by fragment_size like the rest
+    frame_size_ = config_.fragment_size
+                      ? std::min(config_.batch_max_bytes, config_.fragment_size)
+                      : config_.batch_max_bytes;
+    outbox_.reserve(destinations_);
+    for (std::size_t i = 0; i < destinations_; i++) {
+      outbox_.emplace_back(frame_size_);
+    }
+  }
+  outgoing_.reserve(destinations_);
+  std::vector<Strand> strands{};
+  for (std::size_t i = 0; i < transport_->receive_paths(); i++) {
+    shards_.emplace_back(
+        new Shard{io_context_, i, config_, reassembly_pool_, group_size_});
+    Shard& shard = *shards_.back();
+    shard.rtt.reserve(group_size_);
+    for (std::size_t p = 0; p < group_size_; p++) {
+      shard.rtt.emplace_back(config_.initial_rto, config_.min_rto,
+                             config_.max_rto);
+    }
+    strands.push_back(shard.strand);
+  }
+  if (shards_.size() == 1) {
+    // run_on() handles Data and Seq inline on the one shard strand, so what
+    // is posted to order_strand_ has to run there too
+    order_strand_ = shards_.front()->strand;
+  }
+  if (!config_.trace_path.empty()) {
+    tracer_.reset(new Tracer{config_.trace_path, process_id_,
+                             static_cast<uint32_t>(group_size_),
+                             config_.trace_ring_size});
+  }
+  delivery_batch_.reserve(64);
+  seen_.reserve(group_size_);
+  for (std::size_t p = 0; p < group_size_; p++) {
+    seen_.emplace_back(config_.duplicate_window);
+  }
+  sender_epoch_.assign(group_size_, 0);
+  epoch_ = fresh_epoch();
+  if (config_.catchup_history) {
+    history_.reset(new DeliveryHistory{config_.catchup_history});
+  }
+  catchup_sessions_.assign(group_size_, CatchupSession{});
+  if (!config_.journal_path.empty()) {
+    journal_.reset(new Journal{
+        config_.journal_path, config_.journal_capacity, process_id_, epoch_,
+        group_size_, config_.duplicate_window,
+        kMaxHeaderSize + config_.max_payload_size,
+        config_.journal_checkpoint_records, config_.journal_sync_interval});
+  }
+  transport_->start(strands, [this](const BufferRef& buffer, const char* buf,
+                                    std::size_t len) {
+    handle_datagram(buffer, buf, len);
+  });
+  if (journal_) {
+    recover(journal_->recovery());
+  }
+}
+
+void Multicaster::recover(const journal::Recovery& recovery) {
+  // Carrying on with the same msg_ids, so in the same incarnation
+  epoch_ = recovery.epoch;
+  sender_epoch_ = recovery.sender_epoch;
+  last_msg_id_ = recovery.next_msg_id;
+  last_stream_seq_ = recovery.last_stream_seq;
+  delivered_ = recovery.delivered;
+  for (std::size_t p = 0; p < group_size_; p++) {
+    seen_[p] = recovery.seen[p];
+    stream_delivered_[p] = recovery.stream_delivered[p];
+    causal_.restore(static_cast<uint32_t>(p), recovery.stream_delivered[p]);
+  }
+  engine_->restore(recovery.highest_seq, recovery.delivered_seq);
+  delivered_seq_ = recovery.delivered_seq;
+  delivered_proposer_ = recovery.delivered_proposer;
+
+  // Back into the pending store in the state they were left in. One that
+  // was never proposed or sequenced is handled as if it had just arrived.
+  for (const auto& pending : recovery.pending) {
+    if (pending.payload.size() > config_.max_payload_size) {
+      SPDLOG_WARN("Dropping recovered message {} from {}, payload too large",
+                  pending.msg.msg_id, pending.msg.sender);
+      continue;
+    }
+    messages::DataMessage D{pending.msg};
+    BufferRef buffer{};
+    if (!pending.payload.empty()) {
+      buffer = retransmit_pool_.acquire();
+      std::memcpy(buffer->data(), pending.payload.data(),
+                  pending.payload.size());
+      D.payload = buffer->data();
+    }
+    D.payload_size = pending.payload.size();
+    if (D.final_seq) {
+      D.deliverable = true;
+      pending_.insert(D, std::move(buffer));
+    } else if (pending.proposal) {
+      D.final_seq = pending.proposal;
+      D.final_seq_proposer = process_id_;
+      D.deliverable = false;
+      pending_.insert(D, std::move(buffer));
+    } else {
+      engine_->on_data(D, std::move(buffer));
+    }
+  }
+  pending_depth_.store(pending_.size(), std::memory_order_relaxed);
+  // Once there is a sink to deliver to. Held back StreamMessages arrive
+  // again, they only count as seen once delivered.
+  std::vector<std::pair<messages::StreamMessage, BufferRef>> held{};
+  for (const auto& message : recovery.held) {
+    if (message.size() > kMaxHeaderSize + config_.max_payload_size) {
+      SPDLOG_WARN("Dropping recovered stream message, too large");
+      continue;
+    }
+    BufferRef buffer{retransmit_pool_.acquire()};
+    std::memcpy(buffer->data(), message.data(), message.size());
+    held.emplace_back(messages::StreamMessage{buffer->data(), message.size()},
+                      buffer);
+  }
+  boost::asio::post(order_strand_, [this, held]() {
+    if (closing_) return;
+    for (const auto& message : held) {
+      handle_stream(message.first, message.second);
+    }
+    deliver_pending();
+    flush_deliveries();
+  });
+
+  // Without retransmission nothing would see them through
+  if (!config_.retransmit) {
+    return;
+  }
+  auto now = std::chrono::steady_clock::now();
+  for (const auto& own : recovery.own) {
+    Shard& shard = ack_shard(own.msg_id);
+    if (!shard.acks.track(own.msg_id)) continue;
+    AckState& state = *shard.acks.find(own.msg_id);
+    state.stream = messages::codec::peek_type(own.message.data(),
+                                              own.message.size()) == 6;
+    state.final_seq = own.final_seq;
+    state.final_seq_proposer = own.final_seq_proposer;
+    bool known{own.final_seq != 0};
+    if (state.stream || !engine_->sender_collects_acks()) {
+      // Waiting for the hosts to confirm, the Data goes out again to those
+      // that have not
+      state.sequenced = true;
+    } else {
+      // Either the Seq went out, or the acks are collected anew
+      state.sequenced = known;
+    }
+    if (!state.sequenced || !engine_->sender_collects_acks()) {
+      state.message = retransmit_pool_.acquire();
+      std::memcpy(state.message->data(), own.message.data(),
+                  own.message.size());
+      state.message_size = own.message.size();
+    }
+    // Still holding a slot of the window
+    if (state.stream || !known) {
+      in_flight_++;
+    }
+    state.sent_at = now;
+    schedule_retransmit(shard, state);
+  }
 }
 
 Multicaster::~Multicaster() {
-  for (auto m : queue_) {
-    delete m;
+  stop();
+  // Run whatever is still queued so messages handed between strands release
+  // their receive buffers while the pools are alive. Closing the transport
+  // first makes the receives complete without being restarted.
+  closing_ = true;
+  flush_timer_.cancel();
+  catchup_timer_.cancel();
+  for (auto& shard : shards_) {
+    shard->retransmit_timer.cancel();
   }
+  transport_->close();
+  io_context_.restart();
+  io_context_.poll();
 }
 
-void Multicaster::multicast(uint32_t data) {
-  spdlog::info("Multicasting message");
-  messages::DataMessage msg{process_id_, last_msg_id_++, data};
-  std::vector<uint32_t> msg_vect{};
-  msg.serialize(msg_vect);
-  spdlog::info("Process {} prepared message {}", process_id_, msg.msg_id);
+void Multicaster::run() {
+  running_ = true;
+  switch (config_.wait_strategy) {
+    case WaitStrategy::kBlock:
+      io_context_.run();
+      break;
+    case WaitStrategy::kSpinThenBlock:
+      run_spin_then_block();
+      break;
+    case WaitStrategy::kBusyPoll:
+      while (!io_context_.stopped()) {
+        io_context_.poll();
+      }
+      break;
+  }
+}
 
-  send_multi(boost::asio::buffer((char*)&msg_vect.front(), 16));
+void Multicaster::run_spin_then_block() {
+  using clock = std::chrono::steady_clock;
+  // Upper bound on pause instructions between two idle polls
+  constexpr unsigned kMaxBackoff{64};
+  const std::chrono::nanoseconds min_spin{config_.spin_duration / 8};
+  const std::chrono::nanoseconds max_spin{config_.spin_duration * 8};
+  std::chrono::nanoseconds spin{config_.spin_duration};
+  while (!io_context_.stopped()) {
+    auto deadline = clock::now() + spin;
+    unsigned backoff{1};
+    while (clock::now() < deadline && !io_context_.stopped()) {
+      if (io_context_.poll()) {
+        backoff = 1;
+        deadline = clock::now() + spin;
+        continue;
+      }
+      for (unsigned i = 0; i < backoff; i++) {
+        cpu_relax();
+      }
+      backoff = std::min(2 * backoff, kMaxBackoff);
+    }
+    // Nothing came in while spinning, sleep until something does
+    auto blocked = clock::now();
+    io_context_.run_one();
+    // Work that showed up shortly after giving up would have been caught by
+    // spinning longer, work after a long idle period would not
+    if (clock::now() - blocked < 2 * spin) {
+      spin = std::min(2 * spin, max_spin);
+    } else {
+      spin = std::max(spin / 2, min_spin);
+    }
+  }
 }
 
-void Multicaster::start_receive() {
-  socket_.async_receive_from(
-      boost::asio::buffer((char*)&recv_buffer_.front(), 20), remote_endpoint_,
-      boost::bind(&Multicaster::handle_receive, this,
-                  boost::asio::placeholders::error,
-                  boost::asio::placeholders::bytes_transferred));
+void Multicaster::start() {
+  if (!workers_.empty()) {
+    return;
+  }
+  running_ = true;
+  std::size_t threads{std::max<std::size_t>(1, config_.threads)};
+  spdlog::info("Starting {} worker threads over {} shards", threads,
+               shards_.size());
+  for (std::size_t i = 0; i < threads; i++) {
+    workers_.emplace_back([this, i]() {
+      if (!config_.cpu_affinity.empty()) {
+        pin_thread(config_.cpu_affinity[i % config_.cpu_affinity.size()]);
+      }
+      try {
+        run();
+      } catch (const std::exception& e) {
+        // Every worker stops with it rather than carry on without its state
+        spdlog::critical("Multicaster stopped: {}", e.what());
+        failed_ = true;
+        io_context_.stop();
+      }
+    });
+  }
 }
 
-void Multicaster::handle_receive(const boost::system::error_code& error,
-                    std::size_t /*bytes_transferred*/) {
-  if (error) {
-    spdlog::error("Error reading from socket");
+void Multicaster::stop() {
+  io_context_.stop();
+  for (auto& worker : workers_) {
+    worker.join();
+  }
+  workers_.clear();
+  running_ = false;
+}
+
+void Multicaster::multicast(uint32_t data) { multicast(nullptr, 0, data); }
+
+void Multicaster::multicast(const void* payload, std::size_t len,
+                            uint32_t data, DeliveryOrder order) {
+  if (len > config_.max_payload_size) {
+    throw std::runtime_error("Payload larger than max_payload_size");
+  }
+  if (journal_ && !journal_->admit()) {
+    throw std::runtime_error("No room in the journal for another message");
+  }
+  in_flight_++;
+  send_data(payload, len, data, order);
+}
+
+bool Multicaster::try_multicast(const void* payload, std::size_t len,
+                                uint32_t data, DeliveryOrder order) {
+  if (len > config_.max_payload_size) {
+    throw std::runtime_error("Payload larger than max_payload_size");
+  }
+  if (!acquire_window_slot()) {
+    window_blocked_ = true;
+    // A slot freed before the flag was raised would not have reported the
+    // window open, so look once more
+    if (!acquire_window_slot()) {
+      return false;
+    }
+    // Nobody was refused after all, the handler is not owed a call
+    window_blocked_ = false;
+  }
+  if (journal_ && !journal_->admit()) {
+    // Not owed a call by the window either, the slot was never used
+    in_flight_--;
+    journal_blocked_ = true;
+    // Room made before the flag was raised would not have been reported
+    if (!journal_->admit()) {
+      return false;
+    }
+    journal_blocked_ = false;
+    in_flight_++;
+  }
+  send_data(payload, len, data, order);
+  return true;
+}
+
+bool Multicaster::acquire_window_slot() {
+  if (!config_.max_in_flight) {
+    in_flight_++;
+    return true;
+  }
+  std::size_t in_flight{in_flight_.load()};
+  while (in_flight < config_.max_in_flight) {
+    if (in_flight_.compare_exchange_weak(in_flight, in_flight + 1)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void Multicaster::release_window_slot() {
+  std::size_t in_flight{--in_flight_};
+  if ((!config_.max_in_flight || in_flight < config_.max_in_flight) &&
+      window_blocked_.exchange(false) && on_window_open_) {
+    on_window_open_();
+  }
+}
+
+BufferRef Multicaster::retain(const BufferRef& buffer, const char*& data,
+                              std::size_t size) {
+  if (!size) return BufferRef{};
+  if (!buffer || 4 * size >= buffer->capacity() ||
+      size > retained_pool_.buffer_size()) {
+    return buffer;
+  }
+  // Start over once nothing copied into the buffer is still referenced, and
+  // move on once there is no room left
+  if (retained_buffer_.use_count() == 1) {
+    retained_offset_ = 0;
+  }
+  if (!retained_buffer_ ||
+      retained_offset_ + size > retained_buffer_->capacity()) {
+    retained_buffer_ = retained_pool_.acquire();
+    retained_offset_ = 0;
+  }
+  char* copy = retained_buffer_->data() + retained_offset_;
+  std::memcpy(copy, data, size);
+  data = copy;
+  // Keep the next copy 8 byte aligned
+  retained_offset_ += (size + 7) & ~std::size_t{7};
+  return retained_buffer_;
+}
+
+void Multicaster::journal_room_made() {
+  if (journal_blocked_.exchange(false) && on_window_open_) {
+    on_window_open_();
+  }
+}
+
+void Multicaster::confirmed(uint32_t msg_id) {
+  if (!journal_) return;
+  journal_->confirmed(msg_id);
+  journal_room_made();
+}
+
+void Multicaster::send_data(const void* payload, std::size_t len,
+                            uint32_t data, DeliveryOrder order) {
+  SPDLOG_DEBUG("Multicasting message");
+  // Total and stream messages share the msg_ids, so one duplicate window
+  // per sender covers both
+  uint32_t msg_id{last_msg_id_++};
+  bool stream{order != DeliveryOrder::kTotal};
+  char header[kMaxHeaderSize];
+  std::size_t header_len{};
+  if (stream) {
+    header_len = encode_stream(msg_id, data, order, header, sizeof(header));
+  } else {
+    messages::DataMessage msg{process_id_, msg_id, data};
+    msg.epoch = epoch_;
+    header_len = msg.encode(header, sizeof(header));
+  }
+  // On record before it can be acked, so a restart resends it
+  if (journal_) journal_->sent(msg_id, header, header_len, payload, len);
+  SPDLOG_DEBUG("Process {} prepared message {} with {} bytes of payload",
+               process_id_, msg_id, len);
+
+  // Keep a copy to retransmit from, the caller's payload is only borrowed
+  BufferRef copy{};
+  if (config_.retransmit) {
+    copy = retransmit_pool_.acquire();
+    std::memcpy(copy->data(), header, header_len);
+    if (len) std::memcpy(copy->data() + header_len, payload, len);
+  }
+
+  // Collection starts before the message leaves, so an ack can never arrive
+  // for a message that is not being tracked
+  Shard& shard = ack_shard(msg_id);
+  std::size_t size{header_len + len};
+  std::chrono::steady_clock::time_point multicast_at{};
+  if (config_.latency_stats) {
+    multicast_at = std::chrono::steady_clock::now();
+  }
+  auto track = [this, &shard, msg_id, stream, copy, size, multicast_at]() {
+    if (!shard.acks.track(msg_id)) return;
+    AckState& state = *shard.acks.find(msg_id);
+    // Without acks to collect the message goes straight to waiting for the
+    // hosts to confirm its Seq, or itself
+    state.stream = stream;
+    state.sequenced = stream || !engine_->sender_collects_acks();
+    state.multicast_at = multicast_at;
+    if (!copy) return;
+    state.message = copy;
+    state.message_size = size;
+    state.sent_at = std::chrono::steady_clock::now();
+    schedule_retransmit(shard, state);
+  };
+  if (!running_) {
+    run_on(shard.strand, track);
+  } else {
+    boost::asio::post(shard.strand, track);
+  }
+
+  record_trace(trace::Kind::kSent, stream ? 6 : 1, process_id_, msg_id, 0,
+               trace::kGroup);
+  if (!fragmented(size)) {
+    send_record_multi(Segments{boost::asio::buffer(header, header_len),
+                               boost::asio::buffer(payload, len)});
     return;
   }
+  // Counted once however many fragments it takes. They are cut from the
+  // message in one piece, the retransmit copy if there is one.
+  count(sent_, header, header_len);
+  BufferRef whole{copy};
+  if (!whole) {
+    whole = retransmit_pool_.acquire();
+    std::memcpy(whole->data(), header, header_len);
+    if (len) std::memcpy(whole->data() + header_len, payload, len);
+  }
+  fragment(msg_id, whole->data(), size,
+           [this](const Segments& piece) { send_record_multi(piece); });
+}
 
-  uint32_t msg_type = ntohl(recv_buffer_[0]);
+std::size_t Multicaster::encode_stream(uint32_t msg_id, uint32_t data,
+                                       DeliveryOrder order, char* buf,
+                                       std::size_t len) {
+  uint32_t stream_seq{++last_stream_seq_};
+  messages::StreamMessage msg{process_id_, msg_id, data,
+                              static_cast<uint32_t>(order), stream_seq};
+  msg.epoch = epoch_;
+  uint32_t clock[kMaxGroupSize];
+  if (order == DeliveryOrder::kCausal) {
+    // Everything delivered here so far happened before this message
+    for (std::size_t k = 0; k < group_size_; k++) {
+      uint32_t entry{stream_seq};
+      if (k != process_id_) {
+        entry = stream_delivered_[k].load(std::memory_order_acquire);
+      }
+      clock[k] = htonl(entry);
+    }
+    msg.clock_size = static_cast<uint32_t>(group_size_);
+    msg.clock = reinterpret_cast<const char*>(clock);
+  }
+  return msg.encode(buf, len);
+}
 
-  switch (msg_type) {
-    case 1: {
-      spdlog::info("Received Data Message");
-      messages::DataMessage* M = new messages::DataMessage{recv_buffer_};
-      queue_.push_back(M);
-      // Update msg id if necessary to prevent repeating msg id
-      last_msg_id_ = std::max(last_msg_id_, M->msg_id);
-      spdlog::info("Added M to queue");
+void Multicaster::handle_datagram(const BufferRef& buffer, const char* buf,
+                                  std::size_t len) {
+  try {
+    uint32_t type{};
+    if (len >= sizeof(type)) std::memcpy(&type, buf, sizeof(type));
+    if (len >= sizeof(type) && ntohl(type) == messages::FrameBuilder::kType) {
+      messages::FrameReader frame{buf, len};
+      SPDLOG_TRACE("Received frame of {} messages", frame.count());
+      const char* record{};
+      std::size_t record_len{};
+      while (frame.next(record, record_len)) {
+        handle_message(buffer, record, record_len);
+      }
+    } else {
+      handle_message(buffer, buf, len);
+    }
+  } catch (const JournalError&) {
+    // Not the datagram's fault, and fatal
+    throw;
+  } catch (std::runtime_error& e) {
+    SPDLOG_ERROR("Dropping malformed datagram: {}", e.what());
+  }
+}
 
-      messages::AckMessage A{M->sender, M->msg_id, last_seq_received_ + 1,
-                              process_id_};
-      std::vector<uint32_t> ack_vect{};
-      A.serialize(ack_vect);
-      send_single(boost::asio::buffer((char*)&ack_vect.front(), 20),
-                  M->sender);
-      spdlog::info("Sent ack message");
+void Multicaster::handle_message(const BufferRef& buffer, const char* buf,
+                                 std::size_t len) {
+  uint32_t msg_type = messages::codec::peek_type(buf, len);
+  if (msg_type < kMessageTypes) {
+    received_[msg_type].fetch_add(1, std::memory_order_relaxed);
+  }
 
+  switch (msg_type) {
+    case 1: {
+      SPDLOG_DEBUG("Received Data Message");
+      messages::DataMessage D{buf, len};
+      if (D.sender >= group_size_) {
+        SPDLOG_WARN("Data from unknown process {}", D.sender);
+        break;
+      }
+      record_trace(trace::Kind::kReceived, 1, D.sender, D.msg_id, 0,
+                   D.sender);
+      // Only pin the receive buffer if there is a payload to keep
+      BufferRef payload_buffer{D.payload_size ? buffer : BufferRef{}};
+      run_on(order_strand_, [this, D, payload_buffer]() mutable {
+        handle_data(D, std::move(payload_buffer));
+      });
       break;
     }
     case 2: {
-      spdlog::info("Received Ack Message");
-      // Sender collects all acks from all hosts and calculate final_seq
-      messages::AckMessage A{recv_buffer_};
-      for (auto m : queue_) {
-        if (m->msg_id == A.msg_id) {
-          m->acks_received++;
-          if (A.proposed_seq > m->final_seq) {
-            m->final_seq = A.proposed_seq;
-            m->final_seq_proposer = A.proposer;
-          }
-
-          if (m->acks_received == hosts_.size()) {
-            spdlog::info("All acks received");
-            spdlog::info("Multicasting final_seq {} proposed by {}",
-                          m->final_seq, m->final_seq_proposer);
-            messages::SeqMessage S{m->sender, m->msg_id, m->final_seq,
-                                    process_id_};
-            std::vector<uint32_t> msg_vect{};
-            S.serialize(msg_vect);
-            send_multi(boost::asio::buffer((char*)&msg_vect.front(), 20));
-          }
-          break;
-        }
+      SPDLOG_DEBUG("Received Ack Message");
+      messages::AckMessage A{buf, len};
+      if (A.sender != process_id_) {
+        SPDLOG_WARN("Ack for message {} of process {}", A.msg_id, A.sender);
+        break;
       }
+      record_trace(trace::Kind::kReceived, 2, A.sender, A.msg_id,
+                   A.proposed_seq, A.proposer);
+      Shard& shard = ack_shard(A.msg_id);
+      run_on(shard.strand, [this, &shard, A]() { handle_ack(shard, A); });
       break;
     }
     case 3: {
-      spdlog::info("Received Seq Message");
-      // ??? We don't reorder the queue, should we
-      messages::SeqMessage S{recv_buffer_};
-      messages::DataMessage* m{};
-      for (auto it = queue_.begin(); it != queue_.end(); /*left empty*/) {
-        m = *it;
-        if (m->deliverable && m->final_seq < S.final_seq) {
-          spdlog::info("Delivering message with sequence {}", m->final_seq);
-          // deliver messages with lower seq and deliverable
-          std::cout << process_id_ << ": Processed message " << m->msg_id
-                    << " with from sender " << m->sender << " with seq ("
-                    << m->final_seq << ", " << m->final_seq_proposer << ")"
-                    << std::endl;
-          // Update iterator if we remove the message
-          it = queue_.erase(it);
-
-        } else if (m->msg_id == S.msg_id) {
-          // mark as deliverable and set appropriate fields
-          spdlog::info("Marking message deliverable");
-          m->deliverable = true;
-          m->final_seq = S.final_seq;
-          m->final_seq_proposer = S.final_seq_proposer;
-          it++;
-
-        } else {
-          // Iterator condition
-          it++;
-        }
+      SPDLOG_DEBUG("Received Seq Message");
+      messages::SeqMessage S{buf, len};
+      if (S.sender >= group_size_) {
+        SPDLOG_WARN("Seq from unknown process {}", S.sender);
+        break;
+      }
+      record_trace(trace::Kind::kReceived, 3, S.sender, S.msg_id,
+                   S.final_seq,
+                   engine_->sender_collects_acks() ? S.sender
+                                                   : config_.sequencer);
+      run_on(order_strand_, [this, S]() { handle_seq(S); });
+      break;
+    }
+    case 6: {
+      SPDLOG_DEBUG("Received Stream Message");
+      messages::StreamMessage M{buf, len};
+      if (M.sender >= group_size_) {
+        SPDLOG_WARN("Stream message from unknown process {}", M.sender);
+        break;
       }
-      // update last_seq_received
-      last_seq_received_ = S.final_seq;
-      spdlog::info("Updated last_seq_received to {}", last_seq_received_);
+      if (M.order != static_cast<uint32_t>(DeliveryOrder::kFifo) &&
+          M.order != static_cast<uint32_t>(DeliveryOrder::kCausal)) {
+        SPDLOG_WARN("Stream message {} from {} with unknown order {}",
+                    M.msg_id, M.sender, M.order);
+        break;
+      }
+      record_trace(trace::Kind::kReceived, 6, M.sender, M.msg_id,
+                   M.stream_seq, M.sender);
+      // The clock lives in the receive buffer too
+      run_on(order_strand_, [this, M, buffer]() mutable {
+        handle_stream(M, std::move(buffer));
+      });
+      break;
+    }
+    case 5: {
+      SPDLOG_DEBUG("Received SeqAck Message");
+      messages::SeqAckMessage SA{buf, len};
+      if (SA.sender != process_id_) {
+        SPDLOG_WARN("SeqAck for message {} of process {}", SA.msg_id,
+                    SA.sender);
+        break;
+      }
+      record_trace(trace::Kind::kReceived, 5, SA.sender, SA.msg_id, 0,
+                   SA.acker);
+      Shard& shard = ack_shard(SA.msg_id);
+      run_on(shard.strand,
+             [this, &shard, SA]() { handle_seq_ack(shard, SA); });
+      break;
+    }
+    case 7: {
+      SPDLOG_DEBUG("Received Catchup Request");
+      messages::CatchupRequestMessage R{buf, len};
+      if (R.requester >= group_size_ || R.requester == process_id_) {
+        SPDLOG_WARN("Catch-up request from process {}", R.requester);
+        break;
+      }
+      // Kept off the receive path, batches are sent a step at a time
+      boost::asio::post(catchup_strand_,
+                        [this, R]() { handle_catchup_request(R); });
+      break;
+    }
+    case 8: {
+      SPDLOG_DEBUG("Received Catchup Batch");
+      messages::CatchupReader batch{buf, len};
+      if (batch.responder() >= group_size_) {
+        SPDLOG_WARN("Catch-up batch from process {}", batch.responder());
+        break;
+      }
+      // Checked whole before any of it is applied, so that a bad batch is
+      // dropped here rather than failing halfway through on the order strand
+      if (!valid_catchup(batch)) {
+        SPDLOG_WARN("Malformed catch-up batch from process {}",
+                    batch.responder());
+        break;
+      }
+      // The payloads are delivered from the receive buffer, see retain()
+      run_on(order_strand_, [this, batch, buffer]() mutable {
+        handle_catchup(batch, std::move(buffer));
+      });
+      break;
+    }
+    case 9: {
+      SPDLOG_DEBUG("Received Fragment");
+      messages::FragmentMessage F{buf, len};
+      if (F.sender >= group_size_) {
+        SPDLOG_WARN("Fragment from unknown process {}", F.sender);
+        break;
+      }
+      // Every fragment of a sender goes to the same shard, whichever path
+      // it came in on. The bytes are read from the receive buffer.
+      Shard& shard = *shards_[F.sender % shards_.size()];
+      run_on(shard.strand, [this, &shard, F, buffer]() {
+        handle_fragment(shard, F);
+      });
       break;
     }
     default: {
-      spdlog::error("Unknown message type received");
+      SPDLOG_ERROR("Unknown message type received");
+    }
+  }
+}
+
+void Multicaster::handle_fragment(Shard& shard,
+                                  const messages::FragmentMessage& F) {
+  if (closing_) return;
+  BufferRef message{};
+  try {
+    if (!shard.reassembler.add(F, message)) return;
+  } catch (const std::runtime_error& e) {
+    SPDLOG_WARN("Dropping fragment of message {} from {}: {}", F.msg_id,
+                F.sender, e.what());
+    return;
+  }
+  // Only acked from here on, so the sender retransmits a message that never
+  // came together
+  try {
+    uint32_t type{messages::codec::peek_type(message->data(), F.size)};
+    if (type != 1 && type != 6) {
+      SPDLOG_WARN("Fragments of message {} from {} make up a type {}",
+                  F.msg_id, F.sender, type);
+      return;
+    }
+    handle_message(message, message->data(), F.size);
+  } catch (const JournalError&) {
+    throw;
+  } catch (const std::exception& e) {
+    SPDLOG_ERROR("Dropping malformed reassembled message: {}", e.what());
+  }
+}
+
+void Multicaster::check_epoch(uint32_t sender, uint32_t epoch) {
+  uint32_t& known = sender_epoch_[sender];
+  if (!epoch || epoch == known) return;
+  if (known) {
+    SPDLOG_WARN("Process {} restarted, its messages start over", sender);
+    seen_[sender] = DuplicateWindow{config_.duplicate_window};
+    for (auto it = early_seqs_.begin(); it != early_seqs_.end();) {
+      if (it->first >> 32 == sender) {
+        it = early_seqs_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    causal_.reset(sender);
+    stream_delivered_[sender].store(0, std::memory_order_release);
+  }
+  known = epoch;
+  if (journal_) journal_->epoch(sender, epoch);
+}
+
+void Multicaster::handle_data(messages::DataMessage& D, BufferRef buffer) {
+  if (closing_) return;
+  check_epoch(D.sender, D.epoch);
+  switch (seen_[D.sender].check(D.msg_id)) {
+    case DuplicateWindow::Result::kNew: {
+      // On record before it counts as seen. Without room it is dropped
+      // unacked like one ahead of the window, and taken when resent once
+      // deliveries have made room.
+      if (journal_ && !journal_->data(D)) {
+        journal_full_.fetch_add(1, std::memory_order_relaxed);
+        SPDLOG_DEBUG("No room in the journal for message {} from {}",
+                     D.msg_id, D.sender);
+        break;
+      }
+      seen_[D.sender].insert(D.msg_id);
+      // Pending until its Seq comes
+      buffer = retain(buffer, D.payload, D.payload_size);
+      engine_->on_data(D, std::move(buffer));
+      auto early = early_seqs_.find(message_key(D.sender, D.msg_id));
+      if (early != early_seqs_.end()) {
+        messages::SeqMessage S{early->second};
+        early_seqs_.erase(early);
+        handle_seq(S);
+      }
+      break;
+    }
+    case DuplicateWindow::Result::kDuplicate:
+      duplicate_data_.fetch_add(1, std::memory_order_relaxed);
+      engine_->on_duplicate_data(D, pending_.find(D.sender, D.msg_id));
+      break;
+    case DuplicateWindow::Result::kAhead:
+      // Unanswered, so the sender retransmits it once the window has moved
+      data_ahead_.fetch_add(1, std::memory_order_relaxed);
+      SPDLOG_DEBUG("Message {} from {} is ahead of the duplicate window",
+                   D.msg_id, D.sender);
+      break;
+  }
+  pending_depth_.store(pending_.size() + causal_.held(),
+                       std::memory_order_relaxed);
+}
+
+void Multicaster::send_ack(const messages::AckMessage& A) {
+  char ack_buf[messages::codec::WireLayout<messages::AckMessage>::kSize];
+  std::size_t ack_len = A.encode(ack_buf, sizeof(ack_buf));
+  if (journal_) journal_->proposed(A.sender, A.msg_id, A.proposed_seq);
+  record_trace(trace::Kind::kSent, 2, A.sender, A.msg_id, A.proposed_seq,
+               A.sender);
+  send_record(Segments{boost::asio::buffer(ack_buf, ack_len),
+                       boost::asio::const_buffer{}},
+              A.sender);
+  SPDLOG_DEBUG("Sent ack message");
+}
+
+void Multicaster::send_seq(const messages::SeqMessage& S, uint32_t hostnum) {
+  char seq_buf[messages::codec::WireLayout<messages::SeqMessage>::kSize];
+  std::size_t seq_len = S.encode(seq_buf, sizeof(seq_buf));
+  record_trace(trace::Kind::kSent, 3, S.sender, S.msg_id, S.final_seq,
+               hostnum);
+  send_record(Segments{boost::asio::buffer(seq_buf, seq_len),
+                       boost::asio::const_buffer{}},
+              hostnum);
+}
+
+void Multicaster::send_seq_all(const messages::SeqMessage& S) {
+  char seq_buf[messages::codec::WireLayout<messages::SeqMessage>::kSize];
+  std::size_t seq_len = S.encode(seq_buf, sizeof(seq_buf));
+  if (journal_) journal_->sequenced(S);
+  record_trace(trace::Kind::kSent, 3, S.sender, S.msg_id, S.final_seq,
+               trace::kGroup);
+  send_record_multi(Segments{boost::asio::buffer(seq_buf, seq_len),
+                             boost::asio::const_buffer{}});
+}
+
+void Multicaster::handle_ack(Shard& shard, const messages::AckMessage& A) {
+  if (closing_) return;
+  // Sender collects all acks from all hosts and calculate final_seq
+  AckState* state = shard.acks.add(A.msg_id, A.proposed_seq, A.proposer);
+  if (!state) {
+    // Repeated by a retransmission or arriving after the Seq went out
+    duplicate_acks_.fetch_add(1, std::memory_order_relaxed);
+    SPDLOG_DEBUG("Ignoring ack for message {} from {}", A.msg_id, A.proposer);
+    return;
+  }
+  auto now = std::chrono::steady_clock::now();
+  if (!state->retransmits && A.proposer < shard.rtt.size()) {
+    shard.rtt[A.proposer].sample(now - state->sent_at);
+  }
+  if (state->acks_received < group_size_) {
+    return;
+  }
+  SPDLOG_DEBUG("All acks received");
+  if (state->multicast_at != std::chrono::steady_clock::time_point{}) {
+    data_to_acks_.record(now - state->multicast_at);
+    state->sequenced_at = now;
+  }
+  SPDLOG_DEBUG("Multicasting final_seq {} proposed by {}", state->final_seq,
+               state->final_seq_proposer);
+  messages::SeqMessage S{process_id_, state->msg_id, state->final_seq,
+                         state->final_seq_proposer};
+  if (config_.retransmit) {
+    // Hold on to the state until every host has confirmed the Seq
+    state->sequenced = true;
+    state->retransmits = 0;
+    state->sent_at = now;
+    state->message.reset();
+    schedule_retransmit(shard, *state);
+  } else {
+    shard.acks.erase(A.msg_id);
+    confirmed(A.msg_id);
+  }
+  send_seq_all(S);
+  release_window_slot();
+}
+
+void Multicaster::handle_seq_ack(Shard& shard,
+                                 const messages::SeqAckMessage& SA) {
+  if (closing_) return;
+  AckState* state = shard.acks.confirm(SA.msg_id, SA.acker);
+  if (!state) {
+    SPDLOG_DEBUG("Ignoring SeqAck for message {} from {}", SA.msg_id,
+                 SA.acker);
+    return;
+  }
+  auto now = std::chrono::steady_clock::now();
+  if (!state->retransmits && SA.acker < shard.rtt.size()) {
+    shard.rtt[SA.acker].sample(now - state->sent_at);
+  }
+  if (state->confirmations < group_size_) {
+    return;
+  }
+  SPDLOG_DEBUG("All hosts confirmed Seq of message {}", SA.msg_id);
+  bool stream{state->stream};
+  if (!stream &&
+      state->sequenced_at != std::chrono::steady_clock::time_point{}) {
+    acks_to_seq_.record(now - state->sequenced_at);
+  }
+  // Its pending timer goes stale and is ignored when it expires
+  shard.acks.erase(SA.msg_id);
+  confirmed(SA.msg_id);
+  if (stream) {
+    release_window_slot();
+  }
+}
+
+void Multicaster::schedule_retransmit(Shard& shard, AckState& state) {
+  uint64_t answered{state.sequenced ? state.confirmed : state.acked};
+  std::chrono::nanoseconds timeout{config_.min_rto};
+  for (std::size_t p = 0; p < group_size_; p++) {
+    if (!(answered & (uint64_t{1} << p))) {
+      timeout = std::max(timeout, shard.rtt[p].rto());
+    }
+  }
+  // Back off exponentially, giving up on doubling once past max_rto
+  for (uint32_t i = 0; i < state.retransmits && timeout < config_.max_rto;
+       i++) {
+    timeout *= 2;
+  }
+  timeout = std::min<std::chrono::nanoseconds>(timeout, config_.max_rto);
+  state.deadline = shard.retransmit_wheel.schedule(state.msg_id, timeout);
+  arm_retransmit_timer(shard);
+}
+
+void Multicaster::arm_retransmit_timer(Shard& shard) {
+  if (shard.retransmit_timer_armed || shard.retransmit_wheel.empty()) {
+    return;
+  }
+  shard.retransmit_timer_armed = true;
+  shard.retransmit_timer.expires_at(shard.retransmit_wheel.next_tick());
+  shard.retransmit_timer.async_wait(boost::asio::bind_executor(
+      shard.strand, [this, &shard](const boost::system::error_code& error) {
+        shard.retransmit_timer_armed = false;
+        if (error || closing_) return;
+        shard.retransmit_wheel.advance(
+            std::chrono::steady_clock::now(),
+            [this, &shard](uint32_t msg_id, uint64_t tick) {
+              retransmit(shard, msg_id, tick);
+            });
+        arm_retransmit_timer(shard);
+      }));
+}
+
+void Multicaster::retransmit(Shard& shard, uint32_t msg_id, uint64_t tick) {
+  AckState* state = shard.acks.find(msg_id);
+  if (!state || state->deadline != tick) {
+    // Finished, or rescheduled since this timer was set
+    return;
+  }
+  state->retransmits++;
+  Segments data{};
+  if (state->message) {
+    data = Segments{boost::asio::buffer(state->message->data(),
+                                        state->message_size),
+                    boost::asio::const_buffer{}};
+  }
+  messages::SeqMessage S{process_id_, state->msg_id, state->final_seq,
+                         state->final_seq_proposer};
+  char seq_buf[messages::codec::WireLayout<messages::SeqMessage>::kSize];
+  std::size_t seq_len = S.encode(seq_buf, sizeof(seq_buf));
+  Segments seq{boost::asio::buffer(seq_buf, seq_len),
+               boost::asio::const_buffer{}};
+
+  std::size_t data_resent{};
+  std::size_t seq_resent{};
+  uint32_t data_type{state->stream ? 6u : 1u};
+  auto resend_data = [&](std::size_t p) {
+    record_trace(trace::Kind::kSent, data_type, process_id_, msg_id, 0,
+                 static_cast<uint32_t>(p));
+    if (fragmented(state->message_size)) {
+      // Every fragment again, the receiver may have lost any of them
+      count(sent_, state->message->data(), state->message_size);
+      fragment(msg_id, state->message->data(), state->message_size,
+               [this, p](const Segments& piece) { send_record(piece, p); });
+    } else {
+      send_record(data, p);
+    }
+    data_resent++;
+  };
+  auto resend_seq = [&](std::size_t p) {
+    record_trace(trace::Kind::kSent, 3, process_id_, msg_id, S.final_seq,
+                 static_cast<uint32_t>(p));
+    send_record(seq, p);
+    seq_resent++;
+  };
+  if (state->stream) {
+    for (std::size_t p = 0; p < group_size_; p++) {
+      if (state->confirmed & (uint64_t{1} << p)) continue;
+      resend_data(p);
+    }
+  } else if (!state->sequenced) {
+    for (std::size_t p = 0; p < group_size_; p++) {
+      if (state->acked & (uint64_t{1} << p)) continue;
+      resend_data(p);
+    }
+  } else if (engine_->sender_collects_acks()) {
+    for (std::size_t p = 0; p < group_size_; p++) {
+      if (state->confirmed & (uint64_t{1} << p)) continue;
+      resend_seq(p);
+    }
+  } else {
+    // A host that has not confirmed may be missing the Data, the Seq or
+    // both. The sequence is only known here once the own Seq came back, and
+    // until then the sequencer is asked for it again with the Data.
+    bool known{state->final_seq != 0};
+    for (std::size_t p = 0; p < group_size_; p++) {
+      bool confirmed{(state->confirmed & (uint64_t{1} << p)) != 0};
+      if (!confirmed || (!known && p == config_.sequencer)) {
+        resend_data(p);
+      }
+      if (!confirmed && known) {
+        resend_seq(p);
+      }
+    }
+  }
+  data_retransmits_.fetch_add(data_resent, std::memory_order_relaxed);
+  seq_retransmits_.fetch_add(seq_resent, std::memory_order_relaxed);
+  SPDLOG_DEBUG("Retransmitted {} Data and {} Seq of message {}, attempt {}",
+               data_resent, seq_resent, msg_id, state->retransmits);
+  schedule_retransmit(shard, *state);
+}
+
+void Multicaster::handle_own_seq(Shard& shard, const messages::SeqMessage& S) {
+  if (closing_) return;
+  AckState* state = shard.acks.find(S.msg_id);
+  if (!state || state->final_seq) {
+    return;
+  }
+  state->final_seq = S.final_seq;
+  state->final_seq_proposer = S.final_seq_proposer;
+  if (state->multicast_at != std::chrono::steady_clock::time_point{}) {
+    state->sequenced_at = std::chrono::steady_clock::now();
+  }
+  if (!config_.retransmit) {
+    shard.acks.erase(S.msg_id);
+    confirmed(S.msg_id);
+  }
+  release_window_slot();
+}
+
+void Multicaster::handle_seq(const messages::SeqMessage& S) {
+  if (closing_) return;
+  PendingEntry* entry = pending_.find_entry(S.sender, S.msg_id);
+  messages::DataMessage* m = entry ? &entry->msg : nullptr;
+  if (!m && !seen_[S.sender].seen(S.msg_id)) {
+    // It overtook its Data, which takes another path from the sequencer,
+    // and is applied once that arrives. Unconfirmed until then, in case the
+    // Data was lost.
+    SPDLOG_DEBUG("Seq for unknown message {} from {}", S.msg_id, S.sender);
+    if (early_seqs_.size() < kMaxEarlySeqs) {
+      early_seqs_.emplace(message_key(S.sender, S.msg_id), S);
+    }
+    return;
+  }
+  bool first{m && !m->deliverable};
+  if (first) {
+    if (journal_) journal_->sequenced(S);
+    if (config_.latency_stats) {
+      entry->sequenced_at = std::chrono::steady_clock::now();
+    }
+    engine_->on_seq(m, S);
+    if (S.sender == process_id_ && !engine_->sender_collects_acks()) {
+      // Learn the sequence of an own message, before confirming it below
+      Shard& shard = ack_shard(S.msg_id);
+      run_on(shard.strand, [this, &shard, S]() { handle_own_seq(shard, S); });
+    }
+  } else {
+    // Already sequenced, or delivered and gone from the store
+    duplicate_seqs_.fetch_add(1, std::memory_order_relaxed);
+    SPDLOG_DEBUG("Dropping duplicate Seq {} from {}", S.msg_id, S.sender);
+  }
+
+  // Confirm even a repeated Seq, the sender evidently missed our SeqAck
+  send_seq_ack(S.sender, S.msg_id);
+  if (!first) {
+    return;
+  }
+  deliver_pending();
+  pending_depth_.store(pending_.size() + causal_.held(),
+                       std::memory_order_relaxed);
+  flush_deliveries();
+}
+
+void Multicaster::deliver_pending() {
+  if (catching_up_) {
+    // Live messages follow on from the last one caught up
+    return;
+  }
+  // The entry goes back to the pool once delivered, the payload buffer moves
+  // on with the delivery
+  std::chrono::steady_clock::time_point now{};
+  if (config_.latency_stats) {
+    now = std::chrono::steady_clock::now();
+  }
+  for (PendingStore::Handle delivered = engine_->pop_deliverable(); delivered;
+       delivered = engine_->pop_deliverable()) {
+    messages::DataMessage* m = &delivered->msg;
+    if (journal_) {
+      journal_->delivered(m->sender, m->msg_id, m->final_seq,
+                          m->final_seq_proposer, DeliveryOrder::kTotal);
+    }
+    if (history_) history_->append(*m);
+    delivered_seq_ = m->final_seq;
+    delivered_proposer_ = m->final_seq_proposer;
+    record_trace(trace::Kind::kDelivered, 1, m->sender, m->msg_id,
+                 m->final_seq, process_id_);
+    if (delivered->sequenced_at != std::chrono::steady_clock::time_point{}) {
+      seq_to_delivery_.record(now - delivered->sequenced_at);
+    }
+    SPDLOG_DEBUG("Delivering message with sequence {}", m->final_seq);
+    delivery_batch_.push_back(
+        Delivery{m->sender, m->msg_id, m->data, m->final_seq,
+                 m->final_seq_proposer,
+                 Payload{std::move(delivered->payload_buffer), m->payload,
+                         m->payload_size}});
+  }
+}
+
+void Multicaster::handle_stream(const messages::StreamMessage& M,
+                                BufferRef buffer) {
+  if (closing_) return;
+  check_epoch(M.sender, M.epoch);
+  switch (seen_[M.sender].check(M.msg_id)) {
+    case DuplicateWindow::Result::kNew: {
+      // Confirmed below, so a restart has to bring it back itself. On
+      // record before it counts as seen, and left unconfirmed without
+      // room, as for Data.
+      if (journal_ && !causal_.deliverable(M) && !journal_->held(M)) {
+        journal_full_.fetch_add(1, std::memory_order_relaxed);
+        SPDLOG_DEBUG("No room in the journal for message {} from {}",
+                     M.msg_id, M.sender);
+        return;
+      }
+      seen_[M.sender].insert(M.msg_id);
+      // Held back or delivered, kept past this handler either way. The
+      // payload follows the clock.
+      messages::StreamMessage kept{M};
+      std::size_t clock_bytes{std::size_t{M.clock_size} * sizeof(uint32_t)};
+      buffer = retain(buffer, kept.clock, clock_bytes + M.payload_size);
+      if (kept.payload) kept.payload = kept.clock + clock_bytes;
+      causal_.receive(kept, std::move(buffer),
+                      [this](const messages::StreamMessage& m,
+                             BufferRef payload_buffer) {
+                        SPDLOG_DEBUG("Delivering stream message {} from {}",
+                                     m.stream_seq, m.sender);
+                        record_trace(trace::Kind::kDelivered, 6, m.sender,
+                                     m.msg_id, m.stream_seq, process_id_);
+                        if (journal_) {
+                          journal_->delivered(
+                              m.sender, m.msg_id, m.stream_seq, m.sender,
+                              static_cast<DeliveryOrder>(m.order));
+                        }
+                        // Published before the sink sees it, so whatever the
+                        // application sends in response depends on it
+                        stream_delivered_[m.sender].store(
+                            causal_.delivered(m.sender),
+                            std::memory_order_release);
+                        delivery_batch_.push_back(Delivery{
+                            m.sender, m.msg_id, m.data, m.stream_seq,
+                            m.sender,
+                            Payload{std::move(payload_buffer), m.payload,
+                                    m.payload_size},
+                            static_cast<DeliveryOrder>(m.order)});
+                      });
+      break;
+    }
+    case DuplicateWindow::Result::kDuplicate:
+      duplicate_data_.fetch_add(1, std::memory_order_relaxed);
+      SPDLOG_DEBUG("Dropping duplicate stream message {} from {}", M.msg_id,
+                   M.sender);
+      break;
+    case DuplicateWindow::Result::kAhead:
+      // Unconfirmed, so the sender retransmits it once the window has moved
+      data_ahead_.fetch_add(1, std::memory_order_relaxed);
+      SPDLOG_DEBUG("Message {} from {} is ahead of the duplicate window",
+                   M.msg_id, M.sender);
+      return;
+  }
+  // Held back or not, the message is here for good
+  send_seq_ack(M.sender, M.msg_id);
+  pending_depth_.store(pending_.size() + causal_.held(),
+                       std::memory_order_relaxed);
+  flush_deliveries();
+}
+
+void Multicaster::catch_up(uint32_t peer) {
+  if (peer >= group_size_ || peer == process_id_) {
+    throw std::runtime_error("Can only catch up from another host");
+  }
+  // Raised right away, so nothing live is delivered before the request
+  // goes out
+  catching_up_ = true;
+  boost::asio::post(order_strand_, [this, peer]() {
+    if (closing_) return;
+    spdlog::info("Catching up from {} after sequence {}", peer,
+                 delivered_seq_);
+    catching_up_ = true;
+    catchup_peer_ = peer;
+    catchup_progress_ = false;
+    send_catchup_request();
+    arm_catchup_timer();
+  });
+}
+
+void Multicaster::send_catchup_request() {
+  messages::CatchupRequestMessage R{process_id_, delivered_seq_,
+                                    delivered_proposer_};
+  char request_buf
+      [messages::codec::WireLayout<messages::CatchupRequestMessage>::kSize];
+  std::size_t request_len = R.encode(request_buf, sizeof(request_buf));
+  send_record(Segments{boost::asio::buffer(request_buf, request_len),
+                       boost::asio::const_buffer{}},
+              catchup_peer_);
+}
+
+void Multicaster::arm_catchup_timer() {
+  catchup_timer_.expires_after(config_.catchup_timeout);
+  catchup_timer_.async_wait(boost::asio::bind_executor(
+      order_strand_, [this](const boost::system::error_code& error) {
+        if (error || closing_ || !catching_up_) return;
+        if (!catchup_progress_) {
+          // The request or a batch got lost
+          SPDLOG_DEBUG("Asking {} again for what follows sequence {}",
+                       catchup_peer_, delivered_seq_);
+          send_catchup_request();
+        }
+        catchup_progress_ = false;
+        arm_catchup_timer();
+      }));
+}
+
+void Multicaster::handle_catchup(messages::CatchupReader& batch,
+                                 BufferRef buffer) {
+  if (closing_) return;
+  if (!catching_up_ || batch.responder() != catchup_peer_ ||
+      batch.after_seq() != delivered_seq_ ||
+      batch.after_proposer() != delivered_proposer_) {
+    // Stale, or a batch before it was lost and is asked for again
+    SPDLOG_DEBUG("Dropping catch-up batch after sequence {} from {}",
+                 batch.after_seq(), batch.responder());
+    return;
+  }
+  catchup_progress_ = true;
+  if (batch.status() == messages::CatchupBuilder::kGone) {
+    spdlog::warn("Process {} no longer has the messages after sequence {}",
+                 catchup_peer_, delivered_seq_);
+    catching_up_ = false;
+    catchup_timer_.cancel();
+    deliver_pending();
+    flush_deliveries();
+    return;
+  }
+  messages::DataMessage m{0, 0, 0};
+  std::size_t applied{};
+  while (batch.next(m)) {
+    if (m.sender != process_id_ && !sender_epoch_[m.sender]) {
+      check_epoch(m.sender, m.epoch);
+    }
+    uint32_t known{m.sender == process_id_ ? epoch_ : sender_epoch_[m.sender]};
+    // One of an earlier incarnation of its sender, such as our own from
+    // before we restarted without a journal, shares its id with one of the
+    // current incarnation and is left out of the window
+    if (!m.epoch || m.epoch == known) {
+      // Whatever arrived of it live is superseded
+      pending_.remove(m.sender, m.msg_id);
+      // A window too far behind to record it, as that of a node that was
+      // never there, starts over from the first message it is caught up on
+      DuplicateWindow& window = seen_[m.sender];
+      if (window.insert(m.msg_id) == DuplicateWindow::Result::kAhead) {
+        window = DuplicateWindow{config_.duplicate_window, m.msg_id};
+        window.insert(m.msg_id);
+      }
+    }
+    if (journal_) {
+      journal_->delivered(m.sender, m.msg_id, m.final_seq,
+                          m.final_seq_proposer, DeliveryOrder::kTotal);
+    }
+    if (history_) history_->append(m);
+    delivered_seq_ = m.final_seq;
+    delivered_proposer_ = m.final_seq_proposer;
+    record_trace(trace::Kind::kDelivered, 1, m.sender, m.msg_id, m.final_seq,
+                 process_id_);
+    BufferRef payload_buffer{retain(buffer, m.payload, m.payload_size)};
+    delivery_batch_.push_back(
+        Delivery{m.sender, m.msg_id, m.data, m.final_seq,
+                 m.final_seq_proposer,
+                 Payload{std::move(payload_buffer), m.payload,
+                         m.payload_size}});
+    applied++;
+  }
+  caught_up_ += applied;
+  flush_deliveries();
+  pending_depth_.store(pending_.size() + causal_.held(),
+                       std::memory_order_relaxed);
+  switch (batch.status()) {
+    case messages::CatchupBuilder::kPartial:
+      send_catchup_request();
+      break;
+    case messages::CatchupBuilder::kDone:
+      finish_catch_up();
+      break;
+    default:
+      break;
+  }
+}
+
+bool Multicaster::valid_catchup(
+    const messages::CatchupReader& batch) const {
+  messages::CatchupReader check{batch};
+  messages::DataMessage m{0, 0, 0};
+  try {
+    while (check.next(m)) {
+      if (m.sender >= group_size_) return false;
     }
+  } catch (const std::runtime_error& e) {
+    return false;
   }
+  return true;
+}
 
-  start_receive();
+void Multicaster::finish_catch_up() {
+  spdlog::info("Caught up from {} to sequence {}", catchup_peer_,
+               delivered_seq_);
+  catching_up_ = false;
+  catchup_timer_.cancel();
+  // Proposals and sequencing carry on past the messages caught up
+  engine_->restore(delivered_seq_, delivered_seq_);
+  deliver_pending();
+  pending_depth_.store(pending_.size() + causal_.held(),
+                       std::memory_order_relaxed);
+  flush_deliveries();
 }
 
-void Multicaster::send_single(boost::asio::mutable_buffer message, int hostnum) {
-  udp::resolver resolver{io_context_};
-  udp::endpoint receiver_endpoint =
-      *resolver.resolve(udp::v4(), hosts_[hostnum], port_).begin();
-  socket_.async_send_to(
-      message, receiver_endpoint,
-      boost::bind(&Multicaster::handle_send, this, message,
-                  boost::asio::placeholders::error,
-                  boost::asio::placeholders::bytes_transferred));
-  spdlog::info("Sent message to {}", hosts_[hostnum]);
+void Multicaster::handle_catchup_request(
+    const messages::CatchupRequestMessage& R) {
+  if (closing_) return;
+  CatchupSession& session = catchup_sessions_[R.requester];
+  bool serving{session.batches != 0};
+  session = CatchupSession{R.after_seq, R.after_proposer,
+                           std::max<std::size_t>(1, config_.catchup_window)};
+  if (!serving) {
+    serve_catchup(R.requester);
+  }
 }
 
-void Multicaster::send_multi(boost::asio::mutable_buffer message) {
-  udp::resolver resolver{io_context_};
-  udp::endpoint receiver_endpoint{};
-  for (auto host : hosts_) {
-    receiver_endpoint = *resolver.resolve(udp::v4(), host, port_).begin();
-    socket_.async_send_to(
-        message, receiver_endpoint,
-        boost::bind(&Multicaster::handle_send, this, message,
-                    boost::asio::placeholders::error,
-                    boost::asio::placeholders::bytes_transferred));
+void Multicaster::serve_catchup(uint32_t requester) {
+  if (closing_) return;
+  CatchupSession& session = catchup_sessions_[requester];
+  catchup_batch_.start(process_id_, session.seq, session.proposer);
+  messages::CatchupBuilder::Status status{messages::CatchupBuilder::kGone};
+  if (history_) {
+    status = history_->fill(session.seq, session.proposer, catchup_batch_);
+  }
+  if (status == messages::CatchupBuilder::kMore && session.batches == 1) {
+    status = messages::CatchupBuilder::kPartial;
+  }
+  catchup_batch_.set_status(status);
+  SPDLOG_DEBUG("Sending {} messages after sequence {} to {}",
+               catchup_batch_.count(), session.seq, requester);
+  session.seq = catchup_batch_.last_seq();
+  session.proposer = catchup_batch_.last_proposer();
+  session.batches =
+      status == messages::CatchupBuilder::kMore ? session.batches - 1 : 0;
+
+  // Straight to the transport, a batch is too large for a frame
+  count(sent_, catchup_batch_.data(), catchup_batch_.size());
+  {
+    std::lock_guard<std::mutex> lock{send_mutex_};
+    transport_->send(
+        Segments{boost::asio::buffer(catchup_batch_.data(),
+                                     catchup_batch_.size()),
+                 boost::asio::const_buffer{}},
+        requester);
+  }
+  if (session.batches) {
+    // One batch per step, so live traffic gets through in between
+    boost::asio::post(catchup_strand_,
+                      [this, requester]() { serve_catchup(requester); });
   }
-  spdlog::info("Message successfully multicast");
-}
\ No newline at end of file
+}
+
+void Multicaster::send_seq_ack(uint32_t sender, uint32_t msg_id) {
+  messages::SeqAckMessage SA{sender, msg_id, process_id_};
+  char seq_ack_buf[messages::codec::WireLayout<messages::SeqAckMessage>::kSize];
+  std::size_t seq_ack_len = SA.encode(seq_ack_buf, sizeof(seq_ack_buf));
+  record_trace(trace::Kind::kSent, 5, sender, msg_id, 0, sender);
+  send_record(Segments{boost::asio::buffer(seq_ack_buf, seq_ack_len),
+                       boost::asio::const_buffer{}},
+              sender);
+}
+
+StatsSnapshot Multicaster::stats() const {
+  auto counts = [](const std::array<std::atomic<uint64_t>, kMessageTypes>& c) {
+    return MessageCounts{c[1].load(std::memory_order_relaxed),
+                         c[2].load(std::memory_order_relaxed),
+                         c[3].load(std::memory_order_relaxed),
+                         c[5].load(std::memory_order_relaxed),
+                         c[6].load(std::memory_order_relaxed)};
+  };
+  StatsSnapshot snapshot{};
+  snapshot.sent = counts(sent_);
+  snapshot.received = counts(received_);
+  snapshot.delivered = delivered_.load(std::memory_order_relaxed);
+  snapshot.in_flight = in_flight_.load(std::memory_order_relaxed);
+  snapshot.pending = pending_depth_.load(std::memory_order_relaxed);
+  snapshot.retransmits = retransmit_stats();
+  snapshot.duplicates = duplicate_stats();
+  snapshot.data_to_acks = data_to_acks_.snapshot();
+  snapshot.acks_to_seq = acks_to_seq_.snapshot();
+  snapshot.seq_to_delivery = seq_to_delivery_.snapshot();
+  return snapshot;
+}
+
+void Multicaster::count(
+    std::array<std::atomic<uint64_t>, kMessageTypes>& counts, const char* buf,
+    std::size_t len) {
+  uint32_t type{messages::codec::peek_type(buf, len)};
+  if (type < kMessageTypes) {
+    counts[type].fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+void Multicaster::flush_deliveries() {
+  if (delivery_batch_.empty()) {
+    return;
+  }
+  delivered_ += delivery_batch_.size();
+  if (sink_) {
+    sink_->deliver(delivery_batch_.data(), delivery_batch_.size());
+  }
+  delivery_batch_.clear();
+  journal_room_made();
+}
+
+void Multicaster::send_multi(const Segments& message) {
+  for (std::size_t hostnum = 0; hostnum < group_size_; hostnum++) {
+    outgoing_.push_back(Outgoing{message, hostnum});
+  }
+  transport_->send(outgoing_.data(), outgoing_.size());
+  outgoing_.clear();
+  SPDLOG_TRACE("Message successfully multicast");
+}
+
+void Multicaster::send_record(const Segments& message, std::size_t hostnum) {
+  count(sent_, static_cast<const char*>(message[0].data()),
+        message[0].size());
+  std::lock_guard<std::mutex> lock{send_mutex_};
+  append_record(message, hostnum);
+}
+
+void Multicaster::append_record(const Segments& message,
+                                std::size_t hostnum) {
+  if (!config_.batch_max_bytes) {
+    transport_->send(message, hostnum);
+    return;
+  }
+  if (!outbox_[hostnum].fits(segments_size(message))) {
+    flush(hostnum);
+  }
+  if (!outbox_[hostnum].append(message[0].data(), message[0].size(),
+                               message[1].data(), message[1].size())) {
+    // Too large for any frame
+    transport_->send(message, hostnum);
+    return;
+  }
+  if (outbox_[hostnum].size() + messages::FrameBuilder::kRecordHeaderSize >=
+      frame_size_) {
+    flush(hostnum);
+  } else if (!flush_pending_) {
+    flush_pending_ = true;
+    flush_timer_.expires_after(config_.batch_delay);
+    flush_timer_.async_wait([this](const boost::system::error_code& error) {
+      if (error || closing_) return;
+      std::lock_guard<std::mutex> lock{send_mutex_};
+      flush_pending_ = false;
+      flush_all();
+    });
+  }
+}
+
+void Multicaster::send_record_multi(const Segments& message) {
+  count(sent_, static_cast<const char*>(message[0].data()),
+        message[0].size());
+  std::lock_guard<std::mutex> lock{send_mutex_};
+  if (transport_->has_group()) {
+    append_record(message, group_size_);
+    return;
+  }
+  if (!config_.batch_max_bytes) {
+    send_multi(message);
+    return;
+  }
+  for (std::size_t hostnum = 0; hostnum < group_size_; hostnum++) {
+    append_record(message, hostnum);
+  }
+}
+
+void Multicaster::flush(std::size_t hostnum) {
+  if (outbox_[hostnum].empty()) {
+    return;
+  }
+  SPDLOG_TRACE("Flushing frame of {} messages to {}",
+               outbox_[hostnum].count(), hostnum);
+  transport_->send(Segments{boost::asio::buffer(outbox_[hostnum].data(),
+                                                outbox_[hostnum].size()),
+                            boost::asio::const_buffer{}},
+                   hostnum);
+  outbox_[hostnum].clear();
+}
+
+void Multicaster::flush_all() {
+  for (std::size_t hostnum = 0; hostnum < outbox_.size(); hostnum++) {
+    if (outbox_[hostnum].empty()) continue;
+    outgoing_.push_back(
+        Outgoing{Segments{boost::asio::buffer(outbox_[hostnum].data(),
+                                              outbox_[hostnum].size()),
+                          boost::asio::const_buffer{}},
+                 hostnum});
+  }
+  // Every frame is copied or sent by the time this returns
+  transport_->send(outgoing_.data(), outgoing_.size());
+  outgoing_.clear();
+  for (auto& frame : outbox_) {
+    frame.clear();
+  }
+}
@@ -0,0 +1,144 @@
+#include "ordering.hpp"
+
+#include <algorithm>
+
+#include <spdlog/spdlog.h>
+
+using namespace multicast;
+
+namespace {
+std::size_t next_power_of_2(std::size_t n) {
+  std::size_t p{1};
+  while (p < n) p <<= 1;
+  return p;
+}
+}  // namespace
+
+void IsisEngine::on_data(const messages::DataMessage& D, BufferRef buffer) {
+  // Propose one past anything this process has agreed on or proposed
+  messages::DataMessage proposed{D};
+  proposed.final_seq = std::max(last_seq_received_, last_seq_proposed_) + 1;
+  proposed.final_seq_proposer = process_id_;
+  messages::DataMessage* M = pending_.insert(proposed, std::move(buffer));
+  if (!M) return;
+  last_seq_proposed_ = M->final_seq;
+  SPDLOG_DEBUG("Added M to queue");
+  output_.send_ack(
+      messages::AckMessage{M->sender, M->msg_id, M->final_seq, process_id_});
+}
+
+void IsisEngine::on_duplicate_data(const messages::DataMessage& D,
+                                   messages::DataMessage* pending) {
+  // Until the Seq is in the sender is missing our ack, so repeat the
+  // proposal already made. Once it is, there is nothing to resend.
+  if (!pending || pending->deliverable) {
+    SPDLOG_DEBUG("Dropping duplicate message {} from {}", D.msg_id, D.sender);
+    return;
+  }
+  SPDLOG_DEBUG("Re-acking message {} from {}", D.msg_id, D.sender);
+  output_.send_ack(messages::AckMessage{pending->sender, pending->msg_id,
+                                        pending->final_seq, process_id_});
+}
+
+void IsisEngine::on_seq(messages::DataMessage* m,
+                        const messages::SeqMessage& S) {
+  // mark as deliverable and move to its final position
+  SPDLOG_DEBUG("Marking message deliverable");
+  pending_.reorder(m, S.final_seq, S.final_seq_proposer, true);
+  last_seq_received_ = std::max(last_seq_received_, S.final_seq);
+  SPDLOG_DEBUG("Updated last_seq_received to {}", last_seq_received_);
+}
+
+void IsisEngine::restore(uint32_t highest_seq, uint32_t) {
+  // Proposals must keep growing past anything handed out before
+  last_seq_received_ = std::max(last_seq_received_, highest_seq);
+  last_seq_proposed_ = std::max(last_seq_proposed_, highest_seq);
+}
+
+PendingStore::Handle IsisEngine::pop_deliverable() {
+  // Deliver from the head for as long as it is final
+  if (!pending_.deliverable_head()) {
+    return PendingStore::Handle{};
+  }
+  return pending_.pop_head();
+}
+
+SequencerEngine::SequencerEngine(PendingStore& pending, OrderingOutput& output,
+                                 uint32_t process_id, uint32_t sequencer,
+                                 std::size_t hosts, std::size_t history)
+    : OrderingEngine{pending, output, process_id}, sequencer_{sequencer} {
+  if (is_sequencer()) {
+    std::size_t size{next_power_of_2(history)};
+    history_.assign(hosts, std::vector<Assignment>(size, Assignment{}));
+    history_mask_ = size - 1;
+  }
+}
+
+void SequencerEngine::on_data(const messages::DataMessage& D,
+                              BufferRef buffer) {
+  messages::DataMessage unordered{D};
+  unordered.final_seq = PendingStore::kUnordered;
+  unordered.final_seq_proposer = sequencer_;
+  if (!pending_.insert(unordered, std::move(buffer))) return;
+  SPDLOG_DEBUG("Added M to queue");
+  if (!is_sequencer()) return;
+
+  uint32_t seq{next_assigned_++};
+  history_[D.sender][D.msg_id & history_mask_] = Assignment{D.msg_id, seq};
+  SPDLOG_DEBUG("Sequenced message {} from {} as {}", D.msg_id, D.sender,
+               seq);
+  output_.send_seq_all(
+      messages::SeqMessage{D.sender, D.msg_id, seq, sequencer_});
+}
+
+void SequencerEngine::on_duplicate_data(const messages::DataMessage& D,
+                                        messages::DataMessage* pending) {
+  if (!is_sequencer()) {
+    SPDLOG_DEBUG("Dropping duplicate message {} from {}", D.msg_id, D.sender);
+    return;
+  }
+  // The sender retransmits to the sequencer when it never saw its Seq
+  const Assignment& assigned = history_[D.sender][D.msg_id & history_mask_];
+  if (pending && pending->deliverable &&
+      (!assigned.seq || assigned.msg_id != D.msg_id)) {
+    // Sequenced before a restart, which the history does not survive
+    output_.send_seq(messages::SeqMessage{D.sender, D.msg_id,
+                                          pending->final_seq, sequencer_},
+                     D.sender);
+    return;
+  }
+  if (!assigned.seq || assigned.msg_id != D.msg_id) {
+    SPDLOG_WARN("Sequence of message {} from {} no longer known", D.msg_id,
+                D.sender);
+    return;
+  }
+  SPDLOG_DEBUG("Resending sequence of message {} to {}", D.msg_id, D.sender);
+  output_.send_seq(
+      messages::SeqMessage{D.sender, D.msg_id, assigned.seq, sequencer_},
+      D.sender);
+}
+
+void SequencerEngine::on_seq(messages::DataMessage* m,
+                             const messages::SeqMessage& S) {
+  SPDLOG_DEBUG("Marking message deliverable");
+  pending_.reorder(m, S.final_seq, S.final_seq_proposer, true);
+}
+
+PendingStore::Handle SequencerEngine::pop_deliverable() {
+  messages::DataMessage* head = pending_.deliverable_head();
+  if (!head || head->final_seq != next_delivered_) {
+    // Waiting for the message numbered next_delivered_
+    return PendingStore::Handle{};
+  }
+  next_delivered_++;
+  return pending_.pop_head();
+}
+
+void SequencerEngine::restore(uint32_t highest_seq, uint32_t delivered_seq) {
+  next_delivered_ = std::max(next_delivered_, delivered_seq + 1);
+  if (is_sequencer()) {
+    // Only numbers of messages still pending can be resent from here on,
+    // see on_duplicate_data()
+    next_assigned_ = std::max(next_assigned_, highest_seq + 1);
+  }
+}
@@ -0,0 +1,108 @@
+#include "peers.hpp"
+
+#include <algorithm>
+
+#include <spdlog/spdlog.h>
+
+using namespace multicast;
+using boost::asio::ip::udp;
+
+constexpr std::chrono::milliseconds PeerDirectory::kRetryDelay;
+constexpr std::size_t PeerDirectory::kMaxResolverThreads;
+
+PeerDirectory::PeerDirectory(boost::asio::io_context& io_context,
+                             const std::vector<std::string>& hosts,
+                             const std::string& port,
+                             std::chrono::milliseconds refresh_interval)
+    : io_context_{io_context},
+      port_{port},
+      refresh_interval_{refresh_interval},
+      unresolved_{hosts.size()},
+      alive_{std::make_shared<bool>(true)},
+      resolver_pool_{std::max<std::size_t>(
+          1, std::min(hosts.size(), kMaxResolverThreads))} {
+  peers_.reserve(hosts.size());
+  for (auto& host : hosts) {
+    peers_.emplace_back(io_context_, host);
+  }
+}
+
+PeerDirectory::~PeerDirectory() {
+  alive_.reset();
+  for (auto& peer : peers_) {
+    peer.timer.cancel();
+  }
+  resolver_pool_.join();
+}
+
+void PeerDirectory::start(ResolveHandler on_resolved) {
+  on_resolved_ = std::move(on_resolved);
+  for (std::size_t peer = 0; peer < peers_.size(); peer++) {
+    resolve(peer);
+  }
+}
+
+void PeerDirectory::resolve(std::size_t peer) {
+  std::weak_ptr<bool> alive{alive_};
+  std::string host{peers_[peer].host};
+  std::string port{port_};
+  // Counts as outstanding work on io_context_ until the result is posted back
+  auto work = boost::asio::make_work_guard(io_context_);
+  boost::asio::post(resolver_pool_, [this, alive, peer, host, port, work]() {
+    // Blocking lookup on a pool thread, one per host in flight.
+    boost::asio::io_context lookup_context{};
+    udp::resolver resolver{lookup_context};
+    boost::system::error_code error{};
+    udp::endpoint endpoint{};
+    auto results = resolver.resolve(udp::v4(), host, port, error);
+    if (!error) {
+      endpoint = *results.begin();
+    }
+    boost::asio::post(io_context_, [this, alive, peer, error, endpoint]() {
+      if (alive.expired()) return;
+      handle_resolve(peer, error, endpoint);
+    });
+  });
+}
+
+void PeerDirectory::handle_resolve(std::size_t peer,
+                                   const boost::system::error_code& error,
+                                   const udp::endpoint& endpoint) {
+  Peer& p = peers_[peer];
+  if (error) {
+    spdlog::error("Unable to resolve {}: {}", p.host, error.message());
+    schedule(peer, p.resolved ? std::max(refresh_interval_, kRetryDelay)
+                              : kRetryDelay);
+    return;
+  }
+
+  bool first{};
+  bool changed{};
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    first = !p.resolved;
+    changed = first || p.endpoint != endpoint;
+    p.endpoint = endpoint;
+    p.resolved = true;
+    if (first) unresolved_--;
+  }
+  if (changed) {
+    spdlog::info("Resolved {} to {}", p.host, endpoint.address().to_string());
+  }
+  if (first && on_resolved_) on_resolved_(peer);
+
+  if (refresh_interval_.count() > 0) {
+    schedule(peer, refresh_interval_);
+  }
+}
+
+void PeerDirectory::schedule(std::size_t peer,
+                             std::chrono::milliseconds delay) {
+  std::weak_ptr<bool> alive{alive_};
+  peers_[peer].timer.expires_after(delay);
+  peers_[peer].timer.async_wait(
+      [this, alive, peer](const boost::system::error_code& error) {
+        if (error || alive.expired()) return;
+        resolve(peer);
+      });
+}
@@ -0,0 +1,117 @@
+#include "pending.hpp"
+
+using namespace multicast;
+
+constexpr uint32_t PendingStore::kUnordered;
+
+namespace {
+std::size_t next_power_of_2(std::size_t n) {
+  std::size_t p{1};
+  while (p < n) p <<= 1;
+  return p;
+}
+}  // namespace
+
+PendingStore::PendingStore(MessagePool& pool, std::size_t capacity_hint)
+    : pool_{pool},
+      buckets_(next_power_of_2(capacity_hint)),
+      index_{Index::bucket_traits(buckets_.data(), buckets_.size())},
+      order_{OrdersAfter{}, [capacity_hint]() {
+               std::vector<HeapNode> nodes{};
+               nodes.reserve(2 * capacity_hint);
+               return nodes;
+             }()} {
+  pool_.reserve(capacity_hint);
+}
+
+PendingStore::~PendingStore() {
+  index_.clear_and_dispose([this](PendingEntry* entry) { pool_.adopt(entry); });
+}
+
+messages::DataMessage* PendingStore::insert(const messages::DataMessage& msg,
+                                            BufferRef payload_buffer) {
+  if (find(msg.sender, msg.msg_id)) {
+    return nullptr;
+  }
+  if (index_.size() >= buckets_.size()) {
+    grow_index();
+  }
+  PendingEntry* entry = pool_.acquire(msg, std::move(payload_buffer)).release();
+  index_.insert(*entry);
+  if (entry->msg.final_seq != kUnordered) {
+    order_.push(HeapNode{entry->msg.final_seq, entry->msg.final_seq_proposer,
+                         entry->key});
+  }
+  return &entry->msg;
+}
+
+messages::DataMessage* PendingStore::find(uint32_t sender, uint32_t msg_id) {
+  auto it = index_.find(MessageKey{sender, msg_id});
+  return it == index_.end() ? nullptr : &it->msg;
+}
+
+PendingEntry* PendingStore::find_entry(uint32_t sender, uint32_t msg_id) {
+  auto it = index_.find(MessageKey{sender, msg_id});
+  return it == index_.end() ? nullptr : &*it;
+}
+
+void PendingStore::reorder(messages::DataMessage* msg, uint32_t seq,
+                           uint32_t proposer, bool deliverable) {
+  msg->deliverable = deliverable;
+  if (msg->final_seq == seq && msg->final_seq_proposer == proposer) {
+    return;
+  }
+  msg->final_seq = seq;
+  msg->final_seq_proposer = proposer;
+  order_.push(HeapNode{seq, proposer, MessageKey{msg->sender, msg->msg_id}});
+}
+
+messages::DataMessage* PendingStore::deliverable_head() {
+  discard_stale();
+  if (order_.empty()) {
+    return nullptr;
+  }
+  messages::DataMessage* m = find(order_.top().key.sender,
+                                  order_.top().key.msg_id);
+  return m->deliverable ? m : nullptr;
+}
+
+PendingStore::Handle PendingStore::pop_head() {
+  discard_stale();
+  if (order_.empty()) {
+    return Handle{};
+  }
+  auto it = index_.find(order_.top().key);
+  order_.pop();
+  PendingEntry& entry = *it;
+  index_.erase(it);
+  return pool_.adopt(&entry);
+}
+
+PendingStore::Handle PendingStore::remove(uint32_t sender, uint32_t msg_id) {
+  auto it = index_.find(MessageKey{sender, msg_id});
+  if (it == index_.end()) {
+    return Handle{};
+  }
+  PendingEntry& entry = *it;
+  index_.erase(it);
+  return pool_.adopt(&entry);
+}
+
+void PendingStore::discard_stale() {
+  while (!order_.empty()) {
+    const HeapNode& node = order_.top();
+    messages::DataMessage* m = find(node.key.sender, node.key.msg_id);
+    if (m && m->final_seq == node.seq &&
+        m->final_seq_proposer == node.proposer) {
+      return;
+    }
+    order_.pop();
+  }
+}
+
+void PendingStore::grow_index() {
+  std::vector<Index::bucket_type> buckets(2 * buckets_.size());
+  index_.rehash(Index::bucket_traits(buckets.data(), buckets.size()));
+  buckets_.swap(buckets);
+}
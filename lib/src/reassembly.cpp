@@ -0,0 +1,82 @@
+#include "reassembly.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+using namespace multicast;
+
+Reassembler::Reassembler(BufferPool& pool, std::size_t senders,
+                         std::size_t slots)
+    : pool_{pool},
+      slots_(senders, std::vector<Slot>(std::max<std::size_t>(1, slots))) {}
+
+bool Reassembler::add(const messages::FragmentMessage& fragment,
+                      BufferRef& buffer) {
+  if (fragment.sender >= slots_.size()) {
+    throw std::runtime_error("Fragment from unknown sender");
+  }
+  if (fragment.size > pool_.buffer_size() || !fragment.count ||
+      fragment.count > fragment.size || fragment.index >= fragment.count ||
+      fragment.offset > fragment.size ||
+      fragment.bytes_size > fragment.size - fragment.offset) {
+    throw std::runtime_error("Fragment outside its message");
+  }
+
+  // The message's slot, or else a free one, or else the least recently used
+  Slot* slot{};
+  Slot* victim{};
+  for (Slot& candidate : slots_[fragment.sender]) {
+    if (candidate.buffer && candidate.msg_id == fragment.msg_id) {
+      slot = &candidate;
+      break;
+    }
+    if (!victim || (victim->buffer && (!candidate.buffer ||
+                                       candidate.used < victim->used))) {
+      victim = &candidate;
+    }
+  }
+  if (!slot) {
+    if (victim->buffer) {
+      // Left for its sender to retransmit
+      evicted_++;
+    }
+    slot = victim;
+    slot->msg_id = fragment.msg_id;
+    slot->size = fragment.size;
+    slot->count = fragment.count;
+    slot->received = 0;
+    slot->buffer = pool_.acquire();
+    slot->have.assign((fragment.count + 63) / 64, 0);
+  } else if (slot->size != fragment.size || slot->count != fragment.count) {
+    throw std::runtime_error("Fragment disagrees with its message");
+  }
+  slot->used = ++clock_;
+
+  uint64_t& word = slot->have[fragment.index / 64];
+  uint64_t bit{uint64_t{1} << (fragment.index % 64)};
+  if (word & bit) {
+    return false;
+  }
+  word |= bit;
+  if (fragment.bytes_size) {
+    std::memcpy(slot->buffer->data() + fragment.offset, fragment.bytes,
+                fragment.bytes_size);
+  }
+  if (++slot->received < slot->count) {
+    return false;
+  }
+  // Frees the slot
+  buffer = std::move(slot->buffer);
+  return true;
+}
+
+std::size_t Reassembler::in_progress() const {
+  std::size_t count{};
+  for (const auto& slots : slots_) {
+    for (const Slot& slot : slots) {
+      if (slot.buffer) count++;
+    }
+  }
+  return count;
+}
@@ -0,0 +1,25 @@
+#include "rtt.hpp"
+
+#include <algorithm>
+
+using namespace multicast;
+
+RttEstimator::RttEstimator(Duration initial_rto, Duration min_rto,
+                           Duration max_rto)
+    : min_rto_{min_rto},
+      max_rto_{std::max(min_rto, max_rto)},
+      rto_{std::min(std::max(initial_rto, min_rto_), max_rto_)} {}
+
+void RttEstimator::sample(Duration rtt) {
+  if (rtt < Duration::zero()) rtt = Duration::zero();
+  if (samples_ == 0) {
+    srtt_ = rtt;
+    rttvar_ = rtt / 2;
+  } else {
+    Duration error{srtt_ > rtt ? srtt_ - rtt : rtt - srtt_};
+    rttvar_ += (error - rttvar_) / 4;
+    srtt_ += (rtt - srtt_) / 8;
+  }
+  samples_++;
+  rto_ = std::min(std::max(srtt_ + 4 * rttvar_, min_rto_), max_rto_);
+}
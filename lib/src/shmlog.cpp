@@ -0,0 +1,213 @@
+#include "shmlog.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <spdlog/spdlog.h>
+
+using namespace multicast;
+
+namespace {
+std::size_t next_power_of_2(std::size_t n) {
+  std::size_t p{1};
+  while (p < n) p <<= 1;
+  return p;
+}
+
+std::runtime_error system_failure(const std::string& what,
+                                  const std::string& path) {
+  return std::runtime_error{what + " " + path + ": " + std::strerror(errno)};
+}
+}  // namespace
+
+static_assert(sizeof(shmlog::Header) <= shmlog::kDataOffset,
+              "Header must fit before the data");
+static_assert(sizeof(shmlog::Record) % 8 == 0,
+              "Records must keep the ring 8 byte aligned");
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2,
+              "Cursors must be lock free to be shared between processes");
+
+ShmLogSink::ShmLogSink(const std::string& path, std::size_t capacity)
+    : path_{path},
+      capacity_{next_power_of_2(std::max<std::size_t>(capacity, 4096))},
+      mapped_size_{shmlog::kDataOffset + capacity_} {
+  int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    throw system_failure("Unable to create", path);
+  }
+  if (::ftruncate(fd, static_cast<off_t>(mapped_size_)) != 0) {
+    ::close(fd);
+    throw system_failure("Unable to size", path);
+  }
+  mapping_ = ::mmap(nullptr, mapped_size_, PROT_READ | PROT_WRITE, MAP_SHARED,
+                    fd, 0);
+  ::close(fd);
+  if (mapping_ == MAP_FAILED) {
+    mapping_ = nullptr;
+    throw system_failure("Unable to map", path);
+  }
+  header_ = new (mapping_) shmlog::Header{};
+  header_->version = shmlog::kVersion;
+  header_->capacity = capacity_;
+  data_ = static_cast<char*>(mapping_) + shmlog::kDataOffset;
+  // Readers only trust the header once the magic is there
+  std::atomic_thread_fence(std::memory_order_release);
+  header_->magic = shmlog::kMagic;
+}
+
+ShmLogSink::~ShmLogSink() {
+  if (mapping_) ::munmap(mapping_, mapped_size_);
+}
+
+void ShmLogSink::deliver(Delivery* deliveries, std::size_t count) {
+  for (std::size_t i = 0; i < count; i++) {
+    const Delivery& delivery = deliveries[i];
+    std::size_t size{(sizeof(shmlog::Record) + delivery.payload.size + 7) &
+                     ~std::size_t{7}};
+    if (size > capacity_ / 2) {
+      SPDLOG_ERROR("Delivery {} from {} too large for the log, skipped",
+                   delivery.msg_id, delivery.sender);
+      continue;
+    }
+    shmlog::Record* record = reserve(size);
+    record->size = static_cast<uint32_t>(size);
+    record->type = shmlog::kDelivery;
+    record->index = records_++;
+    record->sender = delivery.sender;
+    record->msg_id = delivery.msg_id;
+    record->data = delivery.data;
+    record->final_seq = delivery.final_seq;
+    record->final_seq_proposer = delivery.final_seq_proposer;
+    record->payload_size = static_cast<uint32_t>(delivery.payload.size);
+    if (delivery.payload.size) {
+      std::memcpy(record + 1, delivery.payload.data, delivery.payload.size);
+    }
+  }
+  header_->records.store(records_, std::memory_order_relaxed);
+  header_->published.store(position_, std::memory_order_release);
+}
+
+shmlog::Record* ShmLogSink::reserve(std::size_t size) {
+  uint64_t mask{capacity_ - 1};
+  uint64_t offset{position_ & mask};
+  uint64_t end{position_ + size};
+  if (offset + size > capacity_) {
+    // Pad out the end of the ring and start the record at the beginning
+    end += capacity_ - offset;
+  }
+  // Retire the records about to be overwritten and tell readers before
+  // touching them
+  while (end - oldest_ > capacity_) {
+    oldest_ += reinterpret_cast<const shmlog::Record*>(data_ + (oldest_ & mask))
+                   ->size;
+  }
+  header_->oldest.store(oldest_, std::memory_order_relaxed);
+  header_->reserved.store(end, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  if (offset + size > capacity_) {
+    auto padding = reinterpret_cast<shmlog::Record*>(data_ + offset);
+    padding->size = static_cast<uint32_t>(capacity_ - offset);
+    padding->type = shmlog::kPadding;
+    position_ += capacity_ - offset;
+    offset = 0;
+  }
+  position_ += size;
+  return reinterpret_cast<shmlog::Record*>(data_ + offset);
+}
+
+ShmLogReader::ShmLogReader(const std::string& path, bool from_latest) {
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw system_failure("Unable to open", path);
+  }
+  struct stat status {};
+  if (::fstat(fd, &status) != 0) {
+    ::close(fd);
+    throw system_failure("Unable to stat", path);
+  }
+  mapped_size_ = static_cast<std::size_t>(status.st_size);
+  if (mapped_size_ < shmlog::kDataOffset) {
+    ::close(fd);
+    throw std::runtime_error{path + " is not a delivery log"};
+  }
+  mapping_ = ::mmap(nullptr, mapped_size_, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (mapping_ == MAP_FAILED) {
+    mapping_ = nullptr;
+    throw system_failure("Unable to map", path);
+  }
+  header_ = static_cast<const shmlog::Header*>(mapping_);
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if (header_->magic != shmlog::kMagic ||
+      header_->version != shmlog::kVersion ||
+      shmlog::kDataOffset + header_->capacity > mapped_size_) {
+    ::munmap(mapping_, mapped_size_);
+    throw std::runtime_error{path + " is not a delivery log"};
+  }
+  capacity_ = header_->capacity;
+  data_ = static_cast<const char*>(mapping_) + shmlog::kDataOffset;
+  if (from_latest) {
+    next_index_ = header_->records.load(std::memory_order_acquire);
+    position_ = header_->published.load(std::memory_order_acquire);
+  } else {
+    position_ = header_->oldest.load(std::memory_order_acquire);
+    next_index_ = UINT64_MAX;
+  }
+}
+
+ShmLogReader::~ShmLogReader() {
+  if (mapping_) ::munmap(mapping_, mapped_size_);
+}
+
+ShmLogReader::Status ShmLogReader::next(Entry& entry) {
+  while (true) {
+    uint64_t published{header_->published.load(std::memory_order_acquire)};
+    if (position_ == published) {
+      return Status::kEmpty;
+    }
+    auto record = reinterpret_cast<const shmlog::Record*>(
+        data_ + (position_ & (capacity_ - 1)));
+    uint32_t size{record->size};
+    uint32_t type{record->type};
+    uint64_t index{record->index};
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (header_->reserved.load(std::memory_order_relaxed) - position_ >
+            capacity_ ||
+        size < 8) {
+      // Overwritten while we were behind, carry on from the oldest record
+      position_ = header_->oldest.load(std::memory_order_acquire);
+      return Status::kLapped;
+    }
+    if (type == shmlog::kPadding) {
+      position_ += size;
+      continue;
+    }
+    if (next_index_ != UINT64_MAX && index > next_index_) {
+      lost_ += index - next_index_;
+    }
+    next_index_ = index + 1;
+    entry = Entry{record, reinterpret_cast<const char*>(record + 1),
+                  position_};
+    position_ += size;
+    return Status::kEntry;
+  }
+}
+
+bool ShmLogReader::valid(const Entry& entry) const {
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return header_->reserved.load(std::memory_order_relaxed) - entry.position <=
+         capacity_;
+}
+
+uint64_t ShmLogReader::published() const {
+  return header_->records.load(std::memory_order_acquire);
+}
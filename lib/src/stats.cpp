@@ -0,0 +1,128 @@
+#include "stats.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#include <spdlog/spdlog.h>
+
+using namespace multicast;
+using boost::asio::local::stream_protocol;
+
+namespace {
+constexpr char kUnixPrefix[]{"unix:"};
+
+void write_counts(std::ostream& out, const MessageCounts& counts) {
+  out << "{\"data\":" << counts.data << ",\"acks\":" << counts.acks
+      << ",\"seqs\":" << counts.seqs << ",\"seq_acks\":" << counts.seq_acks
+      << ",\"stream\":" << counts.stream << "}";
+}
+
+void write_histogram(std::ostream& out, const HistogramSnapshot& histogram) {
+  out << "{\"count\":" << histogram.count
+      << ",\"mean\":" << static_cast<uint64_t>(histogram.mean())
+      << ",\"min\":" << histogram.min
+      << ",\"p50\":" << histogram.percentile(0.5)
+      << ",\"p90\":" << histogram.percentile(0.9)
+      << ",\"p99\":" << histogram.percentile(0.99)
+      << ",\"p999\":" << histogram.percentile(0.999)
+      << ",\"max\":" << histogram.max << "}";
+}
+}  // namespace
+
+std::string multicast::to_json(const StatsSnapshot& snapshot) {
+  auto now = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::system_clock::now().time_since_epoch());
+  std::ostringstream out{};
+  out << "{\"time_ms\":" << now.count() << ",\"sent\":";
+  write_counts(out, snapshot.sent);
+  out << ",\"received\":";
+  write_counts(out, snapshot.received);
+  out << ",\"delivered\":" << snapshot.delivered
+      << ",\"in_flight\":" << snapshot.in_flight
+      << ",\"pending\":" << snapshot.pending
+      << ",\"acks_per_message\":" << snapshot.acks_per_message()
+      << ",\"retransmits\":{\"data\":" << snapshot.retransmits.data
+      << ",\"seq\":" << snapshot.retransmits.seq << "}"
+      << ",\"duplicates\":{\"data\":" << snapshot.duplicates.data
+      << ",\"acks\":" << snapshot.duplicates.acks
+      << ",\"seqs\":" << snapshot.duplicates.seqs
+      << ",\"ahead\":" << snapshot.duplicates.ahead
+      << ",\"journal_full\":" << snapshot.duplicates.journal_full << "}"
+      << ",\"latency_ns\":{\"data_to_acks\":";
+  write_histogram(out, snapshot.data_to_acks);
+  out << ",\"acks_to_seq\":";
+  write_histogram(out, snapshot.acks_to_seq);
+  out << ",\"seq_to_delivery\":";
+  write_histogram(out, snapshot.seq_to_delivery);
+  out << "}}";
+  return out.str();
+}
+
+StatsReporter::StatsReporter(Source source, const std::string& target,
+                             std::chrono::milliseconds interval)
+    : source_{std::move(source)}, interval_{interval} {
+  if (target.compare(0, sizeof(kUnixPrefix) - 1, kUnixPrefix) == 0) {
+    path_ = target.substr(sizeof(kUnixPrefix) - 1);
+    // A socket left behind by an earlier run would fail the bind
+    std::remove(path_.c_str());
+    acceptor_.reset(new stream_protocol::acceptor{
+        io_context_, stream_protocol::endpoint{path_}});
+    start_accept();
+  } else {
+    path_ = target;
+    start_timer();
+  }
+  thread_ = std::thread{[this]() { io_context_.run(); }};
+}
+
+StatsReporter::~StatsReporter() {
+  io_context_.stop();
+  thread_.join();
+  if (acceptor_) {
+    std::remove(path_.c_str());
+  }
+}
+
+void StatsReporter::start_accept() {
+  auto socket = std::make_shared<stream_protocol::socket>(io_context_);
+  acceptor_->async_accept(
+      *socket, [this, socket](const boost::system::error_code& error) {
+        if (error) {
+          if (error == boost::asio::error::operation_aborted) return;
+          spdlog::warn("Unable to accept stats client: {}", error.message());
+        } else {
+          auto json = std::make_shared<std::string>(to_json(source_()));
+          json->push_back('\n');
+          boost::asio::async_write(
+              *socket, boost::asio::buffer(*json),
+              [socket, json](const boost::system::error_code&, std::size_t) {
+                // Closed once the last reference goes
+              });
+        }
+        start_accept();
+      });
+}
+
+void StatsReporter::start_timer() {
+  write_file();
+  timer_.expires_after(interval_);
+  timer_.async_wait([this](const boost::system::error_code& error) {
+    if (!error) start_timer();
+  });
+}
+
+void StatsReporter::write_file() {
+  std::string tmp{path_ + ".tmp"};
+  {
+    std::ofstream out{tmp, std::ios_base::trunc};
+    out << to_json(source_()) << '\n';
+    if (!out) {
+      spdlog::warn("Unable to write stats to {}", tmp);
+      return;
+    }
+  }
+  if (std::rename(tmp.c_str(), path_.c_str()) != 0) {
+    spdlog::warn("Unable to move stats into {}", path_);
+  }
+}
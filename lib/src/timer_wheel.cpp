@@ -0,0 +1,41 @@
+#include "timer_wheel.hpp"
+
+#include <stdexcept>
+
+using namespace multicast;
+
+namespace {
+std::size_t next_power_of_2(std::size_t n) {
+  std::size_t p{1};
+  while (p < n) p <<= 1;
+  return p;
+}
+}  // namespace
+
+TimingWheel::TimingWheel(Clock::duration tick, std::size_t slots,
+                         Clock::time_point start)
+    : tick_{tick},
+      start_{start},
+      slots_(next_power_of_2(slots)),
+      mask_{slots_.size() - 1} {
+  if (tick_ <= Clock::duration::zero()) {
+    throw std::runtime_error("Timing wheel tick must be positive");
+  }
+}
+
+uint64_t TimingWheel::schedule(uint32_t id, Clock::duration delay,
+                               Clock::time_point now) {
+  // Round up so a timer never fires before its delay has passed
+  Clock::time_point due{now + delay};
+  uint64_t tick{tick_of(due)};
+  if (start_ + static_cast<Clock::rep>(tick) * tick_ < due) tick++;
+  if (tick <= current_) tick = current_ + 1;
+  slots_[tick & mask_].push_back(Timer{tick, id});
+  size_++;
+  return tick;
+}
+
+uint64_t TimingWheel::tick_of(Clock::time_point time) const {
+  if (time <= start_) return 0;
+  return static_cast<uint64_t>((time - start_) / tick_);
+}
@@ -0,0 +1,248 @@
+#include "trace.hpp"
+
+#include <algorithm>
+#include <map>
+#include <stdexcept>
+
+using namespace multicast;
+
+namespace {
+std::size_t next_power_of_2(std::size_t n) {
+  std::size_t p{64};
+  while (p < n) p <<= 1;
+  return p;
+}
+
+std::atomic<uint64_t> next_tracer_id{1};
+
+/**
+ * The rings this thread last recorded into, so that the common case finds
+ * its ring without a lock even with a few tracers in the process.
+ */
+struct RingCache {
+  static constexpr std::size_t kSize{4};
+  uint64_t ids[kSize]{};
+  void* rings[kSize]{};
+  std::size_t next{};
+};
+thread_local RingCache ring_cache{};
+}  // namespace
+
+std::pair<trace::FileHeader, std::vector<trace::Event>> trace::read_file(
+    const std::string& path) {
+  std::ifstream in{path, std::ios_base::binary};
+  if (!in) {
+    throw std::runtime_error("Unable to open trace file " + path);
+  }
+  FileHeader header{};
+  in.read(reinterpret_cast<char*>(&header), sizeof(header));
+  if (!in || header.magic != kMagic) {
+    throw std::runtime_error(path + " is not a trace file");
+  }
+  if (header.version != kVersion || header.event_size != sizeof(Event)) {
+    throw std::runtime_error("Unsupported trace file version in " + path);
+  }
+  std::vector<Event> events{};
+  Event event{};
+  while (in.read(reinterpret_cast<char*>(&event), sizeof(event))) {
+    events.push_back(event);
+  }
+  return {header, std::move(events)};
+}
+
+namespace {
+/**
+ * The first time of every step of one message, per host where it matters.
+ */
+struct Steps {
+  uint64_t sent{};
+  uint64_t seq_sent{};
+  uint32_t seq_node{};
+  std::vector<uint64_t> ack_times{};
+  std::map<uint32_t, uint64_t> data_received{};
+  std::map<uint32_t, uint64_t> seq_received{};
+  std::map<uint32_t, uint64_t> delivered{};
+};
+
+void first(std::map<uint32_t, uint64_t>& times, uint32_t node, uint64_t t) {
+  times.emplace(node, t);
+}
+
+int64_t between(uint64_t from, uint64_t to) {
+  return from && to ? static_cast<int64_t>(to - from) : trace::kMissing;
+}
+
+uint64_t at(const std::map<uint32_t, uint64_t>& times, uint32_t node) {
+  auto it = times.find(node);
+  return it == times.end() ? 0 : it->second;
+}
+}  // namespace
+
+std::vector<trace::CriticalPath> trace::critical_paths(
+    std::vector<Event>& events) {
+  std::stable_sort(
+      events.begin(), events.end(),
+      [](const Event& a, const Event& b) { return a.time_ns < b.time_ns; });
+  std::map<std::pair<uint32_t, uint32_t>, Steps> messages{};
+  for (const Event& e : events) {
+    Steps& steps = messages[{e.sender, e.msg_id}];
+    bool data{e.type == 1 || e.type == 6};
+    switch (e.kind) {
+      case Kind::kSent:
+        if (data && e.node == e.sender && !steps.sent) {
+          steps.sent = e.time_ns;
+        } else if (e.type == 3 && !steps.seq_sent) {
+          steps.seq_sent = e.time_ns;
+          steps.seq_node = e.node;
+        }
+        break;
+      case Kind::kReceived:
+        if (data) {
+          first(steps.data_received, e.node, e.time_ns);
+        } else if (e.type == 2 && e.node == e.sender) {
+          steps.ack_times.push_back(e.time_ns);
+        } else if (e.type == 3) {
+          first(steps.seq_received, e.node, e.time_ns);
+        }
+        break;
+      case Kind::kDelivered:
+        first(steps.delivered, e.node, e.time_ns);
+        break;
+    }
+  }
+
+  std::vector<CriticalPath> paths{};
+  for (const auto& message : messages) {
+    const Steps& steps = message.second;
+    if (!steps.sent || steps.delivered.empty()) continue;
+    auto last = std::max_element(
+        steps.delivered.begin(), steps.delivered.end(),
+        [](const std::pair<const uint32_t, uint64_t>& a,
+           const std::pair<const uint32_t, uint64_t>& b) {
+          return a.second < b.second;
+        });
+    CriticalPath path{message.first.first, message.first.second,
+                      last->first,         between(steps.sent, last->second),
+                      kMissing,            kMissing,
+                      kMissing,            kMissing};
+    uint64_t arrived{};
+    if (steps.seq_sent) {
+      // Acks repeated after the Seq went out held nothing up
+      uint64_t ordered{};
+      for (uint64_t t : steps.ack_times) {
+        if (t <= steps.seq_sent) ordered = std::max(ordered, t);
+      }
+      if (!ordered) ordered = at(steps.data_received, steps.seq_node);
+      path.to_order = between(steps.sent, ordered);
+      path.to_seq = between(ordered, steps.seq_sent);
+      arrived = at(steps.seq_received, last->first);
+      path.to_last = between(steps.seq_sent, arrived);
+    } else {
+      arrived = at(steps.data_received, last->first);
+      path.to_last = between(steps.sent, arrived);
+    }
+    path.to_deliver = between(arrived, last->second);
+    paths.push_back(path);
+  }
+  return paths;
+}
+
+Tracer::Tracer(const std::string& path, uint32_t node, uint32_t group_size,
+               std::size_t ring_size,
+               std::chrono::milliseconds flush_interval)
+    : id_{next_tracer_id++},
+      node_{node},
+      ring_size_{next_power_of_2(ring_size)},
+      flush_interval_{flush_interval},
+      file_{path, std::ios_base::binary | std::ios_base::trunc} {
+  if (!file_) {
+    throw std::runtime_error("Unable to create trace file " + path);
+  }
+  trace::FileHeader header{trace::kMagic, trace::kVersion, node, group_size,
+                           sizeof(trace::Event), 0};
+  file_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  flusher_ = std::thread{[this]() {
+    std::unique_lock<std::mutex> lock{stop_mutex_};
+    while (!stop_cv_.wait_for(lock, flush_interval_,
+                              [this]() { return stopping_; })) {
+      flush();
+    }
+  }};
+}
+
+Tracer::~Tracer() {
+  {
+    std::lock_guard<std::mutex> lock{stop_mutex_};
+    stopping_ = true;
+  }
+  stop_cv_.notify_one();
+  flusher_.join();
+  flush();
+}
+
+void Tracer::record(trace::Kind kind, uint32_t type, uint32_t sender,
+                    uint32_t msg_id, uint32_t seq, uint32_t peer) {
+  Ring& r = ring();
+  uint64_t tail{r.tail.load(std::memory_order_relaxed)};
+  if (tail - r.head.load(std::memory_order_acquire) > r.mask) {
+    dropped_.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  auto now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::system_clock::now().time_since_epoch());
+  r.events[tail & r.mask] = trace::Event{static_cast<uint64_t>(now.count()),
+                                         node_,
+                                         sender,
+                                         msg_id,
+                                         seq,
+                                         peer,
+                                         kind,
+                                         static_cast<uint8_t>(type),
+                                         0};
+  r.tail.store(tail + 1, std::memory_order_release);
+}
+
+Tracer::Ring& Tracer::ring() {
+  for (std::size_t i = 0; i < RingCache::kSize; i++) {
+    if (ring_cache.ids[i] == id_) {
+      return *static_cast<Ring*>(ring_cache.rings[i]);
+    }
+  }
+  Ring& r = add_ring();
+  std::size_t slot{ring_cache.next++ % RingCache::kSize};
+  ring_cache.ids[slot] = id_;
+  ring_cache.rings[slot] = &r;
+  return r;
+}
+
+Tracer::Ring& Tracer::add_ring() {
+  std::lock_guard<std::mutex> lock{rings_mutex_};
+  // Evicted from the cache by other tracers, or new
+  auto self = std::this_thread::get_id();
+  for (auto& entry : rings_) {
+    if (entry.first == self) return *entry.second;
+  }
+  rings_.emplace_back(self, std::unique_ptr<Ring>{new Ring{ring_size_}});
+  return *rings_.back().second;
+}
+
+void Tracer::flush() {
+  std::lock_guard<std::mutex> file_lock{file_mutex_};
+  std::lock_guard<std::mutex> rings_lock{rings_mutex_};
+  for (auto& entry : rings_) {
+    Ring& r = *entry.second;
+    uint64_t head{r.head.load(std::memory_order_relaxed)};
+    uint64_t tail{r.tail.load(std::memory_order_acquire)};
+    while (head != tail) {
+      // Up to the end of the ring at most
+      std::size_t begin{static_cast<std::size_t>(head & r.mask)};
+      std::size_t count{static_cast<std::size_t>(
+          std::min<uint64_t>(tail - head, r.mask + 1 - begin))};
+      file_.write(reinterpret_cast<const char*>(&r.events[begin]),
+                  count * sizeof(trace::Event));
+      head += count;
+    }
+    r.head.store(head, std::memory_order_release);
+  }
+  file_.flush();
+}
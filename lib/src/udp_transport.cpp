@@ -0,0 +1,371 @@
+#include "udp_transport.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include <spdlog/spdlog.h>
+
+using namespace multicast;
+using boost::asio::ip::udp;
+
+namespace {
+/**
+ * Have socket busy poll the device queue for busy_poll, if it is nonzero.
+ */
+void set_busy_poll(udp::socket& socket, std::chrono::microseconds busy_poll) {
+  if (busy_poll.count() > 0) {
+#ifdef SO_BUSY_POLL
+    int usec = static_cast<int>(busy_poll.count());
+    if (setsockopt(socket.native_handle(), SOL_SOCKET, SO_BUSY_POLL, &usec,
+                   sizeof(usec)) != 0) {
+      spdlog::warn("Unable to set SO_BUSY_POLL: {}", std::strerror(errno));
+    }
+#else
+    spdlog::warn("SO_BUSY_POLL unavailable, polling without it");
+#endif
+  }
+}
+
+/**
+ * Open socket on port, optionally letting other sockets bind the same port.
+ */
+void bind_socket(udp::socket& socket, uint16_t port, bool reuse_port,
+                 std::chrono::microseconds busy_poll) {
+  socket.open(udp::v4());
+#ifdef SO_REUSEPORT
+  if (reuse_port) {
+    int enable{1};
+    if (setsockopt(socket.native_handle(), SOL_SOCKET, SO_REUSEPORT, &enable,
+                   sizeof(enable)) != 0) {
+      throw boost::system::system_error{
+          boost::system::error_code{errno, boost::system::system_category()},
+          "SO_REUSEPORT"};
+    }
+  }
+#endif
+  set_busy_poll(socket, busy_poll);
+  socket.bind(udp::endpoint{udp::v4(), port});
+  // Sends complete synchronously unless the socket buffer is full
+  socket.non_blocking(true);
+}
+
+/**
+ * Open socket on the port of group and join it on the interface with
+ * address iface, or the one the routing table picks if iface is
+ * unspecified. Other processes on this host may join the same group and
+ * port.
+ */
+void join_group(udp::socket& socket, const udp::endpoint& group,
+                const boost::asio::ip::address_v4& iface,
+                std::chrono::microseconds busy_poll) {
+  socket.open(udp::v4());
+  socket.set_option(udp::socket::reuse_address{true});
+  set_busy_poll(socket, busy_poll);
+  // Bound to the group address only datagrams sent to the group come in
+  socket.bind(group);
+  socket.set_option(boost::asio::ip::multicast::join_group{
+      group.address().to_v4(), iface});
+}
+
+/**
+ * Copy the segments of a message into one contiguous datagram.
+ */
+std::shared_ptr<std::vector<char>> copy_segments(const Segments& message) {
+  auto datagram = std::make_shared<std::vector<char>>();
+  datagram->reserve(segments_size(message));
+  for (auto& segment : message) {
+    auto begin = static_cast<const char*>(segment.data());
+    datagram->insert(datagram->end(), begin, begin + segment.size());
+  }
+  return datagram;
+}
+}  // namespace
+
+UdpTransport::UdpTransport(boost::asio::io_context& io_context,
+                           const std::vector<std::string>& hosts,
+                           uint16_t port, uint32_t process_id,
+                           const Config& config)
+    : config_{config},
+      io_context_{io_context},
+      socket_{io_context},
+      hosts_{hosts},
+      port_{std::to_string(port)},
+      process_id_{process_id},
+      peers_{io_context, hosts_, port_, config.peer_refresh_interval},
+      unresolved_sends_(hosts_.size()) {
+  if (config_.use_mmsg && !mmsg_supported()) {
+    spdlog::warn("recvmmsg/sendmmsg unavailable, using asio sends");
+    config_.use_mmsg = false;
+  }
+  std::size_t paths{std::max<std::size_t>(1, config_.threads)};
+#ifndef SO_REUSEPORT
+  if (paths > 1) {
+    spdlog::warn("SO_REUSEPORT unavailable, receiving on a single shard");
+    paths = 1;
+  }
+#endif
+  std::chrono::microseconds busy_poll{};
+  if (config_.wait_strategy == WaitStrategy::kBusyPoll) {
+    busy_poll = config_.busy_poll;
+  }
+  bind_socket(socket_, port, paths > 1, busy_poll);
+  for (std::size_t i = 0; i < paths; i++) {
+    paths_.emplace_back(new ReceivePath{io_context_, &socket_});
+    ReceivePath& path = *paths_.back();
+    if (i > 0) {
+      path.owned_socket.reset(new udp::socket{io_context_});
+      bind_socket(*path.owned_socket, port, true, busy_poll);
+      path.socket = path.owned_socket.get();
+    }
+    if (config_.use_mmsg) {
+      path.mmsg_receiver.reset(
+          new MmsgReceiver{config_.mmsg_batch, kMaxDatagramSize});
+    }
+  }
+  if (!config_.multicast_group.empty()) {
+    if (!config_.multicast_port) {
+      throw std::runtime_error("Multicast group without a port");
+    }
+    auto group = boost::asio::ip::make_address_v4(config_.multicast_group);
+    if (!group.is_multicast()) {
+      throw std::runtime_error("Not a multicast group: " +
+                               config_.multicast_group);
+    }
+    boost::asio::ip::address_v4 iface{};
+    if (!config_.multicast_interface.empty()) {
+      iface = boost::asio::ip::make_address_v4(config_.multicast_interface);
+      socket_.set_option(boost::asio::ip::multicast::outbound_interface{iface});
+    }
+    socket_.set_option(
+        boost::asio::ip::multicast::hops{config_.multicast_ttl});
+    socket_.set_option(boost::asio::ip::multicast::enable_loopback{
+        config_.multicast_loopback});
+    group_endpoint_ = udp::endpoint{group, config_.multicast_port};
+    group_path_.reset(new ReceivePath{io_context_, nullptr});
+    group_path_->owned_socket.reset(new udp::socket{io_context_});
+    group_path_->socket = group_path_->owned_socket.get();
+    join_group(*group_path_->socket, group_endpoint_, iface, busy_poll);
+    if (config_.use_mmsg) {
+      group_path_->mmsg_receiver.reset(
+          new MmsgReceiver{config_.mmsg_batch, kMaxDatagramSize});
+    }
+  }
+  if (config_.use_mmsg) {
+    batch_.reserve(hosts_.size() + 1);
+  }
+}
+
+UdpTransport::~UdpTransport() { close(); }
+
+void UdpTransport::start(const std::vector<Strand>& strands,
+                         ReceiveHandler handler) {
+  handler_ = std::move(handler);
+  for (std::size_t i = 0; i < paths_.size(); i++) {
+    paths_[i]->strand = strands[i];
+  }
+  if (group_path_ && strands.size() == 1) {
+    // With a single path the Multicaster handles everything received inline,
+    // counting on it all being serialized on that path's strand
+    group_path_->strand = strands.front();
+  }
+  peers_.start([this](std::size_t hostnum) { handle_resolved(hostnum); });
+  for (auto& path : paths_) {
+    start_receive(*path);
+  }
+  if (group_path_) {
+    start_receive(*group_path_);
+  }
+}
+
+void UdpTransport::close() {
+  closing_ = true;
+  boost::system::error_code error{};
+  for (auto& path : paths_) {
+    path->socket->close(error);
+  }
+  if (group_path_) {
+    group_path_->socket->close(error);
+  }
+}
+
+void UdpTransport::start_receive(ReceivePath& path) {
+  if (path.mmsg_receiver) {
+    path.socket->async_wait(
+        udp::socket::wait_read,
+        boost::asio::bind_executor(
+            path.strand, [this, &path](const boost::system::error_code& e) {
+              handle_readable(path, e);
+            }));
+    return;
+  }
+  // Pack datagrams back to back, starting over once nothing received into the
+  // buffer is still referenced and moving on once there is no room left.
+  if (path.receive_buffer.use_count() == 1) {
+    path.receive_offset = 0;
+  }
+  if (!path.receive_buffer ||
+      path.receive_buffer->capacity() - path.receive_offset <
+          kMaxDatagramSize) {
+    path.receive_buffer = path.receive_pool.acquire();
+    path.receive_offset = 0;
+  }
+  path.socket->async_receive_from(
+      boost::asio::buffer(path.receive_buffer->data() + path.receive_offset,
+                          kMaxDatagramSize),
+      path.remote_endpoint,
+      boost::asio::bind_executor(
+          path.strand,
+          [this, &path](const boost::system::error_code& e, std::size_t n) {
+            handle_receive(path, e, n);
+          }));
+}
+
+void UdpTransport::handle_receive(ReceivePath& path,
+                                  const boost::system::error_code& error,
+                                  std::size_t bytes_transferred) {
+  if (closing_) return;
+  if (error) {
+    if (error == boost::asio::error::operation_aborted) {
+      return;
+    }
+    // ICMP errors from an unreachable peer surface here, keep listening
+    SPDLOG_ERROR("Error reading from socket: {}", error.message());
+    start_receive(path);
+    return;
+  }
+
+  const char* buf = path.receive_buffer->data() + path.receive_offset;
+  // Keep the next datagram 8 byte aligned
+  path.receive_offset += (bytes_transferred + 7) & ~std::size_t{7};
+  handler_(path.receive_buffer, buf, bytes_transferred);
+  start_receive(path);
+}
+
+void UdpTransport::handle_readable(ReceivePath& path,
+                                   const boost::system::error_code& error) {
+  if (error == boost::asio::error::operation_aborted || closing_) {
+    return;
+  }
+  MmsgReceiver& receiver = *path.mmsg_receiver;
+  // Bound the work per wakeup so timers and sends are not starved
+  constexpr int kMaxBatchesPerWakeup{4};
+  for (int i = 0; i < kMaxBatchesPerWakeup; i++) {
+    boost::system::error_code recv_error{};
+    std::size_t received =
+        receiver.receive(path.socket->native_handle(), recv_error);
+    if (recv_error) {
+      SPDLOG_ERROR("Error reading from socket: {}", recv_error.message());
+    }
+    for (std::size_t slot = 0; slot < received; slot++) {
+      if (receiver.truncated(slot)) {
+        SPDLOG_ERROR("Dropping truncated datagram");
+        continue;
+      }
+      handler_(receiver.buffer(slot), receiver.data(slot),
+               receiver.size(slot));
+    }
+    if (received < receiver.batch()) break;
+  }
+  start_receive(path);
+}
+
+bool UdpTransport::endpoint(std::size_t destination, udp::endpoint& endpoint) {
+  if (destination == hosts_.size()) {
+    endpoint = group_endpoint_;
+    return true;
+  }
+  return peers_.endpoint(destination, endpoint);
+}
+
+void UdpTransport::send(const Segments& message, std::size_t destination) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  send_single(message, destination);
+}
+
+void UdpTransport::send(const Outgoing* datagrams, std::size_t count) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  if (!config_.use_mmsg) {
+    for (std::size_t i = 0; i < count; i++) {
+      send_single(datagrams[i].message, datagrams[i].destination);
+    }
+    return;
+  }
+  // One sendmmsg for every resolved destination. The endpoints must not move
+  // while batch_ points at them.
+  if (batch_endpoints_.size() < count) {
+    batch_endpoints_.resize(count);
+  }
+  for (std::size_t i = 0; i < count; i++) {
+    const Outgoing& datagram = datagrams[i];
+    if (!endpoint(datagram.destination, batch_endpoints_[i])) {
+      send_single(datagram.message, datagram.destination);
+      continue;
+    }
+    batch_.push_back(OutgoingDatagram{datagram.message, &batch_endpoints_[i]});
+    if (datagram.destination == hosts_.size() &&
+        !config_.multicast_loopback) {
+      send_single(datagram.message, process_id_);
+    }
+  }
+  boost::system::error_code error{};
+  std::size_t sent = send_batch(socket_.native_handle(), batch_, error);
+  if (error) {
+    SPDLOG_ERROR("Error sending batch: {}", error.message());
+  }
+  for (std::size_t i = sent; i < batch_.size(); i++) {
+    send_to(batch_[i].message, *batch_[i].endpoint);
+  }
+  batch_.clear();
+}
+
+void UdpTransport::send_single(const Segments& message,
+                               std::size_t destination) {
+  udp::endpoint receiver_endpoint{};
+  if (!endpoint(destination, receiver_endpoint)) {
+    // Hold a copy until the directory has an address for this host
+    unresolved_sends_[destination].push_back(copy_segments(message));
+    SPDLOG_INFO("Deferred message to unresolved host {}", name(destination));
+    return;
+  }
+  send_to(message, receiver_endpoint);
+  SPDLOG_TRACE("Sent message to {}", name(destination));
+  if (destination == hosts_.size() && !config_.multicast_loopback) {
+    // The kernel keeps the group's datagrams from this host
+    send_single(message, process_id_);
+  }
+}
+
+void UdpTransport::send_to(const Segments& message,
+                           const udp::endpoint& receiver_endpoint) {
+  boost::system::error_code error{};
+  socket_.send_to(message, receiver_endpoint, 0, error);
+  if (error == boost::asio::error::would_block) {
+    // The socket is full, keep a copy alive until asio gets it out
+    auto datagram = copy_segments(message);
+    socket_.async_send_to(
+        boost::asio::buffer(*datagram), receiver_endpoint,
+        [datagram](const boost::system::error_code& /*error*/,
+                   std::size_t /*bytes_transferred*/) {});
+  } else if (error) {
+    SPDLOG_ERROR("Error sending to {}: {}",
+                 receiver_endpoint.address().to_string(), error.message());
+  }
+}
+
+void UdpTransport::handle_resolved(std::size_t hostnum) {
+  if (closing_) return;
+  std::lock_guard<std::mutex> lock{mutex_};
+  std::vector<std::shared_ptr<Datagram>> pending{};
+  pending.swap(unresolved_sends_[hostnum]);
+  udp::endpoint receiver_endpoint{};
+  peers_.endpoint(hostnum, receiver_endpoint);
+  for (auto& datagram : pending) {
+    send_to(Segments{boost::asio::buffer(*datagram),
+                     boost::asio::const_buffer{}},
+            receiver_endpoint);
+  }
+  if (!pending.empty()) {
+    SPDLOG_INFO("Flushed {} deferred messages to {}", pending.size(),
+                hosts_[hostnum]);
+  }
+}
@@ -0,0 +1,85 @@
+#include "gtest/gtest.h"
+
+#include "acks.hpp"
+
+/************************************************
+ *  Ack Collector Tests
+ ***********************************************/
+TEST(AckCollectorTest, TestTakesLargestProposal) {
+  multicast::AckCollector acks{};
+  ASSERT_TRUE(acks.track(7));
+  ASSERT_FALSE(acks.track(7));
+
+  acks.add(7, 3, 1);
+  acks.add(7, 5, 0);
+  acks.add(7, 5, 2);
+  multicast::AckState* state = acks.add(7, 4, 3);
+  ASSERT_NE(state, nullptr);
+  ASSERT_EQ(state->acks_received, 4);
+  ASSERT_EQ(state->final_seq, 5);
+  ASSERT_EQ(state->final_seq_proposer, 2);
+}
+
+TEST(AckCollectorTest, TestUnknownMessage) {
+  multicast::AckCollector acks{};
+  ASSERT_EQ(acks.add(1, 1, 0), nullptr);
+  acks.track(1);
+  acks.erase(1);
+  ASSERT_EQ(acks.add(1, 1, 0), nullptr);
+  ASSERT_EQ(acks.size(), 0);
+}
+
+TEST(AckCollectorTest, TestGrowsOnCollision) {
+  multicast::AckCollector acks{4};
+  for (uint32_t msg_id = 0; msg_id < 100; msg_id++) {
+    ASSERT_TRUE(acks.track(msg_id));
+    acks.add(msg_id, msg_id, 1);
+  }
+  ASSERT_EQ(acks.size(), 100);
+  ASSERT_GE(acks.capacity(), 100);
+  for (uint32_t msg_id = 0; msg_id < 100; msg_id++) {
+    multicast::AckState* state = acks.add(msg_id, 0, 0);
+    ASSERT_NE(state, nullptr);
+    ASSERT_EQ(state->acks_received, 2);
+    ASSERT_EQ(state->final_seq, msg_id);
+  }
+}
+
+TEST(AckCollectorTest, TestDuplicateAckIgnored) {
+  multicast::AckCollector acks{};
+  acks.track(3);
+  ASSERT_NE(acks.add(3, 1, 0), nullptr);
+  ASSERT_EQ(acks.add(3, 9, 0), nullptr);
+  multicast::AckState* state = acks.add(3, 2, 1);
+  ASSERT_NE(state, nullptr);
+  ASSERT_EQ(state->acks_received, 2);
+  ASSERT_EQ(state->acked, 3);
+  ASSERT_EQ(state->final_seq, 2);
+}
+
+TEST(AckCollectorTest, TestConfirmOnceSequenced) {
+  multicast::AckCollector acks{};
+  acks.track(3);
+  ASSERT_EQ(acks.confirm(3, 0), nullptr);
+  acks.add(3, 1, 0);
+  acks.find(3)->sequenced = true;
+  // No more acks once the Seq is out
+  ASSERT_EQ(acks.add(3, 1, 1), nullptr);
+  ASSERT_NE(acks.confirm(3, 0), nullptr);
+  ASSERT_EQ(acks.confirm(3, 0), nullptr);
+  multicast::AckState* state = acks.confirm(3, 2);
+  ASSERT_NE(state, nullptr);
+  ASSERT_EQ(state->confirmations, 2);
+  ASSERT_EQ(state->confirmed, 5);
+}
+
+TEST(AckCollectorTest, TestEraseReleasesMessage) {
+  multicast::BufferPool pool{16};
+  multicast::AckCollector acks{};
+  acks.track(3);
+  acks.find(3)->message = pool.acquire();
+  ASSERT_EQ(pool.stats().in_use, 1);
+  acks.erase(3);
+  ASSERT_EQ(acks.find(3), nullptr);
+  ASSERT_EQ(pool.stats().in_use, 0);
+}
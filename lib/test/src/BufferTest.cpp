@@ -0,0 +1,71 @@
+#include "gtest/gtest.h"
+#include <cstring>
+
+#include "buffer.hpp"
+
+/************************************************
+ *  Buffer Pool Tests
+ ***********************************************/
+TEST(BufferPoolTest, TestAcquire) {
+  multicast::BufferPool pool{128};
+  multicast::BufferRef buffer = pool.acquire();
+  ASSERT_TRUE(buffer);
+  ASSERT_EQ(buffer->capacity(), 128);
+  ASSERT_EQ(buffer.use_count(), 1);
+  ASSERT_EQ(pool.stats().in_use, 1);
+  ASSERT_EQ(pool.stats().capacity, 1);
+}
+
+TEST(BufferPoolTest, TestInitial) {
+  multicast::BufferPool pool{128, 4};
+  ASSERT_EQ(pool.stats().capacity, 4);
+  ASSERT_EQ(pool.stats().in_use, 0);
+}
+
+TEST(BufferPoolTest, TestSharedUntilLastRef) {
+  multicast::BufferPool pool{128};
+  multicast::BufferRef a = pool.acquire();
+  multicast::BufferRef b = a;
+  ASSERT_EQ(a.use_count(), 2);
+  a.reset();
+  ASSERT_FALSE(a);
+  ASSERT_EQ(b.use_count(), 1);
+  ASSERT_EQ(pool.stats().in_use, 1);
+  b.reset();
+  ASSERT_EQ(pool.stats().in_use, 0);
+}
+
+TEST(BufferPoolTest, TestMoveDoesNotShare) {
+  multicast::BufferPool pool{128};
+  multicast::BufferRef a = pool.acquire();
+  multicast::BufferRef b{std::move(a)};
+  ASSERT_FALSE(a);
+  ASSERT_EQ(b.use_count(), 1);
+}
+
+TEST(BufferPoolTest, TestReleasedBufferReused) {
+  multicast::BufferPool pool{128};
+  multicast::Buffer* first{};
+  {
+    multicast::BufferRef a = pool.acquire();
+    first = a.get();
+  }
+  multicast::BufferRef b = pool.acquire();
+  ASSERT_EQ(b.get(), first);
+  ASSERT_EQ(pool.stats().capacity, 1);
+  ASSERT_EQ(pool.stats().high_water, 1);
+}
+
+TEST(BufferPoolTest, TestPayloadKeepsBufferAlive) {
+  multicast::BufferPool pool{128};
+  multicast::Payload payload{};
+  {
+    multicast::BufferRef buffer = pool.acquire();
+    std::memcpy(buffer->data(), "hello", 5);
+    payload = multicast::Payload{buffer, buffer->data(), 5};
+  }
+  ASSERT_EQ(pool.stats().in_use, 1);
+  ASSERT_EQ(std::string(payload.data, payload.size), "hello");
+  payload.buffer.reset();
+  ASSERT_EQ(pool.stats().in_use, 0);
+}
@@ -0,0 +1,166 @@
+#include "gtest/gtest.h"
+#include <deque>
+#include <utility>
+#include <vector>
+#include <boost/asio.hpp>
+
+#include "causal.hpp"
+#include "messages.hpp"
+
+namespace {
+/**
+ * Encodes StreamMessages and keeps their bytes alive, as the receive buffer
+ * would.
+ */
+class StreamBuilder {
+ public:
+  messages::StreamMessage fifo(uint32_t sender, uint32_t stream_seq) {
+    return build(sender, stream_seq, multicast::DeliveryOrder::kFifo, {});
+  }
+
+  messages::StreamMessage causal(uint32_t sender, uint32_t stream_seq,
+                                 std::vector<uint32_t> clock) {
+    return build(sender, stream_seq, multicast::DeliveryOrder::kCausal,
+                 std::move(clock));
+  }
+
+ private:
+  messages::StreamMessage build(uint32_t sender, uint32_t stream_seq,
+                                multicast::DeliveryOrder order,
+                                std::vector<uint32_t> clock) {
+    for (auto& entry : clock) entry = htonl(entry);
+    messages::StreamMessage M{sender, next_msg_id_++, stream_seq,
+                              static_cast<uint32_t>(order), stream_seq};
+    M.clock_size = static_cast<uint32_t>(clock.size());
+    M.clock = reinterpret_cast<const char*>(clock.data());
+    buffers_.emplace_back();
+    M.serialize(buffers_.back());
+    return messages::StreamMessage{buffers_.back()};
+  }
+
+  uint32_t next_msg_id_{};
+  std::deque<std::vector<uint32_t>> buffers_{};
+};
+
+/**
+ * Feeds messages to a CausalOrder and records (sender, stream_seq) of what
+ * it delivers.
+ */
+struct Receiver {
+  explicit Receiver(std::size_t hosts) : order{hosts} {}
+
+  bool receive(const messages::StreamMessage& M) {
+    return order.receive(
+        M, multicast::BufferRef{},
+        [this](const messages::StreamMessage& m, multicast::BufferRef) {
+          delivered.emplace_back(m.sender, m.stream_seq);
+        });
+  }
+
+  multicast::CausalOrder order;
+  std::vector<std::pair<uint32_t, uint32_t>> delivered{};
+};
+
+using Delivered = std::vector<std::pair<uint32_t, uint32_t>>;
+}  // namespace
+
+/************************************************
+ *  FIFO Tests
+ ***********************************************/
+TEST(CausalOrderTest, TestFifoInOrderDeliversImmediately) {
+  StreamBuilder builder{};
+  Receiver receiver{2};
+  ASSERT_TRUE(receiver.receive(builder.fifo(0, 1)));
+  ASSERT_TRUE(receiver.receive(builder.fifo(1, 1)));
+  ASSERT_TRUE(receiver.receive(builder.fifo(0, 2)));
+  ASSERT_EQ(receiver.delivered, (Delivered{{0, 1}, {1, 1}, {0, 2}}));
+  ASSERT_EQ(receiver.order.delivered(0), 2);
+  ASSERT_EQ(receiver.order.delivered(1), 1);
+  ASSERT_EQ(receiver.order.held(), 0);
+}
+
+TEST(CausalOrderTest, TestFifoHoldsBackUntilGapFills) {
+  StreamBuilder builder{};
+  Receiver receiver{1};
+  auto first = builder.fifo(0, 1);
+  ASSERT_TRUE(receiver.receive(builder.fifo(0, 3)));
+  ASSERT_TRUE(receiver.receive(builder.fifo(0, 2)));
+  ASSERT_TRUE(receiver.delivered.empty());
+  ASSERT_EQ(receiver.order.held(), 2);
+
+  ASSERT_TRUE(receiver.receive(first));
+  ASSERT_EQ(receiver.delivered, (Delivered{{0, 1}, {0, 2}, {0, 3}}));
+  ASSERT_EQ(receiver.order.held(), 0);
+}
+
+TEST(CausalOrderTest, TestRejectsRepeats) {
+  StreamBuilder builder{};
+  Receiver receiver{1};
+  auto first = builder.fifo(0, 1);
+  auto third = builder.fifo(0, 3);
+  ASSERT_TRUE(receiver.receive(first));
+  ASSERT_FALSE(receiver.receive(first));
+  ASSERT_TRUE(receiver.receive(third));
+  ASSERT_FALSE(receiver.receive(third));
+  ASSERT_EQ(receiver.delivered.size(), 1);
+  ASSERT_EQ(receiver.order.held(), 1);
+}
+
+/************************************************
+ *  Causal Tests
+ ***********************************************/
+TEST(CausalOrderTest, TestCausalWaitsForDependencies) {
+  StreamBuilder builder{};
+  Receiver receiver{3};
+  // Process 1 had delivered the first two messages of process 0
+  ASSERT_TRUE(receiver.receive(builder.causal(1, 1, {2, 1, 0})));
+  ASSERT_TRUE(receiver.receive(builder.causal(0, 1, {1, 0, 0})));
+  ASSERT_EQ(receiver.delivered, (Delivered{{0, 1}}));
+
+  // Unrelated traffic is not held up
+  ASSERT_TRUE(receiver.receive(builder.causal(2, 1, {0, 0, 1})));
+  ASSERT_EQ(receiver.delivered, (Delivered{{0, 1}, {2, 1}}));
+
+  ASSERT_TRUE(receiver.receive(builder.causal(0, 2, {2, 0, 0})));
+  ASSERT_EQ(receiver.delivered, (Delivered{{0, 1}, {2, 1}, {0, 2}, {1, 1}}));
+  ASSERT_EQ(receiver.order.held(), 0);
+}
+
+TEST(CausalOrderTest, TestTellsDeliverable) {
+  StreamBuilder builder{};
+  Receiver receiver{2};
+  auto first = builder.fifo(0, 1);
+  auto second = builder.fifo(0, 2);
+  auto dependent = builder.causal(1, 1, {1, 1});
+  ASSERT_TRUE(receiver.order.deliverable(first));
+  ASSERT_FALSE(receiver.order.deliverable(second));
+  ASSERT_FALSE(receiver.order.deliverable(dependent));
+  ASSERT_TRUE(receiver.receive(first));
+  ASSERT_TRUE(receiver.order.deliverable(second));
+  ASSERT_TRUE(receiver.order.deliverable(dependent));
+  ASSERT_EQ(receiver.order.held(), 0);
+}
+
+TEST(CausalOrderTest, TestChainsReleaseAcrossSenders) {
+  StreamBuilder builder{};
+  Receiver receiver{3};
+  // 0 -> 1 -> 2, arriving backwards
+  ASSERT_TRUE(receiver.receive(builder.causal(2, 1, {1, 1, 1})));
+  ASSERT_TRUE(receiver.receive(builder.causal(1, 1, {1, 1, 0})));
+  ASSERT_TRUE(receiver.delivered.empty());
+  ASSERT_TRUE(receiver.receive(builder.causal(0, 1, {1, 0, 0})));
+  ASSERT_EQ(receiver.delivered, (Delivered{{0, 1}, {1, 1}, {2, 1}}));
+}
+
+TEST(CausalOrderTest, TestFifoIgnoresOtherSenders) {
+  StreamBuilder builder{};
+  Receiver receiver{2};
+  auto causal = builder.causal(0, 1, {1, 1});
+  auto fifo = builder.fifo(0, 2);
+  ASSERT_TRUE(receiver.receive(causal));
+  // Still FIFO behind the held causal message of the same sender
+  ASSERT_TRUE(receiver.receive(fifo));
+  ASSERT_TRUE(receiver.delivered.empty());
+  ASSERT_TRUE(receiver.receive(builder.fifo(1, 1)));
+  ASSERT_EQ(receiver.delivered, (Delivered{{1, 1}, {0, 1}, {0, 2}}));
+}
@@ -0,0 +1,145 @@
+#include "gtest/gtest.h"
+#include <string>
+#include <vector>
+
+#include "history.hpp"
+
+namespace {
+using messages::CatchupBuilder;
+using messages::CatchupReader;
+using multicast::DeliveryHistory;
+
+/**
+ * Record message msg_id of sender delivered at (seq, proposer).
+ */
+void deliver(DeliveryHistory& history, uint32_t sender, uint32_t msg_id,
+             uint32_t seq, uint32_t proposer, const std::string& payload) {
+  messages::DataMessage msg{sender, msg_id, msg_id};
+  msg.final_seq = seq;
+  msg.final_seq_proposer = proposer;
+  msg.payload = payload.data();
+  msg.payload_size = payload.size();
+  history.append(msg);
+}
+
+/**
+ * The final seqs in batch.
+ */
+std::vector<uint32_t> seqs(const CatchupBuilder& batch) {
+  CatchupReader reader{batch.data(), batch.size()};
+  std::vector<uint32_t> result{};
+  messages::DataMessage msg{0, 0, 0};
+  while (reader.next(msg)) {
+    result.push_back(msg.final_seq);
+  }
+  return result;
+}
+}  // namespace
+
+/************************************************
+ *  Delivery History Tests
+ ***********************************************/
+TEST(DeliveryHistoryTest, TestFillsAfterPosition) {
+  DeliveryHistory history{4096};
+  for (uint32_t seq = 1; seq <= 10; seq++) {
+    deliver(history, seq % 3, seq, seq, seq % 3, "payload " +
+                                                     std::to_string(seq));
+  }
+  ASSERT_EQ(history.size(), 10);
+
+  CatchupBuilder batch{4096};
+  batch.start(0, 0, 0);
+  ASSERT_EQ(history.fill(0, 0, batch), CatchupBuilder::kDone);
+  ASSERT_EQ(seqs(batch).size(), 10);
+
+  batch.start(0, 7, 1);
+  ASSERT_EQ(history.fill(7, 1, batch), CatchupBuilder::kDone);
+  ASSERT_EQ(seqs(batch), (std::vector<uint32_t>{8, 9, 10}));
+  CatchupReader reader{batch.data(), batch.size()};
+  messages::DataMessage msg{0, 0, 0};
+  ASSERT_TRUE(reader.next(msg));
+  ASSERT_EQ(msg.sender, 2);
+  ASSERT_EQ(msg.msg_id, 8);
+  ASSERT_EQ(std::string(msg.payload, msg.payload_size), "payload 8");
+
+  // Nothing after the last one
+  batch.start(0, 10, 1);
+  ASSERT_EQ(history.fill(10, 1, batch), CatchupBuilder::kDone);
+  ASSERT_EQ(batch.count(), 0);
+}
+
+TEST(DeliveryHistoryTest, TestOrdersByProposerOnTie) {
+  DeliveryHistory history{4096};
+  deliver(history, 0, 0, 5, 0, "");
+  deliver(history, 1, 0, 5, 2, "");
+  deliver(history, 2, 0, 6, 1, "");
+
+  CatchupBuilder batch{4096};
+  batch.start(0, 5, 1);
+  ASSERT_EQ(history.fill(5, 1, batch), CatchupBuilder::kDone);
+  ASSERT_EQ(seqs(batch), (std::vector<uint32_t>{5, 6}));
+  ASSERT_EQ(batch.last_seq(), 6);
+  ASSERT_EQ(batch.last_proposer(), 1);
+}
+
+TEST(DeliveryHistoryTest, TestBatchesWhenFull) {
+  DeliveryHistory history{1 << 16};
+  std::string payload(100, 'p');
+  for (uint32_t seq = 1; seq <= 50; seq++) {
+    deliver(history, 0, seq, seq, 0, payload);
+  }
+
+  // Room for four messages a batch
+  CatchupBuilder batch{CatchupBuilder::kHeaderSize +
+                       4 * CatchupBuilder::entry_size(payload.size())};
+  uint32_t seq{};
+  std::size_t batches{};
+  CatchupBuilder::Status status{CatchupBuilder::kMore};
+  while (status == CatchupBuilder::kMore) {
+    batch.start(0, seq, 0);
+    status = history.fill(seq, 0, batch);
+    ASSERT_EQ(seqs(batch).front(), seq + 1);
+    seq = batch.last_seq();
+    batches++;
+  }
+  ASSERT_EQ(status, CatchupBuilder::kDone);
+  ASSERT_EQ(seq, 50);
+  ASSERT_EQ(batches, 13);
+}
+
+TEST(DeliveryHistoryTest, TestEvictsOldest) {
+  // Room for the payloads of ten messages
+  DeliveryHistory history{1000};
+  std::string payload(100, 'p');
+  for (uint32_t seq = 1; seq <= 25; seq++) {
+    deliver(history, 0, seq, seq, 0, payload);
+  }
+  ASSERT_EQ(history.size(), 10);
+
+  CatchupBuilder batch{1 << 16};
+  batch.start(0, 0, 0);
+  ASSERT_EQ(history.fill(0, 0, batch), CatchupBuilder::kGone);
+  batch.start(0, 14, 0);
+  ASSERT_EQ(history.fill(14, 0, batch), CatchupBuilder::kGone);
+  // Right after the last one evicted is still whole
+  batch.start(0, 15, 0);
+  ASSERT_EQ(history.fill(15, 0, batch), CatchupBuilder::kDone);
+  ASSERT_EQ(seqs(batch).size(), 10);
+  ASSERT_EQ(seqs(batch).front(), 16);
+
+  // Nor does it hold more messages than fit their headers
+  DeliveryHistory small{10 * CatchupBuilder::kEntryHeaderSize};
+  for (uint32_t seq = 1; seq <= 25; seq++) {
+    deliver(small, 0, seq, seq, 0, "");
+  }
+  ASSERT_EQ(small.size(), 10);
+}
+
+TEST(DeliveryHistoryTest, TestTooLargeForBatch) {
+  DeliveryHistory history{4096};
+  deliver(history, 0, 1, 1, 0, std::string(1000, 'p'));
+
+  CatchupBuilder batch{512};
+  batch.start(0, 0, 0);
+  ASSERT_EQ(history.fill(0, 0, batch), CatchupBuilder::kGone);
+}
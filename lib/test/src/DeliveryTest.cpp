@@ -0,0 +1,179 @@
+#include "gtest/gtest.h"
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "delivery.hpp"
+#include "ring.hpp"
+
+namespace {
+multicast::Delivery make_delivery(uint32_t seq) {
+  multicast::Delivery delivery{};
+  delivery.sender = 1;
+  delivery.msg_id = seq;
+  delivery.final_seq = seq;
+  return delivery;
+}
+}  // namespace
+
+/************************************************
+ *  SPSC Ring Tests
+ ***********************************************/
+TEST(SpscRingTest, TestPushPopInOrder) {
+  multicast::SpscRing<int> ring{3};
+  ASSERT_EQ(ring.capacity(), 4);
+  for (int i = 0; i < 4; i++) {
+    ASSERT_TRUE(ring.try_push(int{i}));
+  }
+  ASSERT_FALSE(ring.try_push(4));
+  ASSERT_EQ(ring.size(), 4);
+
+  int value{};
+  for (int i = 0; i < 4; i++) {
+    ASSERT_TRUE(ring.try_pop(value));
+    ASSERT_EQ(value, i);
+  }
+  ASSERT_FALSE(ring.try_pop(value));
+}
+
+TEST(SpscRingTest, TestAcrossThreads) {
+  constexpr int kCount{200000};
+  multicast::SpscRing<int> ring{64};
+  std::thread producer{[&ring]() {
+    for (int i = 0; i < kCount; i++) {
+      while (!ring.try_push(int{i})) std::this_thread::yield();
+    }
+  }};
+  int expected{};
+  int value{};
+  while (expected < kCount) {
+    if (!ring.try_pop(value)) {
+      std::this_thread::yield();
+      continue;
+    }
+    ASSERT_EQ(value, expected);
+    expected++;
+  }
+  producer.join();
+}
+
+/************************************************
+ *  SPSC Queue Tests
+ ***********************************************/
+TEST(SpscQueueTest, TestGrowsInOrder) {
+  multicast::SpscQueue<int> queue{4};
+  int value{};
+  ASSERT_FALSE(queue.try_pop(value));
+  for (int i = 0; i < 10; i++) {
+    queue.push(int{i});
+  }
+  for (int i = 0; i < 6; i++) {
+    ASSERT_TRUE(queue.try_pop(value));
+    ASSERT_EQ(value, i);
+  }
+  for (int i = 10; i < 20; i++) {
+    queue.push(int{i});
+  }
+  for (int i = 6; i < 20; i++) {
+    ASSERT_TRUE(queue.try_pop(value));
+    ASSERT_EQ(value, i);
+  }
+  ASSERT_FALSE(queue.try_pop(value));
+}
+
+TEST(SpscQueueTest, TestAcrossThreads) {
+  constexpr int kCount{200000};
+  multicast::SpscQueue<int> queue{64};
+  std::thread producer{[&queue]() {
+    for (int i = 0; i < kCount; i++) {
+      queue.push(int{i});
+    }
+  }};
+  int expected{};
+  int value{};
+  while (expected < kCount) {
+    if (!queue.try_pop(value)) {
+      std::this_thread::yield();
+      continue;
+    }
+    ASSERT_EQ(value, expected);
+    expected++;
+  }
+  producer.join();
+}
+
+/************************************************
+ *  Ring Sink Tests
+ ***********************************************/
+TEST(RingSinkTest, TestOverflowKeepsOrder) {
+  multicast::RingSink sink{4};
+  std::vector<multicast::Delivery> batch{};
+  for (uint32_t seq = 0; seq < 10; seq++) {
+    batch.push_back(make_delivery(seq));
+  }
+  sink.deliver(batch.data(), 6);
+  ASSERT_EQ(sink.overflowed(), 2);
+
+  multicast::Delivery delivery{};
+  for (uint32_t seq = 0; seq < 3; seq++) {
+    ASSERT_TRUE(sink.try_pop(delivery));
+    ASSERT_EQ(delivery.final_seq, seq);
+  }
+  // Room in the ring again, but the overflow must still come first
+  sink.deliver(batch.data() + 6, 4);
+  for (uint32_t seq = 3; seq < 10; seq++) {
+    ASSERT_TRUE(sink.try_pop(delivery));
+    ASSERT_EQ(delivery.final_seq, seq);
+  }
+  ASSERT_FALSE(sink.try_pop(delivery));
+}
+
+TEST(RingSinkTest, TestOverflowAcrossThreads) {
+  constexpr uint32_t kCount{100000};
+  multicast::RingSink sink{4};
+  // Batches far larger than the ring, which never make the producer wait
+  std::thread producer{[&sink]() {
+    std::vector<multicast::Delivery> batch{};
+    for (uint32_t seq = 0; seq < kCount; seq++) {
+      batch.push_back(make_delivery(seq));
+      if (batch.size() == 64) {
+        sink.deliver(batch.data(), batch.size());
+        batch.clear();
+      }
+    }
+    sink.deliver(batch.data(), batch.size());
+  }};
+  multicast::Delivery delivery{};
+  uint32_t expected{};
+  while (expected < kCount) {
+    if (!sink.try_pop(delivery)) {
+      std::this_thread::yield();
+      continue;
+    }
+    ASSERT_EQ(delivery.final_seq, expected);
+    expected++;
+  }
+  producer.join();
+  ASSERT_FALSE(sink.try_pop(delivery));
+  ASSERT_GT(sink.overflowed(), 0);
+}
+
+TEST(RingSinkTest, TestKeepsPayloadAlive) {
+  multicast::BufferPool pool{64};
+  multicast::RingSink sink{4};
+  multicast::Delivery delivery = make_delivery(0);
+  delivery.payload.buffer = pool.acquire();
+  delivery.payload.data = delivery.payload.buffer->data();
+  delivery.payload.size = 5;
+  std::memcpy(delivery.payload.buffer->data(), "hello", 5);
+  sink.deliver(&delivery, 1);
+  ASSERT_EQ(pool.stats().in_use, 1);
+
+  multicast::Delivery received{};
+  ASSERT_TRUE(sink.try_pop(received));
+  ASSERT_EQ(std::string(received.payload.data, received.payload.size),
+            "hello");
+  received = multicast::Delivery{};
+  ASSERT_EQ(pool.stats().in_use, 0);
+}
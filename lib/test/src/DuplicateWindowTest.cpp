@@ -0,0 +1,95 @@
+#include "gtest/gtest.h"
+
+#include "dedup.hpp"
+
+namespace {
+using Result = multicast::DuplicateWindow::Result;
+}  // namespace
+
+/************************************************
+ *  Duplicate Window Tests
+ ***********************************************/
+TEST(DuplicateWindowTest, TestInOrder) {
+  multicast::DuplicateWindow window{64};
+  for (uint32_t id = 0; id < 1000; id++) {
+    ASSERT_EQ(window.insert(id), Result::kNew);
+    ASSERT_EQ(window.insert(id), Result::kDuplicate);
+  }
+  ASSERT_EQ(window.base(), 1000);
+  ASSERT_TRUE(window.seen(0));
+  ASSERT_TRUE(window.seen(999));
+  ASSERT_FALSE(window.seen(1000));
+}
+
+TEST(DuplicateWindowTest, TestOutOfOrder) {
+  multicast::DuplicateWindow window{64};
+  ASSERT_EQ(window.insert(2), Result::kNew);
+  ASSERT_EQ(window.insert(1), Result::kNew);
+  ASSERT_EQ(window.base(), 0);
+  ASSERT_FALSE(window.seen(0));
+  ASSERT_TRUE(window.seen(1));
+  ASSERT_EQ(window.insert(2), Result::kDuplicate);
+  ASSERT_EQ(window.insert(0), Result::kNew);
+  ASSERT_EQ(window.base(), 3);
+  ASSERT_EQ(window.insert(1), Result::kDuplicate);
+}
+
+TEST(DuplicateWindowTest, TestCheckDoesNotRecord) {
+  multicast::DuplicateWindow window{64};
+  ASSERT_EQ(window.check(0), Result::kNew);
+  ASSERT_EQ(window.check(0), Result::kNew);
+  ASSERT_EQ(window.check(64), Result::kAhead);
+  ASSERT_FALSE(window.seen(0));
+  ASSERT_EQ(window.insert(0), Result::kNew);
+  ASSERT_EQ(window.check(0), Result::kDuplicate);
+  ASSERT_EQ(window.check(64), Result::kNew);
+}
+
+TEST(DuplicateWindowTest, TestAheadOfWindow) {
+  multicast::DuplicateWindow window{64};
+  ASSERT_EQ(window.size(), 64);
+  ASSERT_EQ(window.insert(63), Result::kNew);
+  ASSERT_EQ(window.insert(64), Result::kAhead);
+  ASSERT_FALSE(window.seen(64));
+  // Filling the hole at the bottom makes room
+  for (uint32_t id = 0; id < 63; id++) {
+    window.insert(id);
+  }
+  ASSERT_EQ(window.base(), 64);
+  ASSERT_EQ(window.insert(64), Result::kNew);
+  ASSERT_EQ(window.insert(127), Result::kNew);
+  ASSERT_EQ(window.base(), 65);
+  ASSERT_EQ(window.insert(129), Result::kAhead);
+}
+
+TEST(DuplicateWindowTest, TestBitsReusedAfterSliding) {
+  multicast::DuplicateWindow window{64};
+  for (uint32_t id = 0; id < 64; id++) {
+    window.insert(id);
+  }
+  // id 64 maps onto the bit id 0 used, which must have been cleared
+  ASSERT_FALSE(window.seen(64));
+  ASSERT_EQ(window.insert(64), Result::kNew);
+  ASSERT_EQ(window.insert(64 + 63), Result::kNew);
+  ASSERT_FALSE(window.seen(64 + 62));
+}
+
+TEST(DuplicateWindowTest, TestWrapsAround) {
+  uint32_t id{0xfffffff0u};
+  multicast::DuplicateWindow window{64, id};
+  ASSERT_TRUE(window.seen(id - 1));
+  for (uint32_t i = 0; i < 32; i++) {
+    ASSERT_EQ(window.insert(id + i), Result::kNew);
+  }
+  ASSERT_EQ(window.base(), 16);
+  ASSERT_EQ(window.insert(0xffffffffu), Result::kDuplicate);
+  ASSERT_EQ(window.insert(15), Result::kDuplicate);
+  ASSERT_EQ(window.insert(16), Result::kNew);
+}
+
+TEST(DuplicateWindowTest, TestRoundsUpSize) {
+  multicast::DuplicateWindow small{1};
+  ASSERT_EQ(small.size(), 64);
+  multicast::DuplicateWindow odd{100};
+  ASSERT_EQ(odd.size(), 128);
+}
@@ -0,0 +1,95 @@
+#include "gtest/gtest.h"
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "histogram.hpp"
+
+using multicast::LatencyHistogram;
+
+/************************************************
+ *  Latency Histogram Tests
+ ***********************************************/
+TEST(LatencyHistogramTest, TestSmallValuesAreExact) {
+  for (uint64_t ns = 0; ns < 128; ns++) {
+    ASSERT_EQ(LatencyHistogram::bucket(ns), ns);
+    ASSERT_EQ(LatencyHistogram::highest(ns), ns);
+  }
+}
+
+TEST(LatencyHistogramTest, TestBucketsCoverEveryValue) {
+  // Each bucket starts right after the previous one ends
+  for (std::size_t i = 1; i < LatencyHistogram::kBuckets; i++) {
+    uint64_t low{LatencyHistogram::highest(i - 1) + 1};
+    ASSERT_EQ(LatencyHistogram::bucket(low), i);
+    ASSERT_EQ(LatencyHistogram::bucket(LatencyHistogram::highest(i)), i);
+  }
+}
+
+TEST(LatencyHistogramTest, TestRelativeError) {
+  for (uint64_t ns = 128; ns < (uint64_t{1} << 36); ns = ns * 3 + 1) {
+    uint64_t high{LatencyHistogram::highest(LatencyHistogram::bucket(ns))};
+    ASSERT_GE(high, ns);
+    ASSERT_LE(high - ns, ns / 64);
+  }
+}
+
+TEST(LatencyHistogramTest, TestHugeValuesLandInTopBucket) {
+  ASSERT_EQ(LatencyHistogram::bucket(UINT64_MAX),
+            LatencyHistogram::kBuckets - 1);
+}
+
+TEST(LatencyHistogramTest, TestEmptySnapshot) {
+  LatencyHistogram histogram{};
+  auto snapshot = histogram.snapshot();
+  ASSERT_EQ(snapshot.count, 0);
+  ASSERT_EQ(snapshot.mean(), 0);
+  ASSERT_EQ(snapshot.percentile(0.99), 0);
+}
+
+TEST(LatencyHistogramTest, TestPercentiles) {
+  LatencyHistogram histogram{};
+  for (uint64_t ns = 1; ns <= 100; ns++) {
+    histogram.record(ns * 1000);
+  }
+  auto snapshot = histogram.snapshot();
+  ASSERT_EQ(snapshot.count, 100);
+  ASSERT_EQ(snapshot.min, 1000);
+  ASSERT_EQ(snapshot.max, 100000);
+  ASSERT_DOUBLE_EQ(snapshot.mean(), 50500);
+  ASSERT_NEAR(snapshot.percentile(0.5), 50000, 50000 / 64);
+  ASSERT_NEAR(snapshot.percentile(0.9), 90000, 90000 / 64);
+  ASSERT_EQ(snapshot.percentile(1), 100000);
+  ASSERT_EQ(snapshot.percentile(0), snapshot.percentile(0.01));
+}
+
+TEST(LatencyHistogramTest, TestRecordDuration) {
+  LatencyHistogram histogram{};
+  histogram.record(std::chrono::microseconds{3});
+  histogram.record(std::chrono::steady_clock::duration{-5});
+  auto snapshot = histogram.snapshot();
+  ASSERT_EQ(snapshot.min, 0);
+  ASSERT_EQ(snapshot.max, 3000);
+}
+
+TEST(LatencyHistogramTest, TestConcurrentRecords) {
+  LatencyHistogram histogram{};
+  constexpr uint64_t kPerThread{10000};
+  std::vector<std::thread> threads{};
+  for (uint64_t t = 0; t < 4; t++) {
+    threads.emplace_back([&histogram, t]() {
+      for (uint64_t i = 0; i < kPerThread; i++) {
+        histogram.record(t * kPerThread + i);
+      }
+    });
+  }
+  for (auto& thread : threads) thread.join();
+  auto snapshot = histogram.snapshot();
+  ASSERT_EQ(snapshot.count, 4 * kPerThread);
+  ASSERT_EQ(snapshot.min, 0);
+  ASSERT_EQ(snapshot.max, 4 * kPerThread - 1);
+  uint64_t total{};
+  for (uint64_t c : snapshot.counts) total += c;
+  ASSERT_EQ(total, 4 * kPerThread);
+}
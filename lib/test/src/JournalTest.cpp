@@ -0,0 +1,385 @@
+#include "gtest/gtest.h"
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "journal.hpp"
+
+namespace {
+using multicast::DeliveryOrder;
+using multicast::Journal;
+
+constexpr std::size_t kWindow{1024};
+constexpr std::size_t kMessageSize{1024};
+
+std::string temp_path(const std::string& name) {
+  return "/tmp/isis_multicast_" + name + "_" + std::to_string(getpid());
+}
+
+std::unique_ptr<Journal> open(const std::string& path,
+                              uint32_t process_id = 0,
+                              std::size_t checkpoint_records = 65536,
+                              uint32_t epoch = 1) {
+  return std::unique_ptr<Journal>{new Journal{
+      path, 1 << 20, process_id, epoch, 3, kWindow, kMessageSize,
+      checkpoint_records, std::chrono::milliseconds{0}}};
+}
+
+/**
+ * Journal an own DataMessage with payload as process 0 sends it.
+ */
+void send(Journal& journal, uint32_t msg_id, const std::string& payload) {
+  messages::DataMessage D{0, msg_id, msg_id};
+  char header[64];
+  std::size_t header_len = D.encode(header, sizeof(header));
+  journal.sent(msg_id, header, header_len, payload.data(), payload.size());
+}
+
+/**
+ * Journal the receipt of message msg_id of sender with payload.
+ */
+void receive(Journal& journal, uint32_t sender, uint32_t msg_id,
+             const std::string& payload) {
+  messages::DataMessage D{sender, msg_id, msg_id};
+  D.payload = payload.data();
+  D.payload_size = payload.size();
+  journal.data(D);
+}
+
+/**
+ * Journal a kCausal StreamMessage of sender held back for stream_seq - 1.
+ */
+void hold(Journal& journal, uint32_t sender, uint32_t msg_id,
+          uint32_t stream_seq, const std::string& payload) {
+  messages::StreamMessage M{sender, msg_id, 0,
+                            static_cast<uint32_t>(DeliveryOrder::kCausal),
+                            stream_seq};
+  uint32_t clock[3]{htonl(0), htonl(stream_seq), htonl(0)};
+  M.clock_size = 3;
+  M.clock = reinterpret_cast<const char*>(clock);
+  M.payload = payload.data();
+  M.payload_size = payload.size();
+  journal.held(M);
+}
+
+/**
+ * Position in the file of the last record written after the first
+ * checkpoint, for a journal that has not wrapped.
+ */
+std::size_t last_record(const std::string& path) {
+  std::ifstream in{path, std::ios_base::binary};
+  std::size_t offset{multicast::journal::kDataOffset};
+  std::size_t last{};
+  multicast::journal::Record record{};
+  while (in.seekg(offset) &&
+         in.read(reinterpret_cast<char*>(&record), sizeof(record)) &&
+         record.size &&
+         record.position == offset - multicast::journal::kDataOffset) {
+    last = offset;
+    offset += record.size;
+  }
+  return last;
+}
+}  // namespace
+
+/************************************************
+ *  Journal Tests
+ ***********************************************/
+TEST(JournalTest, TestNewJournalIsEmpty) {
+  std::string path{temp_path("journal_new")};
+  std::remove(path.c_str());
+  {
+    auto journal = open(path);
+    const auto& recovery = journal->recovery();
+    ASSERT_EQ(recovery.next_msg_id, 0);
+    ASSERT_EQ(recovery.highest_seq, 0);
+    ASSERT_EQ(recovery.delivered, 0);
+    ASSERT_TRUE(recovery.pending.empty());
+    ASSERT_TRUE(recovery.own.empty());
+    ASSERT_EQ(journal->capacity(), 1 << 20);
+  }
+  // Reopened before anything was written
+  auto journal = open(path);
+  ASSERT_EQ(journal->recovery().records, 0);
+  ASSERT_EQ(journal->recovery().seen.size(), 3);
+  std::remove(path.c_str());
+}
+
+TEST(JournalTest, TestRecoversState) {
+  std::string path{temp_path("journal_state")};
+  std::remove(path.c_str());
+  {
+    auto journal = open(path);
+    send(*journal, 0, "own 0");
+    send(*journal, 1, "own 1");
+    receive(*journal, 0, 0, "own 0");
+    receive(*journal, 1, 0, "from 1");
+    receive(*journal, 2, 0, "from 2");
+    journal->proposed(0, 0, 1);
+    journal->proposed(1, 0, 2);
+    journal->proposed(2, 0, 3);
+    // Own message 0 and message 0 of 1 are agreed on, 1 is delivered
+    journal->sequenced(messages::SeqMessage{0, 0, 4, 2});
+    journal->sequenced(messages::SeqMessage{1, 0, 5, 1});
+    journal->delivered(0, 0, 4, 2, DeliveryOrder::kTotal);
+    journal->confirmed(0);
+    journal->delivered(2, 7, 1, 2, DeliveryOrder::kFifo);
+  }
+
+  auto journal = open(path);
+  const auto& recovery = journal->recovery();
+  ASSERT_EQ(recovery.records, 13);
+  ASSERT_EQ(recovery.next_msg_id, 2);
+  ASSERT_EQ(recovery.highest_seq, 5);
+  ASSERT_EQ(recovery.delivered_seq, 4);
+  ASSERT_EQ(recovery.delivered_proposer, 2);
+  ASSERT_EQ(recovery.delivered, 2);
+  ASSERT_TRUE(recovery.seen[0].seen(0));
+  ASSERT_FALSE(recovery.seen[0].seen(1));
+  ASSERT_TRUE(recovery.seen[2].seen(7));
+  ASSERT_EQ(recovery.stream_delivered[2], 1);
+
+  ASSERT_EQ(recovery.pending.size(), 2);
+  for (const auto& pending : recovery.pending) {
+    std::string payload{pending.payload.begin(), pending.payload.end()};
+    if (pending.msg.sender == 1) {
+      ASSERT_EQ(payload, "from 1");
+      ASSERT_EQ(pending.proposal, 2);
+      ASSERT_EQ(pending.msg.final_seq, 5);
+      ASSERT_EQ(pending.msg.final_seq_proposer, 1);
+    } else {
+      ASSERT_EQ(pending.msg.sender, 2);
+      ASSERT_EQ(payload, "from 2");
+      ASSERT_EQ(pending.proposal, 3);
+      ASSERT_EQ(pending.msg.final_seq, 0);
+    }
+  }
+
+  // Own message 0 was confirmed, 1 was not and was never sequenced
+  ASSERT_EQ(recovery.own.size(), 1);
+  ASSERT_EQ(recovery.own[0].msg_id, 1);
+  ASSERT_EQ(recovery.own[0].final_seq, 0);
+  messages::DataMessage D{recovery.own[0].message.data(),
+                          recovery.own[0].message.size()};
+  ASSERT_EQ(D.msg_id, 1);
+  ASSERT_EQ(std::string(D.payload, D.payload_size), "own 1");
+  std::remove(path.c_str());
+}
+
+TEST(JournalTest, TestIgnoresTornTail) {
+  std::string path{temp_path("journal_torn")};
+  std::remove(path.c_str());
+  {
+    auto journal = open(path);
+    receive(*journal, 1, 0, "first");
+    receive(*journal, 1, 1, "second");
+  }
+  // As if the process died halfway through writing the second
+  std::size_t offset{last_record(path)};
+  ASSERT_GT(offset, 0);
+  {
+    std::fstream file{path,
+                      std::ios_base::binary | std::ios_base::in |
+                          std::ios_base::out};
+    file.seekp(offset + sizeof(multicast::journal::Record) +
+               sizeof(multicast::journal::DataBody));
+    file.write("XX", 2);
+  }
+
+  {
+    auto journal = open(path);
+    const auto& recovery = journal->recovery();
+    ASSERT_EQ(recovery.records, 1);
+    ASSERT_EQ(recovery.pending.size(), 1);
+    ASSERT_EQ(recovery.pending[0].msg.msg_id, 0);
+    ASSERT_FALSE(recovery.seen[1].seen(1));
+    // Written over the torn record
+    receive(*journal, 1, 1, "again");
+  }
+  auto journal = open(path);
+  ASSERT_EQ(journal->recovery().records, 2);
+  ASSERT_EQ(journal->recovery().pending.size(), 2);
+  std::remove(path.c_str());
+}
+
+TEST(JournalTest, TestCheckpointsBoundReplay) {
+  std::string path{temp_path("journal_checkpoint")};
+  std::remove(path.c_str());
+  // Several laps of the ring, a message at a time left pending
+  std::string payload(1000, 'p');
+  const uint32_t count{5000};
+  {
+    auto journal = open(path, 0, 100);
+    for (uint32_t i = 0; i < count; i++) {
+      receive(*journal, 1, i, payload);
+      journal->proposed(1, i, i + 1);
+      journal->sequenced(messages::SeqMessage{1, i, i + 1, 0});
+      if (i + 1 < count) {
+        journal->delivered(1, i, i + 1, 0, DeliveryOrder::kTotal);
+      }
+    }
+  }
+
+  auto journal = open(path, 0, 100);
+  const auto& recovery = journal->recovery();
+  ASSERT_LE(recovery.records, 100);
+  ASSERT_EQ(recovery.delivered, count - 1);
+  ASSERT_EQ(recovery.delivered_seq, count - 1);
+  ASSERT_EQ(recovery.highest_seq, count);
+  ASSERT_EQ(recovery.seen[1].base(), count);
+  ASSERT_EQ(recovery.pending.size(), 1);
+  ASSERT_EQ(recovery.pending[0].msg.msg_id, count - 1);
+  ASSERT_EQ(recovery.pending[0].msg.final_seq, count);
+  ASSERT_EQ(std::string(recovery.pending[0].payload.begin(),
+                        recovery.pending[0].payload.end()),
+            payload);
+  std::remove(path.c_str());
+}
+
+TEST(JournalTest, TestCheckpointKeepsState) {
+  std::string path{temp_path("journal_explicit")};
+  std::remove(path.c_str());
+  {
+    auto journal = open(path);
+    send(*journal, 0, "own");
+    receive(*journal, 2, 0, "theirs");
+    receive(*journal, 2, 5, "ahead");
+    hold(*journal, 1, 4, 2, "second");
+    hold(*journal, 1, 6, 3, "third");
+    journal->checkpoint();
+    journal->delivered(2, 3, 1, 2, DeliveryOrder::kCausal);
+    // Released by the first
+    journal->delivered(1, 6, 3, 1, DeliveryOrder::kCausal);
+  }
+
+  auto journal = open(path);
+  const auto& recovery = journal->recovery();
+  ASSERT_EQ(recovery.records, 2);
+  ASSERT_EQ(recovery.next_msg_id, 1);
+  ASSERT_EQ(recovery.own.size(), 1);
+  ASSERT_EQ(recovery.pending.size(), 2);
+  ASSERT_EQ(recovery.seen[2].base(), 1);
+  ASSERT_TRUE(recovery.seen[2].seen(3));
+  ASSERT_TRUE(recovery.seen[2].seen(5));
+  ASSERT_FALSE(recovery.seen[2].seen(4));
+  ASSERT_EQ(recovery.stream_delivered[2], 1);
+  ASSERT_EQ(recovery.held.size(), 1);
+  messages::StreamMessage M{recovery.held[0].data(),
+                            recovery.held[0].size()};
+  ASSERT_EQ(M.sender, 1);
+  ASSERT_EQ(M.msg_id, 4);
+  ASSERT_EQ(M.stream_seq, 2);
+  ASSERT_EQ(M.clock_at(1), 2);
+  ASSERT_EQ(std::string(M.payload, M.payload_size), "second");
+  std::remove(path.c_str());
+}
+
+TEST(JournalTest, TestSyncs) {
+  std::string path{temp_path("journal_sync")};
+  std::remove(path.c_str());
+  {
+    Journal journal{path, 1 << 20, 0, 1, 3, kWindow, kMessageSize, 65536,
+                    std::chrono::milliseconds{1}};
+    for (uint32_t i = 0; i < 100; i++) {
+      receive(journal, 1, i, "payload");
+    }
+    journal.sync();
+  }
+  ASSERT_EQ(open(path)->recovery().pending.size(), 100);
+  std::remove(path.c_str());
+}
+
+TEST(JournalTest, TestKeepsEpochs) {
+  std::string path{temp_path("journal_epoch")};
+  std::remove(path.c_str());
+  {
+    auto journal = open(path, 0, 65536, 5);
+    ASSERT_EQ(journal->recovery().epoch, 5);
+    journal->epoch(1, 100);
+    receive(*journal, 1, 0, "first");
+    receive(*journal, 1, 1, "second");
+    hold(*journal, 2, 3, 2, "held");
+    journal->epoch(2, 300);
+    journal->checkpoint();
+    // Restarted without its state
+    journal->epoch(1, 200);
+    receive(*journal, 1, 0, "again");
+    journal->epoch(2, 400);
+  }
+
+  // Opened by a new incarnation, which carries on as the old one
+  auto journal = open(path, 0, 65536, 9);
+  const auto& recovery = journal->recovery();
+  ASSERT_EQ(recovery.epoch, 5);
+  ASSERT_EQ(recovery.sender_epoch[0], 0);
+  ASSERT_EQ(recovery.sender_epoch[1], 200);
+  ASSERT_EQ(recovery.sender_epoch[2], 400);
+  ASSERT_TRUE(recovery.seen[1].seen(0));
+  ASSERT_FALSE(recovery.seen[1].seen(1));
+  ASSERT_TRUE(recovery.held.empty());
+  std::remove(path.c_str());
+}
+
+TEST(JournalTest, TestRefusesOtherProcess) {
+  std::string path{temp_path("journal_other")};
+  std::remove(path.c_str());
+  { open(path, 0); }
+  ASSERT_THROW(open(path, 1), std::runtime_error);
+  std::remove(path.c_str());
+}
+
+TEST(JournalTest, TestRefusesTooSmallForMessage) {
+  std::string path{temp_path("journal_small")};
+  std::remove(path.c_str());
+  // A checkpoint of a single 512 KiB message does not fit a quarter of 1 MiB
+  ASSERT_THROW(Journal(path, 1 << 20, 0, 1, 3, kWindow, 512 << 10, 65536,
+                       std::chrono::milliseconds{0}),
+               std::runtime_error);
+  // Nothing was kept of it, it may be opened larger
+  Journal journal{path, 4 << 20, 0, 1, 3, kWindow, 512 << 10, 65536,
+                  std::chrono::milliseconds{0}};
+  ASSERT_EQ(journal.capacity(), 4 << 20);
+  ASSERT_EQ(journal.recovery().records, 0);
+  std::remove(path.c_str());
+}
+
+TEST(JournalTest, TestTurnsAwayWhatDoesNotFit) {
+  std::string path{temp_path("journal_full")};
+  std::remove(path.c_str());
+  auto journal = open(path);
+  std::string payload(kMessageSize, 'x');
+  messages::DataMessage D{1, 0, 0};
+  D.payload = payload.data();
+  D.payload_size = payload.size();
+  uint32_t count{};
+  for (; journal->data(D); D.msg_id = ++count) {
+    ASSERT_LT(count, 1000);
+  }
+  // Waiting messages fill up a quarter of the ring, less the duplicate
+  // windows
+  ASSERT_GT(count, 200);
+  ASSERT_FALSE(journal->admit());
+  messages::StreamMessage M{2, 0, 0,
+                            static_cast<uint32_t>(DeliveryOrder::kFifo), 2};
+  M.payload = payload.data();
+  M.payload_size = payload.size();
+  ASSERT_FALSE(journal->held(M));
+
+  // Deliveries make room again
+  journal->delivered(1, 0, 1, 0, DeliveryOrder::kTotal);
+  ASSERT_TRUE(journal->data(D));
+  journal->delivered(1, 1, 2, 0, DeliveryOrder::kTotal);
+  journal->delivered(1, 2, 3, 0, DeliveryOrder::kTotal);
+  ASSERT_TRUE(journal->admit());
+  send(*journal, 0, payload);
+
+  // And a checkpoint takes all of it
+  journal->checkpoint();
+  journal.reset();
+  ASSERT_EQ(open(path)->recovery().pending.size(), count - 2);
+  std::remove(path.c_str());
+}
@@ -0,0 +1,160 @@
+#include "gtest/gtest.h"
+#include <chrono>
+#include <string>
+#include <vector>
+#include <boost/asio.hpp>
+
+#include "loopback.hpp"
+
+namespace {
+/**
+ * A loopback transport on its own io_context that keeps what it receives.
+ */
+struct Node {
+  Node(multicast::LoopbackNetwork& network, uint32_t process_id)
+      : transport{network.transport(process_id)(io_context)},
+        strands{multicast::Strand{io_context.get_executor()}} {
+    transport->start(strands, [this](const multicast::BufferRef&,
+                                     const char* data, std::size_t len) {
+      received.emplace_back(data, len);
+    });
+  }
+
+  void send(const std::string& message, std::size_t destination) {
+    transport->send(
+        multicast::Segments{boost::asio::buffer(message),
+                            boost::asio::const_buffer{}},
+        destination);
+  }
+
+  /**
+   * Poll until count datagrams have arrived or a second has passed.
+   */
+  bool poll_until(std::size_t count) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{1};
+    while (received.size() < count &&
+           std::chrono::steady_clock::now() < deadline) {
+      io_context.poll();
+      io_context.restart();
+    }
+    return received.size() >= count;
+  }
+
+  boost::asio::io_context io_context{};
+  std::unique_ptr<multicast::Transport> transport;
+  std::vector<multicast::Strand> strands;
+  std::vector<std::string> received{};
+};
+}  // namespace
+
+/************************************************
+ *  Delivery Tests
+ ***********************************************/
+TEST(LoopbackTest, TestUnicastReachesOnlyDestination) {
+  multicast::LoopbackNetwork network{2};
+  Node a{network, 0};
+  Node b{network, 1};
+  a.send("hello", 1);
+  ASSERT_TRUE(b.poll_until(1));
+  ASSERT_EQ(b.received, std::vector<std::string>{"hello"});
+  a.io_context.poll();
+  ASSERT_TRUE(a.received.empty());
+  ASSERT_EQ(network.sent(), 1);
+}
+
+TEST(LoopbackTest, TestGroupReachesEveryone) {
+  multicast::LoopbackNetwork network{3};
+  Node a{network, 0};
+  Node b{network, 1};
+  Node c{network, 2};
+  ASSERT_TRUE(a.transport->has_group());
+  a.send("all", network.size());
+  ASSERT_TRUE(a.poll_until(1));
+  ASSERT_TRUE(b.poll_until(1));
+  ASSERT_TRUE(c.poll_until(1));
+  ASSERT_EQ(network.sent(), 3);
+}
+
+TEST(LoopbackTest, TestWithoutGroup) {
+  multicast::LoopbackConfig config{};
+  config.group = false;
+  multicast::LoopbackNetwork network{1, config};
+  Node a{network, 0};
+  ASSERT_FALSE(a.transport->has_group());
+}
+
+TEST(LoopbackTest, TestDelayKeepsOrder) {
+  multicast::LoopbackConfig config{};
+  config.delay = std::chrono::milliseconds{2};
+  multicast::LoopbackNetwork network{2, config};
+  Node a{network, 0};
+  Node b{network, 1};
+  auto sent = std::chrono::steady_clock::now();
+  for (int i = 0; i < 10; i++) {
+    a.send(std::to_string(i), 1);
+  }
+  b.io_context.poll();
+  ASSERT_TRUE(b.received.empty());
+  ASSERT_TRUE(b.poll_until(10));
+  ASSERT_GE(std::chrono::steady_clock::now() - sent, config.delay);
+  for (int i = 0; i < 10; i++) {
+    ASSERT_EQ(b.received[i], std::to_string(i));
+  }
+}
+
+TEST(LoopbackTest, TestJitterReorders) {
+  multicast::LoopbackConfig config{};
+  config.jitter = std::chrono::milliseconds{2};
+  multicast::LoopbackNetwork network{2, config};
+  Node a{network, 0};
+  Node b{network, 1};
+  for (int i = 0; i < 100; i++) {
+    a.send(std::to_string(i), 1);
+  }
+  ASSERT_TRUE(b.poll_until(100));
+  bool reordered{};
+  for (int i = 0; i < 100; i++) {
+    reordered = reordered || b.received[i] != std::to_string(i);
+  }
+  ASSERT_TRUE(reordered);
+}
+
+/************************************************
+ *  Loss Tests
+ ***********************************************/
+TEST(LoopbackTest, TestLossDropsSome) {
+  multicast::LoopbackConfig config{};
+  config.loss = 0.5;
+  multicast::LoopbackNetwork network{2, config};
+  Node a{network, 0};
+  Node b{network, 1};
+  for (int i = 0; i < 1000; i++) {
+    a.send("x", 1);
+  }
+  b.io_context.poll();
+  ASSERT_EQ(b.received.size(), network.sent());
+  ASSERT_EQ(network.sent() + network.dropped(), 1000);
+  ASSERT_GT(network.dropped(), 400);
+  ASSERT_LT(network.dropped(), 600);
+}
+
+TEST(LoopbackTest, TestDetachedDropsAll) {
+  multicast::LoopbackNetwork network{2};
+  Node a{network, 0};
+  {
+    Node b{network, 1};
+    b.transport->close();
+    a.send("lost", 1);
+  }
+  a.send("lost", 1);
+  ASSERT_EQ(network.dropped(), 2);
+  ASSERT_EQ(network.sent(), 0);
+}
+
+TEST(LoopbackTest, TestBadConfig) {
+  multicast::LoopbackConfig config{};
+  config.loss = 2;
+  ASSERT_THROW(multicast::LoopbackNetwork(1, config), std::runtime_error);
+  multicast::LoopbackNetwork network{1};
+  ASSERT_THROW(network.transport(1), std::runtime_error);
+}
@@ -1,4 +1,5 @@
 #include "gtest/gtest.h"
+#include <cstring>
 #include <boost/asio.hpp>
 
 #include "messages.hpp"
@@ -26,17 +27,20 @@ TEST(DataMessageTest, TestDeserialize) {
   uint32_t sender{10};
   uint32_t msg_id{25};
   uint32_t data{0xdeadbeef};
+  uint32_t epoch{7};
   std::vector<uint32_t> buf;
   buf.push_back(htonl(type));
   buf.push_back(htonl(sender));
   buf.push_back(htonl(msg_id));
   buf.push_back(htonl(data));
+  buf.push_back(htonl(epoch));
 
   messages::DataMessage m{buf};
   ASSERT_EQ(m.type, 1);
   ASSERT_EQ(m.sender, sender);
   ASSERT_EQ(m.msg_id, msg_id);
   ASSERT_EQ(m.data, data);
+  ASSERT_EQ(m.epoch, epoch);
   ASSERT_FALSE(m.deliverable);
   ASSERT_EQ(m.final_seq, 0);
   ASSERT_EQ(m.acks_received, 0);
@@ -61,11 +65,13 @@ TEST(DataMessageTest, TestDeserializeLongBuf) {
   uint32_t sender{10};
   uint32_t msg_id{25};
   uint32_t data{0xdeadbeef};
+  uint32_t epoch{7};
   std::vector<uint32_t> buf;
   buf.push_back(htonl(type));
   buf.push_back(htonl(sender));
   buf.push_back(htonl(msg_id));
   buf.push_back(htonl(data));
+  buf.push_back(htonl(epoch));
   buf.push_back(0xffffffff);
 
   messages::DataMessage m{buf};
@@ -73,6 +79,7 @@ TEST(DataMessageTest, TestDeserializeLongBuf) {
   ASSERT_EQ(m.sender, sender);
   ASSERT_EQ(m.msg_id, msg_id);
   ASSERT_EQ(m.data, data);
+  ASSERT_EQ(m.epoch, epoch);
   ASSERT_FALSE(m.deliverable);
   ASSERT_EQ(m.final_seq, 0);
   ASSERT_EQ(m.acks_received, 0);
@@ -94,6 +101,30 @@ TEST(DataMessageTest, TestSerialize) {
   ASSERT_EQ(ntohl(buf[3]), data);
 }
 
+TEST(DataMessageTest, TestDeserializePayload) {
+  messages::DataMessage m{10, 25, 0xdeadbeef};
+  char buf[32]{};
+  std::size_t len = m.encode(buf, sizeof(buf));
+  std::memcpy(buf + len, "payload", 7);
+
+  messages::DataMessage decoded{buf, len + 7};
+  ASSERT_EQ(decoded.data, 0xdeadbeef);
+  ASSERT_EQ(decoded.payload, buf + len);
+  ASSERT_EQ(decoded.payload_size, 7);
+}
+
+TEST(DataMessageTest, TestNoPayload) {
+  messages::DataMessage m{10, 25, 0xdeadbeef};
+  ASSERT_EQ(m.payload, nullptr);
+  ASSERT_EQ(m.payload_size, 0);
+
+  char buf[20]{};
+  m.encode(buf, sizeof(buf));
+  messages::DataMessage decoded{buf, sizeof(buf)};
+  ASSERT_EQ(decoded.payload, nullptr);
+  ASSERT_EQ(decoded.payload_size, 0);
+}
+
 TEST(DataMessageTest, TestSerializeNonEmptyBuf) {
   uint32_t sender{10};
   uint32_t msg_id{25};
@@ -314,4 +345,444 @@ TEST(SeqMessageTest, TestSerializeNonEmptyBuf) {
 
   std::vector<uint32_t> buf{5};
   ASSERT_THROW(m.serialize(buf), std::runtime_error);
-}
\ No newline at end of file
+}
+
+/************************************************
+ *  SeqAck Message Tests
+ ***********************************************/
+TEST(SeqAckMessageTest, TestConstructor) {
+  uint32_t sender{10};
+  uint32_t msg_id{25};
+  uint32_t acker{3};
+  messages::SeqAckMessage m{sender, msg_id, acker};
+
+  ASSERT_EQ(m.type, 5);
+  ASSERT_EQ(m.sender, sender);
+  ASSERT_EQ(m.msg_id, msg_id);
+  ASSERT_EQ(m.acker, acker);
+}
+
+TEST(SeqAckMessageTest, TestDeserialize) {
+  uint32_t type{5};
+  uint32_t sender{10};
+  uint32_t msg_id{25};
+  uint32_t acker{3};
+  std::vector<uint32_t> buf;
+  buf.push_back(htonl(type));
+  buf.push_back(htonl(sender));
+  buf.push_back(htonl(msg_id));
+  buf.push_back(htonl(acker));
+
+  messages::SeqAckMessage m{buf};
+  ASSERT_EQ(m.type, 5);
+  ASSERT_EQ(m.sender, sender);
+  ASSERT_EQ(m.msg_id, msg_id);
+  ASSERT_EQ(m.acker, acker);
+}
+
+TEST(SeqAckMessageTest, TestDeserializeShortBuf) {
+  uint32_t type{5};
+  uint32_t sender{10};
+  uint32_t msg_id{25};
+  std::vector<uint32_t> buf;
+  buf.push_back(htonl(type));
+  buf.push_back(htonl(sender));
+  buf.push_back(htonl(msg_id));
+
+  ASSERT_THROW(messages::SeqAckMessage m{buf}, std::runtime_error);
+}
+
+TEST(SeqAckMessageTest, TestSerialize) {
+  uint32_t sender{10};
+  uint32_t msg_id{25};
+  uint32_t acker{3};
+  messages::SeqAckMessage m{sender, msg_id, acker};
+
+  std::vector<uint32_t> buf{};
+  m.serialize(buf);
+
+  ASSERT_EQ(buf.size(), 4);
+  ASSERT_EQ(ntohl(buf[0]), 5);
+  ASSERT_EQ(ntohl(buf[1]), sender);
+  ASSERT_EQ(ntohl(buf[2]), msg_id);
+  ASSERT_EQ(ntohl(buf[3]), acker);
+}
+
+/************************************************
+ *  Stream Message Tests
+ ***********************************************/
+TEST(StreamMessageTest, TestConstructor) {
+  messages::StreamMessage m{10, 25, 7, 2, 4};
+
+  ASSERT_EQ(m.type, 6);
+  ASSERT_EQ(m.sender, 10);
+  ASSERT_EQ(m.msg_id, 25);
+  ASSERT_EQ(m.data, 7);
+  ASSERT_EQ(m.order, 2);
+  ASSERT_EQ(m.stream_seq, 4);
+  ASSERT_EQ(m.clock_size, 0);
+  ASSERT_EQ(m.payload_size, 0);
+}
+
+TEST(StreamMessageTest, TestRoundTripWithClockAndPayload) {
+  uint32_t clock[3]{htonl(5), htonl(0), htonl(9)};
+  messages::StreamMessage m{1, 25, 7, 1, 9};
+  m.clock_size = 3;
+  m.clock = reinterpret_cast<const char*>(clock);
+  char buf[64];
+  std::size_t len = m.encode(buf, sizeof(buf));
+  ASSERT_EQ(len, messages::codec::WireLayout<messages::StreamMessage>::kSize +
+                     3 * sizeof(uint32_t));
+  std::memcpy(buf + len, "abc", 3);
+
+  messages::StreamMessage decoded{buf, len + 3};
+  ASSERT_EQ(decoded.sender, 1);
+  ASSERT_EQ(decoded.msg_id, 25);
+  ASSERT_EQ(decoded.order, 1);
+  ASSERT_EQ(decoded.stream_seq, 9);
+  ASSERT_EQ(decoded.clock_size, 3);
+  ASSERT_EQ(decoded.clock_at(0), 5);
+  ASSERT_EQ(decoded.clock_at(1), 0);
+  ASSERT_EQ(decoded.clock_at(2), 9);
+  ASSERT_EQ(std::string(decoded.payload, decoded.payload_size), "abc");
+}
+
+TEST(StreamMessageTest, TestSerialize) {
+  uint32_t clock[2]{htonl(3), htonl(4)};
+  messages::StreamMessage m{1, 25, 7, 1, 4};
+  m.clock_size = 2;
+  m.clock = reinterpret_cast<const char*>(clock);
+
+  std::vector<uint32_t> buf{};
+  m.epoch = 11;
+  m.serialize(buf);
+  ASSERT_EQ(buf.size(), 10);
+  ASSERT_EQ(ntohl(buf[0]), 6);
+  ASSERT_EQ(ntohl(buf[6]), 11);
+  ASSERT_EQ(ntohl(buf[7]), 2);
+  ASSERT_EQ(ntohl(buf[8]), 3);
+  ASSERT_EQ(ntohl(buf[9]), 4);
+}
+
+TEST(StreamMessageTest, TestDeserializeTruncatedClock) {
+  uint32_t clock[2]{htonl(3), htonl(4)};
+  messages::StreamMessage m{1, 25, 7, 1, 4};
+  m.clock_size = 2;
+  m.clock = reinterpret_cast<const char*>(clock);
+  std::vector<uint32_t> buf{};
+  m.serialize(buf);
+  buf.pop_back();
+
+  ASSERT_THROW(messages::StreamMessage decoded{buf}, std::runtime_error);
+}
+
+/************************************************
+ *  Frame Tests
+ ***********************************************/
+TEST(FrameTest, TestEmptyFrame) {
+  messages::FrameBuilder frame{64};
+  ASSERT_TRUE(frame.empty());
+  ASSERT_EQ(frame.size(), messages::FrameBuilder::kHeaderSize);
+
+  messages::FrameReader reader{frame.data(), frame.size()};
+  const char* record{};
+  std::size_t len{};
+  ASSERT_EQ(reader.count(), 0);
+  ASSERT_FALSE(reader.next(record, len));
+}
+
+TEST(FrameTest, TestRoundTripMixed) {
+  messages::DataMessage d{1, 2, 0xdeadbeef};
+  messages::AckMessage a{1, 2, 3, 4};
+  messages::SeqMessage s{1, 2, 5, 6};
+  std::vector<uint32_t> d_buf{}, a_buf{}, s_buf{};
+  d.serialize(d_buf);
+  a.serialize(a_buf);
+  s.serialize(s_buf);
+
+  messages::FrameBuilder frame{1400};
+  ASSERT_TRUE(frame.append(d_buf.data(), 20));
+  ASSERT_TRUE(frame.append(a_buf.data(), 20));
+  ASSERT_TRUE(frame.append(s_buf.data(), 20));
+  ASSERT_EQ(frame.count(), 3);
+  ASSERT_EQ(frame.size(), 8 + 3 * 4 + 20 + 20 + 20);
+
+  messages::FrameReader reader{frame.data(), frame.size()};
+  ASSERT_EQ(reader.count(), 3);
+  const char* record{};
+  std::size_t len{};
+  std::vector<uint32_t> buf(5);
+
+  ASSERT_TRUE(reader.next(record, len));
+  ASSERT_EQ(len, 20);
+  std::memcpy(buf.data(), record, len);
+  messages::DataMessage d2{buf};
+  ASSERT_EQ(d2.msg_id, 2);
+  ASSERT_EQ(d2.data, 0xdeadbeef);
+
+  ASSERT_TRUE(reader.next(record, len));
+  ASSERT_EQ(len, 20);
+  std::memcpy(buf.data(), record, len);
+  messages::AckMessage a2{buf};
+  ASSERT_EQ(a2.proposed_seq, 3);
+  ASSERT_EQ(a2.proposer, 4);
+
+  ASSERT_TRUE(reader.next(record, len));
+  std::memcpy(buf.data(), record, len);
+  messages::SeqMessage s2{buf};
+  ASSERT_EQ(s2.final_seq, 5);
+  ASSERT_EQ(s2.final_seq_proposer, 6);
+
+  ASSERT_FALSE(reader.next(record, len));
+}
+
+TEST(FrameTest, TestUnalignedRecordPadded) {
+  messages::FrameBuilder frame{64};
+  ASSERT_TRUE(frame.append("abc", 3));
+  ASSERT_TRUE(frame.append("defgh", 5));
+  ASSERT_EQ(frame.size(), 8 + 4 + 4 + 4 + 8);
+
+  messages::FrameReader reader{frame.data(), frame.size()};
+  const char* record{};
+  std::size_t len{};
+  ASSERT_TRUE(reader.next(record, len));
+  ASSERT_EQ(std::string(record, len), "abc");
+  ASSERT_TRUE(reader.next(record, len));
+  ASSERT_EQ(std::string(record, len), "defgh");
+  ASSERT_FALSE(reader.next(record, len));
+}
+
+TEST(FrameTest, TestAppendHeaderAndPayload) {
+  messages::FrameBuilder frame{64};
+  ASSERT_TRUE(frame.append("head", 4, "payload", 7));
+  ASSERT_TRUE(frame.append("x", 1, nullptr, 0));
+
+  messages::FrameReader reader{frame.data(), frame.size()};
+  const char* record{};
+  std::size_t len{};
+  ASSERT_TRUE(reader.next(record, len));
+  ASSERT_EQ(std::string(record, len), "headpayload");
+  ASSERT_TRUE(reader.next(record, len));
+  ASSERT_EQ(std::string(record, len), "x");
+}
+
+TEST(FrameTest, TestFull) {
+  messages::FrameBuilder frame{8 + 2 * (4 + 20)};
+  char record[20]{};
+  ASSERT_TRUE(frame.append(record, 20));
+  ASSERT_TRUE(frame.append(record, 20));
+  ASSERT_FALSE(frame.fits(1));
+  ASSERT_FALSE(frame.append(record, 1));
+  ASSERT_EQ(frame.count(), 2);
+
+  frame.clear();
+  ASSERT_TRUE(frame.empty());
+  ASSERT_TRUE(frame.append(record, 20));
+}
+
+TEST(FrameTest, TestReadShortBuf) {
+  char buf[4]{};
+  ASSERT_THROW(messages::FrameReader(buf, 4), std::runtime_error);
+}
+
+TEST(FrameTest, TestReadWrongType) {
+  std::vector<uint32_t> buf{htonl(1), htonl(0)};
+  ASSERT_THROW(messages::FrameReader((char*)buf.data(), 8),
+               std::runtime_error);
+}
+
+TEST(FrameTest, TestReadTruncatedRecord) {
+  messages::FrameBuilder frame{64};
+  char record[20]{};
+  frame.append(record, 20);
+
+  messages::FrameReader reader{frame.data(), frame.size() - 4};
+  const char* data{};
+  std::size_t len{};
+  ASSERT_THROW(reader.next(data, len), std::runtime_error);
+}
+
+TEST(FrameTest, TestReadCountPastEnd) {
+  std::vector<uint32_t> buf{htonl(messages::FrameBuilder::kType), htonl(3)};
+  messages::FrameReader reader{(char*)buf.data(), 8};
+  const char* data{};
+  std::size_t len{};
+  ASSERT_THROW(reader.next(data, len), std::runtime_error);
+}
+
+/************************************************
+ *  Catchup Tests
+ ***********************************************/
+TEST(CatchupTest, TestRequestSerialize) {
+  messages::CatchupRequestMessage m{2, 40, 1};
+
+  std::vector<uint32_t> buf{};
+  m.serialize(buf);
+  ASSERT_EQ(buf.size(), 4);
+  ASSERT_EQ(ntohl(buf[0]), 7);
+
+  messages::CatchupRequestMessage decoded{buf};
+  ASSERT_EQ(decoded.requester, 2);
+  ASSERT_EQ(decoded.after_seq, 40);
+  ASSERT_EQ(decoded.after_proposer, 1);
+}
+
+TEST(CatchupTest, TestRoundTrip) {
+  messages::CatchupBuilder batch{256};
+  batch.start(1, 40, 2);
+  messages::DataMessage a{0, 7, 70};
+  a.epoch = 5;
+  a.final_seq = 41;
+  a.final_seq_proposer = 0;
+  a.payload = "abc";
+  a.payload_size = 3;
+  messages::DataMessage b{2, 9, 90};
+  b.final_seq = 41;
+  b.final_seq_proposer = 2;
+  ASSERT_TRUE(batch.append(a));
+  ASSERT_TRUE(batch.append(b));
+  batch.set_status(messages::CatchupBuilder::kDone);
+  ASSERT_EQ(batch.size(), 24 + 28 + 4 + 28);
+  ASSERT_EQ(batch.last_seq(), 41);
+  ASSERT_EQ(batch.last_proposer(), 2);
+
+  messages::CatchupReader reader{batch.data(), batch.size()};
+  ASSERT_EQ(reader.responder(), 1);
+  ASSERT_EQ(reader.after_seq(), 40);
+  ASSERT_EQ(reader.after_proposer(), 2);
+  ASSERT_EQ(reader.status(), messages::CatchupBuilder::kDone);
+  ASSERT_EQ(reader.count(), 2);
+  messages::DataMessage m{0, 0, 0};
+  ASSERT_TRUE(reader.next(m));
+  ASSERT_EQ(m.sender, 0);
+  ASSERT_EQ(m.msg_id, 7);
+  ASSERT_EQ(m.data, 70);
+  ASSERT_EQ(m.epoch, 5);
+  ASSERT_EQ(m.final_seq, 41);
+  ASSERT_TRUE(m.deliverable);
+  ASSERT_EQ(std::string(m.payload, m.payload_size), "abc");
+  ASSERT_TRUE(reader.next(m));
+  ASSERT_EQ(m.sender, 2);
+  ASSERT_EQ(m.final_seq_proposer, 2);
+  ASSERT_EQ(m.payload_size, 0);
+  ASSERT_FALSE(reader.next(m));
+
+  // Starting over leaves an empty batch
+  batch.start(1, 41, 2);
+  ASSERT_EQ(batch.count(), 0);
+  ASSERT_EQ(batch.size(), messages::CatchupBuilder::kHeaderSize);
+  ASSERT_EQ(batch.last_seq(), 41);
+  ASSERT_EQ(messages::CatchupReader(batch.data(), batch.size()).status(),
+            messages::CatchupBuilder::kMore);
+}
+
+TEST(CatchupTest, TestFull) {
+  messages::CatchupBuilder batch{24 + 2 * 28};
+  batch.start(0, 0, 0);
+  messages::DataMessage m{0, 1, 0};
+  ASSERT_TRUE(batch.append(m));
+  ASSERT_TRUE(batch.append(m));
+  ASSERT_FALSE(batch.append(m));
+  ASSERT_EQ(batch.count(), 2);
+}
+
+TEST(CatchupTest, TestReadTruncated) {
+  messages::CatchupBuilder batch{256};
+  batch.start(0, 0, 0);
+  messages::DataMessage m{0, 1, 0};
+  m.payload = "payload";
+  m.payload_size = 7;
+  batch.append(m);
+
+  messages::CatchupReader reader{batch.data(), batch.size() - 8};
+  ASSERT_THROW(reader.next(m), std::runtime_error);
+  ASSERT_THROW(messages::CatchupReader(batch.data(), 20), std::runtime_error);
+}
+
+/************************************************
+ *  Fragment Tests
+ ***********************************************/
+TEST(FragmentTest, TestRoundTrip) {
+  messages::FragmentMessage m{2, 17, 5000, 1400, 1, 4};
+  char buf[32]{};
+  ASSERT_EQ(m.encode(buf, 28), 28);
+  std::memcpy(buf + 28, "abc", 3);
+
+  messages::FragmentMessage decoded{buf, 31};
+  ASSERT_EQ(decoded.type, 9);
+  ASSERT_EQ(decoded.sender, 2);
+  ASSERT_EQ(decoded.msg_id, 17);
+  ASSERT_EQ(decoded.size, 5000);
+  ASSERT_EQ(decoded.offset, 1400);
+  ASSERT_EQ(decoded.index, 1);
+  ASSERT_EQ(decoded.count, 4);
+  ASSERT_EQ(std::string(decoded.bytes, decoded.bytes_size), "abc");
+}
+
+TEST(FragmentTest, TestSerializeWithoutBytes) {
+  messages::FragmentMessage m{0, 1, 2, 0, 0, 1};
+  std::vector<uint32_t> buf{};
+  m.serialize(buf);
+  ASSERT_EQ(buf.size(), 7);
+  ASSERT_EQ(ntohl(buf[0]), 9);
+
+  messages::FragmentMessage decoded{buf};
+  ASSERT_EQ(decoded.bytes, nullptr);
+  ASSERT_EQ(decoded.bytes_size, 0);
+  ASSERT_THROW(messages::FragmentMessage(buf.data(), 27), std::runtime_error);
+}
+
+/************************************************
+ *  Codec Tests
+ ***********************************************/
+TEST(CodecTest, TestLayoutSizes) {
+  ASSERT_EQ(messages::codec::WireLayout<messages::DataMessage>::kSize, 20);
+  ASSERT_EQ(messages::codec::WireLayout<messages::AckMessage>::kSize, 20);
+  ASSERT_EQ(messages::codec::WireLayout<messages::SeqMessage>::kSize, 20);
+}
+
+TEST(CodecTest, TestEncodeMatchesSerialize) {
+  messages::AckMessage m{10, 25, 0xdeadbeef, 420};
+  std::vector<uint32_t> serialized{};
+  m.serialize(serialized);
+
+  char buf[32]{};
+  ASSERT_EQ(m.encode(buf, sizeof(buf)), 20);
+  ASSERT_EQ(std::memcmp(buf, serialized.data(), 20), 0);
+}
+
+TEST(CodecTest, TestEncodeShortBuf) {
+  messages::SeqMessage m{10, 25, 0xdeadbeef, 420};
+  char buf[19]{};
+  ASSERT_THROW(m.encode(buf, sizeof(buf)), std::runtime_error);
+}
+
+TEST(CodecTest, TestDecodeUnaligned) {
+  messages::DataMessage m{10, 25, 0xdeadbeef};
+  m.epoch = 3;
+  char buf[21]{};
+  ASSERT_EQ(m.encode(buf + 1, 20), 20);
+
+  messages::DataMessage decoded{buf + 1, 20};
+  ASSERT_EQ(decoded.type, 1);
+  ASSERT_EQ(decoded.sender, 10);
+  ASSERT_EQ(decoded.msg_id, 25);
+  ASSERT_EQ(decoded.data, 0xdeadbeef);
+  ASSERT_EQ(decoded.epoch, 3);
+  ASSERT_FALSE(decoded.deliverable);
+}
+
+TEST(CodecTest, TestDecodeShortBuf) {
+  char buf[20]{};
+  ASSERT_THROW(messages::DataMessage(buf, 19), std::runtime_error);
+  ASSERT_THROW(messages::AckMessage(buf, 19), std::runtime_error);
+  ASSERT_THROW(messages::SeqMessage(buf, 0), std::runtime_error);
+}
+
+TEST(CodecTest, TestPeekType) {
+  messages::SeqMessage m{1, 2, 3, 4};
+  char buf[20]{};
+  m.encode(buf, sizeof(buf));
+  ASSERT_EQ(messages::codec::peek_type(buf, sizeof(buf)), 3);
+  ASSERT_THROW(messages::codec::peek_type(buf, 3), std::runtime_error);
+}
@@ -0,0 +1,128 @@
+#include "gtest/gtest.h"
+#include <boost/asio.hpp>
+
+#include "mmsg.hpp"
+
+using boost::asio::ip::udp;
+
+/************************************************
+ *  recvmmsg / sendmmsg Tests
+ ***********************************************/
+TEST(MmsgTest, TestSendAndReceiveBatch) {
+  if (!multicast::mmsg_supported()) GTEST_SKIP();
+  boost::asio::io_context io_context{};
+  udp::socket receiver{io_context, udp::endpoint{udp::v4(), 0}};
+  udp::socket sender{io_context, udp::endpoint{udp::v4(), 0}};
+  receiver.non_blocking(true);
+  udp::endpoint destination{boost::asio::ip::make_address("127.0.0.1"),
+                            receiver.local_endpoint().port()};
+
+  std::vector<std::string> payloads{"one", "two", "three"};
+  std::vector<multicast::OutgoingDatagram> datagrams{};
+  for (auto& payload : payloads) {
+    datagrams.push_back(multicast::OutgoingDatagram{
+        multicast::Segments{boost::asio::buffer(payload),
+                            boost::asio::const_buffer{}},
+        &destination});
+  }
+  boost::system::error_code error{};
+  ASSERT_EQ(multicast::send_batch(sender.native_handle(), datagrams, error), 3);
+  ASSERT_FALSE(error);
+
+  multicast::MmsgReceiver mmsg{8, 64};
+  std::size_t received{};
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{2};
+  std::vector<std::string> seen{};
+  while (seen.size() < 3 && std::chrono::steady_clock::now() < deadline) {
+    received = mmsg.receive(receiver.native_handle(), error);
+    ASSERT_FALSE(error);
+    for (std::size_t slot = 0; slot < received; slot++) {
+      seen.emplace_back(mmsg.data(slot), mmsg.size(slot));
+    }
+  }
+  ASSERT_EQ(seen, payloads);
+}
+
+TEST(MmsgTest, TestReceiveEmpty) {
+  if (!multicast::mmsg_supported()) GTEST_SKIP();
+  boost::asio::io_context io_context{};
+  udp::socket receiver{io_context, udp::endpoint{udp::v4(), 0}};
+  receiver.non_blocking(true);
+
+  multicast::MmsgReceiver mmsg{4, 64};
+  boost::system::error_code error{};
+  ASSERT_EQ(mmsg.receive(receiver.native_handle(), error), 0);
+  ASSERT_FALSE(error);
+}
+
+TEST(MmsgTest, TestReceiveTruncated) {
+  if (!multicast::mmsg_supported()) GTEST_SKIP();
+  boost::asio::io_context io_context{};
+  udp::socket receiver{io_context, udp::endpoint{udp::v4(), 0}};
+  udp::socket sender{io_context, udp::endpoint{udp::v4(), 0}};
+  receiver.non_blocking(true);
+  udp::endpoint destination{boost::asio::ip::make_address("127.0.0.1"),
+                            receiver.local_endpoint().port()};
+  std::string payload(100, 'x');
+  sender.send_to(boost::asio::buffer(payload), destination);
+
+  multicast::MmsgReceiver mmsg{4, 16};
+  boost::system::error_code error{};
+  std::size_t received{};
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{2};
+  while (!received && std::chrono::steady_clock::now() < deadline) {
+    received = mmsg.receive(receiver.native_handle(), error);
+  }
+  ASSERT_EQ(received, 1);
+  ASSERT_TRUE(mmsg.truncated(0));
+}
+
+TEST(MmsgTest, TestPacksSmallDatagrams) {
+  if (!multicast::mmsg_supported()) GTEST_SKIP();
+  boost::asio::io_context io_context{};
+  udp::socket receiver{io_context, udp::endpoint{udp::v4(), 0}};
+  udp::socket sender{io_context, udp::endpoint{udp::v4(), 0}};
+  receiver.non_blocking(true);
+  udp::endpoint destination{boost::asio::ip::make_address("127.0.0.1"),
+                            receiver.local_endpoint().port()};
+  std::vector<std::string> payloads{"one", "two", std::string(40, 'x')};
+  for (auto& payload : payloads) {
+    sender.send_to(boost::asio::buffer(payload), destination);
+  }
+
+  multicast::MmsgReceiver mmsg{8, 64};
+  boost::system::error_code error{};
+  // Held like payloads that are not delivered yet
+  std::vector<multicast::BufferRef> held{};
+  std::vector<const char*> data{};
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{2};
+  while (held.size() < 3 && std::chrono::steady_clock::now() < deadline) {
+    std::size_t received = mmsg.receive(receiver.native_handle(), error);
+    for (std::size_t slot = 0; slot < received; slot++) {
+      ASSERT_EQ(std::string(mmsg.data(slot), mmsg.size(slot)),
+                payloads[held.size()]);
+      held.push_back(mmsg.buffer(slot));
+      data.push_back(mmsg.data(slot));
+    }
+  }
+  ASSERT_EQ(held.size(), 3);
+  // The small ones share a packed buffer, 8 byte aligned, the large one
+  // keeps its slot
+  ASSERT_EQ(held[0].get(), held[1].get());
+  ASSERT_EQ(held[0]->capacity(), 4 * 64);
+  ASSERT_EQ(data[1] - data[0], 8);
+  ASSERT_EQ(held[2]->capacity(), 64);
+
+  // Reading on does not overwrite what is held
+  sender.send_to(boost::asio::buffer(std::string{"four"}), destination);
+  std::size_t received{};
+  deadline = std::chrono::steady_clock::now() + std::chrono::seconds{2};
+  while (!received && std::chrono::steady_clock::now() < deadline) {
+    received = mmsg.receive(receiver.native_handle(), error);
+  }
+  ASSERT_EQ(received, 1);
+  ASSERT_EQ(std::string(mmsg.data(0), mmsg.size(0)), "four");
+  ASSERT_EQ(std::string(data[0], 3), "one");
+  ASSERT_EQ(std::string(data[1], 3), "two");
+  ASSERT_EQ(std::string(data[2], 40), std::string(40, 'x'));
+}
@@ -1,18 +1,22 @@
 #include "gtest/gtest.h"
+#include <atomic>
+#include <cstdio>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unistd.h>
 #include <boost/asio.hpp>
 
+#include "loopback.hpp"
 #include "messages.hpp"
 #include "multicast.hpp"
 
 // TODO so testing single multicaster for things like bad messages incoming
 // etc is easy enough to do
 
-// TODO multiple casters is harder, because of the way that we defined the 
-// whole thing we expect to be sending out on the same port that we're
-// listening on. 
-// ??? Option to do whatever using docker, which we probably should do at some 
-// point, but there's also the idea of using a mock. But is too much of the 
-// functionality already baked into the main thing
+// Multiple casters can't share a port, so the multi node tests wire them
+// together on a LoopbackNetwork instead.
 
 // TODO some setup things, failed to bind port, multiple multi on same port
 
@@ -50,4 +54,1401 @@
 // XXX I don't think that mocking will help here, 1) we don't have a interface
 // with virtual methods to mock and 2) there's nothing that really gets passed
 // to the functions beyond the initial multicast etc.
-// Actually that may be worth mocking not really sure
\ No newline at end of file
+// Actually that may be worth mocking not really sure
+
+namespace {
+/**
+ * Poll until every pending message has been delivered or timeout expires.
+ */
+bool poll_until_delivered(multicast::Multicaster& multicaster,
+                          std::size_t expected) {
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{5};
+  while (std::chrono::steady_clock::now() < deadline) {
+    multicaster.poll();
+    auto stats = multicaster.pool_stats();
+    if (stats.high_water >= expected && stats.in_use == 0) return true;
+  }
+  return false;
+}
+
+/**
+ * Wait for worker threads to deliver expected messages or timeout to expire.
+ */
+bool wait_until_delivered(const multicast::Multicaster& multicaster,
+                          std::size_t expected) {
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{5};
+  while (std::chrono::steady_clock::now() < deadline) {
+    if (multicaster.delivered() >= expected) return true;
+    std::this_thread::sleep_for(std::chrono::milliseconds{1});
+  }
+  return false;
+}
+
+/**
+ * Keeps every delivery it is handed.
+ */
+class CollectingSink : public multicast::DeliverySink {
+ public:
+  void deliver(multicast::Delivery* deliveries, std::size_t count) override {
+    batches++;
+    for (std::size_t i = 0; i < count; i++) {
+      delivered.push_back(std::move(deliveries[i]));
+    }
+  }
+
+  std::vector<multicast::Delivery> delivered{};
+  int batches{};
+};
+
+/**
+ * A group of Multicasters on one LoopbackNetwork, each with its own sink,
+ * polled round robin from the test thread.
+ */
+struct LoopbackGroup {
+  // Adjusts the config of a single node
+  using Tweak = std::function<void(uint32_t, multicast::Config&)>;
+
+  LoopbackGroup(std::size_t size, const multicast::Config& config,
+                const multicast::LoopbackConfig& network_config =
+                    multicast::LoopbackConfig{},
+                const Tweak& tweak = Tweak{})
+      : network{size, network_config}, sinks(size) {
+    for (uint32_t i = 0; i < size; i++) {
+      multicast::Config node_config{config};
+      if (tweak) tweak(i, node_config);
+      nodes.emplace_back(new multicast::Multicaster{
+          size, i, network.transport(i), node_config});
+      nodes.back()->set_sink(&sinks[i]);
+    }
+  }
+
+  ~LoopbackGroup() {
+    for (auto& node : nodes) node->set_sink(nullptr);
+  }
+
+  void poll() {
+    for (auto& node : nodes) node->poll();
+  }
+
+  /**
+   * Poll until every node has delivered expected messages and has none of
+   * its own in flight, or timeout expires.
+   */
+  bool poll_until_delivered(std::size_t expected) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{10};
+    while (std::chrono::steady_clock::now() < deadline) {
+      poll();
+      bool done{true};
+      for (auto& node : nodes) {
+        done = done && node->delivered() >= expected && !node->in_flight();
+      }
+      if (done) return true;
+    }
+    return false;
+  }
+
+  /**
+   * Check that every node delivered the same messages in the same order.
+   */
+  void expect_agreement() const {
+    for (std::size_t i = 1; i < sinks.size(); i++) {
+      ASSERT_EQ(sinks[i].delivered.size(), sinks[0].delivered.size());
+      for (std::size_t k = 0; k < sinks[0].delivered.size(); k++) {
+        auto& expected = sinks[0].delivered[k];
+        auto& delivery = sinks[i].delivered[k];
+        ASSERT_EQ(delivery.sender, expected.sender);
+        ASSERT_EQ(delivery.msg_id, expected.msg_id);
+        ASSERT_EQ(delivery.data, expected.data);
+        ASSERT_EQ(delivery.final_seq, expected.final_seq);
+        ASSERT_EQ(delivery.final_seq_proposer, expected.final_seq_proposer);
+      }
+    }
+  }
+
+  multicast::LoopbackNetwork network;
+  std::vector<std::unique_ptr<multicast::Multicaster>> nodes{};
+  // Go before the nodes, whose pools their payloads point into
+  std::vector<CollectingSink> sinks;
+};
+
+/**
+ * Have every node of group multicast count messages, interleaved, with data
+ * sender * count + i.
+ */
+void multicast_from_all(LoopbackGroup& group, uint32_t count) {
+  uint32_t size = static_cast<uint32_t>(group.nodes.size());
+  for (uint32_t i = 0; i < count; i++) {
+    for (uint32_t p = 0; p < size; p++) {
+      std::string payload{"payload " + std::to_string(p * count + i)};
+      group.nodes[p]->multicast(payload.data(), payload.size(),
+                                p * count + i);
+    }
+    group.poll();
+  }
+}
+}  // namespace
+
+/************************************************
+ *  Single Node Tests
+ ***********************************************/
+TEST(MulticasterTest, TestSingleNodeDelivers) {
+  std::vector<std::string> hosts{"127.0.0.1"};
+  multicast::Multicaster multicaster{hosts, 47001, 0};
+  for (uint32_t i = 0; i < 10; i++) {
+    multicaster.multicast(i);
+  }
+  ASSERT_TRUE(poll_until_delivered(multicaster, 1));
+}
+
+TEST(MulticasterTest, TestSingleNodeDeliversBatched) {
+  std::vector<std::string> hosts{"127.0.0.1"};
+  multicast::Config config{};
+  config.batch_max_bytes = 1400;
+  config.batch_delay = std::chrono::microseconds{100};
+  multicast::Multicaster multicaster{hosts, 47002, 0, config};
+  for (uint32_t i = 0; i < 100; i++) {
+    multicaster.multicast(i);
+  }
+  // All data messages leave in one frame so they are all pending at once
+  ASSERT_TRUE(poll_until_delivered(multicaster, 100));
+}
+
+TEST(MulticasterTest, TestSingleNodeDeliversMmsg) {
+  std::vector<std::string> hosts{"127.0.0.1"};
+  multicast::Config config{};
+  config.use_mmsg = true;
+  multicast::Multicaster multicaster{hosts, 47003, 0, config};
+  for (uint32_t i = 0; i < 10; i++) {
+    multicaster.multicast(i);
+  }
+  ASSERT_TRUE(poll_until_delivered(multicaster, 1));
+}
+
+TEST(MulticasterTest, TestSingleNodeDeliversMmsgBatched) {
+  std::vector<std::string> hosts{"127.0.0.1"};
+  multicast::Config config{};
+  config.use_mmsg = true;
+  config.batch_max_bytes = 1400;
+  multicast::Multicaster multicaster{hosts, 47004, 0, config};
+  for (uint32_t i = 0; i < 100; i++) {
+    multicaster.multicast(i);
+  }
+  ASSERT_TRUE(poll_until_delivered(multicaster, 100));
+}
+
+TEST(MulticasterTest, TestSingleNodeDeliversPayload) {
+  std::vector<std::string> hosts{"127.0.0.1"};
+  multicast::Config config{};
+  config.batch_max_bytes = 1400;
+  multicast::Multicaster multicaster{hosts, 47005, 0, config};
+  std::vector<char> small(100, 'a');
+  std::vector<char> large(4000, 'b');
+  for (uint32_t i = 0; i < 10; i++) {
+    // Large payloads do not fit in a frame and go out on their own
+    auto& payload = i % 2 ? large : small;
+    multicaster.multicast(payload.data(), payload.size(), i);
+  }
+  ASSERT_TRUE(poll_until_delivered(multicaster, 1));
+}
+
+TEST(MulticasterTest, TestPayloadTooLarge) {
+  std::vector<std::string> hosts{"127.0.0.1"};
+  multicast::Config config{};
+  config.max_payload_size = 16;
+  multicast::Multicaster multicaster{hosts, 47006, 0, config};
+  std::vector<char> payload(17);
+  ASSERT_THROW(multicaster.multicast(payload.data(), payload.size()),
+               std::runtime_error);
+}
+
+TEST(MulticasterTest, TestSingleNodeDeliversThreaded) {
+  std::vector<std::string> hosts{"127.0.0.1"};
+  multicast::Config config{};
+  config.threads = 2;
+  config.cpu_affinity = {0};
+  multicast::Multicaster multicaster{hosts, 47007, 0, config};
+  multicaster.start();
+  for (uint32_t i = 0; i < 100; i++) {
+    multicaster.multicast(i);
+  }
+  ASSERT_TRUE(wait_until_delivered(multicaster, 100));
+  multicaster.stop();
+  ASSERT_EQ(multicaster.pool_stats().in_use, 0);
+}
+
+TEST(MulticasterTest, TestSingleNodeDeliversThreadedBatchedMmsg) {
+  std::vector<std::string> hosts{"127.0.0.1"};
+  multicast::Config config{};
+  config.threads = 4;
+  config.batch_max_bytes = 1400;
+  config.use_mmsg = true;
+  multicast::Multicaster multicaster{hosts, 47008, 0, config};
+  multicaster.start();
+  std::vector<char> payload(200, 'p');
+  for (uint32_t i = 0; i < 200; i++) {
+    multicaster.multicast(payload.data(), payload.size(), i);
+  }
+  ASSERT_TRUE(wait_until_delivered(multicaster, 200));
+}
+
+TEST(MulticasterTest, TestPolledShardsDeliver) {
+  std::vector<std::string> hosts{"127.0.0.1"};
+  multicast::Config config{};
+  config.threads = 3;
+  multicast::Multicaster multicaster{hosts, 47009, 0, config};
+  for (uint32_t i = 0; i < 10; i++) {
+    multicaster.multicast(i);
+  }
+  // Without start() the handoffs between strands are run by poll()
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{5};
+  while (multicaster.delivered() < 10 &&
+         std::chrono::steady_clock::now() < deadline) {
+    multicaster.poll();
+  }
+  ASSERT_EQ(multicaster.delivered(), 10);
+  ASSERT_EQ(multicaster.pool_stats().in_use, 0);
+}
+
+TEST(MulticasterTest, TestWaitStrategiesDeliver) {
+  const multicast::WaitStrategy strategies[]{
+      multicast::WaitStrategy::kBlock, multicast::WaitStrategy::kSpinThenBlock,
+      multicast::WaitStrategy::kBusyPoll};
+  uint16_t port{47010};
+  for (auto strategy : strategies) {
+    std::vector<std::string> hosts{"127.0.0.1"};
+    multicast::Config config{};
+    config.wait_strategy = strategy;
+    multicast::Multicaster multicaster{hosts, port++, 0, config};
+    multicaster.start();
+    for (uint32_t i = 0; i < 20; i++) {
+      multicaster.multicast(i);
+    }
+    ASSERT_TRUE(wait_until_delivered(multicaster, 20));
+  }
+}
+
+TEST(MulticasterTest, TestStopEndsRun) {
+  std::vector<std::string> hosts{"127.0.0.1"};
+  multicast::Config config{};
+  config.wait_strategy = multicast::WaitStrategy::kSpinThenBlock;
+  multicast::Multicaster multicaster{hosts, 47013, 0, config};
+  std::thread runner{[&multicaster]() { multicaster.run(); }};
+  std::this_thread::sleep_for(std::chrono::milliseconds{10});
+  multicaster.multicast(1);
+  ASSERT_TRUE(wait_until_delivered(multicaster, 1));
+  multicaster.stop();
+  runner.join();
+}
+
+TEST(MulticasterTest, TestWindowRefusesWhenFull) {
+  std::vector<std::string> hosts{"127.0.0.1"};
+  multicast::Config config{};
+  config.max_in_flight = 4;
+  multicast::Multicaster multicaster{hosts, 47014, 0, config};
+  int opened{};
+  multicaster.on_window_open([&opened]() { opened++; });
+  for (uint32_t i = 0; i < 4; i++) {
+    ASSERT_TRUE(multicaster.try_multicast(nullptr, 0, i));
+  }
+  ASSERT_FALSE(multicaster.try_multicast(nullptr, 0, 4));
+  ASSERT_EQ(multicaster.in_flight(), 4);
+
+  ASSERT_TRUE(poll_until_delivered(multicaster, 4));
+  ASSERT_EQ(multicaster.in_flight(), 0);
+  // Reported once for the one refusal
+  ASSERT_EQ(opened, 1);
+  ASSERT_TRUE(multicaster.try_multicast(nullptr, 0, 5));
+}
+
+TEST(MulticasterTest, TestWindowPumpsThreaded) {
+  std::vector<std::string> hosts{"127.0.0.1"};
+  multicast::Config config{};
+  config.threads = 2;
+  config.max_in_flight = 8;
+  config.batch_max_bytes = 1400;
+  multicast::Multicaster multicaster{hosts, 47015, 0, config};
+  constexpr uint32_t kCount{500};
+  std::mutex mutex{};
+  uint32_t next{};
+  auto pump = [&]() {
+    std::lock_guard<std::mutex> lock{mutex};
+    while (next < kCount && multicaster.try_multicast(nullptr, 0, next)) {
+      next++;
+    }
+  };
+  multicaster.on_window_open(pump);
+  multicaster.start();
+  pump();
+  ASSERT_TRUE(wait_until_delivered(multicaster, kCount));
+  ASSERT_EQ(multicaster.in_flight(), 0);
+}
+
+TEST(MulticasterTest, TestSinkGetsOrderedPayloads) {
+  std::vector<std::string> hosts{"127.0.0.1"};
+  multicast::Config config{};
+  config.batch_max_bytes = 1400;
+  multicast::Multicaster multicaster{hosts, 47016, 0, config};
+  CollectingSink sink{};
+  multicaster.set_sink(&sink);
+  for (uint32_t i = 0; i < 20; i++) {
+    std::string payload{"payload " + std::to_string(i)};
+    multicaster.multicast(payload.data(), payload.size(), i);
+  }
+  ASSERT_TRUE(poll_until_delivered(multicaster, 20));
+
+  ASSERT_EQ(sink.delivered.size(), 20);
+  ASSERT_LE(sink.batches, 20);
+  for (uint32_t i = 0; i < 20; i++) {
+    auto& delivery = sink.delivered[i];
+    ASSERT_EQ(delivery.data, i);
+    ASSERT_EQ(delivery.final_seq, i + 1);
+    ASSERT_EQ(std::string(delivery.payload.data, delivery.payload.size),
+              "payload " + std::to_string(i));
+  }
+}
+
+TEST(MulticasterTest, TestRingSinkAcrossThreads) {
+  std::vector<std::string> hosts{"127.0.0.1"};
+  multicast::Config config{};
+  config.threads = 2;
+  // Keep the burst within the socket buffer so nothing waits on a resend
+  config.batch_max_bytes = 1400;
+  multicast::Multicaster multicaster{hosts, 47017, 0, config};
+  multicast::RingSink sink{16};
+  multicaster.set_sink(&sink);
+  multicaster.start();
+  for (uint32_t i = 0; i < 200; i++) {
+    multicaster.multicast(i);
+  }
+  uint32_t next_seq{1};
+  multicast::Delivery delivery{};
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{5};
+  while (next_seq <= 200 && std::chrono::steady_clock::now() < deadline) {
+    if (sink.try_pop(delivery)) {
+      ASSERT_EQ(delivery.final_seq, next_seq);
+      next_seq++;
+    }
+  }
+  ASSERT_EQ(next_seq, 201);
+}
+
+TEST(MulticasterTest, TestRecoversFromOverrunSocket) {
+  std::vector<std::string> hosts{"127.0.0.1"};
+  multicast::Config config{};
+  config.threads = 2;
+  config.initial_rto = std::chrono::milliseconds{10};
+  config.min_rto = std::chrono::milliseconds{1};
+  multicast::Multicaster multicaster{hosts, 47018, 0, config};
+  multicaster.start();
+  // Unbatched, a burst this size overruns the receive buffer and whatever
+  // is dropped has to be retransmitted
+  constexpr uint32_t kCount{2000};
+  std::vector<char> payload(1024, 'x');
+  for (uint32_t i = 0; i < kCount; i++) {
+    multicaster.multicast(payload.data(), payload.size(), i);
+  }
+  ASSERT_TRUE(wait_until_delivered(multicaster, kCount));
+  ASSERT_EQ(multicaster.in_flight(), 0);
+}
+
+TEST(MulticasterTest, TestSequencerDeliversPayloads) {
+  std::vector<std::string> hosts{"127.0.0.1"};
+  multicast::Config config{};
+  config.ordering = multicast::Ordering::kSequencer;
+  multicast::Multicaster multicaster{hosts, 47019, 0, config};
+  CollectingSink sink{};
+  multicaster.set_sink(&sink);
+  for (uint32_t i = 0; i < 20; i++) {
+    std::string payload{"payload " + std::to_string(i)};
+    multicaster.multicast(payload.data(), payload.size(), i);
+  }
+  ASSERT_TRUE(poll_until_delivered(multicaster, 20));
+  for (uint32_t i = 0; i < 20; i++) {
+    auto& delivery = sink.delivered[i];
+    ASSERT_EQ(delivery.data, i);
+    ASSERT_EQ(delivery.final_seq, i + 1);
+    ASSERT_EQ(delivery.final_seq_proposer, 0);
+    ASSERT_EQ(std::string(delivery.payload.data, delivery.payload.size),
+              "payload " + std::to_string(i));
+  }
+}
+
+TEST(MulticasterTest, TestSequencerRecoversFromOverrunSocket) {
+  std::vector<std::string> hosts{"127.0.0.1"};
+  multicast::Config config{};
+  config.threads = 2;
+  config.ordering = multicast::Ordering::kSequencer;
+  config.initial_rto = std::chrono::milliseconds{10};
+  config.min_rto = std::chrono::milliseconds{1};
+  config.max_in_flight = 1000;
+  multicast::Multicaster multicaster{hosts, 47020, 0, config};
+  multicaster.start();
+  constexpr uint32_t kCount{2000};
+  std::vector<char> payload(1024, 'x');
+  uint32_t sent{};
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{5};
+  while (sent < kCount && std::chrono::steady_clock::now() < deadline) {
+    if (multicaster.try_multicast(payload.data(), payload.size(), sent)) {
+      sent++;
+    }
+  }
+  ASSERT_EQ(sent, kCount);
+  ASSERT_TRUE(wait_until_delivered(multicaster, kCount));
+}
+
+TEST(MulticasterTest, TestSequencerMustBeAHost) {
+  std::vector<std::string> hosts{"127.0.0.1"};
+  multicast::Config config{};
+  config.ordering = multicast::Ordering::kSequencer;
+  config.sequencer = 1;
+  ASSERT_THROW(multicast::Multicaster(hosts, 47021, 0, config),
+               std::runtime_error);
+}
+
+TEST(MulticasterTest, TestStreamOrdersBesideTotalOrder) {
+  std::vector<std::string> hosts{"127.0.0.1"};
+  multicast::Multicaster multicaster{hosts, 47022, 0};
+  CollectingSink sink{};
+  multicaster.set_sink(&sink);
+  const multicast::DeliveryOrder orders[]{multicast::DeliveryOrder::kTotal,
+                                          multicast::DeliveryOrder::kFifo,
+                                          multicast::DeliveryOrder::kCausal};
+  for (uint32_t i = 0; i < 30; i++) {
+    std::string payload{"payload " + std::to_string(i)};
+    multicaster.multicast(payload.data(), payload.size(), i, orders[i % 3]);
+  }
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{5};
+  while ((multicaster.delivered() < 30 || multicaster.in_flight()) &&
+         std::chrono::steady_clock::now() < deadline) {
+    multicaster.poll();
+  }
+  ASSERT_EQ(sink.delivered.size(), 30);
+  ASSERT_EQ(multicaster.in_flight(), 0);
+
+  uint32_t last_total{};
+  uint32_t last_stream{};
+  for (auto& delivery : sink.delivered) {
+    ASSERT_EQ(delivery.order, orders[delivery.data % 3]);
+    ASSERT_EQ(std::string(delivery.payload.data, delivery.payload.size),
+              "payload " + std::to_string(delivery.data));
+    if (delivery.order == multicast::DeliveryOrder::kTotal) {
+      ASSERT_GT(delivery.final_seq, last_total);
+      last_total = delivery.final_seq;
+    } else {
+      // Each stream message right after the one before it
+      ASSERT_EQ(delivery.final_seq, last_stream + 1);
+      ASSERT_EQ(delivery.final_seq_proposer, 0);
+      last_stream = delivery.final_seq;
+    }
+  }
+  ASSERT_EQ(last_stream, 20);
+}
+
+TEST(MulticasterTest, TestCausalRecoversFromOverrunSocket) {
+  std::vector<std::string> hosts{"127.0.0.1"};
+  multicast::Config config{};
+  config.threads = 2;
+  config.initial_rto = std::chrono::milliseconds{10};
+  config.min_rto = std::chrono::milliseconds{1};
+  multicast::Multicaster multicaster{hosts, 47023, 0, config};
+  multicaster.start();
+  constexpr uint32_t kCount{2000};
+  std::vector<char> payload(1024, 'x');
+  for (uint32_t i = 0; i < kCount; i++) {
+    multicaster.multicast(payload.data(), payload.size(), i,
+                          multicast::DeliveryOrder::kCausal);
+  }
+  ASSERT_TRUE(wait_until_delivered(multicaster, kCount));
+}
+
+/************************************************
+ *  Multicast Group Tests
+ ***********************************************/
+TEST(MulticasterTest, TestGroupFanOut) {
+  std::vector<std::string> hosts{"127.0.0.1"};
+  multicast::Config config{};
+  config.multicast_group = "239.255.47.24";
+  config.multicast_port = 47124;
+  config.multicast_interface = "127.0.0.1";
+  // Listens in on the group next to the multicaster
+  boost::asio::io_context io_context{};
+  boost::asio::ip::udp::socket spy{io_context};
+  boost::asio::ip::udp::endpoint group{
+      boost::asio::ip::make_address_v4(config.multicast_group),
+      config.multicast_port};
+  spy.open(boost::asio::ip::udp::v4());
+  spy.set_option(boost::asio::ip::udp::socket::reuse_address{true});
+  spy.bind(group);
+  spy.set_option(boost::asio::ip::multicast::join_group{
+      group.address().to_v4(),
+      boost::asio::ip::make_address_v4(config.multicast_interface)});
+  spy.non_blocking(true);
+
+  multicast::Multicaster multicaster{hosts, 47024, 0, config};
+  for (uint32_t i = 0; i < 10; i++) {
+    multicaster.multicast(i);
+  }
+  ASSERT_TRUE(poll_until_delivered(multicaster, 10));
+
+  // Every Data and every Seq went to the group once
+  std::size_t datagrams{};
+  char buf[multicast::kMaxDatagramSize];
+  boost::system::error_code error{};
+  while (true) {
+    spy.receive(boost::asio::buffer(buf), 0, error);
+    if (error) break;
+    datagrams++;
+  }
+  ASSERT_EQ(datagrams, 20);
+}
+
+TEST(MulticasterTest, TestGroupWithoutLoopback) {
+  std::vector<std::string> hosts{"127.0.0.1"};
+  multicast::Config config{};
+  config.multicast_group = "239.255.47.25";
+  config.multicast_port = 47125;
+  config.multicast_interface = "127.0.0.1";
+  config.multicast_loopback = false;
+  config.batch_max_bytes = 1400;
+  multicast::Multicaster multicaster{hosts, 47025, 0, config};
+  for (uint32_t i = 0; i < 100; i++) {
+    multicaster.multicast(i);
+  }
+  ASSERT_TRUE(poll_until_delivered(multicaster, 100));
+}
+
+TEST(MulticasterTest, TestGroupMustBeMulticast) {
+  std::vector<std::string> hosts{"127.0.0.1"};
+  multicast::Config config{};
+  config.multicast_group = "127.0.0.1";
+  config.multicast_port = 47126;
+  ASSERT_THROW(multicast::Multicaster(hosts, 47026, 0, config),
+               std::runtime_error);
+  config.multicast_group = "239.255.47.26";
+  config.multicast_port = 0;
+  ASSERT_THROW(multicast::Multicaster(hosts, 47026, 0, config),
+               std::runtime_error);
+}
+
+/************************************************
+ *  Multi Node Tests
+ ***********************************************/
+TEST(MulticasterTest, TestNodesAgreeOnOrder) {
+  LoopbackGroup group{3, multicast::Config{}};
+  multicast_from_all(group, 50);
+  ASSERT_TRUE(group.poll_until_delivered(150));
+  group.expect_agreement();
+  for (auto& delivery : group.sinks[0].delivered) {
+    ASSERT_EQ(delivery.sender, delivery.data / 50);
+    ASSERT_EQ(std::string(delivery.payload.data, delivery.payload.size),
+              "payload " + std::to_string(delivery.data));
+  }
+}
+
+TEST(MulticasterTest, TestNodesAgreeWithSequencer) {
+  multicast::Config config{};
+  config.ordering = multicast::Ordering::kSequencer;
+  config.sequencer = 1;
+  multicast::LoopbackConfig network_config{};
+  network_config.group = false;
+  LoopbackGroup group{3, config, network_config};
+  multicast_from_all(group, 50);
+  ASSERT_TRUE(group.poll_until_delivered(150));
+  group.expect_agreement();
+  for (auto& delivery : group.sinks[0].delivered) {
+    ASSERT_EQ(delivery.final_seq_proposer, 1);
+  }
+}
+
+TEST(MulticasterTest, TestSequencerKeepsSeqAheadOfData) {
+  multicast::Config config{};
+  config.ordering = multicast::Ordering::kSequencer;
+  config.sequencer = 1;
+  // Nothing would resend a Seq that was dropped
+  config.retransmit = false;
+  multicast::LoopbackConfig network_config{};
+  network_config.group = false;
+  // Data from 0 reaches 2 well after the sequencer's Seq for it
+  network_config.link_delay = [](uint32_t from, std::size_t to) {
+    return std::chrono::microseconds{from == 0 && to == 2 ? 20000 : 0};
+  };
+  LoopbackGroup group{3, config, network_config};
+  for (uint32_t i = 0; i < 20; i++) {
+    group.nodes[0]->multicast(i);
+  }
+  ASSERT_TRUE(group.poll_until_delivered(20));
+  group.expect_agreement();
+}
+
+TEST(MulticasterTest, TestNodesAgreeDespiteLoss) {
+  multicast::Config config{};
+  config.initial_rto = std::chrono::milliseconds{5};
+  config.min_rto = std::chrono::milliseconds{1};
+  config.batch_max_bytes = 1400;
+  multicast::LoopbackConfig network_config{};
+  network_config.delay = std::chrono::microseconds{100};
+  network_config.jitter = std::chrono::microseconds{500};
+  network_config.loss = 0.1;
+  LoopbackGroup group{4, config, network_config};
+  multicast_from_all(group, 50);
+  ASSERT_TRUE(group.poll_until_delivered(200));
+  group.expect_agreement();
+  ASSERT_GT(group.network.dropped(), 0);
+}
+
+TEST(MulticasterTest, TestNodesDeliverCausally) {
+  multicast::Config config{};
+  config.initial_rto = std::chrono::milliseconds{5};
+  config.min_rto = std::chrono::milliseconds{1};
+  multicast::LoopbackConfig network_config{};
+  network_config.jitter = std::chrono::microseconds{500};
+  network_config.loss = 0.1;
+  LoopbackGroup group{3, config, network_config};
+  // Each node answers every message of the node before it, so each answer
+  // depends on the chain of messages before it
+  constexpr uint32_t kRounds{20};
+  for (uint32_t round = 0; round < kRounds; round++) {
+    for (uint32_t p = 0; p < 3; p++) {
+      uint32_t data{round * 3 + p};
+      group.nodes[p]->multicast(&data, sizeof(data), data,
+                                multicast::DeliveryOrder::kCausal);
+      ASSERT_TRUE(group.poll_until_delivered(data + 1));
+    }
+  }
+  for (auto& sink : group.sinks) {
+    ASSERT_EQ(sink.delivered.size(), kRounds * 3);
+    for (uint32_t k = 0; k < kRounds * 3; k++) {
+      ASSERT_EQ(sink.delivered[k].data, k);
+      ASSERT_EQ(sink.delivered[k].order, multicast::DeliveryOrder::kCausal);
+    }
+  }
+}
+
+TEST(MulticasterTest, TestDeliveriesDoNotPinReceiveBuffers) {
+  LoopbackGroup group{2, multicast::Config{}};
+  for (uint32_t i = 0; i < 10; i++) {
+    std::string payload{"payload " + std::to_string(i)};
+    group.nodes[0]->multicast(payload.data(), payload.size(), i);
+    group.nodes[1]->multicast(payload.data(), payload.size(), i,
+                              multicast::DeliveryOrder::kFifo);
+  }
+  ASSERT_TRUE(group.poll_until_delivered(20));
+  // Every datagram was received into a buffer shared with the others, the
+  // deliveries hold copies of their own
+  for (auto& sink : group.sinks) {
+    ASSERT_EQ(sink.delivered.size(), 20);
+    for (auto& delivery : sink.delivered) {
+      ASSERT_LT(delivery.payload.buffer->capacity(),
+                multicast::kReceiveBufferSize);
+      ASSERT_EQ(std::string(delivery.payload.data, delivery.payload.size),
+                "payload " + std::to_string(delivery.data));
+    }
+  }
+}
+
+TEST(MulticasterTest, TestStatsCountMessagesAndPhases) {
+  // Nothing is lost, keep retransmissions of a slow run out of the counts
+  multicast::Config config{};
+  config.initial_rto = std::chrono::seconds{5};
+  config.min_rto = std::chrono::seconds{5};
+  config.max_rto = std::chrono::seconds{5};
+  LoopbackGroup group{3, config};
+  multicast_from_all(group, 50);
+  ASSERT_TRUE(group.poll_until_delivered(150));
+  // The last SeqAcks may still be on their way once nothing is in flight
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{5};
+  auto confirmed = [&group]() {
+    for (auto& node : group.nodes) {
+      if (node->stats().acks_to_seq.count < 50) return false;
+    }
+    return true;
+  };
+  while (!confirmed() && std::chrono::steady_clock::now() < deadline) {
+    group.poll();
+  }
+  for (auto& node : group.nodes) {
+    multicast::StatsSnapshot stats = node->stats();
+    // Data and Seq go to the group once, acks and confirmations to a peer
+    ASSERT_EQ(stats.sent.data, 50);
+    ASSERT_EQ(stats.sent.seqs, 50);
+    ASSERT_EQ(stats.sent.acks, 150);
+    ASSERT_EQ(stats.sent.seq_acks, 150);
+    ASSERT_EQ(stats.received.data, 150);
+    ASSERT_EQ(stats.received.acks, 150);
+    ASSERT_EQ(stats.received.seqs, 150);
+    ASSERT_EQ(stats.received.seq_acks, 150);
+    ASSERT_EQ(stats.delivered, 150);
+    ASSERT_EQ(stats.pending, 0);
+    ASSERT_DOUBLE_EQ(stats.acks_per_message(), 3.0);
+    ASSERT_EQ(stats.data_to_acks.count, 50);
+    ASSERT_EQ(stats.acks_to_seq.count, 50);
+    ASSERT_EQ(stats.seq_to_delivery.count, 150);
+    ASSERT_LE(stats.data_to_acks.min, stats.data_to_acks.percentile(0.5));
+    ASSERT_LE(stats.data_to_acks.percentile(0.99), stats.data_to_acks.max);
+  }
+}
+
+TEST(MulticasterTest, TestStatsWithoutLatency) {
+  multicast::Config config{};
+  config.latency_stats = false;
+  LoopbackGroup group{2, config};
+  multicast_from_all(group, 10);
+  ASSERT_TRUE(group.poll_until_delivered(20));
+  for (auto& node : group.nodes) {
+    multicast::StatsSnapshot stats = node->stats();
+    ASSERT_EQ(stats.sent.data, 10);
+    ASSERT_EQ(stats.delivered, 20);
+    ASSERT_EQ(stats.data_to_acks.count, 0);
+    ASSERT_EQ(stats.acks_to_seq.count, 0);
+    ASSERT_EQ(stats.seq_to_delivery.count, 0);
+  }
+}
+
+TEST(MulticasterTest, TestNodesTrace) {
+  auto path = [](uint32_t node) {
+    return "/tmp/isis_multicast_trace_" + std::to_string(getpid()) + "_" +
+           std::to_string(node);
+  };
+  {
+    LoopbackGroup group{3, multicast::Config{}, multicast::LoopbackConfig{},
+                        [&path](uint32_t node, multicast::Config& config) {
+                          config.trace_path = path(node);
+                        }};
+    multicast_from_all(group, 20);
+    ASSERT_TRUE(group.poll_until_delivered(60));
+  }
+  // Flushed as the multicasters went
+  std::vector<multicast::trace::Event> events{};
+  for (uint32_t node = 0; node < 3; node++) {
+    auto file = multicast::trace::read_file(path(node));
+    ASSERT_EQ(file.first.node, node);
+    ASSERT_EQ(file.first.group_size, 3);
+    for (auto& event : file.second) {
+      ASSERT_EQ(event.node, node);
+      events.push_back(event);
+    }
+    std::remove(path(node).c_str());
+  }
+  auto paths = multicast::trace::critical_paths(events);
+  ASSERT_EQ(paths.size(), 60);
+  for (auto& p : paths) {
+    ASSERT_GE(p.to_order, 0);
+    ASSERT_GE(p.to_seq, 0);
+    ASSERT_GE(p.to_last, 0);
+    ASSERT_GE(p.to_deliver, 0);
+    // One clock here, so the phases add up
+    ASSERT_EQ(p.to_order + p.to_seq + p.to_last + p.to_deliver, p.total);
+  }
+}
+
+TEST(MulticasterTest, TestNodeRestartsFromJournal) {
+  auto path = [](uint32_t node) {
+    return "/tmp/isis_multicast_journal_" + std::to_string(getpid()) + "_" +
+           std::to_string(node);
+  };
+  for (auto ordering :
+       {multicast::Ordering::kIsis, multicast::Ordering::kSequencer}) {
+    for (uint32_t node = 0; node < 3; node++) {
+      std::remove(path(node).c_str());
+    }
+    multicast::Config config{};
+    config.ordering = ordering;
+    config.journal_sync_interval = std::chrono::milliseconds{0};
+    config.max_in_flight = 256;
+    LoopbackGroup group{3, config, multicast::LoopbackConfig{},
+                        [&path](uint32_t node, multicast::Config& config) {
+                          config.journal_path = path(node);
+                        }};
+    multicast_from_all(group, 20);
+
+    // Node 1 goes down with messages in flight and comes back on its
+    // journal. Its first life's deliveries go first, their payloads point
+    // into its pools.
+    std::vector<std::pair<uint32_t, uint32_t>> delivered{};
+    for (auto& delivery : group.sinks[1].delivered) {
+      delivered.emplace_back(delivery.sender, delivery.msg_id);
+    }
+    group.sinks[1].delivered.clear();
+    group.nodes[1].reset();
+    multicast::Config restarted{config};
+    restarted.journal_path = path(1);
+    group.nodes[1].reset(new multicast::Multicaster{
+        3, 1, group.network.transport(1), restarted});
+    group.nodes[1]->set_sink(&group.sinks[1]);
+    ASSERT_EQ(group.nodes[1]->delivered(), delivered.size());
+
+    // Reused msg_ids would be dropped as duplicates and never delivered
+    multicast_from_all(group, 20);
+    ASSERT_TRUE(group.poll_until_delivered(120));
+    for (auto& delivery : group.sinks[1].delivered) {
+      delivered.emplace_back(delivery.sender, delivery.msg_id);
+    }
+    ASSERT_EQ(group.sinks[0].delivered.size(), 120);
+    ASSERT_EQ(delivered.size(), 120);
+    for (std::size_t k = 0; k < delivered.size(); k++) {
+      ASSERT_EQ(delivered[k].first, group.sinks[0].delivered[k].sender);
+      ASSERT_EQ(delivered[k].second, group.sinks[0].delivered[k].msg_id);
+    }
+    for (uint32_t node = 0; node < 3; node++) {
+      std::remove(path(node).c_str());
+    }
+  }
+}
+
+TEST(MulticasterTest, TestNodeRestartsWithoutJournal) {
+  multicast::Config config{};
+  config.initial_rto = std::chrono::milliseconds{5};
+  LoopbackGroup group{3, config};
+  multicast_from_all(group, 10);
+  ASSERT_TRUE(group.poll_until_delivered(30));
+
+  // Node 2 comes back with nothing and starts its msg_ids over. Its
+  // deliveries go first, their payloads are in its pools.
+  for (auto& sink : group.sinks) sink.delivered.clear();
+  group.nodes[2].reset();
+  group.nodes[2].reset(
+      new multicast::Multicaster{3, 2, group.network.transport(2), config});
+  group.nodes[2]->set_sink(&group.sinks[2]);
+  multicast_from_all(group, 10);
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{10};
+  auto done = [&group]() {
+    for (std::size_t i = 0; i < 3; i++) {
+      if (group.sinks[i].delivered.size() < 30 ||
+          group.nodes[i]->in_flight()) {
+        return false;
+      }
+    }
+    return true;
+  };
+  while (!done() && std::chrono::steady_clock::now() < deadline) {
+    group.poll();
+  }
+  ASSERT_TRUE(done());
+  group.expect_agreement();
+  std::size_t from_restarted{};
+  for (auto& delivery : group.sinks[0].delivered) {
+    if (delivery.sender == 2) {
+      ASSERT_EQ(delivery.msg_id, from_restarted++);
+    }
+  }
+  ASSERT_EQ(from_restarted, 10);
+
+  // Its stream starts over too
+  group.nodes[2]->multicast(nullptr, 0, 7, multicast::DeliveryOrder::kFifo);
+  while (group.sinks[0].delivered.size() < 31 &&
+         std::chrono::steady_clock::now() < deadline) {
+    group.poll();
+  }
+  ASSERT_EQ(group.sinks[0].delivered.size(), 31);
+  ASSERT_EQ(group.sinks[0].delivered.back().final_seq, 1);
+}
+
+TEST(MulticasterTest, TestJournalRefusesWhenFull) {
+  std::string path{"/tmp/isis_multicast_full_" + std::to_string(getpid())};
+  std::remove(path.c_str());
+  multicast::LoopbackNetwork network{2};
+  multicast::Config config{};
+  config.journal_path = path;
+  config.journal_capacity = 1 << 20;
+  config.journal_sync_interval = std::chrono::milliseconds{0};
+  // Two duplicate windows of 64Ki ids leave no room in a quarter of 1 MiB
+  ASSERT_THROW(multicast::Multicaster(2, 0, network.transport(0), config),
+               std::runtime_error);
+
+  // Nobody else acks, so own messages are never confirmed and fill it up
+  config.duplicate_window = 1024;
+  multicast::Multicaster node{2, 0, network.transport(0), config};
+  int opened{};
+  node.on_window_open([&opened]() { opened++; });
+  std::string payload(8000, 'x');
+  uint32_t sent{};
+  while (node.try_multicast(payload.data(), payload.size(), sent)) {
+    ASSERT_LT(++sent, 100);
+  }
+  ASSERT_GT(sent, 16);
+  ASSERT_THROW(node.multicast(payload.data(), payload.size(), sent),
+               std::runtime_error);
+  ASSERT_EQ(node.in_flight(), sent);
+  ASSERT_EQ(opened, 0);
+  std::remove(path.c_str());
+}
+
+TEST(MulticasterTest, TestJournalFillsBehindLostSeq) {
+  std::string path{"/tmp/isis_multicast_lost_" + std::to_string(getpid())};
+  std::remove(path.c_str());
+  // Node 1 never hears the final sequence number of node 0's first message
+  // until the test lets it, so everything after waits behind it there
+  std::atomic<bool> lose{true};
+  multicast::LoopbackConfig network_config{};
+  network_config.drop = [&lose](uint32_t from, std::size_t to,
+                                const multicast::Segments& message) {
+    const void* data = message[0].data();
+    std::size_t size = message[0].size();
+    if (!lose || from != 0 || to != 1 ||
+        messages::codec::peek_type(data, size) != 3) {
+      return false;
+    }
+    messages::SeqMessage S{data, size};
+    return S.sender == 0 && S.msg_id == 0;
+  };
+  multicast::Config config{};
+  config.duplicate_window = 1024;
+  config.max_rto = std::chrono::milliseconds{20};
+  config.journal_sync_interval = std::chrono::milliseconds{0};
+  LoopbackGroup group{3, config, network_config,
+                      [&path](uint32_t node, multicast::Config& config) {
+                        if (node == 1) {
+                          config.journal_path = path;
+                          config.journal_capacity = 1 << 20;
+                        }
+                      }};
+
+  // Far more than a quarter of node 1's ring, which turns the rest away
+  // instead of failing
+  std::string payload(1000, 'x');
+  for (uint32_t i = 0; i < 200; i++) {
+    group.nodes[0]->multicast(payload.data(), payload.size(), i);
+    group.nodes[2]->multicast(payload.data(), payload.size(), 200 + i);
+    group.poll();
+  }
+  for (int i = 0; i < 100; i++) group.poll();
+  ASSERT_GT(group.nodes[1]->duplicate_stats().journal_full, 0);
+  ASSERT_EQ(group.nodes[1]->delivered(), 0);
+
+  // Once the Seq gets through the turned away messages are resent and taken
+  lose = false;
+  ASSERT_TRUE(group.poll_until_delivered(400));
+  ASSERT_FALSE(group.nodes[1]->failed());
+  group.expect_agreement();
+  std::remove(path.c_str());
+}
+
+TEST(MulticasterTest, TestNodeCatchesUpAfterDowntime) {
+  std::string path{"/tmp/isis_multicast_catchup_" + std::to_string(getpid())};
+  std::remove(path.c_str());
+  multicast::Config config{};
+  config.ordering = multicast::Ordering::kSequencer;
+  config.journal_sync_interval = std::chrono::milliseconds{0};
+  config.max_in_flight = 256;
+  config.catchup_history = 1 << 20;
+  LoopbackGroup group{3, config, multicast::LoopbackConfig{},
+                      [&path](uint32_t node, multicast::Config& config) {
+                        if (node == 2) config.journal_path = path;
+                      }};
+  multicast_from_all(group, 20);
+  ASSERT_TRUE(group.poll_until_delivered(60));
+
+  // Node 2 is down while the others carry on for several batches' worth
+  std::vector<std::pair<uint32_t, uint32_t>> delivered{};
+  for (auto& delivery : group.sinks[2].delivered) {
+    delivered.emplace_back(delivery.sender, delivery.msg_id);
+  }
+  group.sinks[2].delivered.clear();
+  group.nodes[2].reset();
+  std::string payload(1000, 'p');
+  for (uint32_t i = 0; i < 200; i++) {
+    group.nodes[0]->multicast(payload.data(), payload.size(), i);
+    group.nodes[1]->multicast(payload.data(), payload.size(), i);
+    group.nodes[0]->poll();
+    group.nodes[1]->poll();
+  }
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{10};
+  while ((group.nodes[0]->delivered() < 460 ||
+          group.nodes[1]->delivered() < 460) &&
+         std::chrono::steady_clock::now() < deadline) {
+    group.nodes[0]->poll();
+    group.nodes[1]->poll();
+  }
+  ASSERT_EQ(group.nodes[1]->delivered(), 460);
+
+  multicast::Config restarted{config};
+  restarted.journal_path = path;
+  group.nodes[2].reset(new multicast::Multicaster{
+      3, 2, group.network.transport(2), restarted});
+  group.nodes[2]->set_sink(&group.sinks[2]);
+  group.nodes[2]->catch_up(0);
+  ASSERT_TRUE(group.nodes[2]->catching_up());
+  deadline = std::chrono::steady_clock::now() + std::chrono::seconds{10};
+  while (group.nodes[2]->catching_up() &&
+         std::chrono::steady_clock::now() < deadline) {
+    group.poll();
+  }
+  ASSERT_FALSE(group.nodes[2]->catching_up());
+  ASSERT_EQ(group.nodes[2]->caught_up(), 400);
+
+  // And on with the live messages, its own included
+  multicast_from_all(group, 20);
+  ASSERT_TRUE(group.poll_until_delivered(520));
+  for (auto& delivery : group.sinks[2].delivered) {
+    delivered.emplace_back(delivery.sender, delivery.msg_id);
+  }
+  ASSERT_EQ(group.sinks[0].delivered.size(), 520);
+  ASSERT_EQ(delivered.size(), 520);
+  for (std::size_t k = 0; k < delivered.size(); k++) {
+    ASSERT_EQ(delivered[k].first, group.sinks[0].delivered[k].sender);
+    ASSERT_EQ(delivered[k].second, group.sinks[0].delivered[k].msg_id);
+  }
+  std::string caught_up{group.sinks[2].delivered[0].payload.data,
+                        group.sinks[2].delivered[0].payload.size};
+  ASSERT_EQ(caught_up, payload);
+  std::remove(path.c_str());
+}
+
+TEST(MulticasterTest, TestFreshNodeCatchesUp) {
+  multicast::Config config{};
+  config.catchup_history = 1 << 20;
+  // Small batches, several windows
+  config.catchup_batch_bytes = 1024;
+  config.catchup_window = 2;
+  LoopbackGroup group{3, config};
+  multicast_from_all(group, 20);
+  ASSERT_TRUE(group.poll_until_delivered(60));
+
+  // Node 2 comes back with nothing, it only listens from here on
+  group.sinks[2].delivered.clear();
+  group.nodes[2].reset();
+  group.nodes[2].reset(
+      new multicast::Multicaster{3, 2, group.network.transport(2), config});
+  group.nodes[2]->set_sink(&group.sinks[2]);
+  group.nodes[2]->catch_up(1);
+  for (uint32_t i = 0; i < 20; i++) {
+    group.nodes[0]->multicast(i);
+    group.nodes[1]->multicast(i);
+    group.poll();
+  }
+  ASSERT_TRUE(group.poll_until_delivered(100));
+  ASSERT_FALSE(group.nodes[2]->catching_up());
+  ASSERT_GE(group.nodes[2]->caught_up(), 60);
+  group.expect_agreement();
+  std::string payload{group.sinks[2].delivered[0].payload.data,
+                      group.sinks[2].delivered[0].payload.size};
+  ASSERT_EQ(payload, "payload 0");
+}
+
+TEST(MulticasterTest, TestCatchesUpThreadedOnOnePath) {
+  multicast::Config config{};
+  config.threads = 2;
+  config.catchup_history = 1 << 20;
+  config.catchup_batch_bytes = 1024;
+  config.catchup_window = 2;
+  // Its timer keeps firing beside the batches and live traffic
+  config.catchup_timeout = std::chrono::milliseconds{1};
+  LoopbackGroup group{3, config};
+  for (auto& node : group.nodes) node->start();
+  for (uint32_t i = 0; i < 100; i++) {
+    group.nodes[0]->multicast(i);
+    group.nodes[1]->multicast(i);
+  }
+  for (auto& node : group.nodes) {
+    ASSERT_TRUE(wait_until_delivered(*node, 200));
+  }
+
+  // Node 2 comes back fresh on its one receive path and catches up while
+  // the others keep multicasting
+  group.nodes[2].reset();
+  group.sinks[2].delivered.clear();
+  group.nodes[2].reset(
+      new multicast::Multicaster{3, 2, group.network.transport(2), config});
+  group.nodes[2]->set_sink(&group.sinks[2]);
+  group.nodes[2]->start();
+  group.nodes[2]->catch_up(0);
+  for (uint32_t i = 100; i < 300; i++) {
+    group.nodes[0]->multicast(i);
+    group.nodes[1]->multicast(i);
+  }
+  for (auto& node : group.nodes) {
+    ASSERT_TRUE(wait_until_delivered(*node, 600));
+  }
+  for (auto& node : group.nodes) node->stop();
+  ASSERT_FALSE(group.nodes[2]->catching_up());
+  ASSERT_GE(group.nodes[2]->caught_up(), 200);
+  group.expect_agreement();
+}
+
+TEST(MulticasterTest, TestCatchUpFromNodeWithoutHistory) {
+  LoopbackGroup group{2, multicast::Config{}};
+  ASSERT_THROW(group.nodes[0]->catch_up(0), std::runtime_error);
+  ASSERT_THROW(group.nodes[0]->catch_up(2), std::runtime_error);
+  group.nodes[0]->multicast(1);
+  ASSERT_TRUE(group.poll_until_delivered(1));
+
+  // Turned away, it carries on live
+  group.nodes[1]->catch_up(0);
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{10};
+  while (group.nodes[1]->catching_up() &&
+         std::chrono::steady_clock::now() < deadline) {
+    group.poll();
+  }
+  ASSERT_FALSE(group.nodes[1]->catching_up());
+  group.nodes[0]->multicast(2);
+  ASSERT_TRUE(group.poll_until_delivered(2));
+  group.expect_agreement();
+}
+
+TEST(MulticasterTest, TestHistoryMustFitLargestMessage) {
+  multicast::Config config{};
+  config.catchup_history = 1 << 20;
+  config.max_payload_size = 65536;
+  ASSERT_THROW(LoopbackGroup(1, config), std::runtime_error);
+
+  // The largest that fits is caught up on like any other
+  config.max_payload_size = 65000;
+  LoopbackGroup group{2, config};
+  std::string payload(65000, 'p');
+  group.nodes[0]->multicast(payload.data(), payload.size(), 1);
+  ASSERT_TRUE(group.poll_until_delivered(1));
+  group.sinks[1].delivered.clear();
+  group.nodes[1].reset();
+  group.nodes[1].reset(
+      new multicast::Multicaster{2, 1, group.network.transport(1), config});
+  group.nodes[1]->set_sink(&group.sinks[1]);
+  group.nodes[1]->catch_up(0);
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{10};
+  while (group.nodes[1]->catching_up() &&
+         std::chrono::steady_clock::now() < deadline) {
+    group.poll();
+  }
+  ASSERT_EQ(group.nodes[1]->caught_up(), 1);
+  ASSERT_EQ(group.sinks[1].delivered[0].payload.size, 65000);
+}
+
+TEST(MulticasterTest, TestDropsMalformedCatchUpBatch) {
+  multicast::LoopbackNetwork network{2};
+  multicast::Multicaster node{2, 0, network.transport(0), multicast::Config{}};
+  CollectingSink sink{};
+  node.set_sink(&sink);
+  // Stands in for node 1, answering with batches of its own making
+  boost::asio::io_context io_context{};
+  auto peer = network.transport(1)(io_context);
+  peer->start({multicast::Strand{io_context.get_executor()}},
+              [](const multicast::BufferRef&, const char*, std::size_t) {});
+  node.catch_up(1);
+
+  messages::CatchupBuilder batch{4096};
+  auto send = [&](std::size_t size) {
+    peer->send(multicast::Segments{boost::asio::buffer(batch.data(), size),
+                                   boost::asio::const_buffer{}},
+               0);
+    for (int i = 0; i < 100; i++) node.poll();
+  };
+  messages::DataMessage first{1, 0, 10};
+  first.final_seq = 1;
+  first.final_seq_proposer = 1;
+  messages::DataMessage second{5, 0, 11};
+  second.final_seq = 2;
+  second.final_seq_proposer = 1;
+  second.payload = "payload";
+  second.payload_size = 7;
+
+  // From a process outside the group, none of it is applied
+  batch.start(1, 0, 0);
+  batch.append(first);
+  batch.append(second);
+  batch.set_status(messages::CatchupBuilder::kDone);
+  send(batch.size());
+  ASSERT_TRUE(node.catching_up());
+  ASSERT_EQ(node.caught_up(), 0);
+  ASSERT_TRUE(sink.delivered.empty());
+
+  // Cut short inside its last message
+  second.sender = 1;
+  batch.start(1, 0, 0);
+  batch.append(first);
+  batch.append(second);
+  batch.set_status(messages::CatchupBuilder::kDone);
+  send(batch.size() - 4);
+  ASSERT_TRUE(node.catching_up());
+  ASSERT_EQ(node.caught_up(), 0);
+  ASSERT_TRUE(sink.delivered.empty());
+
+  // Whole, it is
+  send(batch.size());
+  ASSERT_FALSE(node.catching_up());
+  ASSERT_EQ(node.caught_up(), 2);
+  ASSERT_EQ(sink.delivered.size(), 2);
+  ASSERT_EQ(std::string(sink.delivered[1].payload.data,
+                        sink.delivered[1].payload.size),
+            "payload");
+  // Requests it was sent hold on to its receive buffers
+  peer->close();
+  io_context.poll();
+}
+
+TEST(MulticasterTest, TestCatchUpPastDuplicateWindow) {
+  std::string path{"/tmp/isis_multicast_window_" + std::to_string(getpid())};
+  std::remove(path.c_str());
+  multicast::Config config{};
+  config.duplicate_window = 64;
+  config.initial_rto = std::chrono::milliseconds{5};
+  config.journal_sync_interval = std::chrono::milliseconds{0};
+  config.max_in_flight = 256;
+  config.catchup_history = 1 << 20;
+  multicast::Config journaled{config};
+  journaled.journal_path = path;
+  LoopbackGroup group{3, config, multicast::LoopbackConfig{},
+                      [&path](uint32_t node, multicast::Config& config) {
+                        if (node == 1) config.journal_path = path;
+                      }};
+  multicast_from_all(group, 100);
+  ASSERT_TRUE(group.poll_until_delivered(300));
+
+  // Node 1 restarts from its journal, its history only holds what follows
+  group.sinks[1].delivered.clear();
+  group.nodes[1].reset();
+  group.nodes[1].reset(new multicast::Multicaster{
+      3, 1, group.network.transport(1), journaled});
+  group.nodes[1]->set_sink(&group.sinks[1]);
+  multicast_from_all(group, 10);
+  ASSERT_TRUE(group.poll_until_delivered(330));
+
+  // Node 2 comes back with nothing and catches up on that, every id well
+  // past a window starting at 0
+  group.sinks[2].delivered.clear();
+  group.nodes[2].reset();
+  group.nodes[2].reset(
+      new multicast::Multicaster{3, 2, group.network.transport(2), config});
+  group.nodes[2]->set_sink(&group.sinks[2]);
+  group.nodes[2]->catch_up(1);
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{10};
+  while (group.nodes[2]->catching_up() &&
+         std::chrono::steady_clock::now() < deadline) {
+    group.poll();
+  }
+  ASSERT_FALSE(group.nodes[2]->catching_up());
+  ASSERT_EQ(group.nodes[2]->caught_up(), 30);
+
+  // Live messages carry on from there, and its own start over
+  multicast_from_all(group, 10);
+  auto done = [&group]() {
+    if (group.sinks[0].delivered.size() < 360 ||
+        group.sinks[2].delivered.size() < 60) {
+      return false;
+    }
+    for (auto& node : group.nodes) {
+      if (node->in_flight()) return false;
+    }
+    return true;
+  };
+  while (!done() && std::chrono::steady_clock::now() < deadline) {
+    group.poll();
+  }
+  ASSERT_TRUE(done());
+  ASSERT_EQ(group.sinks[2].delivered.size(), 60);
+  for (std::size_t k = 0; k < 60; k++) {
+    auto& expected = group.sinks[0].delivered[300 + k];
+    auto& delivery = group.sinks[2].delivered[k];
+    ASSERT_EQ(delivery.sender, expected.sender);
+    ASSERT_EQ(delivery.msg_id, expected.msg_id);
+    ASSERT_EQ(delivery.final_seq, expected.final_seq);
+  }
+  uint32_t from_restarted{};
+  for (std::size_t k = 30; k < 60; k++) {
+    auto& delivery = group.sinks[2].delivered[k];
+    if (delivery.sender == 2) {
+      ASSERT_EQ(delivery.msg_id, from_restarted++);
+    }
+  }
+  ASSERT_EQ(from_restarted, 10);
+  std::remove(path.c_str());
+}
+
+/************************************************
+ *  Fragmentation Tests
+ ***********************************************/
+namespace {
+/**
+ * Have every node of group multicast count messages of size bytes, each
+ * filled from its data, in the given orders in turn.
+ */
+void multicast_large(LoopbackGroup& group, uint32_t count, std::size_t size,
+                     const std::vector<multicast::DeliveryOrder>& orders) {
+  uint32_t nodes = static_cast<uint32_t>(group.nodes.size());
+  for (uint32_t i = 0; i < count; i++) {
+    for (uint32_t p = 0; p < nodes; p++) {
+      uint32_t data{p * count + i};
+      std::string payload(size, static_cast<char>('a' + data % 26));
+      payload.replace(0, std::to_string(data).size(), std::to_string(data));
+      group.nodes[p]->multicast(payload.data(), payload.size(), data,
+                                orders[i % orders.size()]);
+    }
+    group.poll();
+  }
+}
+
+/**
+ * Check every payload node delivered is whole.
+ */
+void expect_whole(const LoopbackGroup& group, std::size_t node,
+                  std::size_t size) {
+  for (auto& delivery : group.sinks[node].delivered) {
+    std::string payload(size, static_cast<char>('a' + delivery.data % 26));
+    payload.replace(0, std::to_string(delivery.data).size(),
+                    std::to_string(delivery.data));
+    ASSERT_EQ(std::string(delivery.payload.data, delivery.payload.size),
+              payload);
+  }
+}
+}  // namespace
+
+TEST(MulticasterTest, TestFragmentSizeMustFitHeader) {
+  multicast::Config config{};
+  config.fragment_size = 28;
+  ASSERT_THROW(LoopbackGroup(1, config), std::runtime_error);
+  config.fragment_size = 70000;
+  ASSERT_THROW(LoopbackGroup(1, config), std::runtime_error);
+}
+
+TEST(MulticasterTest, TestNodesReassembleLargePayloads) {
+  multicast::Config config{};
+  config.max_payload_size = 20000;
+  config.fragment_size = 1000;
+  LoopbackGroup group{3, config};
+  multicast_large(group, 10, 20000, {multicast::DeliveryOrder::kTotal});
+  ASSERT_TRUE(group.poll_until_delivered(30));
+  group.expect_agreement();
+  for (std::size_t i = 0; i < 3; i++) {
+    expect_whole(group, i, 20000);
+    // Once per message however many fragments it took
+    auto stats = group.nodes[i]->stats();
+    ASSERT_EQ(stats.sent.data - stats.retransmits.data, 10);
+    ASSERT_EQ(stats.received.data - stats.duplicates.data, 30);
+  }
+}
+
+TEST(MulticasterTest, TestBatchedFragmentsFitFragmentSize) {
+  multicast::Config config{};
+  config.max_payload_size = 20000;
+  config.fragment_size = 1000;
+  config.batch_max_bytes = 8192;
+  LoopbackGroup group{3, config};
+  multicast_large(group, 10, 20000, {multicast::DeliveryOrder::kTotal});
+  ASSERT_TRUE(group.poll_until_delivered(30));
+  group.expect_agreement();
+  for (std::size_t i = 0; i < 3; i++) {
+    expect_whole(group, i, 20000);
+  }
+  // Fragments and everything else share frames no larger than a fragment
+  ASSERT_LE(group.network.largest(), 1000);
+}
+
+TEST(MulticasterTest, TestSequencerReassemblesDespiteLoss) {
+  multicast::Config config{};
+  config.ordering = multicast::Ordering::kSequencer;
+  config.max_payload_size = 20000;
+  config.fragment_size = 1000;
+  config.initial_rto = std::chrono::milliseconds{5};
+  config.min_rto = std::chrono::milliseconds{1};
+  multicast::LoopbackConfig network_config{};
+  network_config.group = false;
+  network_config.jitter = std::chrono::microseconds{500};
+  network_config.loss = 0.02;
+  LoopbackGroup group{3, config, network_config};
+  multicast_large(group, 10, 20000,
+                  {multicast::DeliveryOrder::kTotal,
+                   multicast::DeliveryOrder::kFifo});
+  ASSERT_TRUE(group.poll_until_delivered(30));
+  ASSERT_GT(group.network.dropped(), 0);
+  for (std::size_t i = 0; i < 3; i++) {
+    expect_whole(group, i, 20000);
+  }
+}
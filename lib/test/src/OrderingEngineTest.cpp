@@ -0,0 +1,174 @@
+#include "gtest/gtest.h"
+#include <vector>
+
+#include "messages.hpp"
+#include "ordering.hpp"
+#include "pending.hpp"
+
+namespace {
+/**
+ * Records what an engine sends.
+ */
+class RecordingOutput : public multicast::OrderingOutput {
+ public:
+  struct SentSeq {
+    messages::SeqMessage seq;
+    int hostnum;  // -1 for all hosts
+  };
+
+  void send_ack(const messages::AckMessage& A) override { acks.push_back(A); }
+  void send_seq(const messages::SeqMessage& S, uint32_t hostnum) override {
+    seqs.push_back(SentSeq{S, static_cast<int>(hostnum)});
+  }
+  void send_seq_all(const messages::SeqMessage& S) override {
+    seqs.push_back(SentSeq{S, -1});
+  }
+
+  std::vector<messages::AckMessage> acks{};
+  std::vector<SentSeq> seqs{};
+};
+
+std::vector<uint32_t> drain(multicast::OrderingEngine& engine) {
+  std::vector<uint32_t> delivered{};
+  while (auto handle = engine.pop_deliverable()) {
+    delivered.push_back(handle->msg.data);
+  }
+  return delivered;
+}
+}  // namespace
+
+/************************************************
+ *  Isis Engine Tests
+ ***********************************************/
+TEST(IsisEngineTest, TestProposesIncreasingSeqs) {
+  multicast::MessagePool pool{};
+  multicast::PendingStore pending{pool};
+  RecordingOutput output{};
+  multicast::IsisEngine engine{pending, output, 2};
+  ASSERT_TRUE(engine.sender_collects_acks());
+
+  engine.on_data(messages::DataMessage{0, 0, 10}, multicast::BufferRef{});
+  engine.on_data(messages::DataMessage{1, 0, 11}, multicast::BufferRef{});
+  ASSERT_EQ(output.acks.size(), 2);
+  ASSERT_EQ(output.acks[0].sender, 0);
+  ASSERT_EQ(output.acks[0].proposed_seq, 1);
+  ASSERT_EQ(output.acks[0].proposer, 2);
+  ASSERT_EQ(output.acks[1].sender, 1);
+  ASSERT_EQ(output.acks[1].proposed_seq, 2);
+  ASSERT_TRUE(drain(engine).empty());
+}
+
+TEST(IsisEngineTest, TestReacksUntilSequenced) {
+  multicast::MessagePool pool{};
+  multicast::PendingStore pending{pool};
+  RecordingOutput output{};
+  multicast::IsisEngine engine{pending, output, 2};
+  messages::DataMessage D{0, 0, 10};
+  engine.on_data(D, multicast::BufferRef{});
+  engine.on_duplicate_data(D, pending.find(0, 0));
+  ASSERT_EQ(output.acks.size(), 2);
+  ASSERT_EQ(output.acks[1].proposed_seq, output.acks[0].proposed_seq);
+
+  engine.on_seq(pending.find(0, 0), messages::SeqMessage{0, 0, 5, 1});
+  engine.on_duplicate_data(D, pending.find(0, 0));
+  ASSERT_EQ(output.acks.size(), 2);
+  ASSERT_EQ(drain(engine), std::vector<uint32_t>{10});
+  engine.on_duplicate_data(D, nullptr);
+  ASSERT_EQ(output.acks.size(), 2);
+}
+
+TEST(IsisEngineTest, TestDeliversInAgreedOrder) {
+  multicast::MessagePool pool{};
+  multicast::PendingStore pending{pool};
+  RecordingOutput output{};
+  multicast::IsisEngine engine{pending, output, 0};
+  engine.on_data(messages::DataMessage{0, 0, 10}, multicast::BufferRef{});
+  engine.on_data(messages::DataMessage{1, 0, 11}, multicast::BufferRef{});
+
+  // The second message is agreed first, but the first may still go before it
+  engine.on_seq(pending.find(1, 0), messages::SeqMessage{1, 0, 2, 0});
+  ASSERT_TRUE(drain(engine).empty());
+  engine.on_seq(pending.find(0, 0), messages::SeqMessage{0, 0, 3, 1});
+  ASSERT_EQ(drain(engine), (std::vector<uint32_t>{11, 10}));
+}
+
+/************************************************
+ *  Sequencer Engine Tests
+ ***********************************************/
+TEST(SequencerEngineTest, TestSequencerNumbersOnArrival) {
+  multicast::MessagePool pool{};
+  multicast::PendingStore pending{pool};
+  RecordingOutput output{};
+  multicast::SequencerEngine engine{pending, output, 0, 0, 3};
+  ASSERT_TRUE(engine.is_sequencer());
+  ASSERT_FALSE(engine.sender_collects_acks());
+
+  engine.on_data(messages::DataMessage{2, 0, 10}, multicast::BufferRef{});
+  engine.on_data(messages::DataMessage{1, 0, 11}, multicast::BufferRef{});
+  ASSERT_TRUE(output.acks.empty());
+  ASSERT_EQ(output.seqs.size(), 2);
+  ASSERT_EQ(output.seqs[0].hostnum, -1);
+  ASSERT_EQ(output.seqs[0].seq.sender, 2);
+  ASSERT_EQ(output.seqs[0].seq.final_seq, 1);
+  ASSERT_EQ(output.seqs[1].seq.sender, 1);
+  ASSERT_EQ(output.seqs[1].seq.final_seq, 2);
+  // Nothing is deliverable until the Seqs come back
+  ASSERT_TRUE(drain(engine).empty());
+}
+
+TEST(SequencerEngineTest, TestOthersOnlyStore) {
+  multicast::MessagePool pool{};
+  multicast::PendingStore pending{pool};
+  RecordingOutput output{};
+  multicast::SequencerEngine engine{pending, output, 1, 0, 3};
+  ASSERT_FALSE(engine.is_sequencer());
+  messages::DataMessage D{2, 0, 10};
+  engine.on_data(D, multicast::BufferRef{});
+  engine.on_duplicate_data(D, pending.find(2, 0));
+  ASSERT_TRUE(output.acks.empty());
+  ASSERT_TRUE(output.seqs.empty());
+  ASSERT_NE(pending.find(2, 0), nullptr);
+}
+
+TEST(SequencerEngineTest, TestDeliversWithoutGaps) {
+  multicast::MessagePool pool{};
+  multicast::PendingStore pending{pool};
+  RecordingOutput output{};
+  multicast::SequencerEngine engine{pending, output, 1, 0, 3};
+  engine.on_data(messages::DataMessage{0, 0, 10}, multicast::BufferRef{});
+  engine.on_data(messages::DataMessage{2, 0, 11}, multicast::BufferRef{});
+  engine.on_data(messages::DataMessage{2, 1, 12}, multicast::BufferRef{});
+
+  engine.on_seq(pending.find(2, 0), messages::SeqMessage{2, 0, 2, 0});
+  engine.on_seq(pending.find(2, 1), messages::SeqMessage{2, 1, 3, 0});
+  // Sequence 1 is still missing
+  ASSERT_TRUE(drain(engine).empty());
+  engine.on_seq(pending.find(0, 0), messages::SeqMessage{0, 0, 1, 0});
+  ASSERT_EQ(drain(engine), (std::vector<uint32_t>{10, 11, 12}));
+  ASSERT_TRUE(pending.empty());
+}
+
+TEST(SequencerEngineTest, TestAnswersRetransmittedData) {
+  multicast::MessagePool pool{};
+  multicast::PendingStore pending{pool};
+  RecordingOutput output{};
+  multicast::SequencerEngine engine{pending, output, 0, 0, 3, 4};
+  messages::DataMessage D{2, 0, 10};
+  engine.on_data(D, multicast::BufferRef{});
+  engine.on_seq(pending.find(2, 0), output.seqs[0].seq);
+  ASSERT_EQ(drain(engine), std::vector<uint32_t>{10});
+
+  // Delivered here, but the sender never saw its Seq
+  engine.on_duplicate_data(D, nullptr);
+  ASSERT_EQ(output.seqs.size(), 2);
+  ASSERT_EQ(output.seqs[1].hostnum, 2);
+  ASSERT_EQ(output.seqs[1].seq.final_seq, 1);
+
+  // Forgotten once the history has wrapped
+  for (uint32_t msg_id = 1; msg_id <= 4; msg_id++) {
+    engine.on_data(messages::DataMessage{2, msg_id, 0},
+                   multicast::BufferRef{});
+  }
+  engine.on_duplicate_data(D, nullptr);
+  ASSERT_EQ(output.seqs.size(), 6);
+}
@@ -0,0 +1,67 @@
+#include "gtest/gtest.h"
+#include <boost/asio.hpp>
+
+#include "peers.hpp"
+
+using boost::asio::ip::udp;
+
+/************************************************
+ *  Peer Directory Tests
+ ***********************************************/
+TEST(PeerDirectoryTest, TestUnresolvedBeforeStart) {
+  boost::asio::io_context io_context{};
+  std::vector<std::string> hosts{"127.0.0.1", "127.0.0.2"};
+  multicast::PeerDirectory peers{io_context, hosts, "4000",
+                                 std::chrono::milliseconds{0}};
+
+  ASSERT_EQ(peers.size(), 2);
+  ASSERT_FALSE(peers.all_resolved());
+  udp::endpoint endpoint{};
+  ASSERT_FALSE(peers.endpoint(0, endpoint));
+  ASSERT_FALSE(peers.endpoint(1, endpoint));
+}
+
+TEST(PeerDirectoryTest, TestResolveAll) {
+  boost::asio::io_context io_context{};
+  std::vector<std::string> hosts{"127.0.0.1", "localhost", "127.0.0.3"};
+  multicast::PeerDirectory peers{io_context, hosts, "4000",
+                                 std::chrono::milliseconds{0}};
+
+  std::vector<std::size_t> resolved{};
+  peers.start([&](std::size_t peer) { resolved.push_back(peer); });
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{5};
+  while (!peers.all_resolved() && std::chrono::steady_clock::now() < deadline) {
+    io_context.run_one_for(std::chrono::milliseconds{10});
+  }
+
+  ASSERT_TRUE(peers.all_resolved());
+  ASSERT_EQ(resolved.size(), 3);
+  udp::endpoint endpoint{};
+  ASSERT_TRUE(peers.endpoint(0, endpoint));
+  ASSERT_EQ(endpoint,
+            udp::endpoint(boost::asio::ip::make_address("127.0.0.1"), 4000));
+  ASSERT_TRUE(peers.endpoint(2, endpoint));
+  ASSERT_EQ(endpoint,
+            udp::endpoint(boost::asio::ip::make_address("127.0.0.3"), 4000));
+  ASSERT_TRUE(peers.endpoint(1, endpoint));
+  ASSERT_EQ(endpoint.port(), 4000);
+}
+
+TEST(PeerDirectoryTest, TestRefreshKeepsEndpoint) {
+  boost::asio::io_context io_context{};
+  std::vector<std::string> hosts{"127.0.0.1"};
+  multicast::PeerDirectory peers{io_context, hosts, "4000",
+                                 std::chrono::milliseconds{5}};
+
+  int resolved{};
+  peers.start([&](std::size_t /*peer*/) { resolved++; });
+  // Run long enough for several refreshes to complete
+  io_context.run_for(std::chrono::milliseconds{100});
+
+  ASSERT_TRUE(peers.all_resolved());
+  ASSERT_EQ(resolved, 1);
+  udp::endpoint endpoint{};
+  ASSERT_TRUE(peers.endpoint(0, endpoint));
+  ASSERT_EQ(endpoint,
+            udp::endpoint(boost::asio::ip::make_address("127.0.0.1"), 4000));
+}
@@ -0,0 +1,182 @@
+#include "gtest/gtest.h"
+
+#include "messages.hpp"
+#include "pending.hpp"
+
+/************************************************
+ *  Pending Store Tests
+ ***********************************************/
+TEST(PendingStoreTest, TestInsertAndFind) {
+  multicast::MessagePool pool{};
+  multicast::PendingStore store{pool};
+  messages::DataMessage* m = store.insert(messages::DataMessage{1, 7, 42});
+  ASSERT_NE(m, nullptr);
+  ASSERT_EQ(store.size(), 1);
+  ASSERT_EQ(store.find(1, 7), m);
+  ASSERT_EQ(m->data, 42);
+  ASSERT_EQ(store.find(1, 8), nullptr);
+  ASSERT_EQ(store.find(2, 7), nullptr);
+}
+
+TEST(PendingStoreTest, TestSameMsgIdDifferentSenders) {
+  multicast::MessagePool pool{};
+  multicast::PendingStore store{pool};
+  messages::DataMessage* a = store.insert(messages::DataMessage{1, 7, 10});
+  messages::DataMessage* b = store.insert(messages::DataMessage{2, 7, 20});
+  ASSERT_NE(a, b);
+  ASSERT_EQ(store.find(1, 7)->data, 10);
+  ASSERT_EQ(store.find(2, 7)->data, 20);
+}
+
+TEST(PendingStoreTest, TestDuplicateInsert) {
+  multicast::MessagePool pool{};
+  multicast::PendingStore store{pool};
+  ASSERT_NE(store.insert(messages::DataMessage{1, 7, 10}), nullptr);
+  ASSERT_EQ(store.insert(messages::DataMessage{1, 7, 10}), nullptr);
+  ASSERT_EQ(store.size(), 1);
+}
+
+TEST(PendingStoreTest, TestUndeliverableHeadBlocks) {
+  multicast::MessagePool pool{};
+  multicast::PendingStore store{pool};
+  messages::DataMessage* a = store.insert(messages::DataMessage{1, 1, 0});
+  messages::DataMessage* b = store.insert(messages::DataMessage{2, 1, 0});
+  store.reorder(a, 1, 1, false);
+  store.reorder(b, 2, 2, true);
+
+  // b is final but a may still end up ordered before it
+  ASSERT_EQ(store.deliverable_head(), nullptr);
+
+  store.reorder(a, 3, 0, true);
+  ASSERT_EQ(store.deliverable_head(), b);
+  store.pop_head();
+  ASSERT_EQ(store.deliverable_head(), a);
+  store.pop_head();
+  ASSERT_TRUE(store.empty());
+  ASSERT_EQ(store.deliverable_head(), nullptr);
+}
+
+TEST(PendingStoreTest, TestUnorderedEntriesDoNotBlock) {
+  multicast::MessagePool pool{};
+  multicast::PendingStore store{pool};
+  messages::DataMessage unordered{1, 1, 0};
+  unordered.final_seq = multicast::PendingStore::kUnordered;
+  messages::DataMessage* a = store.insert(unordered);
+  messages::DataMessage* b = store.insert(messages::DataMessage{2, 1, 0});
+  ASSERT_NE(a, nullptr);
+  ASSERT_EQ(store.find(1, 1), a);
+  store.reorder(b, 2, 0, true);
+  ASSERT_EQ(store.deliverable_head(), b);
+  store.pop_head();
+
+  // Only the unordered entry is left, which has nothing to deliver
+  ASSERT_EQ(store.deliverable_head(), nullptr);
+  ASSERT_FALSE(store.pop_head());
+  ASSERT_EQ(store.size(), 1);
+
+  store.reorder(a, 1, 0, true);
+  ASSERT_EQ(store.deliverable_head(), a);
+}
+
+TEST(PendingStoreTest, TestOrderByProposerOnTie) {
+  multicast::MessagePool pool{};
+  multicast::PendingStore store{pool};
+  messages::DataMessage* a = store.insert(messages::DataMessage{1, 1, 0});
+  messages::DataMessage* b = store.insert(messages::DataMessage{2, 1, 0});
+  store.reorder(a, 5, 3, true);
+  store.reorder(b, 5, 1, true);
+
+  ASSERT_EQ(store.deliverable_head(), b);
+  store.pop_head();
+  ASSERT_EQ(store.deliverable_head(), a);
+  store.pop_head();
+  ASSERT_TRUE(store.empty());
+}
+
+TEST(PendingStoreTest, TestRemoveFromTheMiddle) {
+  multicast::MessagePool pool{};
+  multicast::PendingStore store{pool};
+  messages::DataMessage* a = store.insert(messages::DataMessage{1, 1, 0});
+  messages::DataMessage* b = store.insert(messages::DataMessage{2, 1, 0});
+  messages::DataMessage* c = store.insert(messages::DataMessage{3, 1, 0});
+  store.reorder(a, 1, 0, true);
+  store.reorder(b, 2, 0, false);
+  store.reorder(c, 3, 0, true);
+
+  // b no longer holds c up once it is gone
+  multicast::PendingStore::Handle removed = store.remove(2, 1);
+  ASSERT_TRUE(removed);
+  ASSERT_EQ(removed->msg.sender, 2);
+  ASSERT_FALSE(store.remove(2, 1));
+  ASSERT_EQ(store.find(2, 1), nullptr);
+  ASSERT_EQ(store.size(), 2);
+  removed.reset();
+  ASSERT_EQ(pool.stats().in_use, 2);
+
+  ASSERT_EQ(store.deliverable_head(), a);
+  store.pop_head();
+  ASSERT_EQ(store.deliverable_head(), c);
+  store.pop_head();
+  ASSERT_TRUE(store.empty());
+  ASSERT_EQ(store.deliverable_head(), nullptr);
+}
+
+TEST(PendingStoreTest, TestManyMessages) {
+  multicast::MessagePool pool{};
+  multicast::PendingStore store{pool};
+  const uint32_t count{1000};
+  for (uint32_t i = 0; i < count; i++) {
+    messages::DataMessage* m = store.insert(messages::DataMessage{i % 4, i, i});
+    // Finalize in reverse so every reorder moves the message
+    store.reorder(m, 1, 0, false);
+  }
+  for (uint32_t i = 0; i < count; i++) {
+    store.reorder(store.find(i % 4, i), 2 * count - i, i % 4, true);
+  }
+
+  uint32_t last{};
+  uint32_t delivered{};
+  while (messages::DataMessage* m = store.deliverable_head()) {
+    ASSERT_GT(m->final_seq, last);
+    last = m->final_seq;
+    store.pop_head();
+    delivered++;
+  }
+  ASSERT_EQ(delivered, count);
+  ASSERT_TRUE(store.empty());
+}
+
+TEST(PendingStoreTest, TestEntriesReturnToPool) {
+  multicast::MessagePool pool{16};
+  multicast::PendingStore store{pool, 16};
+  ASSERT_EQ(pool.stats().capacity, 16);
+
+  for (uint32_t round = 0; round < 10; round++) {
+    for (uint32_t i = 0; i < 16; i++) {
+      messages::DataMessage* m =
+          store.insert(messages::DataMessage{0, round * 16 + i, 0});
+      store.reorder(m, round * 16 + i + 1, 0, true);
+    }
+    ASSERT_EQ(pool.stats().in_use, 16);
+    while (store.deliverable_head()) {
+      store.pop_head();
+    }
+    ASSERT_EQ(pool.stats().in_use, 0);
+  }
+
+  // Steady state never needed more than the initial slab
+  ASSERT_EQ(pool.stats().capacity, 16);
+  ASSERT_EQ(pool.stats().slabs, 1);
+  ASSERT_EQ(pool.stats().high_water, 16);
+}
+
+TEST(PendingStoreTest, TestDestructorReleasesEntries) {
+  multicast::MessagePool pool{};
+  {
+    multicast::PendingStore store{pool};
+    store.insert(messages::DataMessage{0, 1, 0});
+    store.insert(messages::DataMessage{0, 2, 0});
+    ASSERT_EQ(pool.stats().in_use, 2);
+  }
+  ASSERT_EQ(pool.stats().in_use, 0);
+}
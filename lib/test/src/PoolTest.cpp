@@ -0,0 +1,86 @@
+#include "gtest/gtest.h"
+
+#include "pool.hpp"
+
+namespace {
+struct Tracked {
+  explicit Tracked(int& live, int value) : live{live}, value{value} { live++; }
+  ~Tracked() { live--; }
+  int& live;
+  int value;
+};
+}  // namespace
+
+/************************************************
+ *  Object Pool Tests
+ ***********************************************/
+TEST(ObjectPoolTest, TestAcquireConstructs) {
+  int live{};
+  multicast::ObjectPool<Tracked> pool{4};
+  auto a = pool.acquire(live, 1);
+  auto b = pool.acquire(live, 2);
+  ASSERT_EQ(live, 2);
+  ASSERT_EQ(a->value, 1);
+  ASSERT_EQ(b->value, 2);
+  ASSERT_EQ(pool.stats().in_use, 2);
+  ASSERT_EQ(pool.stats().capacity, 4);
+}
+
+TEST(ObjectPoolTest, TestHandleReleases) {
+  int live{};
+  multicast::ObjectPool<Tracked> pool{4};
+  {
+    auto a = pool.acquire(live, 1);
+    ASSERT_EQ(live, 1);
+  }
+  ASSERT_EQ(live, 0);
+  ASSERT_EQ(pool.stats().in_use, 0);
+  ASSERT_EQ(pool.stats().high_water, 1);
+}
+
+TEST(ObjectPoolTest, TestSlotsReused) {
+  int live{};
+  multicast::ObjectPool<Tracked> pool{2};
+  Tracked* first{};
+  {
+    auto a = pool.acquire(live, 1);
+    first = a.get();
+  }
+  auto b = pool.acquire(live, 2);
+  ASSERT_EQ(b.get(), first);
+  ASSERT_EQ(pool.stats().slabs, 1);
+}
+
+TEST(ObjectPoolTest, TestGrowsBySlab) {
+  int live{};
+  multicast::ObjectPool<Tracked> pool{2};
+  std::vector<multicast::ObjectPool<Tracked>::Handle> handles{};
+  for (int i = 0; i < 5; i++) {
+    handles.push_back(pool.acquire(live, i));
+  }
+  ASSERT_EQ(pool.stats().slabs, 3);
+  ASSERT_EQ(pool.stats().capacity, 6);
+  ASSERT_EQ(pool.stats().high_water, 5);
+  handles.clear();
+  ASSERT_EQ(live, 0);
+  ASSERT_EQ(pool.stats().in_use, 0);
+  ASSERT_EQ(pool.stats().high_water, 5);
+}
+
+TEST(ObjectPoolTest, TestReserve) {
+  multicast::ObjectPool<int> pool{8};
+  pool.reserve(20);
+  ASSERT_EQ(pool.stats().capacity, 24);
+  ASSERT_EQ(pool.stats().in_use, 0);
+}
+
+TEST(ObjectPoolTest, TestAdopt) {
+  multicast::ObjectPool<int> pool{8};
+  int* raw = pool.acquire(5).release();
+  ASSERT_EQ(pool.stats().in_use, 1);
+  {
+    auto handle = pool.adopt(raw);
+    ASSERT_EQ(*handle, 5);
+  }
+  ASSERT_EQ(pool.stats().in_use, 0);
+}
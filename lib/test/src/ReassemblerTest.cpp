@@ -0,0 +1,131 @@
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "reassembly.hpp"
+
+namespace {
+using messages::FragmentMessage;
+using multicast::BufferPool;
+using multicast::BufferRef;
+using multicast::Reassembler;
+
+/**
+ * Fragment index of message msg_id of sender, whole being the message cut
+ * into slices of slice bytes.
+ */
+FragmentMessage piece(uint32_t sender, uint32_t msg_id,
+                      const std::string& whole, std::size_t slice,
+                      uint32_t index) {
+  uint32_t count{static_cast<uint32_t>((whole.size() + slice - 1) / slice)};
+  std::size_t offset{index * slice};
+  FragmentMessage F{sender, msg_id, static_cast<uint32_t>(whole.size()),
+                    static_cast<uint32_t>(offset), index, count};
+  F.bytes = whole.data() + offset;
+  F.bytes_size = std::min(slice, whole.size() - offset);
+  return F;
+}
+
+std::string message(char c, std::size_t size) {
+  std::string whole(size, c);
+  for (std::size_t i = 0; i < size; i += 7) whole[i] = 'a' + i % 26;
+  return whole;
+}
+}  // namespace
+
+/************************************************
+ *  Reassembler Tests
+ ***********************************************/
+TEST(ReassemblerTest, TestOutOfOrderFragments) {
+  BufferPool pool{4096};
+  Reassembler reassembler{pool, 2, 2};
+  std::string whole{message('x', 1000)};
+  BufferRef buffer{};
+  for (uint32_t index : {3u, 0u, 2u}) {
+    ASSERT_FALSE(reassembler.add(piece(1, 5, whole, 300, index), buffer));
+    ASSERT_FALSE(buffer);
+  }
+  ASSERT_EQ(reassembler.in_progress(), 1);
+  ASSERT_TRUE(reassembler.add(piece(1, 5, whole, 300, 1), buffer));
+  ASSERT_TRUE(buffer);
+  ASSERT_EQ(std::string(buffer->data(), whole.size()), whole);
+  ASSERT_EQ(reassembler.in_progress(), 0);
+}
+
+TEST(ReassemblerTest, TestSingleFragment) {
+  BufferPool pool{64};
+  Reassembler reassembler{pool, 1, 1};
+  std::string whole{"whole"};
+  BufferRef buffer{};
+  ASSERT_TRUE(reassembler.add(piece(0, 0, whole, 64, 0), buffer));
+  ASSERT_EQ(std::string(buffer->data(), whole.size()), whole);
+}
+
+TEST(ReassemblerTest, TestIgnoresDuplicates) {
+  BufferPool pool{4096};
+  Reassembler reassembler{pool, 1, 1};
+  std::string whole{message('y', 900)};
+  BufferRef buffer{};
+  ASSERT_FALSE(reassembler.add(piece(0, 1, whole, 300, 0), buffer));
+  ASSERT_FALSE(reassembler.add(piece(0, 1, whole, 300, 0), buffer));
+  ASSERT_FALSE(reassembler.add(piece(0, 1, whole, 300, 2), buffer));
+  ASSERT_FALSE(reassembler.add(piece(0, 1, whole, 300, 2), buffer));
+  ASSERT_TRUE(reassembler.add(piece(0, 1, whole, 300, 1), buffer));
+  ASSERT_EQ(std::string(buffer->data(), whole.size()), whole);
+
+  // Retransmitted after it came together, starts over
+  buffer = BufferRef{};
+  ASSERT_FALSE(reassembler.add(piece(0, 1, whole, 300, 1), buffer));
+  ASSERT_EQ(reassembler.in_progress(), 1);
+}
+
+TEST(ReassemblerTest, TestBoundsMessagesPerSender) {
+  BufferPool pool{4096};
+  Reassembler reassembler{pool, 2, 2};
+  std::string whole{message('z', 900)};
+  BufferRef buffer{};
+  // Two of sender 0 in progress, a third takes the place of the one that
+  // has gone longest without a fragment
+  ASSERT_FALSE(reassembler.add(piece(0, 1, whole, 300, 0), buffer));
+  ASSERT_FALSE(reassembler.add(piece(0, 2, whole, 300, 0), buffer));
+  ASSERT_FALSE(reassembler.add(piece(1, 1, whole, 300, 0), buffer));
+  ASSERT_FALSE(reassembler.add(piece(0, 1, whole, 300, 1), buffer));
+  ASSERT_EQ(reassembler.evicted(), 0);
+  ASSERT_FALSE(reassembler.add(piece(0, 3, whole, 300, 0), buffer));
+  ASSERT_EQ(reassembler.evicted(), 1);
+  ASSERT_EQ(reassembler.in_progress(), 3);
+  ASSERT_EQ(pool.stats().in_use, 3);
+
+  // Message 2 starts over in place of 1, other senders are left alone
+  ASSERT_FALSE(reassembler.add(piece(0, 2, whole, 300, 1), buffer));
+  ASSERT_EQ(reassembler.evicted(), 2);
+  ASSERT_FALSE(reassembler.add(piece(1, 1, whole, 300, 1), buffer));
+  ASSERT_TRUE(reassembler.add(piece(1, 1, whole, 300, 2), buffer));
+  ASSERT_EQ(std::string(buffer->data(), whole.size()), whole);
+}
+
+TEST(ReassemblerTest, TestRejectsInconsistentFragments) {
+  BufferPool pool{1024};
+  Reassembler reassembler{pool, 2, 1};
+  std::string whole{message('w', 600)};
+  BufferRef buffer{};
+  ASSERT_THROW(reassembler.add(piece(2, 0, whole, 300, 0), buffer),
+               std::runtime_error);
+  ASSERT_THROW(reassembler.add(piece(0, 0, message('v', 2000), 300, 0),
+                               buffer),
+               std::runtime_error);
+
+  FragmentMessage past{piece(0, 0, whole, 300, 1)};
+  past.offset = 500;
+  ASSERT_THROW(reassembler.add(past, buffer), std::runtime_error);
+  FragmentMessage index{piece(0, 0, whole, 300, 1)};
+  index.index = 2;
+  ASSERT_THROW(reassembler.add(index, buffer), std::runtime_error);
+
+  ASSERT_FALSE(reassembler.add(piece(0, 0, whole, 300, 0), buffer));
+  FragmentMessage size{piece(0, 0, whole, 300, 1)};
+  size.size = 700;
+  ASSERT_THROW(reassembler.add(size, buffer), std::runtime_error);
+  ASSERT_TRUE(reassembler.add(piece(0, 0, whole, 300, 1), buffer));
+}
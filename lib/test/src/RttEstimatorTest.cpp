@@ -0,0 +1,61 @@
+#include "gtest/gtest.h"
+#include <chrono>
+
+#include "rtt.hpp"
+
+namespace {
+using std::chrono::microseconds;
+using std::chrono::milliseconds;
+}  // namespace
+
+/************************************************
+ *  Rtt Estimator Tests
+ ***********************************************/
+TEST(RttEstimatorTest, TestInitialTimeout) {
+  multicast::RttEstimator rtt{milliseconds{100}, milliseconds{2},
+                              milliseconds{1000}};
+  ASSERT_EQ(rtt.rto(), milliseconds{100});
+  ASSERT_EQ(rtt.samples(), 0);
+}
+
+TEST(RttEstimatorTest, TestFirstSample) {
+  multicast::RttEstimator rtt{milliseconds{100}, microseconds{1},
+                              milliseconds{1000}};
+  rtt.sample(milliseconds{10});
+  ASSERT_EQ(rtt.srtt(), milliseconds{10});
+  ASSERT_EQ(rtt.rttvar(), milliseconds{5});
+  ASSERT_EQ(rtt.rto(), milliseconds{30});
+}
+
+TEST(RttEstimatorTest, TestConvergesOnSteadyRtt) {
+  multicast::RttEstimator rtt{milliseconds{100}, microseconds{1},
+                              milliseconds{1000}};
+  for (int i = 0; i < 100; i++) {
+    rtt.sample(microseconds{200});
+  }
+  ASSERT_EQ(rtt.srtt(), microseconds{200});
+  ASSERT_LT(rtt.rttvar(), microseconds{1});
+  ASSERT_LT(rtt.rto(), microseconds{210});
+}
+
+TEST(RttEstimatorTest, TestJitterWidensTimeout) {
+  multicast::RttEstimator steady{milliseconds{100}, microseconds{1},
+                                 milliseconds{1000}};
+  multicast::RttEstimator jittery{milliseconds{100}, microseconds{1},
+                                  milliseconds{1000}};
+  for (int i = 0; i < 50; i++) {
+    steady.sample(milliseconds{1});
+    jittery.sample(i % 2 ? microseconds{200} : microseconds{1800});
+  }
+  ASSERT_GT(jittery.rto(), steady.rto());
+}
+
+TEST(RttEstimatorTest, TestClamped) {
+  multicast::RttEstimator rtt{milliseconds{100}, milliseconds{2},
+                              milliseconds{50}};
+  ASSERT_EQ(rtt.rto(), milliseconds{50});
+  rtt.sample(microseconds{10});
+  ASSERT_EQ(rtt.rto(), milliseconds{2});
+  rtt.sample(milliseconds{500});
+  ASSERT_EQ(rtt.rto(), milliseconds{50});
+}
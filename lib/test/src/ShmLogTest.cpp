@@ -0,0 +1,115 @@
+#include "gtest/gtest.h"
+#include <cstdio>
+#include <string>
+
+#include <unistd.h>
+
+#include "shmlog.hpp"
+
+namespace {
+std::string log_path(const std::string& name) {
+  return "/dev/shm/isis_multicast_test_" + name + "_" +
+         std::to_string(::getpid());
+}
+
+multicast::Delivery make_delivery(uint32_t seq, const std::string& payload) {
+  multicast::Delivery delivery{};
+  delivery.sender = 2;
+  delivery.msg_id = seq;
+  delivery.data = seq * 10;
+  delivery.final_seq = seq;
+  delivery.final_seq_proposer = 1;
+  delivery.payload.data = payload.data();
+  delivery.payload.size = payload.size();
+  return delivery;
+}
+}  // namespace
+
+/************************************************
+ *  Shared Memory Log Tests
+ ***********************************************/
+TEST(ShmLogTest, TestRoundTrip) {
+  std::string path{log_path("round_trip")};
+  multicast::ShmLogSink sink{path, 4096};
+  multicast::ShmLogReader reader{path};
+
+  std::vector<std::string> payloads{"", "a", "hello world"};
+  std::vector<multicast::Delivery> batch{};
+  for (uint32_t i = 0; i < payloads.size(); i++) {
+    batch.push_back(make_delivery(i, payloads[i]));
+  }
+  multicast::ShmLogReader::Entry entry{};
+  ASSERT_EQ(reader.next(entry), multicast::ShmLogReader::Status::kEmpty);
+  sink.deliver(batch.data(), batch.size());
+  ASSERT_EQ(reader.published(), 3);
+
+  for (uint32_t i = 0; i < payloads.size(); i++) {
+    ASSERT_EQ(reader.next(entry), multicast::ShmLogReader::Status::kEntry);
+    ASSERT_EQ(entry.record->index, i);
+    ASSERT_EQ(entry.record->msg_id, i);
+    ASSERT_EQ(entry.record->data, i * 10);
+    ASSERT_EQ(entry.record->sender, 2);
+    ASSERT_EQ(std::string(entry.payload, entry.record->payload_size),
+              payloads[i]);
+    ASSERT_TRUE(reader.valid(entry));
+  }
+  ASSERT_EQ(reader.next(entry), multicast::ShmLogReader::Status::kEmpty);
+  ::unlink(path.c_str());
+}
+
+TEST(ShmLogTest, TestWrapsAndDetectsLapping) {
+  std::string path{log_path("lapping")};
+  multicast::ShmLogSink sink{path, 4096};
+  multicast::ShmLogReader reader{path};
+  std::string payload(200, 'x');
+
+  // Keep up for several trips around the ring
+  multicast::ShmLogReader::Entry entry{};
+  for (uint32_t i = 0; i < 100; i++) {
+    auto delivery = make_delivery(i, payload);
+    sink.deliver(&delivery, 1);
+    ASSERT_EQ(reader.next(entry), multicast::ShmLogReader::Status::kEntry);
+    ASSERT_EQ(entry.record->index, i);
+  }
+
+  // Fall a whole ring behind
+  for (uint32_t i = 100; i < 200; i++) {
+    auto delivery = make_delivery(i, payload);
+    sink.deliver(&delivery, 1);
+  }
+  ASSERT_EQ(reader.next(entry), multicast::ShmLogReader::Status::kLapped);
+  uint64_t last{};
+  while (reader.next(entry) == multicast::ShmLogReader::Status::kEntry) {
+    last = entry.record->index;
+  }
+  ASSERT_EQ(last, 199);
+  ASSERT_GT(reader.lost(), 0);
+  ASSERT_LT(reader.lost(), 100);
+  ::unlink(path.c_str());
+}
+
+TEST(ShmLogTest, TestFromLatest) {
+  std::string path{log_path("latest")};
+  multicast::ShmLogSink sink{path, 4096};
+  auto early = make_delivery(0, "early");
+  sink.deliver(&early, 1);
+
+  multicast::ShmLogReader reader{path, true};
+  multicast::ShmLogReader::Entry entry{};
+  ASSERT_EQ(reader.next(entry), multicast::ShmLogReader::Status::kEmpty);
+  auto late = make_delivery(1, "late");
+  sink.deliver(&late, 1);
+  ASSERT_EQ(reader.next(entry), multicast::ShmLogReader::Status::kEntry);
+  ASSERT_EQ(entry.record->msg_id, 1);
+  ::unlink(path.c_str());
+}
+
+TEST(ShmLogTest, TestRejectsOtherFiles) {
+  std::string path{log_path("bogus")};
+  FILE* file = std::fopen(path.c_str(), "w");
+  std::fputs("not a log", file);
+  std::fclose(file);
+  ASSERT_THROW(multicast::ShmLogReader{path}, std::runtime_error);
+  ::unlink(path.c_str());
+  ASSERT_THROW(multicast::ShmLogReader{path}, std::runtime_error);
+}
@@ -0,0 +1,93 @@
+#include "gtest/gtest.h"
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <boost/asio.hpp>
+
+#include "stats.hpp"
+
+namespace {
+multicast::StatsSnapshot make_snapshot() {
+  multicast::StatsSnapshot snapshot{};
+  snapshot.sent.data = 4;
+  snapshot.received.acks = 12;
+  snapshot.delivered = 7;
+  snapshot.retransmits.seq = 2;
+  snapshot.duplicates.ahead = 1;
+  multicast::LatencyHistogram histogram{};
+  histogram.record(100);
+  histogram.record(300);
+  snapshot.seq_to_delivery = histogram.snapshot();
+  return snapshot;
+}
+
+std::string temp_path(const std::string& name) {
+  return "/tmp/isis_multicast_" + name + "_" + std::to_string(getpid());
+}
+
+std::string read_file(const std::string& path) {
+  std::ifstream in{path};
+  std::string line{};
+  std::getline(in, line);
+  return line;
+}
+}  // namespace
+
+/************************************************
+ *  Stats Tests
+ ***********************************************/
+TEST(StatsTest, TestToJson) {
+  std::string json{multicast::to_json(make_snapshot())};
+  ASSERT_EQ(json.front(), '{');
+  ASSERT_EQ(json.back(), '}');
+  ASSERT_NE(json.find("\"sent\":{\"data\":4,"), std::string::npos);
+  ASSERT_NE(json.find("\"delivered\":7"), std::string::npos);
+  ASSERT_NE(json.find("\"acks_per_message\":3"), std::string::npos);
+  ASSERT_NE(json.find("\"retransmits\":{\"data\":0,\"seq\":2}"),
+            std::string::npos);
+  ASSERT_NE(json.find("\"ahead\":1"), std::string::npos);
+  ASSERT_NE(json.find("\"seq_to_delivery\":{\"count\":2,\"mean\":200,"
+                      "\"min\":100,\"p50\":100,"),
+            std::string::npos);
+  ASSERT_NE(json.find("\"data_to_acks\":{\"count\":0,"), std::string::npos);
+}
+
+TEST(StatsTest, TestReporterWritesFile) {
+  std::string path{temp_path("stats")};
+  std::remove(path.c_str());
+  {
+    multicast::StatsReporter reporter{make_snapshot, path,
+                                      std::chrono::milliseconds{10}};
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{1};
+    while (read_file(path).empty() &&
+           std::chrono::steady_clock::now() < deadline) {
+      std::this_thread::sleep_for(std::chrono::milliseconds{1});
+    }
+  }
+  // Complete, as the file is only ever replaced whole
+  ASSERT_EQ(read_file(path).back(), '}');
+  ASSERT_NE(read_file(path).find("\"delivered\":7"), std::string::npos);
+  std::remove(path.c_str());
+}
+
+TEST(StatsTest, TestReporterServesSocket) {
+  std::string path{temp_path("stats_sock")};
+  multicast::StatsReporter reporter{make_snapshot, "unix:" + path,
+                                    std::chrono::milliseconds{1000}};
+  boost::asio::io_context io_context{};
+  for (int i = 0; i < 2; i++) {
+    boost::asio::local::stream_protocol::socket socket{io_context};
+    socket.connect(boost::asio::local::stream_protocol::endpoint{path});
+    boost::asio::streambuf buf{};
+    boost::system::error_code error{};
+    boost::asio::read(socket, buf, error);
+    ASSERT_EQ(error, boost::asio::error::eof);
+    std::string json{boost::asio::buffers_begin(buf.data()),
+                     boost::asio::buffers_end(buf.data())};
+    ASSERT_EQ(json.back(), '\n');
+    ASSERT_NE(json.find("\"delivered\":7"), std::string::npos);
+  }
+}
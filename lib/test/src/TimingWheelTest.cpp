@@ -0,0 +1,100 @@
+#include "gtest/gtest.h"
+#include <chrono>
+#include <vector>
+
+#include "timer_wheel.hpp"
+
+namespace {
+using Clock = multicast::TimingWheel::Clock;
+using std::chrono::milliseconds;
+
+struct Expiry {
+  uint32_t id;
+  uint64_t tick;
+};
+}  // namespace
+
+/************************************************
+ *  Timing Wheel Tests
+ ***********************************************/
+TEST(TimingWheelTest, TestExpiresInOrderOfTicks) {
+  Clock::time_point start{};
+  multicast::TimingWheel wheel{milliseconds{1}, 8, start};
+  wheel.schedule(1, milliseconds{3}, start);
+  wheel.schedule(2, milliseconds{1}, start);
+  wheel.schedule(3, milliseconds{2}, start);
+  ASSERT_EQ(wheel.size(), 3);
+
+  std::vector<uint32_t> expired{};
+  auto collect = [&](uint32_t id, uint64_t) { expired.push_back(id); };
+  ASSERT_EQ(wheel.advance(start + milliseconds{1}, collect), 1);
+  ASSERT_EQ(wheel.advance(start + milliseconds{3}, collect), 2);
+  ASSERT_EQ(expired, (std::vector<uint32_t>{2, 3, 1}));
+  ASSERT_TRUE(wheel.empty());
+}
+
+TEST(TimingWheelTest, TestNeverExpiresEarly) {
+  Clock::time_point start{};
+  multicast::TimingWheel wheel{milliseconds{1}, 8, start};
+  // Half way into a tick, due half way into the tick after next
+  uint64_t tick = wheel.schedule(1, milliseconds{2},
+                                 start + std::chrono::microseconds{500});
+  ASSERT_EQ(tick, 3);
+  std::size_t expired{};
+  auto count = [&](uint32_t, uint64_t) { expired++; };
+  wheel.advance(start + std::chrono::microseconds{2900}, count);
+  ASSERT_EQ(expired, 0);
+  wheel.advance(start + milliseconds{3}, count);
+  ASSERT_EQ(expired, 1);
+}
+
+TEST(TimingWheelTest, TestTimersBeyondOneRevolution) {
+  Clock::time_point start{};
+  multicast::TimingWheel wheel{milliseconds{1}, 4, start};
+  // Both land in slot 1, one revolution apart
+  wheel.schedule(1, milliseconds{1}, start);
+  wheel.schedule(2, milliseconds{5}, start);
+
+  std::vector<Expiry> expired{};
+  auto collect = [&](uint32_t id, uint64_t tick) {
+    expired.push_back(Expiry{id, tick});
+  };
+  wheel.advance(start + milliseconds{4}, collect);
+  ASSERT_EQ(expired.size(), 1);
+  ASSERT_EQ(expired[0].id, 1);
+  ASSERT_EQ(expired[0].tick, 1);
+  wheel.advance(start + milliseconds{5}, collect);
+  ASSERT_EQ(expired.size(), 2);
+  ASSERT_EQ(expired[1].id, 2);
+  ASSERT_EQ(expired[1].tick, 5);
+}
+
+TEST(TimingWheelTest, TestRescheduleFromExpiry) {
+  Clock::time_point start{};
+  multicast::TimingWheel wheel{milliseconds{1}, 4, start};
+  wheel.schedule(7, milliseconds{1}, start);
+  std::size_t expired{};
+  auto again = [&](uint32_t id, uint64_t tick) {
+    expired++;
+    if (expired < 3) {
+      // A full revolution out lands in the slot being expired
+      wheel.schedule(id, milliseconds{4}, start + milliseconds{tick});
+    }
+  };
+  wheel.advance(start + milliseconds{20}, again);
+  ASSERT_EQ(expired, 3);
+  ASSERT_TRUE(wheel.empty());
+}
+
+TEST(TimingWheelTest, TestIdleWheelSkipsAhead) {
+  Clock::time_point start{};
+  multicast::TimingWheel wheel{milliseconds{1}, 4, start};
+  wheel.advance(start + std::chrono::hours{1},
+                [](uint32_t, uint64_t) { FAIL(); });
+  ASSERT_EQ(wheel.current_tick(), 3600000);
+  ASSERT_EQ(wheel.next_tick(), start + std::chrono::hours{1} + milliseconds{1});
+  // A delay of zero still waits for the next tick
+  ASSERT_EQ(wheel.schedule(1, Clock::duration::zero(),
+                           start + std::chrono::hours{1}),
+            3600001);
+}
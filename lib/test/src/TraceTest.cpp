@@ -0,0 +1,169 @@
+#include "gtest/gtest.h"
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "trace.hpp"
+
+namespace {
+using multicast::trace::Event;
+using multicast::trace::Kind;
+
+std::string temp_path(const std::string& name) {
+  return "/tmp/isis_multicast_" + name + "_" + std::to_string(getpid());
+}
+
+Event event(uint64_t time_ns, uint32_t node, Kind kind, uint8_t type,
+            uint32_t sender, uint32_t msg_id) {
+  return Event{time_ns, node, sender, msg_id, 0, 0, kind, type, 0};
+}
+}  // namespace
+
+/************************************************
+ *  Tracer Tests
+ ***********************************************/
+TEST(TracerTest, TestRecordsFromEveryThread) {
+  std::string path{temp_path("trace")};
+  {
+    multicast::Tracer tracer{path, 2, 3};
+    std::vector<std::thread> threads{};
+    for (uint32_t t = 0; t < 4; t++) {
+      threads.emplace_back([&tracer, t]() {
+        for (uint32_t i = 0; i < 1000; i++) {
+          tracer.record(Kind::kSent, 1, t, i, 0, multicast::trace::kGroup);
+        }
+      });
+    }
+    for (auto& thread : threads) thread.join();
+    ASSERT_EQ(tracer.dropped(), 0);
+  }
+  auto file = multicast::trace::read_file(path);
+  ASSERT_EQ(file.first.node, 2);
+  ASSERT_EQ(file.first.group_size, 3);
+  ASSERT_EQ(file.second.size(), 4000);
+  std::vector<uint32_t> next(4);
+  for (const Event& e : file.second) {
+    ASSERT_EQ(e.node, 2);
+    ASSERT_EQ(e.kind, Kind::kSent);
+    // In order per thread
+    ASSERT_EQ(e.msg_id, next[e.sender]++);
+  }
+  std::remove(path.c_str());
+}
+
+TEST(TracerTest, TestDropsWhenRingIsFull) {
+  std::string path{temp_path("trace_full")};
+  {
+    multicast::Tracer tracer{path, 0, 1, 64, std::chrono::seconds{60}};
+    for (uint32_t i = 0; i < 100; i++) {
+      tracer.record(Kind::kReceived, 2, 0, i, 0, 0);
+    }
+    ASSERT_EQ(tracer.dropped(), 36);
+    tracer.flush();
+    tracer.record(Kind::kReceived, 2, 0, 100, 0, 0);
+  }
+  auto file = multicast::trace::read_file(path);
+  ASSERT_EQ(file.second.size(), 65);
+  ASSERT_EQ(file.second.back().msg_id, 100);
+  std::remove(path.c_str());
+}
+
+TEST(TracerTest, TestTracersShareThreads) {
+  std::string first_path{temp_path("trace_first")};
+  std::string second_path{temp_path("trace_second")};
+  {
+    multicast::Tracer first{first_path, 0, 2};
+    multicast::Tracer second{second_path, 1, 2};
+    for (uint32_t i = 0; i < 10; i++) {
+      first.record(Kind::kSent, 1, 0, i, 0, 1);
+      second.record(Kind::kReceived, 1, 0, i, 0, 0);
+    }
+  }
+  ASSERT_EQ(multicast::trace::read_file(first_path).second.size(), 10);
+  ASSERT_EQ(multicast::trace::read_file(second_path).second.size(), 10);
+  std::remove(first_path.c_str());
+  std::remove(second_path.c_str());
+}
+
+TEST(TracerTest, TestRejectsOtherFiles) {
+  std::string path{temp_path("not_trace")};
+  { std::ofstream{path} << "not a trace file at all"; }
+  ASSERT_THROW(multicast::trace::read_file(path), std::runtime_error);
+  std::remove(path.c_str());
+  ASSERT_THROW(multicast::trace::read_file(path), std::runtime_error);
+}
+
+/************************************************
+ *  Critical Path Tests
+ ***********************************************/
+TEST(CriticalPathTest, TestIsisPhases) {
+  // Process 0 multicasts message 5 to itself and 1, which delivers last
+  std::vector<Event> events{
+      event(1000, 1, Kind::kReceived, 1, 0, 5),
+      event(100, 0, Kind::kSent, 1, 0, 5),
+      event(150, 0, Kind::kReceived, 1, 0, 5),
+      event(200, 0, Kind::kReceived, 2, 0, 5),
+      event(1500, 0, Kind::kReceived, 2, 0, 5),
+      event(1600, 0, Kind::kSent, 3, 0, 5),
+      // A repeated ack after the Seq went out
+      event(1700, 0, Kind::kReceived, 2, 0, 5),
+      event(1650, 0, Kind::kReceived, 3, 0, 5),
+      event(1660, 0, Kind::kDelivered, 1, 0, 5),
+      event(2100, 1, Kind::kReceived, 3, 0, 5),
+      event(2600, 1, Kind::kDelivered, 1, 0, 5),
+  };
+  auto paths = multicast::trace::critical_paths(events);
+  ASSERT_EQ(paths.size(), 1);
+  ASSERT_EQ(paths[0].sender, 0);
+  ASSERT_EQ(paths[0].msg_id, 5);
+  ASSERT_EQ(paths[0].last_node, 1);
+  ASSERT_EQ(paths[0].total, 2500);
+  ASSERT_EQ(paths[0].to_order, 1400);
+  ASSERT_EQ(paths[0].to_seq, 100);
+  ASSERT_EQ(paths[0].to_last, 500);
+  ASSERT_EQ(paths[0].to_deliver, 500);
+}
+
+TEST(CriticalPathTest, TestSequencerPhases) {
+  // Process 1 sequences message 2 of process 0
+  std::vector<Event> events{
+      event(100, 0, Kind::kSent, 1, 0, 2),
+      event(300, 1, Kind::kReceived, 1, 0, 2),
+      event(350, 1, Kind::kSent, 3, 0, 2),
+      event(400, 1, Kind::kReceived, 3, 0, 2),
+      event(420, 1, Kind::kDelivered, 1, 0, 2),
+      event(500, 0, Kind::kReceived, 3, 0, 2),
+      event(900, 0, Kind::kDelivered, 1, 0, 2),
+  };
+  auto paths = multicast::trace::critical_paths(events);
+  ASSERT_EQ(paths.size(), 1);
+  ASSERT_EQ(paths[0].last_node, 0);
+  ASSERT_EQ(paths[0].to_order, 200);
+  ASSERT_EQ(paths[0].to_seq, 50);
+  ASSERT_EQ(paths[0].to_last, 150);
+  ASSERT_EQ(paths[0].to_deliver, 400);
+}
+
+TEST(CriticalPathTest, TestStreamAndIncompleteMessages) {
+  std::vector<Event> events{
+      event(100, 0, Kind::kSent, 6, 0, 1),
+      event(300, 1, Kind::kReceived, 6, 0, 1),
+      event(700, 1, Kind::kDelivered, 6, 0, 1),
+      // Never delivered
+      event(100, 0, Kind::kSent, 1, 0, 2),
+      // Sent before the trace began
+      event(500, 1, Kind::kDelivered, 1, 0, 3),
+  };
+  auto paths = multicast::trace::critical_paths(events);
+  ASSERT_EQ(paths.size(), 1);
+  ASSERT_EQ(paths[0].msg_id, 1);
+  ASSERT_EQ(paths[0].total, 600);
+  ASSERT_EQ(paths[0].to_order, multicast::trace::kMissing);
+  ASSERT_EQ(paths[0].to_seq, multicast::trace::kMissing);
+  ASSERT_EQ(paths[0].to_last, 200);
+  ASSERT_EQ(paths[0].to_deliver, 400);
+}
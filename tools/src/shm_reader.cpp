@@ -0,0 +1,81 @@
+#include <boost/program_options.hpp>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include <spdlog/spdlog.h>
+
+#include "shmlog.hpp"
+
+/**
+ * Follow the delivery log a multicaster writes with --shm and print every
+ * delivery in order.
+ */
+int main(int argc, char** argv) {
+  using namespace boost::program_options;
+
+  bool is_help{};
+  bool from_latest{};
+  bool follow{};
+  options_description description{"shm reader "};
+  description.add_options()("help,h", bool_switch(&is_help),
+                            "display a help dialog")(
+      "log,l", value<std::string>(), "path of the delivery log")(
+      "latest", bool_switch(&from_latest),
+      "skip what is already in the log")(
+      "follow,f", bool_switch(&follow),
+      "keep waiting for new deliveries instead of exiting");
+
+  command_line_parser parser{argc, argv};
+  parser.options(description);
+
+  variables_map vm;
+  try {
+    store(parser.run(), vm);
+    notify(vm);
+  } catch (const std::exception& e) {
+    spdlog::error("{}", e.what());
+    return -1;
+  }
+
+  if (is_help) {
+    std::cout << description;
+    return 0;
+  }
+  if (vm["log"].empty()) {
+    spdlog::error("Must provide a log");
+    return -1;
+  }
+
+  try {
+    multicast::ShmLogReader reader{vm["log"].as<std::string>(), from_latest};
+    multicast::ShmLogReader::Entry entry{};
+    while (true) {
+      switch (reader.next(entry)) {
+        case multicast::ShmLogReader::Status::kEntry: {
+          // Copy out first, the writer may lap us while we look at it
+          multicast::shmlog::Record m = *entry.record;
+          if (!reader.valid(entry)) break;
+          std::cout << m.index << ": message " << m.msg_id << " from sender "
+                    << m.sender << " with seq (" << m.final_seq << ", "
+                    << m.final_seq_proposer << ") and " << m.payload_size
+                    << " bytes of payload\n";
+          break;
+        }
+        case multicast::ShmLogReader::Status::kLapped:
+          spdlog::warn("Fell behind the writer, {} deliveries lost so far",
+                       reader.lost());
+          break;
+        case multicast::ShmLogReader::Status::kEmpty:
+          std::cout.flush();
+          if (!follow) return 0;
+          std::this_thread::sleep_for(std::chrono::milliseconds{1});
+          break;
+      }
+    }
+  } catch (std::exception& e) {
+    spdlog::error("{}", e.what());
+    return -1;
+  }
+}
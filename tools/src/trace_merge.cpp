@@ -0,0 +1,211 @@
+#include <algorithm>
+#include <boost/program_options.hpp>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+#include "histogram.hpp"
+#include "trace.hpp"
+
+namespace {
+const char* kind_name(multicast::trace::Kind kind) {
+  switch (kind) {
+    case multicast::trace::Kind::kSent:
+      return "sent";
+    case multicast::trace::Kind::kReceived:
+      return "received";
+    case multicast::trace::Kind::kDelivered:
+      return "delivered";
+  }
+  return "?";
+}
+
+const char* type_name(uint8_t type) {
+  switch (type) {
+    case 1:
+      return "Data";
+    case 2:
+      return "Ack";
+    case 3:
+      return "Seq";
+    case 5:
+      return "SeqAck";
+    case 6:
+      return "Stream";
+    default:
+      return "?";
+  }
+}
+
+double to_us(int64_t ns) { return static_cast<double>(ns) / 1000; }
+
+/**
+ * Every event of message msg_id of sender, relative to the first.
+ */
+void print_timeline(const std::vector<multicast::trace::Event>& events,
+                    uint32_t sender, uint32_t msg_id) {
+  std::cout << "message " << msg_id << " from " << sender << "\n";
+  uint64_t start{};
+  for (const auto& e : events) {
+    if (e.sender != sender || e.msg_id != msg_id) continue;
+    if (!start) start = e.time_ns;
+    std::cout << std::setw(12) << to_us(e.time_ns - start) << " us  node "
+              << e.node << " " << kind_name(e.kind) << " "
+              << type_name(e.type);
+    if (e.kind != multicast::trace::Kind::kDelivered) {
+      bool sent{e.kind == multicast::trace::Kind::kSent};
+      std::cout << (sent ? " to " : " from ");
+      if (e.peer == multicast::trace::kGroup) {
+        std::cout << "group";
+      } else {
+        std::cout << e.peer;
+      }
+    }
+    if (e.seq) std::cout << " seq " << e.seq;
+    std::cout << "\n";
+  }
+}
+
+void print_phase(const std::string& name,
+                 const multicast::LatencyHistogram& histogram) {
+  auto s = histogram.snapshot();
+  std::cout << std::left << std::setw(12) << name << std::right
+            << std::setw(8) << s.count;
+  if (s.count) {
+    for (uint64_t ns : {static_cast<uint64_t>(s.mean()), s.percentile(0.5),
+                        s.percentile(0.9), s.percentile(0.99), s.max}) {
+      std::cout << std::setw(12) << to_us(ns);
+    }
+  }
+  std::cout << "\n";
+}
+}  // namespace
+
+/**
+ * Merge the trace files every host wrote with --trace and break the time
+ * of each message down along its critical path.
+ */
+int main(int argc, char** argv) {
+  using namespace boost::program_options;
+
+  bool is_help{};
+  bool all{};
+  options_description description{"trace merge "};
+  description.add_options()("help,h", bool_switch(&is_help),
+                            "display a help dialog")(
+      "trace,t", value<std::vector<std::string>>()->multitoken(),
+      "trace files of the hosts, any number")(
+      "slowest,n", value<std::size_t>()->default_value(10),
+      "break down this many of the slowest messages")(
+      "message,m", value<std::vector<std::string>>()->multitoken(),
+      "print the timeline of SENDER:MSG_ID")(
+      "all", bool_switch(&all), "print the timeline of every message");
+  positional_options_description positional{};
+  positional.add("trace", -1);
+
+  command_line_parser parser{argc, argv};
+  parser.options(description).positional(positional);
+
+  variables_map vm;
+  try {
+    store(parser.run(), vm);
+    notify(vm);
+  } catch (const std::exception& e) {
+    spdlog::error("{}", e.what());
+    return -1;
+  }
+
+  if (is_help) {
+    std::cout << description;
+    return 0;
+  }
+  if (vm["trace"].empty()) {
+    spdlog::error("Must provide a trace file");
+    return -1;
+  }
+
+  std::vector<multicast::trace::Event> events{};
+  try {
+    for (const auto& path : vm["trace"].as<std::vector<std::string>>()) {
+      auto file = multicast::trace::read_file(path);
+      spdlog::info("Read {} events of node {} from {}", file.second.size(),
+                   file.first.node, path);
+      events.insert(events.end(), file.second.begin(), file.second.end());
+    }
+  } catch (std::exception& e) {
+    spdlog::error("{}", e.what());
+    return -1;
+  }
+  auto paths = multicast::trace::critical_paths(events);
+
+  std::cout << std::fixed << std::setprecision(1);
+  if (!vm["message"].empty()) {
+    for (const auto& id : vm["message"].as<std::vector<std::string>>()) {
+      auto colon = id.find(':');
+      if (colon == std::string::npos) {
+        spdlog::error("Expected SENDER:MSG_ID, got {}", id);
+        return -1;
+      }
+      print_timeline(events, std::stoul(id.substr(0, colon)),
+                     std::stoul(id.substr(colon + 1)));
+    }
+    return 0;
+  }
+  if (all) {
+    for (const auto& path : paths) {
+      print_timeline(events, path.sender, path.msg_id);
+    }
+    return 0;
+  }
+
+  // Skew between the hosts' clocks can make a phase come out negative
+  multicast::LatencyHistogram total{}, to_order{}, to_seq{}, to_last{},
+      to_deliver{};
+  auto record = [](multicast::LatencyHistogram& histogram, int64_t ns) {
+    if (ns != multicast::trace::kMissing) {
+      histogram.record(static_cast<uint64_t>(std::max<int64_t>(ns, 0)));
+    }
+  };
+  for (const auto& path : paths) {
+    record(total, path.total);
+    record(to_order, path.to_order);
+    record(to_seq, path.to_seq);
+    record(to_last, path.to_last);
+    record(to_deliver, path.to_deliver);
+  }
+  std::cout << paths.size() << " messages delivered, in us\n"
+            << std::left << std::setw(12) << "phase" << std::right
+            << std::setw(8) << "count" << std::setw(12) << "mean"
+            << std::setw(12) << "p50" << std::setw(12) << "p90"
+            << std::setw(12) << "p99" << std::setw(12) << "max" << "\n";
+  print_phase("total", total);
+  print_phase("to_order", to_order);
+  print_phase("to_seq", to_seq);
+  print_phase("to_last", to_last);
+  print_phase("to_deliver", to_deliver);
+
+  std::sort(paths.begin(), paths.end(),
+            [](const multicast::trace::CriticalPath& a,
+               const multicast::trace::CriticalPath& b) {
+              return a.total > b.total;
+            });
+  std::size_t slowest{
+      std::min(vm["slowest"].as<std::size_t>(), paths.size())};
+  if (slowest) {
+    std::cout << "\nslowest messages, in us\n";
+  }
+  for (std::size_t i = 0; i < slowest; i++) {
+    const auto& p = paths[i];
+    std::cout << "message " << p.msg_id << " from " << p.sender
+              << " last delivered by " << p.last_node << ": total "
+              << to_us(p.total) << " = to_order " << to_us(p.to_order)
+              << " + to_seq " << to_us(p.to_seq) << " + to_last "
+              << to_us(p.to_last) << " + to_deliver " << to_us(p.to_deliver)
+              << "\n";
+  }
+  return 0;
+}